@@ -0,0 +1,53 @@
+/**
+ * allocationcounter.hpp
+ * Replaces the global allocation functions with malloc/free wrappers that count heap allocations and
+ * bytes, for benchmarks reporting what a code path allocates. Every plain, array and sized form is
+ * replaced, so each new is paired with a matching delete. Include from exactly one translation unit.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Heap allocations made through operator new since the program started
+inline std::atomic<uint64_t> allocationCount{0};
+
+// Bytes requested from operator new since the program started
+inline std::atomic<uint64_t> allocatedBytes{0};
+
+inline void* CountedAllocate(std::size_t _size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(_size, std::memory_order_relaxed);
+    if (void* p = std::malloc(_size == 0 ? 1 : _size)) return p;
+    throw std::bad_alloc();
+}
+
+// GCC cannot see that the replaced new allocates with malloc, and warns at every free below
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t _size) { return CountedAllocate(_size); }
+
+void* operator new[](std::size_t _size) { return CountedAllocate(_size); }
+
+void operator delete(void* _ptr) noexcept { std::free(_ptr); }
+
+void operator delete[](void* _ptr) noexcept { std::free(_ptr); }
+
+void operator delete(void* _ptr, std::size_t) noexcept { std::free(_ptr); }
+
+void operator delete[](void* _ptr, std::size_t) noexcept { std::free(_ptr); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
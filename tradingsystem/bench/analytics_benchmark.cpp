@@ -0,0 +1,85 @@
+/**
+ * analytics_benchmark.cpp
+ * Times ExecutionAnalytics accounting for fills with 100, 10000 and 1000000 orders open, to show that the
+ * cost per fill does not grow with the orders and markouts outstanding.
+ *
+ * The books of seven products are quoted once, then fills of one unit land on open orders picked at random,
+ * with a book update of the filled product after each fill settling the markouts that have come due. The
+ * analytics run on the steady clock with markout horizons of 10 us, 100 us and 1 ms, so markouts are both
+ * queued and settled throughout. Reported is the time per fill including its book update.
+ *
+ * Usage: analytics_benchmark [fills]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "executionanalytics.hpp"
+#include "products.hpp"
+#include "simulatedata.hpp"
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    long fills = argc > 1 ? atol(argv[1]) : 1000000;
+    const Ticks centre = Ticks::FromPoints(100);
+
+    vector<Bond> bonds;
+    for (const auto& cusip : CUSIPS_VEC) bonds.push_back(BondInfo(cusip));
+
+    cout << setw(10) << "OPEN" << setw(12) << "FILLS" << setw(12) << "PENDING" << setw(14) << "NS/FILL" << endl;
+
+    for (long open : {100L, 10000L, 1000000L}) {
+        BondMarketDataService<Bond> marketData;
+        ExecutionAnalytics<Bond> analytics(marketData, {10'000, 100'000, 1'000'000});
+        marketData.AddListener(analytics.GetMarketDataListener());
+        for (const auto& bond : bonds) {
+            vector<Order> bids{Order(centre - Ticks(1), 10000000, BID)};
+            vector<Order> offers{Order(centre + Ticks(1), 10000000, OFFER)};
+            OrderBook<Bond> book(bond, bids, offers);
+            marketData.OnMessage(book);
+        }
+
+        const OrderType types[] = {MARKET, IOC, LIMIT};
+        const ExecutionAlgo algos[] = {CROSSING_ALGO, QUOTING_ALGO, SLICING_ALGO};
+        vector<ExecutionOrder<Bond>> orders;
+        orders.reserve(open);
+        for (long i = 0; i < open; ++i) {
+            orders.emplace_back(bonds[i % bonds.size()], i % 2 == 0 ? BID : OFFER, "O" + to_string(i), types[i % 3],
+                                centre, 1000000000, 0, "", false);
+            orders.back().SetAlgo(algos[i % 3]);
+            analytics.OnOrder(orders.back());
+        }
+
+        // Fills are built up front so only the analytics are timed
+        mt19937 rng(42);
+        uniform_int_distribution<long> pick(0, open - 1);
+        vector<Fill<Bond>> batch;
+        batch.reserve(fills);
+        for (long i = 0; i < fills; ++i) {
+            const ExecutionOrder<Bond>& order = orders[pick(rng)];
+            batch.emplace_back(order.GetProduct(), "F", order.GetOrderId(), order.GetPriceSide(), centre, 1, 1, false, 0);
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (const auto& fill : batch) {
+            analytics.OnFill(fill);
+            analytics.OnBook(fill.GetProduct().GetProductId());
+        }
+        double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / fills;
+
+        ExecutionStats total;
+        for (ExecutionAlgo algo : algos) total += analytics.GetStats(algo);
+        if (total.filledQuantity != fills) throw std::logic_error("Fill count differs");
+        cout << setw(10) << open << setw(12) << fills << setw(12) << analytics.GetPendingMarkouts() << setw(14)
+             << fixed << setprecision(1) << nanos << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ * bookhistory_benchmark.cpp
+ * Measures BookHistory appends and window reductions, and compares the reductions against the same
+ * analytics computed from a deque of OrderBook copies, for windows of 64, 1024 and 16384 snapshots.
+ *
+ * Build with ENABLE_NATIVE_ARCH to let the reductions use the widest vectors of the host.
+ *
+ * Usage: bookhistory_benchmark [iterations]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "bookhistory.hpp"
+#include "products.hpp"
+
+using namespace std;
+
+// Keeps results observable so the optimizer cannot drop the timed work
+static double sink = 0;
+
+// Nanoseconds per iteration of a workload
+template <typename F>
+double TimePerOp(long _iterations, F&& _work) {
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < _iterations; ++i) _work(i);
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(elapsed) / _iterations;
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 2000;
+    constexpr size_t CAPACITY = 16384;
+    Bond bond = BondInfo("91282CLY5");
+    const string& productId = bond.GetProductId();
+    const Ticks mid = Ticks::FromPoints(100);
+
+    BondMarketDataService<Bond> service;
+    BookHistory<Bond> history(service, CAPACITY);
+    service.AddListener(&history);
+    deque<OrderBook<Bond>> books;
+
+    // One venue book per update, its top moving by a tick at a time
+    auto makeBook = [&](long _update) {
+        Ticks shift(_update % 16);
+        vector<Order> bids, offers;
+        for (int level = 0; level < 5; ++level) {
+            bids.emplace_back(mid + shift - Ticks(level + 1), 1000000L * (1 + (_update + level) % 9), BID);
+            offers.emplace_back(mid + shift + Ticks(level + 1), 1000000L * (1 + (_update + 2 * level) % 7), OFFER);
+        }
+        return OrderBook<Bond>(bond, bids, offers);
+    };
+
+    vector<OrderBook<Bond>> input;
+    for (long u = 0; u < static_cast<long>(CAPACITY); ++u) input.push_back(makeBook(u));
+    double append = TimePerOp(static_cast<long>(CAPACITY) * 4, [&](long i) {
+        service.OnMessage(input[i % CAPACITY]);
+        books.push_back(input[i % CAPACITY]);
+        if (books.size() > CAPACITY) books.pop_front();
+    });
+    cout << "snapshot + history append: " << fixed << setprecision(1) << append << " ns per update" << endl << endl;
+
+    cout << setw(8) << "WINDOW" << setw(14) << "QUERY" << setw(14) << "BOOKS(ns)" << setw(14) << "RING(ns)" << setw(10)
+         << "SPEEDUP" << endl;
+    for (size_t window : {size_t{64}, size_t{1024}, CAPACITY}) {
+        auto report = [&](const char* _name, double _books, double _ring) {
+            cout << setw(8) << window << setw(14) << _name << setw(14) << fixed << setprecision(1) << _books
+                 << setw(14) << _ring << setw(9) << setprecision(2) << _books / _ring << "x" << endl;
+        };
+
+        double booksSpread = TimePerOp(iterations, [&](long) {
+            double total = 0;
+            for (size_t i = books.size() - window; i < books.size(); ++i) {
+                total += (books[i].GetBestOffer().GetPrice() - books[i].GetBestBid().GetPrice()).Count();
+            }
+            sink += total / window;
+        });
+        double ringSpread = TimePerOp(iterations, [&](long) { sink += history.MeanSpread(productId, window); });
+        report("mean spread", booksSpread, ringSpread);
+
+        double booksVwap = TimePerOp(iterations, [&](long) {
+            double notional = 0, size = 0;
+            for (size_t i = books.size() - window; i < books.size(); ++i) {
+                const Order& bid = books[i].GetBestBid();
+                const Order& offer = books[i].GetBestOffer();
+                notional += static_cast<double>(bid.GetPrice().Count()) * bid.GetQuantity() +
+                            static_cast<double>(offer.GetPrice().Count()) * offer.GetQuantity();
+                size += bid.GetQuantity() + offer.GetQuantity();
+            }
+            sink += notional / size;
+        });
+        double ringVwap = TimePerOp(iterations, [&](long) { sink += history.TopVwap(productId, window); });
+        report("top vwap", booksVwap, ringVwap);
+    }
+
+    if (sink == 42) cout << sink << endl;
+    return 0;
+}
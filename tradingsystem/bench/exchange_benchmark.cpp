@@ -0,0 +1,104 @@
+/**
+ * exchange_benchmark.cpp
+ * Times SimulatedExchange matching orders and rematching resting orders as the books of seven products
+ * change, with 0, 100 and 1000 orders resting per product.
+ *
+ * Each update replaces the book of one product, with its mid within a tick of par and sizes drawn at random,
+ * as the connector does for a line of marketdata.txt. The seeded resting orders sit beyond the displayed
+ * depth, so they stay resting and are rechecked on every update of their product. Every tenth update an
+ * order arrives for the updated product: in turn a MARKET order, an IOC at the touch and a LIMIT a tick
+ * behind it, which rests until the queue ahead of it trades away. Reported is the time per update including
+ * the market data service, which is the rate at which the exchange can replay a market data file.
+ *
+ * Usage: exchange_benchmark [updates]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "products.hpp"
+#include "simulatedata.hpp"
+#include "simulatedexchange.hpp"
+
+using namespace std;
+
+/**
+ * Listener counting the fills published.
+ */
+class FillCounter : public ServiceListener<Fill<Bond>> {
+   public:
+    void ProcessAdd(Fill<Bond>& _data) { ++count; }
+    void ProcessRemove(Fill<Bond>& _data) {}
+    void ProcessUpdate(Fill<Bond>& _data) {}
+
+    uint64_t count = 0;
+};
+
+int main(int argc, char* argv[]) {
+    long updates = argc > 1 ? atol(argv[1]) : 1000000;
+    const Ticks centre = Ticks::FromPoints(100);
+
+    vector<Bond> bonds;
+    for (const auto& cusip : CUSIPS_VEC) bonds.push_back(BondInfo(cusip));
+
+    cout << setw(10) << "RESTING" << setw(12) << "ORDERS" << setw(12) << "FILLS" << setw(14) << "NS/UPDATE"
+         << setw(16) << "UPDATES/S" << endl;
+
+    for (int resting : {0, 100, 1000}) {
+        BondMarketDataService<Bond> marketData;
+        SimulatedExchange<Bond> exchange(marketData);
+        marketData.AddListener(exchange.GetMarketDataListener());
+        FillCounter counter;
+        exchange.AddListener(&counter);
+
+        mt19937_64 rng(42);
+        auto update = [&](size_t _b) {
+            Ticks mid = centre + Ticks(static_cast<int64_t>(rng() % 3) - 1);
+            vector<Order> bids, offers;
+            for (int level = 0; level < 5; ++level) {
+                bids.emplace_back(mid - Ticks(1 + level), 1000000 * (1 + rng() % 10), BID);
+                offers.emplace_back(mid + Ticks(1 + level), 1000000 * (1 + rng() % 10), OFFER);
+            }
+            OrderBook<Bond> book(bonds[_b], bids, offers);
+            marketData.OnMessage(book);
+        };
+
+        // Seed the books and the resting orders, spread over the ten prices beyond the displayed depth
+        for (size_t b = 0; b < bonds.size(); ++b) update(b);
+        for (size_t b = 0; b < bonds.size(); ++b) {
+            for (int i = 0; i < resting; ++i) {
+                PricingSide side = i % 2 ? BID : OFFER;
+                Ticks price = centre + Ticks(side == BID ? 7 + i % 10 : -7 - i % 10);
+                exchange.Submit(ExecutionOrder<Bond>(bonds[b], side, "R" + to_string(i), LIMIT, price, 1000000, 0, "",
+                                                     false));
+            }
+        }
+
+        uint64_t orders = 0;
+        auto start = chrono::steady_clock::now();
+        for (long u = 0; u < updates; ++u) {
+            size_t b = u % bonds.size();
+            update(b);
+            if (u % 10 != 0) continue;
+            const BidOffer bidOffer = marketData.GetBestBidOffer(bonds[b].GetProductId());
+            PricingSide side = orders % 2 ? BID : OFFER;
+            Ticks touch = side == BID ? bidOffer.GetBidOrder().GetPrice() : bidOffer.GetOfferOrder().GetPrice();
+            OrderType type = orders % 3 == 0 ? MARKET : orders % 3 == 1 ? IOC : LIMIT;
+            Ticks price = type == LIMIT ? touch + Ticks(side == BID ? 1 : -1) : touch;
+            exchange.Submit(ExecutionOrder<Bond>(bonds[b], side, to_string(orders), type, price, 2000000, 0, "", false));
+            ++orders;
+        }
+        double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / updates;
+
+        cout << setw(10) << resting * bonds.size() << setw(12) << orders << setw(12) << counter.count << setw(14)
+             << fixed << setprecision(1) << nanos << setw(16) << setprecision(0) << 1e9 / nanos << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * marketdata_benchmark.cpp
+ * Compares the bytes copied per market data update when every update is a full book snapshot
+ * against incremental level deltas applied in place, at depths of 5, 20 and 100 levels per side.
+ *
+ * Each update changes the quantity of one level. The snapshot path rebuilds both stacks, wraps them
+ * in a new OrderBook and hands it to BondMarketDataService::OnMessage, as the connector does for
+ * marketdata.txt; the delta path hands a single BookDelta to BondMarketDataService::OnDelta.
+ * Message bytes are the bytes of the message objects and stacks passed to the service; heap bytes
+ * are everything allocated while processing the updates. Each depth uses the service and books
+ * instantiated with that depth. Before timing, it checks that deltas deleting the best bid, including
+ * zero-quantity modifies, are reported as changing the top of the book.
+ *
+ * Usage: marketdata_benchmark [updates]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "allocationcounter.hpp"
+#include "marketdataservice.hpp"
+#include "products.hpp"
+
+using namespace std;
+
+/**
+ * Listener reading the top of the book on every update, as the algo execution listener does.
+ */
+template <size_t Depth>
+class TopOfBookListener : public BookDeltaListener<Bond, Depth> {
+   public:
+    void ProcessAdd(OrderBook<Bond, Depth>& _data) { sink += _data.GetBestBid().GetQuantity(); }
+    void ProcessDelta(BookDelta<Bond>& _delta, OrderBook<Bond, Depth>& _book) { sink += _book.GetBestBid().GetQuantity(); }
+    void ProcessRemove(OrderBook<Bond, Depth>& _data) {}
+    void ProcessUpdate(OrderBook<Bond, Depth>& _data) {}
+
+    long sink = 0;
+};
+
+// Time both paths through a service whose books hold Depth levels per side
+template <size_t Depth>
+void RunDepth(long _updates, const Bond& _bond, Ticks _mid) {
+    constexpr int depth = static_cast<int>(Depth);
+    BondMarketDataService<Bond, Depth> service;
+    TopOfBookListener<Depth> listener;
+    service.AddListener(&listener);
+
+    auto quantityAt = [](long _update, int _level) { return 1000000L * (1 + (_level + _update) % 9); };
+    auto report = [&](const char* _path, double _messageBytes, uint64_t _heapBytes, double _nanos) {
+        cout << setw(8) << depth << setw(10) << _path << setw(16) << fixed << setprecision(0) << _messageBytes
+             << setw(16) << static_cast<double>(_heapBytes) / _updates << setw(12) << setprecision(1)
+             << _nanos / _updates << endl;
+    };
+
+    // Full snapshot per update
+    uint64_t heapStart = allocatedBytes.load();
+    auto start = chrono::steady_clock::now();
+    for (long u = 0; u < _updates; ++u) {
+        vector<Order> bids, offers;
+        for (int level = 0; level < depth; ++level) {
+            bids.emplace_back(_mid - Ticks(level + 1), level == u % depth ? quantityAt(u, level) : 1000000L, BID);
+            offers.emplace_back(_mid + Ticks(level + 1), 1000000L, OFFER);
+        }
+        OrderBook<Bond, Depth> book(_bond, bids, offers);
+        service.OnMessage(book);
+    }
+    double snapshotNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    uint64_t snapshotHeap = allocatedBytes.load() - heapStart;
+    double snapshotBytes = sizeof(OrderBook<Bond, Depth>) + 2.0 * depth * sizeof(Order);
+    report("snapshot", snapshotBytes, snapshotHeap, snapshotNanos);
+
+    // One level delta per update, applied to the resident book
+    heapStart = allocatedBytes.load();
+    start = chrono::steady_clock::now();
+    for (long u = 0; u < _updates; ++u) {
+        int level = static_cast<int>(u % depth);
+        BookDelta<Bond> delta(_bond, MODIFY_LEVEL, Order(_mid - Ticks(level + 1), quantityAt(u, level), BID));
+        service.OnDelta(delta);
+    }
+    double deltaNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    uint64_t deltaHeap = allocatedBytes.load() - heapStart;
+    report("delta", sizeof(BookDelta<Bond>), deltaHeap, deltaNanos);
+
+    if (listener.sink == 42) cout << listener.sink << endl;
+}
+
+/**
+ * Check that deltas report a change of top exactly when they move the best bid: a zero-quantity modify
+ * of the best level deletes it like DELETE_LEVEL does, while one of a deeper or missing level does not.
+ */
+void CheckChangedTop(const Bond& _bond, Ticks _mid) {
+    vector<Order> bids, offers;
+    for (int level = 0; level < 3; ++level) {
+        bids.emplace_back(_mid - Ticks(level + 1), 1000000L, BID);
+        offers.emplace_back(_mid + Ticks(level + 1), 1000000L, OFFER);
+    }
+    OrderBook<Bond> book(_bond, bids, offers);
+
+    auto changedTop = [&](BookAction _action, Ticks _price, long _quantity) {
+        BookDelta<Bond> delta(_bond, _action, Order(_price, _quantity, BID));
+        delta.ApplyTo(book);
+        return delta.ChangedTop(book);
+    };
+    if (changedTop(MODIFY_LEVEL, _mid - Ticks(3), 0)) throw logic_error("Deeper zero-quantity modify changed top");
+    if (changedTop(MODIFY_LEVEL, _mid - Ticks(9), 0)) throw logic_error("Missing zero-quantity modify changed top");
+    if (!changedTop(MODIFY_LEVEL, _mid - Ticks(1), 0)) throw logic_error("Zero-quantity modify of top missed");
+    if (book.GetBestBid().GetPrice() != _mid - Ticks(2)) throw logic_error("Zero-quantity modify kept top level");
+    if (!changedTop(DELETE_LEVEL, _mid - Ticks(2), 0)) throw logic_error("Delete of top missed");
+}
+
+int main(int argc, char* argv[]) {
+    long updates = argc > 1 ? atol(argv[1]) : 1000000;
+    Bond bond = BondInfo("91282CLY5");
+    const Ticks mid = Ticks::FromPoints(100);
+    CheckChangedTop(bond, mid);
+
+    cout << setw(8) << "DEPTH" << setw(10) << "PATH" << setw(16) << "MSG BYTES/UPD" << setw(16) << "HEAP BYTES/UPD"
+         << setw(12) << "NS/UPD" << endl;
+
+    RunDepth<5>(updates, bond, mid);
+    RunDepth<20>(updates, bond, mid);
+    RunDepth<100>(updates, bond, mid);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * objectpool_benchmark.cpp
+ * Replays synthetic price ticks and book updates through AlgoStreamingService and
+ * AlgoExecutionService, reporting heap allocations and resident memory as the replay runs.
+ *
+ * Usage: objectpool_benchmark [ticks] [--legacy]
+ *   ticks     number of ticks to replay (default 7,000,000, the size of a full prices.txt)
+ *   --legacy  also heap-allocate and drop a payload per tick, as the unpooled wrappers did
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "algoexecutionservice.hpp"
+#include "algostreamingservice.hpp"
+#include "allocationcounter.hpp"
+#include "products.hpp"
+#include "simulatedata.hpp"
+
+using namespace std;
+
+// Resident set size in megabytes
+double ResidentMegabytes() {
+    ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+int main(int argc, char* argv[]) {
+    long ticks = 7000000;
+    bool legacy = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--legacy") == 0)
+            legacy = true;
+        else
+            ticks = atol(argv[i]);
+    }
+
+    AlgoStreamingService<Bond> algoStreamingService;
+    AlgoExecutionService<Bond> algoExecutionService;
+
+    vector<Bond> bonds;
+    for (const auto& cusip : CUSIPS_VEC) bonds.push_back(BondInfo(cusip));
+
+    cout << "Replaying " << ticks << " ticks" << (legacy ? " with a leaked payload per tick" : "") << endl;
+    cout << setw(12) << "TICKS" << setw(16) << "ALLOCATIONS" << setw(14) << "STREAM SLOTS" << setw(14)
+         << "ORDER SLOTS" << setw(12) << "RSS(MB)" << endl;
+
+    const long reportEvery = max(1L, ticks / 7);
+    auto start = chrono::steady_clock::now();
+    for (long tick = 1; tick <= ticks; ++tick) {
+        const Bond& bond = bonds[tick % bonds.size()];
+        Ticks mid = Ticks::FromPoints(99) + Ticks(tick % 512);
+
+        Price<Bond> price(bond, mid - Ticks(1), mid + Ticks(1));
+        algoStreamingService.PublishAlgorithmicPrice(price);
+
+        vector<Order> bids = {Order(mid - Ticks(1), 1000000, BID)};
+        vector<Order> offers = {Order(mid + Ticks(1), 1000000, OFFER)};
+        OrderBook<Bond> book(bond, bids, offers);
+        algoExecutionService.ExecuteOrder(book);
+
+        if (legacy) {
+            // The unpooled wrappers allocated these and never freed them
+            new PriceStream<Bond>(bond, PriceStreamOrder(mid, 1, 2, BID), PriceStreamOrder(mid, 1, 2, OFFER));
+            new ExecutionOrder<Bond>(bond, BID, "", MARKET, mid, 1, 0, "", false);
+        }
+
+        if (tick % reportEvery == 0 || tick == ticks) {
+            cout << setw(12) << tick << setw(16) << allocationCount.load() << setw(14)
+                 << algoStreamingService.GetStreamPool().GetCapacity() << setw(14)
+                 << algoExecutionService.GetOrderPool().GetCapacity() << setw(12) << fixed << setprecision(1)
+                 << ResidentMegabytes() << endl;
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Live price streams: " << algoStreamingService.GetStreamPool().GetLiveCount()
+         << ", live execution orders: " << algoExecutionService.GetOrderPool().GetLiveCount() << endl;
+    cout << "Throughput: " << setprecision(0) << ticks / seconds << " ticks/s" << endl;
+    return 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * orderbook_benchmark.cpp
+ * Compares the sorted OrderBook against the previous unsorted book, whose best bid and offer
+ * came from a linear scan of both stacks, at depths of 5, 20 and 100 orders per side. Each depth
+ * uses the OrderBook instantiated with that depth, so its stacks are inline arrays of that size.
+ *
+ * Three workloads are timed for each depth:
+ *   build+best  construct a book from connector-style stacks, then query the best bid/offer
+ *   best        query the best bid/offer of an existing book
+ *   level+best  update, insert or delete one price level, then query the best bid/offer
+ *
+ * Usage: orderbook_benchmark [iterations]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "marketdataservice.hpp"
+#include "products.hpp"
+
+using namespace std;
+
+/**
+ * The order book as it was before the stacks were kept sorted.
+ */
+class LegacyOrderBook {
+   public:
+    LegacyOrderBook(const Bond& _product, const vector<Order>& _bidStack, const vector<Order>& _offerStack)
+        : product(_product), bidStack(_bidStack), offerStack(_offerStack) {}
+
+    BidOffer GetBestBidOffer() const {
+        Ticks bestBidPrice(numeric_limits<int64_t>::lowest());
+        Order bestBid;
+        for (const auto& b : bidStack) {
+            if (b.GetPrice() > bestBidPrice) {
+                bestBidPrice = b.GetPrice();
+                bestBid = b;
+            }
+        }
+        Ticks bestOfferPrice(numeric_limits<int64_t>::max());
+        Order bestOffer;
+        for (const auto& o : offerStack) {
+            if (o.GetPrice() < bestOfferPrice) {
+                bestOfferPrice = o.GetPrice();
+                bestOffer = o;
+            }
+        }
+        return BidOffer(bestBid, bestOffer);
+    }
+
+    void UpdateLevel(PricingSide _side, Ticks _price, long _quantity) {
+        vector<Order>& stack = _side == BID ? bidStack : offerStack;
+        for (auto it = stack.begin(); it != stack.end(); ++it) {
+            if (it->GetPrice() == _price) {
+                if (_quantity > 0)
+                    *it = Order(_price, _quantity, _side);
+                else
+                    stack.erase(it);
+                return;
+            }
+        }
+        if (_quantity > 0) stack.emplace_back(_price, _quantity, _side);
+    }
+
+   private:
+    Bond product;
+    vector<Order> bidStack;
+    vector<Order> offerStack;
+};
+
+// Keeps results observable so the optimizer cannot drop the timed work
+static int64_t sink = 0;
+
+// Nanoseconds per iteration of a workload
+template <typename F>
+double TimePerOp(long _iterations, F&& _work) {
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < _iterations; ++i) _work(i);
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    return static_cast<double>(elapsed) / _iterations;
+}
+
+// Time the three workloads for books of one depth
+template <size_t Depth>
+void RunDepth(long _iterations, const Bond& _bond, Ticks _mid) {
+    constexpr int depth = static_cast<int>(Depth);
+
+    // Stacks in the order the connector reads them, best level first
+    vector<Order> bids, offers;
+    for (int level = 0; level < depth; ++level) {
+        bids.emplace_back(_mid - Ticks(level + 1), 1000000L * (level + 1), BID);
+        offers.emplace_back(_mid + Ticks(level + 1), 1000000L * (level + 1), OFFER);
+    }
+
+    mt19937 rng(42);
+    vector<int> levels(4096);
+    for (auto& l : levels) l = static_cast<int>(rng() % (depth + 2));
+
+    auto report = [&](const char* _name, double _legacy, double _sorted) {
+        cout << setw(8) << depth << setw(14) << _name << setw(14) << fixed << setprecision(1) << _legacy
+             << setw(14) << _sorted << setw(9) << setprecision(2) << _legacy / _sorted << "x" << endl;
+    };
+
+    double legacyBuild = TimePerOp(_iterations, [&](long) {
+        LegacyOrderBook book(_bond, bids, offers);
+        sink += book.GetBestBidOffer().GetBidOrder().GetPrice().Count();
+    });
+    double sortedBuild = TimePerOp(_iterations, [&](long) {
+        OrderBook<Bond, Depth> book(_bond, bids, offers);
+        sink += book.GetBestBidOffer().GetBidOrder().GetPrice().Count();
+    });
+    report("build+best", legacyBuild, sortedBuild);
+
+    LegacyOrderBook legacyBook(_bond, bids, offers);
+    OrderBook<Bond, Depth> sortedBook(_bond, bids, offers);
+    double legacyBest = TimePerOp(_iterations, [&](long) {
+        sink += legacyBook.GetBestBidOffer().GetOfferOrder().GetPrice().Count();
+    });
+    double sortedBest = TimePerOp(_iterations, [&](long) {
+        sink += sortedBook.GetBestBidOffer().GetOfferOrder().GetPrice().Count();
+    });
+    report("best", legacyBest, sortedBest);
+
+    // Cycle levels through update, delete and re-insert, including the best and one past the worst
+    auto levelUpdate = [&](auto& _book, long _i) {
+        int level = levels[_i & 4095];
+        PricingSide side = (_i & 1) ? BID : OFFER;
+        Ticks price = side == BID ? _mid - Ticks(level + 1) : _mid + Ticks(level + 1);
+        long quantity = (_i & 6) == 6 ? 0 : 1000000L * (1 + (_i & 7));
+        _book.UpdateLevel(side, price, quantity);
+        sink += _book.GetBestBidOffer().GetBidOrder().GetQuantity();
+    };
+    double legacyLevel = TimePerOp(_iterations, [&](long i) { levelUpdate(legacyBook, i); });
+    double sortedLevel = TimePerOp(_iterations, [&](long i) { levelUpdate(sortedBook, i); });
+    report("level+best", legacyLevel, sortedLevel);
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    Bond bond = BondInfo("91282CLY5");
+    const Ticks mid = Ticks::FromPoints(100);
+
+    cout << "sizeof(OrderBook<Bond, 5>): " << sizeof(OrderBook<Bond, 5>) << " bytes" << endl << endl;
+    cout << setw(8) << "DEPTH" << setw(14) << "WORKLOAD" << setw(14) << "LEGACY(ns)" << setw(14) << "SORTED(ns)"
+         << setw(10) << "SPEEDUP" << endl;
+
+    RunDepth<5>(iterations, bond, mid);
+    RunDepth<20>(iterations, bond, mid);
+    RunDepth<100>(iterations, bond, mid);
+
+    if (sink == 42) cout << sink << endl;
+    return 0;
+}
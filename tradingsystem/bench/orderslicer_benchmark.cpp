@@ -0,0 +1,91 @@
+/**
+ * orderslicer_benchmark.cpp
+ * Times OrderSlicer working 1000, 10000 and 100000 concurrent TWAP parents against a scheduler that
+ * scans every parent on every tick to find the slices due, as a per-parent deadline check would.
+ *
+ * Each parent slices once a second over ten minutes, with start times spread across the first second, and
+ * both engines are advanced in 1 ms ticks for a minute. Child orders go to an AlgoExecutionService with a
+ * listener that only counts them.
+ *
+ * Usage: orderslicer_benchmark
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "orderslicer.hpp"
+#include "products.hpp"
+
+using namespace std;
+
+/**
+ * Listener counting the child orders published.
+ */
+class ChildCounter : public ServiceListener<AlgoExecution<Bond>> {
+   public:
+    void ProcessAdd(AlgoExecution<Bond>& _data) { ++count; }
+    void ProcessRemove(AlgoExecution<Bond>& _data) {}
+    void ProcessUpdate(AlgoExecution<Bond>& _data) {}
+
+    uint64_t count = 0;
+};
+
+int main() {
+    constexpr uint64_t MILLIS = 1'000'000;
+    constexpr uint64_t SECOND = 1000 * MILLIS;
+    constexpr uint64_t RUN = 60 * SECOND;
+    Bond bond = BondInfo("91282CLY5");
+    const Ticks price = Ticks::FromPoints(100);
+
+    cout << setw(10) << "PARENTS" << setw(12) << "CHILDREN" << setw(16) << "SCAN(ns/tick)" << setw(16)
+         << "WHEEL(ns/tick)" << setw(10) << "SPEEDUP" << endl;
+
+    for (int parents : {1000, 10000, 100000}) {
+        // Scan: every parent's next deadline is checked on every tick
+        AlgoExecutionService<Bond> scanExecution;
+        ChildCounter scanCounter;
+        scanExecution.AddListener(&scanCounter);
+        vector<uint64_t> deadlines(parents);
+        vector<long> sent(parents, 0);
+        for (int p = 0; p < parents; ++p) deadlines[p] = p * SECOND / parents;
+        vector<string> ids;
+        for (int p = 0; p < parents; ++p) ids.push_back("P" + to_string(p));
+
+        auto start = chrono::steady_clock::now();
+        for (uint64_t now = 0; now < RUN; now += MILLIS) {
+            for (int p = 0; p < parents; ++p) {
+                if (deadlines[p] > now) continue;
+                sent[p] += 1000000;
+                scanExecution.ExecuteChildOrder(bond, BID, GenerateUniqueId(), ids[p], LIMIT, price, 1000000, 0);
+                deadlines[p] += SECOND;
+            }
+        }
+        double scanNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (RUN / MILLIS);
+
+        // Wheel: only parents with a slice due are touched
+        AlgoExecutionService<Bond> wheelExecution;
+        ChildCounter wheelCounter;
+        wheelExecution.AddListener(&wheelCounter);
+        OrderSlicer<Bond> slicer(wheelExecution);
+        for (int p = 0; p < parents; ++p) {
+            uint64_t begin = p * SECOND / parents;
+            slicer.Submit(ParentOrder<Bond>(bond, ids[p], BID, 600000000, price, TWAP, begin, begin + 600 * SECOND, SECOND));
+        }
+
+        start = chrono::steady_clock::now();
+        for (uint64_t now = 0; now < RUN; now += MILLIS) slicer.Advance(now);
+        double wheelNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (RUN / MILLIS);
+
+        if (scanCounter.count != wheelCounter.count) throw std::logic_error("Child counts differ");
+        cout << setw(10) << parents << setw(12) << wheelCounter.count << setw(16) << fixed << setprecision(0)
+             << scanNanos << setw(16) << wheelNanos << setw(9) << setprecision(2) << scanNanos / wheelNanos << "x"
+             << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * orderstore_benchmark.cpp
+ * Compares OrderStore against a std::map from order id to record, the container ExecutionService used
+ * for its orders, keyed here by order id instead of product. Orders of seven products are sent,
+ * acknowledged and filled in two clips.
+ *
+ * Reported per store:
+ *   ns/event    time per lifecycle event (add, acknowledge, fill), with 1000 orders open at a time
+ *   ns/enum     time to enumerate the open orders of one product; the map is scanned in full
+ *
+ * Usage: orderstore_benchmark [orders]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "orderstore.hpp"
+#include "products.hpp"
+#include "simulatedata.hpp"
+
+using namespace std;
+
+// Keeps results observable so the optimizer cannot drop the timed work
+static uint64_t sink = 0;
+
+/**
+ * Orders in a std::map keyed by order id, with the state machine applied in place.
+ */
+class MapStore {
+   public:
+    void Add(const ExecutionOrder<Bond>& _order) {
+        orders[_order.GetOrderId()] =
+            OrderRecord<Bond>{_order, ORDER_NEW, 0, _order.GetVisibleQuantity() + _order.GetHiddenQuantity()};
+    }
+    void Acknowledge(const string& _orderId) { orders.at(_orderId).state = ORDER_ACKNOWLEDGED; }
+    void ApplyFill(const string& _orderId, long _quantity) {
+        OrderRecord<Bond>& record = orders.at(_orderId);
+        record.filledQuantity += _quantity;
+        record.leavesQuantity -= _quantity;
+        record.state = record.leavesQuantity == 0 ? ORDER_FILLED : ORDER_PARTIALLY_FILLED;
+        if (record.state == ORDER_FILLED) orders.erase(_orderId);
+    }
+    template <typename F>
+    void ForEachOpen(const string& _productId, F&& _visit) const {
+        for (const auto& [id, record] : orders) {
+            if (record.order.GetProduct().GetProductId() == _productId && IsOpen(record.state)) _visit(record);
+        }
+    }
+
+   private:
+    map<string, OrderRecord<Bond>> orders;
+};
+
+// Nanoseconds per lifecycle event and per open-order enumeration of one product
+template <typename S>
+void Measure(const char* _name, S& _store, const vector<ExecutionOrder<Bond>>& _orders,
+             const vector<string>& _products) {
+    constexpr size_t OPEN = 1000;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < _orders.size(); ++i) {
+        _store.Add(_orders[i]);
+        _store.Acknowledge(_orders[i].GetOrderId());
+        _store.ApplyFill(_orders[i].GetOrderId(), 500000);
+        // Orders finish OPEN orders after they are sent
+        if (i >= OPEN) _store.ApplyFill(_orders[i - OPEN].GetOrderId(), 500000);
+    }
+    double eventNanos =
+        chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (_orders.size() * 4 - OPEN);
+
+    constexpr int ENUMERATIONS = 10000;
+    start = chrono::steady_clock::now();
+    for (int e = 0; e < ENUMERATIONS; ++e) {
+        _store.ForEachOpen(_products[e % _products.size()], [](const OrderRecord<Bond>& _r) { sink += _r.leavesQuantity; });
+    }
+    double enumNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / ENUMERATIONS;
+
+    cout << setw(12) << _name << setw(12) << fixed << setprecision(1) << eventNanos << setw(14) << enumNanos << endl;
+}
+
+int main(int argc, char* argv[]) {
+    long count = argc > 1 ? atol(argv[1]) : 200000;
+
+    vector<string> products(CUSIPS_VEC.begin(), CUSIPS_VEC.end());
+    vector<ExecutionOrder<Bond>> orders;
+    orders.reserve(count);
+    for (long i = 0; i < count; ++i) {
+        orders.emplace_back(BondInfo(products[i % products.size()]), i % 2 ? BID : OFFER, GenerateUniqueId(), LIMIT,
+                            Ticks::FromPoints(100), 1000000, 0, "", false);
+    }
+
+    cout << setw(12) << "STORE" << setw(12) << "NS/EVENT" << setw(14) << "NS/ENUM" << endl;
+    MapStore mapStore;
+    Measure("std::map", mapStore, orders, products);
+    OrderStore<Bond> orderStore;
+    Measure("OrderStore", orderStore, orders, products);
+
+    if (sink == 42) cout << sink << endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * persistence_benchmark.cpp
+ * Times formatting the records the historical data services persist, and counts the allocations per record,
+ * comparing joining the fields returned by ToStrings with writing them through RecordWriter.
+ *
+ * Each type is formatted the way the historical data connector formats a batch: a timestamp, the fields of
+ * the record each followed by a comma, and a newline, appended to one buffer that is cleared after each batch
+ * of 1000 records. Allocations are counted by replacing the global operator new.
+ *
+ * Usage: persistence_benchmark [records]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "algoexecutionservice.hpp"
+#include "algostreamingservice.hpp"
+#include "allocationcounter.hpp"
+#include "inquiryservice.hpp"
+#include "positionservice.hpp"
+#include "products.hpp"
+#include "riskservice.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+/**
+ * Format _records records of _data both ways and print a line of results.
+ */
+template <typename V>
+void Compare(const string& _name, const V& _data, long _records) {
+    constexpr long BATCH = 1000;
+    const string timestamp = CurrentTimeString();
+    string buffer;
+    buffer.reserve(BATCH * 256);
+    size_t checksum = 0;
+
+    // ToStrings: every field is a string of its own, in a vector of its own
+    uint64_t before = allocationCount.load();
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < _records; ++i) {
+        buffer += timestamp;
+        buffer += ',';
+        for (const auto& element : _data.ToStrings()) {
+            buffer += element;
+            buffer += ',';
+        }
+        buffer += '\n';
+        if ((i + 1) % BATCH == 0) {
+            checksum += buffer.size();
+            buffer.clear();
+        }
+    }
+    double joinNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / _records;
+    double joinAllocations = static_cast<double>(allocationCount.load() - before) / _records;
+
+    // RecordWriter: fields are formatted straight into the buffer
+    before = allocationCount.load();
+    start = chrono::steady_clock::now();
+    for (long i = 0; i < _records; ++i) {
+        RecordWriter writer(buffer);
+        writer.Field(timestamp);
+        _data.Write(writer);
+        writer.End();
+        if ((i + 1) % BATCH == 0) {
+            checksum -= buffer.size();
+            buffer.clear();
+        }
+    }
+    double writeNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / _records;
+    double writeAllocations = static_cast<double>(allocationCount.load() - before) / _records;
+
+    if (checksum != 0) throw std::logic_error("Formats differ for " + _name);
+    cout << setw(14) << _name << setw(14) << fixed << setprecision(1) << joinNanos << setw(14) << joinAllocations
+         << setw(14) << writeNanos << setw(14) << writeAllocations << endl;
+}
+
+int main(int argc, char* argv[]) {
+    long records = argc > 1 ? atol(argv[1]) : 1000000;
+    records -= records % 1000;
+    Bond bond = BondInfo("91282CLY5");
+    Ticks price = Ticks::FromPoints(99) + Ticks(5);
+
+    ExecutionOrder<Bond> order(bond, BID, "3OQ5JWX54618", MARKET, price, 10000000, 0, "", false);
+    Inquiry<Bond> inquiry("3OQ5JWX545ZA", bond, SELL, 1000000, price, DONE);
+    Position<Bond> position(bond);
+    for (string book : {"TRSY1", "TRSY2", "TRSY3"}) position.AddPosition(book, -10000000);
+    PV01<Bond> pv01(bond, 0.1854, -30000000);
+    PriceStream<Bond> stream(bond, PriceStreamOrder(price, 10000000, 20000000, BID),
+                             PriceStreamOrder(price + Ticks(4), 10000000, 20000000, OFFER));
+
+    cout << setw(14) << "RECORD" << setw(14) << "JOIN(ns)" << setw(14) << "JOIN(allocs)" << setw(14) << "WRITE(ns)"
+         << setw(14) << "WRITE(allocs)" << endl;
+    Compare("ExecutionOrder", order, records);
+    Compare("Inquiry", inquiry, records);
+    Compare("Position", position, records);
+    Compare("PV01", pv01, records);
+    Compare("PriceStream", stream, records);
+    return 0;
+}
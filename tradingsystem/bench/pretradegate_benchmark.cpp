@@ -0,0 +1,119 @@
+/**
+ * pretradegate_benchmark.cpp
+ * Times PreTradeGate::Check against the same checks made by looking positions, PV01 and the best bid and
+ * offer up in the position, risk and market data services, as a check without cached counters would.
+ *
+ * Books for seven products are loaded and orders of 5mm at random prices, alternating sides per
+ * product, are run through the gate. The orders that pass are booked into the position service, which
+ * updates the gate through its position and risk listeners. The outcomes of that run are reported, then both checks are timed over the same orders.
+ *
+ * Usage: pretradegate_benchmark [orders]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "pretradegate.hpp"
+#include "products.hpp"
+#include "simulatedata.hpp"
+
+using namespace std;
+
+// Keeps results observable so the optimizer cannot drop the timed work
+static uint64_t sink = 0;
+
+/**
+ * The gate's checks made against the services' own data.
+ */
+PreTradeResult LookupCheck(const PreTradeLimits& _limits, PositionService<Bond>& _positions, RiskService<Bond>& _risk,
+                           BondMarketDataService<Bond>& _marketData, const ExecutionOrder<Bond>& _order) {
+    string productId = _order.GetProduct().GetProductId();
+    long quantity = _order.GetVisibleQuantity() + _order.GetHiddenQuantity();
+    long delta = _order.GetPriceSide() == BID ? -quantity : quantity;
+
+    Position<Bond>& position = _positions.GetData(productId);
+    if (labs(position.GetAggregatePosition() + delta) > _limits.maxPosition) return PRE_TRADE_POSITION_LIMIT;
+    for (const auto& [book, bookPosition] : position.GetPositions()) {
+        if (labs(bookPosition + delta) > _limits.maxBookPosition) return PRE_TRADE_BOOK_LIMIT;
+    }
+    PV01<Bond>& pv01 = _risk.GetData(productId);
+    if (abs(pv01.GetPV01() * (pv01.GetQuantity() + delta)) > _limits.maxPV01) return PRE_TRADE_PV01_LIMIT;
+    BidOffer bidOffer = _marketData.GetBestBidOffer(productId);
+    int64_t distance = 2 * _order.GetPrice().Count() -
+                       (bidOffer.GetBidOrder().GetPrice() + bidOffer.GetOfferOrder().GetPrice()).Count();
+    if (abs(distance) > 2 * _limits.priceBand.Count()) return PRE_TRADE_PRICE_BAND;
+    return PRE_TRADE_PASSED;
+}
+
+int main(int argc, char* argv[]) {
+    long count = argc > 1 ? atol(argv[1]) : 1000000;
+    const PreTradeLimits limits{50'000'000, 30'000'000, 60'000'000.0, Ticks(4), 50'000, 1'000'000'000};
+
+    BondMarketDataService<Bond> marketData;
+    PositionService<Bond> positions;
+    RiskService<Bond> risk;
+    PreTradeGate<Bond> gate(marketData, limits, CUSIPS_VEC);
+    marketData.AddListener(gate.GetMarketDataListener());
+    positions.AddListener(risk.GetListener());
+    positions.AddListener(gate.GetPositionListener());
+    risk.AddListener(gate.GetRiskListener());
+
+    const Ticks centre = Ticks::FromPoints(100);
+    vector<Bond> bonds;
+    for (const auto& cusip : CUSIPS_VEC) {
+        bonds.push_back(BondInfo(cusip));
+        vector<Order> bids{Order(centre - Ticks(1), 10000000, BID)}, offers{Order(centre + Ticks(1), 10000000, OFFER)};
+        OrderBook<Bond> book(bonds.back(), bids, offers);
+        marketData.OnMessage(book);
+    }
+
+    mt19937_64 rng(42);
+    vector<ExecutionOrder<Bond>> orders;
+    orders.reserve(count);
+    for (long i = 0; i < count; ++i) {
+        // Each product alternates sides, as AlgoExecutionService does
+        PricingSide side = (i / bonds.size()) % 2 ? BID : OFFER;
+        Ticks price = centre + Ticks(static_cast<int64_t>(rng() % 13) - 6);
+        orders.emplace_back(bonds[i % bonds.size()], side, "O" + to_string(i), MARKET, price,
+                            5000000, 0, "", false);
+    }
+
+    // Run the orders through the gate, booking those that pass into one book per product
+    const string books[3] = {"TRSY1", "TRSY2", "TRSY3"};
+    for (long i = 0; i < count; ++i) {
+        AlgoExecution<Bond> execution(orders[i].GetProduct(), orders[i].GetPriceSide(), orders[i].GetOrderId(), MARKET,
+                                      orders[i].GetPrice(), orders[i].GetVisibleQuantity(), 0, "", false);
+        gate.ProcessAdd(execution);
+        if (gate.GetCount(PRE_TRADE_PASSED) == sink) continue;
+        sink = gate.GetCount(PRE_TRADE_PASSED);
+        Trade<Bond> trade(orders[i].GetProduct(), orders[i].GetOrderId(), orders[i].GetPrice(), books[i % bonds.size() % 3],
+                          orders[i].GetVisibleQuantity(), orders[i].GetPriceSide() == BID ? SELL : BUY);
+        positions.AddTrade(trade);
+    }
+    for (size_t r = 0; r < PRE_TRADE_RESULT_COUNT; ++r) {
+        cout << setw(16) << PreTradeResultName(static_cast<PreTradeResult>(r)) << setw(10)
+             << gate.GetCount(static_cast<PreTradeResult>(r)) << endl;
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (const auto& order : orders) sink += gate.Check(order);
+    double gateNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / count;
+
+    start = chrono::steady_clock::now();
+    for (const auto& order : orders) sink += LookupCheck(limits, positions, risk, marketData, order);
+    double lookupNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / count;
+
+    cout << setw(16) << "CHECK" << setw(10) << "NS/ORDER" << endl;
+    cout << setw(16) << "lookup" << setw(10) << fixed << setprecision(1) << lookupNanos << endl;
+    cout << setw(16) << "PreTradeGate" << setw(10) << gateNanos << endl;
+
+    if (sink == 42) cout << sink << endl;
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * quoting_benchmark.cpp
+ * Times the market making decision of AlgoExecutionService and counts the quote amendments it sends per book
+ * update, for amend thresholds of 1, 2, 4 and 8 ticks, to show how the hysteresis bounds message traffic.
+ *
+ * Seven products are quoted two ticks wide with a mid that moves by up to two ticks either way at random on each
+ * update. Downstream of the algo a listener counts the quotes placed and amended; nothing fills, so every quote
+ * stays live and each update ends in an amendment or none per side. Reported are amendments and messages per
+ * book update, and the median and 99th percentile time of a decision as the algo measures it.
+ *
+ * Usage: quoting_benchmark [updates]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "algoexecutionservice.hpp"
+#include "products.hpp"
+#include "simulatedata.hpp"
+
+using namespace std;
+
+/**
+ * Listener counting the quotes placed and amended.
+ */
+class QuoteCounter : public ServiceListener<AlgoExecution<Bond>> {
+   public:
+    void ProcessAdd(AlgoExecution<Bond>& _data) { ++placed; }
+    void ProcessRemove(AlgoExecution<Bond>& _data) {}
+    void ProcessUpdate(AlgoExecution<Bond>& _data) { ++amended; }
+
+    uint64_t placed = 0;
+    uint64_t amended = 0;
+};
+
+int main(int argc, char* argv[]) {
+    long updates = argc > 1 ? atol(argv[1]) : 1000000;
+    const Ticks centre = Ticks::FromPoints(100);
+
+    vector<Bond> bonds;
+    for (const auto& cusip : CUSIPS_VEC) bonds.push_back(BondInfo(cusip));
+
+    // Books are built up front so only the algo is timed
+    mt19937 rng(42);
+    uniform_int_distribution<int> step(-2, 2);
+    vector<Ticks> mids(bonds.size(), centre);
+    vector<OrderBook<Bond>> books;
+    books.reserve(updates);
+    for (long i = 0; i < updates; ++i) {
+        size_t product = i % bonds.size();
+        mids[product] = mids[product] + Ticks(step(rng));
+        vector<Order> bids, offers;
+        for (int level = 0; level < 5; ++level) {
+            bids.emplace_back(mids[product] - Ticks(1 + level), 10000000, BID);
+            offers.emplace_back(mids[product] + Ticks(1 + level), 10000000, OFFER);
+        }
+        books.emplace_back(bonds[product], bids, offers);
+    }
+
+    cout << setw(8) << "AMEND" << setw(14) << "AMENDS/BOOK" << setw(14) << "MSGS/BOOK" << setw(12) << "P50(ns)"
+         << setw(12) << "P99(ns)" << endl;
+    for (long threshold : {1L, 2L, 4L, 8L}) {
+        AlgoExecutionParameters parameters;
+        parameters.mode = MAKE_MARKET;
+        parameters.amendThreshold = Ticks(threshold);
+        AlgoExecutionService<Bond> algo(parameters);
+        QuoteCounter counter;
+        algo.AddListener(&counter);
+
+        for (auto& book : books) algo.ExecuteOrder(book);
+
+        if (counter.amended != algo.GetQuoteAmendments()) throw std::logic_error("Amendment counts differ");
+        double amendsPerBook = static_cast<double>(counter.amended) / updates;
+        double messagesPerBook = static_cast<double>(counter.placed + counter.amended) / updates;
+        cout << setw(8) << threshold << setw(14) << fixed << setprecision(3) << amendsPerBook << setw(14)
+             << messagesPerBook << setw(12) << algo.GetDecisionLatency().GetPercentile(50) << setw(12)
+             << algo.GetDecisionLatency().GetPercentile(99) << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * router_benchmark.cpp
+ * Times SmartOrderRouter deciding the split of an order across venues, and routing it in full: building
+ * the venue-tagged children, sending them downstream and folding their fills back into the parent.
+ *
+ * The books of seven products are quoted on all three venues with the touch within a tick of par and sizes
+ * drawn at random, and orders of random product, side and size cycle through MARKET, IOC and LIMIT at the
+ * touch. Downstream of the router a listener fills every child in full at once, as an exchange with
+ * unlimited liquidity would, so parents and children do not accumulate.
+ *
+ * Usage: router_benchmark [orders]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "products.hpp"
+#include "simulatedata.hpp"
+#include "smartorderrouter.hpp"
+
+using namespace std;
+
+/**
+ * Listener filling every child order in full.
+ */
+class ChildFiller : public ServiceListener<ExecutionOrder<Bond>> {
+   public:
+    explicit ChildFiller(SmartOrderRouter<Bond>& _router) : router(_router) {}
+
+    void ProcessAdd(ExecutionOrder<Bond>& _data) {
+        router.OnStatus(_data, ORDER_ACKNOWLEDGED);
+        Fill<Bond> fill(_data.GetProduct(), _data.GetOrderId(), _data.GetOrderId(), _data.GetPriceSide(),
+                        _data.GetPrice(), _data.GetVisibleQuantity() + _data.GetHiddenQuantity(), 0, false, 0);
+        router.OnFill(fill);
+        ++count;
+    }
+    void ProcessRemove(ExecutionOrder<Bond>& _data) {}
+    void ProcessUpdate(ExecutionOrder<Bond>& _data) {}
+
+    SmartOrderRouter<Bond>& router;
+    uint64_t count = 0;
+};
+
+/**
+ * Listener counting the parent fills reported.
+ */
+class FillCounter : public ServiceListener<Fill<Bond>> {
+   public:
+    void ProcessAdd(Fill<Bond>& _data) { ++count; }
+    void ProcessRemove(Fill<Bond>& _data) {}
+    void ProcessUpdate(Fill<Bond>& _data) {}
+
+    uint64_t count = 0;
+};
+
+int main(int argc, char* argv[]) {
+    long orders = argc > 1 ? atol(argv[1]) : 1000000;
+    const Ticks centre = Ticks::FromPoints(100);
+    mt19937 rng(42);
+    uniform_int_distribution<long> sizes(1, 50);
+    uniform_int_distribution<int> ticks(-1, 1);
+
+    vector<Bond> bonds;
+    for (const auto& cusip : CUSIPS_VEC) bonds.push_back(BondInfo(cusip));
+
+    BondMarketDataService<Bond> marketData;
+    SmartOrderRouter<Bond> router({0.0, 0.02, 0.04});
+    marketData.AddListener(router.GetMarketDataListener());
+    ChildFiller filler(router);
+    router.AddListener(&filler);
+    FillCounter counter;
+    router.AddFillListener(&counter);
+
+    for (const auto& bond : bonds) {
+        for (size_t v = 0; v < MARKET_COUNT; ++v) {
+            Ticks bid = centre + Ticks(ticks(rng) - 1);
+            vector<Order> bids, offers;
+            for (int level = 0; level < 5; ++level) {
+                bids.emplace_back(bid - Ticks(level), sizes(rng) * 1000000, BID);
+                offers.emplace_back(bid + Ticks(2 + level), sizes(rng) * 1000000, OFFER);
+            }
+            OrderBook<Bond> book(bond, bids, offers, static_cast<Market>(v));
+            marketData.OnMessage(book);
+        }
+    }
+
+    // Orders are built up front so only the router is timed
+    const OrderType types[] = {MARKET, IOC, LIMIT};
+    vector<ExecutionOrder<Bond>> batch;
+    batch.reserve(orders);
+    for (long i = 0; i < orders; ++i) {
+        const Bond& bond = bonds[i % bonds.size()];
+        PricingSide side = i % 2 == 0 ? BID : OFFER;
+        Ticks price = side == BID ? centre - Ticks(1) : centre + Ticks(1);
+        batch.emplace_back(bond, side, "P" + to_string(i), types[i % 3], price, sizes(rng) * 1000000, 0, "", false);
+    }
+
+    long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (const auto& order : batch) checksum += router.Allocate(order)[BROKERTEC];
+    double allocateNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / orders;
+
+    start = chrono::steady_clock::now();
+    for (const auto& order : batch) router.Route(order);
+    double routeNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / orders;
+
+    cout << setw(10) << "ORDERS" << setw(12) << "CHILDREN" << setw(18) << "ALLOCATE(ns)" << setw(14) << "ROUTE(ns)"
+         << endl;
+    cout << setw(10) << orders << setw(12) << filler.count << setw(18) << fixed << setprecision(1) << allocateNanos
+         << setw(14) << routeNanos << endl;
+    if (counter.count != filler.count || checksum < 0) throw std::logic_error("Fill counts differ");
+    return 0;
+}
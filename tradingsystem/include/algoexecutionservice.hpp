@@ -11,8 +11,17 @@
 #ifndef ALGO_EXECUTION_SERVICE_HPP
 #define ALGO_EXECUTION_SERVICE_HPP
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include "marketdataservice.hpp"
+#include "objectpool.hpp"
+#include "recordwriter.hpp"
 #include "soa.hpp"
 
 /**
@@ -20,20 +29,46 @@
  */
 enum OrderType { FOK, IOC, MARKET, LIMIT, STOP };
 
+// Number of values of OrderType
+constexpr size_t ORDER_TYPE_COUNT = 5;
+
+// Name of each order type, indexed by OrderType
+constexpr string_view ORDER_TYPE_NAMES[ORDER_TYPE_COUNT] = {"FOK", "IOC", "MARKET", "LIMIT", "STOP"};
+
+// Name of an order type
+string OrderTypeName(OrderType _type);
+
+string OrderTypeName(OrderType _type) {
+    return string(ORDER_TYPE_NAMES[_type]);
+}
+
 /**
- * Enum for supported trading markets.
+ * Enum to represent the algo that sent an order.
  */
-enum Market { BROKERTEC, ESPEED, CME };
+enum ExecutionAlgo { NO_ALGO, CROSSING_ALGO, QUOTING_ALGO, SLICING_ALGO };
+
+// Number of values of ExecutionAlgo
+constexpr size_t EXECUTION_ALGO_COUNT = 4;
+
+// Name of each algo, indexed by ExecutionAlgo
+constexpr string_view EXECUTION_ALGO_NAMES[EXECUTION_ALGO_COUNT] = {"NONE", "CROSS", "QUOTE", "SLICE"};
+
+// Name of an algo
+string ExecutionAlgoName(ExecutionAlgo _algo);
+
+string ExecutionAlgoName(ExecutionAlgo _algo) {
+    return string(EXECUTION_ALGO_NAMES[_algo]);
+}
 
 /**
  * Represents an execution order to be sent to an exchange.
  * T represents the type of product.
  */
 template <typename T>
-class ExecutionOrder {
+class ExecutionOrder : public Traced {
    public:
     // Constructor to initialize an order.
-    ExecutionOrder(const T& _product, PricingSide _side, string _orderId, OrderType _orderType, double _price,
+    ExecutionOrder(const T& _product, PricingSide _side, string _orderId, OrderType _orderType, Ticks _price,
                    long _visibleQuantity, long _hiddenQuantity, string _parentOrderId, bool _isChildOrder);
 
     ExecutionOrder() = default;
@@ -50,7 +85,7 @@ class ExecutionOrder {
     OrderType GetOrderType() const;
 
     // Accessor for the price.
-    double GetPrice() const;
+    Ticks GetPrice() const;
 
     // Accessor for the pricing side.
     PricingSide GetPriceSide() const;
@@ -67,19 +102,43 @@ class ExecutionOrder {
     // Checks if the order is a child order.
     bool IsChildOrder() const;
 
+    // Checks if the order is tagged with the venue it must execute on.
+    bool HasVenue() const;
+
+    // Accessor for the venue the order must execute on; meaningful only if HasVenue.
+    Market GetVenue() const;
+
+    // Tags the order with the venue it must execute on.
+    void SetVenue(Market _venue);
+
+    // Accessor for the algo that sent the order.
+    ExecutionAlgo GetAlgo() const;
+
+    // Tags the order with the algo that sent it.
+    void SetAlgo(ExecutionAlgo _algo);
+
+    // Amends the price and visible quantity of the order in place.
+    void Amend(Ticks _price, long _visibleQuantity);
+
     // Converts attributes to string representations.
     vector<string> ToStrings() const;
 
+    // Writes attributes as the fields of a persisted record.
+    void Write(RecordWriter& _writer) const;
+
    private:
-    T product;                 // Product information.
-    PricingSide side;          // Side of the order (BID or OFFER).
-    string orderId;            // Unique order ID.
-    OrderType orderType;       // Type of the order.
-    double price;              // Price of the order.
-    double visibleQuantity;    // Visible quantity of the order.
-    double hiddenQuantity;     // Hidden quantity of the order.
-    string parentOrderId;      // Parent order ID.
-    bool isChildOrder;         // Indicates if it's a child order.
+    T product;                     // Product information.
+    PricingSide side;              // Side of the order (BID or OFFER).
+    string orderId;                // Unique order ID.
+    OrderType orderType;           // Type of the order.
+    Ticks price;                   // Price of the order.
+    long visibleQuantity;          // Visible quantity of the order.
+    long hiddenQuantity;           // Hidden quantity of the order.
+    string parentOrderId;          // Parent order ID.
+    bool isChildOrder;             // Indicates if it's a child order.
+    Market venue = BROKERTEC;      // Venue the order must execute on.
+    bool hasVenue = false;         // Indicates if the order is tagged with a venue.
+    ExecutionAlgo algo = NO_ALGO;  // Algo that sent the order.
 };
 
 /**
@@ -87,7 +146,7 @@ class ExecutionOrder {
  */
 template <typename T>
 ExecutionOrder<T>::ExecutionOrder(const T& _product, PricingSide _side, string _orderId, OrderType _orderType,
-                                  double _price, long _visibleQuantity, long _hiddenQuantity, string _parentOrderId,
+                                  Ticks _price, long _visibleQuantity, long _hiddenQuantity, string _parentOrderId,
                                   bool _isChildOrder)
     : product(_product),
       side(_side),
@@ -113,7 +172,7 @@ OrderType ExecutionOrder<T>::GetOrderType() const {
 }
 
 template <typename T>
-double ExecutionOrder<T>::GetPrice() const {
+Ticks ExecutionOrder<T>::GetPrice() const {
     return price;
 }
 
@@ -148,18 +207,45 @@ bool ExecutionOrder<T>::IsChildOrder() const {
 }
 
 template <typename T>
-vector<string> ExecutionOrder<T>::ToStrings() const {
-    // Map enums to string representations.
-    const unordered_map<PricingSide, string> sideMap = {{BID, "BID"}, {OFFER, "OFFER"}};
-    const unordered_map<OrderType, string> orderTypeMap = {
-        {FOK, "FOK"}, {IOC, "IOC"}, {MARKET, "MARKET"}, {LIMIT, "LIMIT"}, {STOP, "STOP"}};
+bool ExecutionOrder<T>::HasVenue() const {
+    return hasVenue;
+}
+
+template <typename T>
+Market ExecutionOrder<T>::GetVenue() const {
+    return venue;
+}
+
+template <typename T>
+void ExecutionOrder<T>::SetVenue(Market _venue) {
+    venue = _venue;
+    hasVenue = true;
+}
+
+template <typename T>
+ExecutionAlgo ExecutionOrder<T>::GetAlgo() const {
+    return algo;
+}
+
+template <typename T>
+void ExecutionOrder<T>::SetAlgo(ExecutionAlgo _algo) {
+    algo = _algo;
+}
+
+template <typename T>
+void ExecutionOrder<T>::Amend(Ticks _price, long _visibleQuantity) {
+    price = _price;
+    visibleQuantity = _visibleQuantity;
+}
 
+template <typename T>
+vector<string> ExecutionOrder<T>::ToStrings() const {
     // Convert attributes to string format.
     string productStr = product.GetProductId();
-    string sideStr = sideMap.at(side);
+    string sideStr(PRICING_SIDE_NAMES[side]);
     string orderIdStr = orderId;
-    string orderTypeStr = orderTypeMap.at(orderType);
-    string priceStr = FormatPrice(price);
+    string orderTypeStr(ORDER_TYPE_NAMES[orderType]);
+    string priceStr = price.ToString();
     string visibleQuantityStr = to_string(visibleQuantity);
     string hiddenQuantityStr = to_string(hiddenQuantity);
     string parentOrderIdStr = parentOrderId;
@@ -170,6 +256,19 @@ vector<string> ExecutionOrder<T>::ToStrings() const {
             visibleQuantityStr, hiddenQuantityStr, parentOrderIdStr, isChildOrderStr};
 }
 
+template <typename T>
+void ExecutionOrder<T>::Write(RecordWriter& _writer) const {
+    _writer.Field(product.GetProductId())
+        .Field(PRICING_SIDE_NAMES[side])
+        .Field(orderId)
+        .Field(ORDER_TYPE_NAMES[orderType])
+        .Field(price)
+        .Field(visibleQuantity)
+        .Field(hiddenQuantity)
+        .Field(parentOrderId)
+        .Field(isChildOrder ? "YES" : "NO");
+}
+
 /**
  * Represents an algorithmic execution object.
  */
@@ -179,9 +278,14 @@ class AlgoExecution {
     // Default constructor.
     AlgoExecution() = default;
 
-    // Constructor to initialize with attributes.
+    // Constructor to initialize with attributes, placing the order in the default pool.
     AlgoExecution(const T& product, PricingSide pricingSide, string orderIdentifier, OrderType orderKind,
-                  double orderPrice, long visibleQty, long hiddenQty, string parentOrderIdentifier, bool isChild);
+                  Ticks orderPrice, long visibleQty, long hiddenQty, string parentOrderIdentifier, bool isChild);
+
+    // Constructor placing the order in the given pool.
+    AlgoExecution(ObjectPool<ExecutionOrder<T>>& pool, const T& product, PricingSide pricingSide,
+                  string orderIdentifier, OrderType orderKind, Ticks orderPrice, long visibleQty, long hiddenQty,
+                  string parentOrderIdentifier, bool isChild);
 
     virtual ~AlgoExecution() = default;
 
@@ -189,22 +293,84 @@ class AlgoExecution {
     ExecutionOrder<T>* RetrieveExecutionOrder() const;
 
    private:
-    ExecutionOrder<T>* execOrder;  // Pointer to the execution order.
+    PoolPtr<ExecutionOrder<T>> execOrder;  // Pooled execution order, shared between copies.
 };
 
 template <typename T>
 AlgoExecution<T>::AlgoExecution(const T& product, PricingSide pricingSide, string orderIdentifier, OrderType orderKind,
-                                double orderPrice, long visibleQty, long hiddenQty, string parentOrderIdentifier,
-                                bool isChild) {
-    execOrder = new ExecutionOrder<T>(product, pricingSide, orderIdentifier, orderKind, orderPrice, visibleQty,
-                                      hiddenQty, parentOrderIdentifier, isChild);
-}
+                                Ticks orderPrice, long visibleQty, long hiddenQty, string parentOrderIdentifier,
+                                bool isChild)
+    : AlgoExecution(ObjectPool<ExecutionOrder<T>>::Default(), product, pricingSide, orderIdentifier, orderKind,
+                    orderPrice, visibleQty, hiddenQty, parentOrderIdentifier, isChild) {}
+
+template <typename T>
+AlgoExecution<T>::AlgoExecution(ObjectPool<ExecutionOrder<T>>& pool, const T& product, PricingSide pricingSide,
+                                string orderIdentifier, OrderType orderKind, Ticks orderPrice, long visibleQty,
+                                long hiddenQty, string parentOrderIdentifier, bool isChild)
+    : execOrder(pool.Make(product, pricingSide, orderIdentifier, orderKind, orderPrice, visibleQty, hiddenQty,
+                          parentOrderIdentifier, isChild)) {}
 
 template <typename T>
 ExecutionOrder<T>* AlgoExecution<T>::RetrieveExecutionOrder() const {
-    return execOrder;
+    return execOrder.Get();
 }
 
+/**
+ * Rule choosing the side an AlgoExecutionService trades when the spread is tight enough.
+ */
+enum ExecutionSideRule { ALTERNATE_SIDES, FOLLOW_IMBALANCE, FADE_IMBALANCE };
+
+// Number of values of ExecutionSideRule
+constexpr size_t EXECUTION_SIDE_RULE_COUNT = 3;
+
+// Name of each side rule, indexed by ExecutionSideRule
+constexpr string_view EXECUTION_SIDE_RULE_NAMES[EXECUTION_SIDE_RULE_COUNT] = {"ALTERNATE", "FOLLOW", "FADE"};
+
+// Name of a side rule
+string ExecutionSideRuleName(ExecutionSideRule _rule);
+
+string ExecutionSideRuleName(ExecutionSideRule _rule) {
+    return string(EXECUTION_SIDE_RULE_NAMES[_rule]);
+}
+
+/**
+ * How an AlgoExecutionService trades.
+ */
+enum ExecutionMode { CROSS_SPREAD, MAKE_MARKET };
+
+// Number of values of ExecutionMode
+constexpr size_t EXECUTION_MODE_COUNT = 2;
+
+// Name of each mode, indexed by ExecutionMode
+constexpr string_view EXECUTION_MODE_NAMES[EXECUTION_MODE_COUNT] = {"CROSS", "QUOTE"};
+
+// Name of a mode
+string ExecutionModeName(ExecutionMode _mode);
+
+string ExecutionModeName(ExecutionMode _mode) {
+    return string(EXECUTION_MODE_NAMES[_mode]);
+}
+
+/**
+ * Parameters of the execution logic of an AlgoExecutionService. The defaults are the logic of the trading system:
+ * trade the whole top of book, alternating sides, whenever the spread is at most 1/128th.
+ *   CROSS_SPREAD     send a MARKET order for the top of book of the side chosen when the spread is tight enough
+ *     ALTERNATE_SIDES  sell into the bid and buy from the offer in turn
+ *     FOLLOW_IMBALANCE buy when the best bid shows at least the size of the best offer, sell otherwise
+ *     FADE_IMBALANCE   sell when the best bid shows at least the size of the best offer, buy otherwise
+ *   MAKE_MARKET      rest a LIMIT order on each side of each product, quoteOffset behind the best bid and offer,
+ *                    and amend it in place once its target price has moved by amendThreshold or it would cross
+ */
+struct AlgoExecutionParameters {
+    ExecutionMode mode = CROSS_SPREAD;                       // How to trade
+    Ticks spreadThreshold = Ticks(Ticks::PER_POINT / 128);  // Widest spread traded, when crossing it
+    ExecutionSideRule sideRule = ALTERNATE_SIDES;            // Side traded, when crossing the spread
+    double sizeFraction = 1.0;                               // Share of the top of book size traded or quoted
+    long maxQuantity = 0;                                    // Largest quantity of an order, 0 for no cap
+    Ticks quoteOffset = Ticks(0);                            // Distance of the quotes behind the touch
+    Ticks amendThreshold = Ticks(1);                         // Smallest move of a quote's target that amends it
+};
+
 template <typename T>
 class ListenerAlgoToMarketData;
 
@@ -215,8 +381,8 @@ class ListenerAlgoToMarketData;
 template <typename T>
 class AlgoExecutionService : public Service<string, AlgoExecution<T>> {
    public:
-    // Constructor and destructor.
-    AlgoExecutionService();
+    // Constructor taking the parameters of the execution logic, and destructor.
+    explicit AlgoExecutionService(const AlgoExecutionParameters& _parameters = {});
     virtual ~AlgoExecutionService() = default;
 
     // Retrieves data associated with a given key.
@@ -237,21 +403,105 @@ class AlgoExecutionService : public Service<string, AlgoExecution<T>> {
     // Executes an order in the market.
     void ExecuteOrder(OrderBook<T>& orderBook);
 
+    // Publishes a child order of a parent order, such as a slice scheduled by an OrderSlicer, under an order id
+    // chosen by the caller so that fills arriving before this returns can be matched to it. The child carries the
+    // trace of the book the caller sends it against; an empty trace is not recorded.
+    void ExecuteChildOrder(const T& product, PricingSide side, const string& orderId, const string& parentOrderId,
+                           OrderType orderType, Ticks price, long visibleQuantity, long hiddenQuantity,
+                           const TraceContext& trace = TraceContext());
+
+    // Takes the best bid and offer from the consolidated books of a market data service instead of the book received.
+    void SetMarketDataService(MarketDataService<T>* marketData);
+
+    // Retrieves the pool holding this service's execution orders.
+    const ObjectPool<ExecutionOrder<T>>& GetOrderPool() const;
+
+    // Retrieves the parameters of the execution logic.
+    const AlgoExecutionParameters& GetParameters() const;
+
+    // Takes the leaves quantity of a fill of one of the quotes; a quote left with nothing open is replaced.
+    void OnQuoteFill(const string& productId, const string& orderId, long leavesQuantity);
+
+    // Forgets a quote that has been cancelled, so that it is replaced.
+    void OnQuoteEnd(const string& productId, const string& orderId);
+
+    // Takes back a quote or amendment that has been rejected: a quote is forgotten so that it is placed again,
+    // and an amendment rejected while it is being sent is undone, leaving the quote as it was.
+    void OnQuoteRejected(const string& productId, const string& orderId);
+
+    // Retrieves the number of book updates quoted on.
+    uint64_t GetQuoteUpdates() const;
+
+    // Retrieves the number of quotes placed.
+    uint64_t GetQuotesPlaced() const;
+
+    // Retrieves the number of quote amendments sent.
+    uint64_t GetQuoteAmendments() const;
+
+    // Retrieves the time taken by each quoting decision, in nanoseconds.
+    const LatencyHistogram& GetDecisionLatency() const;
+
    private:
-    double executionSpread;                                       // Spread for execution.
+    /**
+     * Quotes of one product, indexed by the side of their orders: the buy quote joins the bids as an OFFER
+     * order, the sell quote joins the offers as a BID order.
+     */
+    struct QuoteState {
+        Ticks price[2];  // Price of each quote
+        long leaves[2];  // Quantity open on each quote, 0 when there is none
+    };
+
+    /**
+     * An amendment of a quote being sent, with the price and quantity to restore if it is rejected.
+     */
+    struct Amendment {
+        const ExecutionOrder<T>* order = nullptr;  // Order amended, null when no amendment is being sent
+        Ticks price;                               // Price before the amendment
+        long visibleQuantity = 0;                  // Visible quantity before the amendment
+    };
+
+    // Quotes both sides of a product for a new book.
+    void Quote(OrderBook<T>& orderBook);
+
+    // Places, amends or leaves one quote given its target price and the best price of the side it must not reach.
+    void UpdateQuote(const T& product, size_t slot, PricingSide side, Ticks target, Ticks far, long shown,
+                     const TraceContext& trace);
+
+    // Quantity of an order for a size shown at the top of book, 0 when nothing is shown.
+    long Size(long shown) const;
+
+    AlgoExecutionParameters parameters;                           // Parameters of the execution logic.
+    ObjectPool<ExecutionOrder<T>> orderPool;                      // Storage for execution orders, outliving them.
+    vector<QuoteState> quotes;                                    // Quotes of each product, by slot.
+    vector<array<AlgoExecution<T>, 2>> quoteOrders;               // Orders of the quotes, by slot.
+    unordered_map<string, size_t> quoteSlots;                     // Slot of each product quoted.
+    Amendment amending;                                           // Quote amendment being sent.
+    uint64_t quoteUpdates;                                        // Book updates quoted on.
+    uint64_t quotesPlaced;                                        // Quotes placed.
+    uint64_t quoteAmendments;                                     // Quote amendments sent.
+    LatencyHistogram decisionLatency;                             // Time per quoting decision.
     long executionCount;                                          // Number of executed orders.
     map<string, AlgoExecution<T>> algoExecutionMap;               // Map of product ID to AlgoExecution.
     vector<ServiceListener<AlgoExecution<T>>*> serviceListeners;  // List of service listeners.
     ListenerAlgoToMarketData<T>* algoListener;                    // Listener for Algo-to-MarketData communication.
+    MarketDataService<T>* marketDataService;                      // Source of cross-venue prices, if any.
 };
 
 template <typename T>
-AlgoExecutionService<T>::AlgoExecutionService() {
-    executionSpread = 1.0 / 128.0;
+AlgoExecutionService<T>::AlgoExecutionService(const AlgoExecutionParameters& _parameters) {
+    if (_parameters.sizeFraction <= 0) throw std::invalid_argument("Size fraction must be positive");
+    if (_parameters.maxQuantity < 0) throw std::invalid_argument("Maximum quantity must not be negative");
+    if (_parameters.quoteOffset < Ticks(0)) throw std::invalid_argument("Quote offset must not be negative");
+    if (_parameters.amendThreshold < Ticks(1)) throw std::invalid_argument("Amend threshold must be at least a tick");
+    parameters = _parameters;
     executionCount = 0;
+    quoteUpdates = 0;
+    quotesPlaced = 0;
+    quoteAmendments = 0;
     algoExecutionMap = map<string, AlgoExecution<T>>();
     serviceListeners = vector<ServiceListener<AlgoExecution<T>>*>();
     algoListener = new ListenerAlgoToMarketData<T>(this);
+    marketDataService = nullptr;
 }
 
 template <typename T>
@@ -261,6 +511,7 @@ AlgoExecution<T>& AlgoExecutionService<T>::GetData(string key) {
 
 template <typename T>
 void AlgoExecutionService<T>::OnMessage(AlgoExecution<T>& data) {
+    auto timer = this->TrackMessage();
     algoExecutionMap[data.RetrieveExecutionOrder()->GetProduct().GetProductId()] = data;
 }
 
@@ -281,6 +532,11 @@ ListenerAlgoToMarketData<T>* AlgoExecutionService<T>::GetListener() {
 
 template <typename T>
 void AlgoExecutionService<T>::ExecuteOrder(OrderBook<T>& currentOrderBook) {
+    if (parameters.mode == MAKE_MARKET) {
+        Quote(currentOrderBook);
+        return;
+    }
+
     // Retrieve product and product ID.
     T associatedProduct = currentOrderBook.GetProduct();
     string productId = associatedProduct.GetProductId();
@@ -288,23 +544,37 @@ void AlgoExecutionService<T>::ExecuteOrder(OrderBook<T>& currentOrderBook) {
     // Variables for the execution order.
     PricingSide selectedSide;
     string uniqueOrderId = GenerateUniqueId();
-    double determinedPrice;
+    Ticks determinedPrice;
     long determinedQuantity;
 
-    // Retrieve the best bid and offer from the order book.
-    BidOffer optimalBidOffer = currentOrderBook.GetBestBidOffer();
+    // Retrieve the best bid and offer, across all venues when consolidated books are available.
+    BidOffer optimalBidOffer =
+        marketDataService ? marketDataService->GetBestBidOffer(productId) : currentOrderBook.GetBestBidOffer();
     Order highestBid = optimalBidOffer.GetBidOrder();
-    double highestBidPrice = highestBid.GetPrice();
+    Ticks highestBidPrice = highestBid.GetPrice();
     long highestBidQuantity = highestBid.GetQuantity();
 
     Order lowestOffer = optimalBidOffer.GetOfferOrder();
-    double lowestOfferPrice = lowestOffer.GetPrice();
+    Ticks lowestOfferPrice = lowestOffer.GetPrice();
     long lowestOfferQuantity = lowestOffer.GetQuantity();
 
-    // Check if the spread meets execution conditions.
-    if ((lowestOfferPrice - highestBidPrice) <= executionSpread) {
-        // Alternate execution between bid and offer sides.
-        if (executionCount % 2 == 0) {
+    // Check if the spread meets execution conditions; a side with no levels has no price to trade at.
+    if (highestBidQuantity > 0 && lowestOfferQuantity > 0 &&
+        (lowestOfferPrice - highestBidPrice) <= parameters.spreadThreshold) {
+        // Choose the side by the rule: alternating, or with or against the imbalance of the top of book.
+        bool sell;
+        switch (parameters.sideRule) {
+            case FOLLOW_IMBALANCE:
+                sell = highestBidQuantity < lowestOfferQuantity;
+                break;
+            case FADE_IMBALANCE:
+                sell = highestBidQuantity >= lowestOfferQuantity;
+                break;
+            default:
+                sell = executionCount % 2 == 0;
+                break;
+        }
+        if (sell) {
             determinedPrice = highestBidPrice;
             determinedQuantity = highestBidQuantity;
             selectedSide = BID;
@@ -314,34 +584,202 @@ void AlgoExecutionService<T>::ExecuteOrder(OrderBook<T>& currentOrderBook) {
             selectedSide = OFFER;
         }
 
+        // Trade the configured share of the size shown.
+        determinedQuantity = Size(determinedQuantity);
+        if (determinedQuantity <= 0) return;
+
         // Increment the execution counter.
         ++executionCount;
 
         // Create an AlgoExecution instance.
-        AlgoExecution<T> executionInstance(associatedProduct, selectedSide, uniqueOrderId, MARKET, determinedPrice,
-                                           determinedQuantity, 0, "", false);
+        AlgoExecution<T> executionInstance(orderPool, associatedProduct, selectedSide, uniqueOrderId, MARKET,
+                                           determinedPrice, determinedQuantity, 0, "", false);
+
+        // Tag the order with its algo and carry the book's trace context into it.
+        executionInstance.RetrieveExecutionOrder()->SetAlgo(CROSSING_ALGO);
+        executionInstance.RetrieveExecutionOrder()->SetTrace(currentOrderBook.GetTrace());
+        LatencyTracer::Instance().Record(TRACE_ALGO_EXECUTION, executionInstance.RetrieveExecutionOrder()->GetTrace());
 
         // Add execution instance to the map.
         algoExecutionMap[productId] = executionInstance;
 
         // Notify all service listeners.
-        for (auto& serviceListener : serviceListeners) {
-            serviceListener->ProcessAdd(executionInstance);
+        this->NotifyAdd(serviceListeners, executionInstance);
+    }
+}
+
+template <typename T>
+void AlgoExecutionService<T>::Quote(OrderBook<T>& currentOrderBook) {
+    uint64_t start = TscClock::Now();
+    ++quoteUpdates;
+
+    const T& product = currentOrderBook.GetProduct();
+    const string& productId = product.GetProductId();
+    BidOffer optimalBidOffer =
+        marketDataService ? marketDataService->GetBestBidOffer(productId) : currentOrderBook.GetBestBidOffer();
+    const Order& bid = optimalBidOffer.GetBidOrder();
+    const Order& offer = optimalBidOffer.GetOfferOrder();
+
+    // Quotes are only placed or moved against a two-sided book.
+    if (bid.GetQuantity() > 0 && offer.GetQuantity() > 0) {
+        auto [slot, added] = quoteSlots.try_emplace(productId, quotes.size());
+        if (added) {
+            quotes.push_back(QuoteState{});
+            quoteOrders.emplace_back();
+        }
+        UpdateQuote(product, slot->second, OFFER, bid.GetPrice() - parameters.quoteOffset, offer.GetPrice(),
+                    bid.GetQuantity(), currentOrderBook.GetTrace());
+        UpdateQuote(product, slot->second, BID, offer.GetPrice() + parameters.quoteOffset, bid.GetPrice(),
+                    offer.GetQuantity(), currentOrderBook.GetTrace());
+    }
+    decisionLatency.Record(TscClock::ToNanos(TscClock::Now() - start));
+}
+
+template <typename T>
+void AlgoExecutionService<T>::UpdateQuote(const T& product, size_t slot, PricingSide side, Ticks target, Ticks far,
+                                          long shown, const TraceContext& trace) {
+    QuoteState& state = quotes[slot];
+    AlgoExecution<T>& quote = quoteOrders[slot][side];
+
+    if (state.leaves[side] > 0) {
+        // Leave the quote until its target has moved by the threshold, unless the book has moved through it.
+        Ticks move = target - state.price[side];
+        bool crosses = side == OFFER ? state.price[side] >= far : state.price[side] <= far;
+        if (!crosses && move < parameters.amendThreshold && -move < parameters.amendThreshold) return;
+
+        // Downstream reads the amendment from the pooled order, so it is applied before it is sent and undone
+        // by OnQuoteRejected if a listener rejects it on the way
+        ExecutionOrder<T>* order = quote.RetrieveExecutionOrder();
+        amending = Amendment{order, order->GetPrice(), order->GetVisibleQuantity()};
+        state.price[side] = target;
+        order->Amend(target, state.leaves[side]);
+        ++quoteAmendments;
+        this->NotifyUpdate(serviceListeners, quote);
+        amending = Amendment{};
+        return;
+    }
+
+    // The quote is recorded before it is sent, so that a fill or rejection on the way finds it
+    long quantity = Size(shown);
+    if (quantity <= 0) return;
+    state.price[side] = target;
+    state.leaves[side] = quantity;
+    quote = AlgoExecution<T>(orderPool, product, side, GenerateUniqueId(), LIMIT, target, quantity, 0, "", false);
+    quote.RetrieveExecutionOrder()->SetAlgo(QUOTING_ALGO);
+    quote.RetrieveExecutionOrder()->SetTrace(trace);
+    LatencyTracer::Instance().Record(TRACE_ALGO_EXECUTION, quote.RetrieveExecutionOrder()->GetTrace());
+    ++quotesPlaced;
+
+    algoExecutionMap[product.GetProductId()] = quote;
+    this->NotifyAdd(serviceListeners, quote);
+}
+
+template <typename T>
+long AlgoExecutionService<T>::Size(long shown) const {
+    // The configured share of the size shown, at least one unit and at most the cap; nothing when nothing is shown.
+    if (shown <= 0) return 0;
+    long quantity = shown;
+    if (parameters.sizeFraction != 1.0) quantity = max(1L, lround(shown * parameters.sizeFraction));
+    if (parameters.maxQuantity > 0) quantity = min(quantity, parameters.maxQuantity);
+    return quantity;
+}
+
+template <typename T>
+void AlgoExecutionService<T>::OnQuoteFill(const string& productId, const string& orderId, long leavesQuantity) {
+    auto slot = quoteSlots.find(productId);
+    if (slot == quoteSlots.end()) return;
+    for (PricingSide side : {BID, OFFER}) {
+        const ExecutionOrder<T>* order = quoteOrders[slot->second][side].RetrieveExecutionOrder();
+        if (order && order->GetOrderId() == orderId) quotes[slot->second].leaves[side] = leavesQuantity;
+    }
+}
+
+template <typename T>
+void AlgoExecutionService<T>::OnQuoteEnd(const string& productId, const string& orderId) {
+    OnQuoteFill(productId, orderId, 0);
+}
+
+template <typename T>
+void AlgoExecutionService<T>::OnQuoteRejected(const string& productId, const string& orderId) {
+    auto slot = quoteSlots.find(productId);
+    if (slot == quoteSlots.end()) return;
+    for (PricingSide side : {BID, OFFER}) {
+        ExecutionOrder<T>* order = quoteOrders[slot->second][side].RetrieveExecutionOrder();
+        if (!order || order->GetOrderId() != orderId) continue;
+        if (order == amending.order) {
+            // The venue still holds the quote as it was before the amendment
+            order->Amend(amending.price, amending.visibleQuantity);
+            quotes[slot->second].price[side] = amending.price;
+        } else {
+            quotes[slot->second].leaves[side] = 0;
         }
     }
 }
 
+template <typename T>
+uint64_t AlgoExecutionService<T>::GetQuoteUpdates() const {
+    return quoteUpdates;
+}
+
+template <typename T>
+uint64_t AlgoExecutionService<T>::GetQuotesPlaced() const {
+    return quotesPlaced;
+}
+
+template <typename T>
+uint64_t AlgoExecutionService<T>::GetQuoteAmendments() const {
+    return quoteAmendments;
+}
+
+template <typename T>
+const LatencyHistogram& AlgoExecutionService<T>::GetDecisionLatency() const {
+    return decisionLatency;
+}
+
+template <typename T>
+void AlgoExecutionService<T>::ExecuteChildOrder(const T& product, PricingSide side, const string& orderId,
+                                                const string& parentOrderId, OrderType orderType, Ticks price,
+                                                long visibleQuantity, long hiddenQuantity,
+                                                const TraceContext& trace) {
+    AlgoExecution<T> executionInstance(orderPool, product, side, orderId, orderType, price,
+                                       visibleQuantity, hiddenQuantity, parentOrderId, true);
+    executionInstance.RetrieveExecutionOrder()->SetAlgo(SLICING_ALGO);
+    executionInstance.RetrieveExecutionOrder()->SetTrace(trace);
+    LatencyTracer::Instance().Record(TRACE_ALGO_EXECUTION, executionInstance.RetrieveExecutionOrder()->GetTrace());
+
+    algoExecutionMap[product.GetProductId()] = executionInstance;
+    this->NotifyAdd(serviceListeners, executionInstance);
+}
+
+template <typename T>
+void AlgoExecutionService<T>::SetMarketDataService(MarketDataService<T>* marketData) {
+    marketDataService = marketData;
+}
+
+template <typename T>
+const ObjectPool<ExecutionOrder<T>>& AlgoExecutionService<T>::GetOrderPool() const {
+    return orderPool;
+}
+
+template <typename T>
+const AlgoExecutionParameters& AlgoExecutionService<T>::GetParameters() const {
+    return parameters;
+}
+
 /**
  * Listener to connect AlgoExecutionService with MarketData.
+ * Snapshots always trigger an execution decision; deltas only when they change the top of the book.
  */
 template <typename T>
-class ListenerAlgoToMarketData : public ServiceListener<OrderBook<T>> {
+class ListenerAlgoToMarketData : public BookDeltaListener<T> {
    public:
     ListenerAlgoToMarketData(AlgoExecutionService<T>* _service);
     virtual ~ListenerAlgoToMarketData() = default;
 
     void ProcessAdd(OrderBook<T>& data);
 
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
     void ProcessRemove(OrderBook<T>& _data);
 
     void ProcessUpdate(OrderBook<T>& data);
@@ -358,6 +796,11 @@ void ListenerAlgoToMarketData<T>::ProcessAdd(OrderBook<T>& _data) {
     service->ExecuteOrder(_data);
 }
 
+template <typename T>
+void ListenerAlgoToMarketData<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    if (_delta.ChangedTop(_book)) service->ExecuteOrder(_book);
+}
+
 template <typename T>
 void ListenerAlgoToMarketData<T>::ProcessRemove(OrderBook<T>& _data) {}
 
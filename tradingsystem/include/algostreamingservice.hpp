@@ -9,7 +9,9 @@
 #define ALGO_STREAMINGSERVICE_HPP
 
 #include <string>
+#include "recordwriter.hpp"
 #include "soa.hpp"
+#include "objectpool.hpp"
 #include "marketdataservice.hpp"
 #include "pricingservice.hpp"
 
@@ -25,13 +27,13 @@ public:
     PriceStreamOrder() = default;
 
     // Constructor initializing price, quantities, and side
-    PriceStreamOrder(double _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side);
+    PriceStreamOrder(Ticks _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side);
 
     // Default destructor
     virtual ~PriceStreamOrder() = default;
 
     // Retrieve the price of the order
-    double GetPrice() const;
+    Ticks GetPrice() const;
 
     // Retrieve the visible quantity of the order
     long GetVisibleQuantity() const;
@@ -45,21 +47,24 @@ public:
     // Convert order attributes to a vector of strings for display
     vector<string> ToStrings() const;
 
+    // Write order attributes as the fields of a persisted record
+    void Write(RecordWriter& _writer) const;
+
 private:
-    double price;                 // Price of the order
+    Ticks price;                  // Price of the order
     long visibleQuantity;         // Visible quantity of the order
     long hiddenQuantity;          // Hidden quantity of the order
     PricingSide side;             // Side of the order (BID/OFFER)
 
 };
 
-PriceStreamOrder::PriceStreamOrder(double _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side)
+PriceStreamOrder::PriceStreamOrder(Ticks _price, long _visibleQuantity, long _hiddenQuantity, PricingSide _side)
     : price(_price), visibleQuantity(_visibleQuantity), hiddenQuantity(_hiddenQuantity), side(_side) {}
 
 
 // Implementation of accessor methods for PriceStreamOrder attributes
 
-double PriceStreamOrder::GetPrice() const
+Ticks PriceStreamOrder::GetPrice() const
 {
     return price;
 }
@@ -82,21 +87,26 @@ PricingSide PriceStreamOrder::GetSide() const
 vector<string> PriceStreamOrder::ToStrings() const
 {
     // Convert price and quantities to string and determine the side
-    string priceStr = FormatPrice(price);
+    string priceStr = price.ToString();
     string visibleQtyStr = to_string(visibleQuantity);
     string hiddenQtyStr = to_string(hiddenQuantity);
-    string sideStr = (side == BID) ? "BID" : "OFFER";
+    string sideStr(PRICING_SIDE_NAMES[side]);
 
     // Return all attributes as strings
     return {priceStr, visibleQtyStr, hiddenQtyStr, sideStr};
 }
 
+void PriceStreamOrder::Write(RecordWriter& _writer) const
+{
+    _writer.Field(price).Field(visibleQuantity).Field(hiddenQuantity).Field(PRICING_SIDE_NAMES[side]);
+}
+
 /**
  * Represents a price stream with a two-way market, including bid and offer orders.
  * Template parameter T is the product type.
  */
 template<typename T>
-class PriceStream
+class PriceStream : public Traced
 {
 
 public:
@@ -122,6 +132,9 @@ public:
     // Convert price stream attributes to a vector of strings for display
     vector<string> ToStrings() const;
 
+    // Write price stream attributes as the fields of a persisted record
+    void Write(RecordWriter& _writer) const;
+
 private:
     T product;                       // The product associated with the price stream
     PriceStreamOrder bidOrder;       // Bid order for the price stream
@@ -167,6 +180,14 @@ vector<string> PriceStream<T>::ToStrings() const
     return resultStrings;
 }
 
+template<typename T>
+void PriceStream<T>::Write(RecordWriter& _writer) const
+{
+    _writer.Field(product.GetProductId());
+    bidOrder.Write(_writer);
+    offerOrder.Write(_writer);
+}
+
 /**
  * Represents an algorithmically managed price stream, combining a product with its bid and offer orders.
  * Template parameter T is the product type.
@@ -180,27 +201,34 @@ public:
     // Default constructor
     AlgoStream() = default;
 
-    // Constructor initializing the product and associated bid/offer orders
+    // Constructor initializing the product and associated bid/offer orders in the default pool
     AlgoStream(const T& _product, const PriceStreamOrder& _bidOrder, const PriceStreamOrder& _offerOrder);
 
+    // Constructor placing the price stream in the given pool
+    AlgoStream(ObjectPool<PriceStream<T>>& _pool, const T& _product, const PriceStreamOrder& _bidOrder,
+               const PriceStreamOrder& _offerOrder);
+
     // Retrieve the underlying price stream
     PriceStream<T>* GetPriceStream() const;
 
 private:
-    PriceStream<T>* priceStream;     // Pointer to the price stream
+    PoolPtr<PriceStream<T>> priceStream;     // Pooled price stream, shared between copies
 
 };
 
 template<typename T>
-AlgoStream<T>::AlgoStream(const T& _product, const PriceStreamOrder& _bidOrder, const PriceStreamOrder& _offerOrder)
-{
-    priceStream = new PriceStream<T>(_product, _bidOrder, _offerOrder);
-}
+AlgoStream<T>::AlgoStream(const T& _product, const PriceStreamOrder& _bidOrder, const PriceStreamOrder& _offerOrder) :
+    AlgoStream(ObjectPool<PriceStream<T>>::Default(), _product, _bidOrder, _offerOrder) {}
+
+template<typename T>
+AlgoStream<T>::AlgoStream(ObjectPool<PriceStream<T>>& _pool, const T& _product, const PriceStreamOrder& _bidOrder,
+                          const PriceStreamOrder& _offerOrder) :
+    priceStream(_pool.Make(_product, _bidOrder, _offerOrder)) {}
 
 template<typename T>
 PriceStream<T>* AlgoStream<T>::GetPriceStream() const
 {
-    return priceStream;
+    return priceStream.Get();
 }
 
 /**
@@ -233,11 +261,22 @@ public:
     // Publish two-way algorithmic prices based on input data
     void PublishAlgorithmicPrice(const Price<T>& price);
 
+    // Publish two-way algorithmic prices for a batch of input prices with one listener notification
+    void PublishAlgorithmicPrices(span<Price<T>> prices);
+
+    // Retrieve the pool holding this service's price streams
+    const ObjectPool<PriceStream<T>>& GetStreamPool() const;
+
 private:
+    // Build the two-way AlgoStream for one input price
+    AlgoStream<T> CreateAlgoStream(const Price<T>& price);
+
     ServiceListener<Price<T>>* algoListener;        // Listener for pricing service updates
     long orderCounter;                              // Counter to manage order sequencing
+    ObjectPool<PriceStream<T>> streamPool;          // Recycled storage for published price streams
     map<string, AlgoStream<T>> algoStreamMap;       // Map of product IDs to AlgoStreams
     vector<ServiceListener<AlgoStream<T>>*> listeners; // List of event listeners
+    vector<AlgoStream<T>> streamBatch;              // Reused buffer for batch publication
 };
 
 template<typename T>
@@ -245,7 +284,8 @@ class ListenerAlgoStreamToPrc;
 
 template<typename T>
 AlgoStreamingService<T>::AlgoStreamingService()
-    : algoStreamMap(map<string, AlgoStream<T>>()),
+    : streamPool(),
+      algoStreamMap(map<string, AlgoStream<T>>()),
       listeners(vector<ServiceListener<AlgoStream<T>>*>()),
       algoListener(new ListenerAlgoStreamToPrc<T>(this)),
       orderCounter(0) 
@@ -260,6 +300,7 @@ AlgoStream<T>& AlgoStreamingService<T>::GetData(string key)
 template<typename T>
 void AlgoStreamingService<T>::OnMessage(AlgoStream<T>& data)
 {
+    auto timer = this->TrackMessage();
     string productId = data.GetPriceStream()->GetProduct().GetProductId();
     algoStreamMap[productId] = data;
 }
@@ -284,15 +325,46 @@ ServiceListener<Price<T>>* AlgoStreamingService<T>::GetListener()
 
 template<typename T>
 void AlgoStreamingService<T>::PublishAlgorithmicPrice(const Price<T>& price)
+{
+    AlgoStream<T> algoStream = CreateAlgoStream(price);
+    algoStreamMap[price.GetProduct().GetProductId()] = algoStream;
+
+    this->NotifyAdd(listeners, algoStream);
+}
+
+template<typename T>
+void AlgoStreamingService<T>::PublishAlgorithmicPrices(span<Price<T>> prices)
+{
+    streamBatch.clear();
+    streamBatch.reserve(prices.size());
+
+    // Input is grouped by product, so consecutive prices usually share one map entry
+    auto entry = algoStreamMap.end();
+    for (const auto& price : prices)
+    {
+        streamBatch.push_back(CreateAlgoStream(price));
+        const string& productId = price.GetProduct().GetProductId();
+        if (entry == algoStreamMap.end() || entry->first != productId)
+        {
+            entry = algoStreamMap.try_emplace(productId).first;
+        }
+        entry->second = streamBatch.back();
+    }
+
+    this->NotifyAddBatch(listeners, span<AlgoStream<T>>(streamBatch));
+
+    // Release the batch's references so unused price streams go back to the pool
+    streamBatch.clear();
+}
+
+template<typename T>
+AlgoStream<T> AlgoStreamingService<T>::CreateAlgoStream(const Price<T>& price)
 {
     const T& product = price.GetProduct();
-    string productId = product.GetProductId();
 
-    // Calculate bid and offer prices
-    double midPrice = price.GetMid();
-    double spread = price.GetBidOfferSpread();
-    double bidPrice = midPrice - (spread / 2.0);
-    double offerPrice = midPrice + (spread / 2.0);
+    // Quote on the price's own bid and offer
+    Ticks bidPrice = price.GetBid();
+    Ticks offerPrice = price.GetOffer();
 
     // Determine quantities
     long visibleQty = ((orderCounter % 2) + 1) * 10000000;
@@ -304,14 +376,16 @@ void AlgoStreamingService<T>::PublishAlgorithmicPrice(const Price<T>& price)
     // Create bid and offer orders and publish as an AlgoStream
     PriceStreamOrder bidOrder(bidPrice, visibleQty, hiddenQty, BID);
     PriceStreamOrder offerOrder(offerPrice, visibleQty, hiddenQty, OFFER);
-    AlgoStream<T> algoStream(product, bidOrder, offerOrder);
-
-    algoStreamMap[productId] = algoStream;
+    AlgoStream<T> algoStream(streamPool, product, bidOrder, offerOrder);
+    algoStream.GetPriceStream()->SetTrace(price.GetTrace());
+    LatencyTracer::Instance().Record(TRACE_ALGO_STREAM, algoStream.GetPriceStream()->GetTrace());
+    return algoStream;
+}
 
-    for (auto& listener : listeners)
-    {
-        listener->ProcessAdd(algoStream);
-    }
+template<typename T>
+const ObjectPool<PriceStream<T>>& AlgoStreamingService<T>::GetStreamPool() const
+{
+    return streamPool;
 }
 
 /**
@@ -335,6 +409,9 @@ public:
     // Process add event from the pricing service
     void ProcessAdd(Price<T>& _data);
 
+    // Process a batch of add events from the pricing service
+    void ProcessAddBatch(span<Price<T>> _data) override;
+
     // No implementation needed for remove event
     void ProcessRemove(Price<T>& _data);
 
@@ -355,6 +432,12 @@ void ListenerAlgoStreamToPrc<T>::ProcessAdd(Price<T>& _data)
     service->PublishAlgorithmicPrice(_data);
 }
 
+template<typename T>
+void ListenerAlgoStreamToPrc<T>::ProcessAddBatch(span<Price<T>> _data)
+{
+    service->PublishAlgorithmicPrices(_data);
+}
+
 template<typename T>
 void ListenerAlgoStreamToPrc<T>::ProcessRemove(Price<T>& _data) {}
 
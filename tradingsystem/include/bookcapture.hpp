@@ -0,0 +1,191 @@
+/**
+ * bookcapture.hpp
+ * Defines BookCapture, a compact in-memory recording of order books that can be saved to and loaded from a
+ * binary file, for replaying market data without parsing it again.
+ *
+ * Each book is a fixed-size record of its product's index, venue and the price and quantity of up to Depth
+ * orders per side, and each product is stored once. The file holds a header (magic, depth, product count),
+ * the product identifiers each preceded by its length, the record count and the records as laid out in
+ * memory, so a capture loads with one read. Captures are written and read on the same machine.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef BOOK_CAPTURE_HPP
+#define BOOK_CAPTURE_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "marketdataservice.hpp"
+
+using namespace std;
+
+/**
+ * Recorded order books of one product type.
+ * T: The product type.
+ * Depth: Maximum number of orders recorded on each side.
+ */
+template <typename T, size_t Depth = DEFAULT_BOOK_DEPTH>
+class BookCapture {
+   public:
+    // First bytes of a capture file
+    static constexpr char MAGIC[8] = {'B', 'K', 'C', 'A', 'P', 'T', '0', '1'};
+
+    /**
+     * One recorded book.
+     */
+    struct Record {
+        uint32_t product;                  // Index of the product
+        uint8_t venue;                     // Venue quoted on
+        uint8_t bidCount;                  // Number of bids recorded
+        uint8_t offerCount;                // Number of offers recorded
+        array<int64_t, Depth> bidPrices;   // Bid prices in ticks, best first
+        array<int64_t, Depth> bidSizes;    // Bid quantities
+        array<int64_t, Depth> offerPrices; // Offer prices in ticks, best first
+        array<int64_t, Depth> offerSizes;  // Offer quantities
+    };
+
+    // Record a book at the end of the capture
+    void Append(const OrderBook<T, Depth>& _book);
+
+    // Rebuild the book recorded at an index
+    OrderBook<T, Depth> Book(size_t _index) const;
+
+    // Number of books recorded
+    size_t GetSize() const;
+
+    // Products of the books recorded, by index
+    const vector<T>& GetProducts() const;
+
+    // Write the capture to a file; throws if it cannot be written
+    void Save(const string& _path) const;
+
+    // Read a capture from a file, making each product from its identifier; throws if the file is not a capture
+    // of this depth
+    template <typename F>
+    static BookCapture Load(const string& _path, F _makeProduct);
+
+   private:
+    vector<T> products;                          // Products by index
+    unordered_map<string, uint32_t> indices;     // Index of each product identifier
+    vector<Record> records;                      // Books in the order recorded
+};
+
+template <typename T, size_t Depth>
+void BookCapture<T, Depth>::Append(const OrderBook<T, Depth>& _book) {
+    const string& productId = _book.GetProduct().GetProductId();
+    auto [it, added] = indices.try_emplace(productId, static_cast<uint32_t>(products.size()));
+    if (added) products.push_back(_book.GetProduct());
+
+    Record record{};
+    record.product = it->second;
+    record.venue = static_cast<uint8_t>(_book.GetVenue());
+    span<const Order> bids = _book.GetBidStack();
+    span<const Order> offers = _book.GetOfferStack();
+    record.bidCount = static_cast<uint8_t>(bids.size());
+    record.offerCount = static_cast<uint8_t>(offers.size());
+    for (size_t i = 0; i < bids.size(); ++i) {
+        record.bidPrices[i] = bids[i].GetPrice().Count();
+        record.bidSizes[i] = bids[i].GetQuantity();
+    }
+    for (size_t i = 0; i < offers.size(); ++i) {
+        record.offerPrices[i] = offers[i].GetPrice().Count();
+        record.offerSizes[i] = offers[i].GetQuantity();
+    }
+    records.push_back(record);
+}
+
+template <typename T, size_t Depth>
+OrderBook<T, Depth> BookCapture<T, Depth>::Book(size_t _index) const {
+    const Record& record = records.at(_index);
+    array<Order, Depth> bids, offers;
+    for (size_t i = 0; i < record.bidCount; ++i) {
+        bids[i] = Order(Ticks(record.bidPrices[i]), record.bidSizes[i], BID);
+    }
+    for (size_t i = 0; i < record.offerCount; ++i) {
+        offers[i] = Order(Ticks(record.offerPrices[i]), record.offerSizes[i], OFFER);
+    }
+    return OrderBook<T, Depth>(products[record.product], span<const Order>(bids.data(), record.bidCount),
+                               span<const Order>(offers.data(), record.offerCount),
+                               static_cast<Market>(record.venue));
+}
+
+template <typename T, size_t Depth>
+size_t BookCapture<T, Depth>::GetSize() const {
+    return records.size();
+}
+
+template <typename T, size_t Depth>
+const vector<T>& BookCapture<T, Depth>::GetProducts() const {
+    return products;
+}
+
+template <typename T, size_t Depth>
+void BookCapture<T, Depth>::Save(const string& _path) const {
+    ofstream file(_path, ios::binary | ios::trunc);
+    if (!file) throw std::runtime_error("Cannot open capture file: " + _path);
+
+    uint32_t header[2] = {static_cast<uint32_t>(Depth), static_cast<uint32_t>(products.size())};
+    file.write(MAGIC, sizeof(MAGIC));
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const auto& product : products) {
+        const string& productId = product.GetProductId();
+        uint32_t length = static_cast<uint32_t>(productId.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(productId.data(), length);
+    }
+    uint64_t count = records.size();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(records.data()), static_cast<streamsize>(count * sizeof(Record)));
+    if (!file) throw std::runtime_error("Cannot write capture file: " + _path);
+}
+
+template <typename T, size_t Depth>
+template <typename F>
+BookCapture<T, Depth> BookCapture<T, Depth>::Load(const string& _path, F _makeProduct) {
+    ifstream file(_path, ios::binary);
+    if (!file) throw std::runtime_error("Cannot open capture file: " + _path);
+
+    char magic[sizeof(MAGIC)];
+    uint32_t header[2];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::invalid_argument("Not a book capture: " + _path);
+    }
+    if (header[0] != Depth) {
+        throw std::invalid_argument("Capture of depth " + to_string(header[0]) + " read at depth " +
+                                    to_string(Depth) + ": " + _path);
+    }
+
+    BookCapture capture;
+    for (uint32_t i = 0; i < header[1]; ++i) {
+        uint32_t length = 0;
+        file.read(reinterpret_cast<char*>(&length), sizeof(length));
+        string productId(length, '\0');
+        file.read(productId.data(), length);
+        capture.indices.emplace(productId, i);
+        capture.products.push_back(_makeProduct(productId));
+    }
+    uint64_t count = 0;
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    capture.records.resize(count);
+    file.read(reinterpret_cast<char*>(capture.records.data()), static_cast<streamsize>(count * sizeof(Record)));
+    if (!file) throw std::invalid_argument("Truncated book capture: " + _path);
+    for (const Record& record : capture.records) {
+        if (record.product >= header[1] || record.venue >= MARKET_COUNT || record.bidCount > Depth ||
+            record.offerCount > Depth) {
+            throw std::invalid_argument("Corrupt book capture: " + _path);
+        }
+    }
+    return capture;
+}
+
+#endif
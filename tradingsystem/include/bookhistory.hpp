@@ -0,0 +1,319 @@
+/**
+ * bookhistory.hpp
+ * Defines BookHistory, a bounded lookback of consolidated top-of-book snapshots per product.
+ *
+ * Every product gets a ring of a fixed, power-of-two number of slots when it is first seen, so the
+ * memory held is capacity x products however long the run lasts. Appending overwrites the oldest
+ * slot in O(1). Next to the compact top-N snapshots the ring keeps one column per derived quantity
+ * (spread, microprice, top notional and size, time until the next snapshot), so a window reduction
+ * is one or two contiguous loops that the compiler vectorizes (see -fopenmp-simd in CMakeLists.txt).
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef BOOK_HISTORY_HPP
+#define BOOK_HISTORY_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "coroutine.hpp"
+#include "marketdataservice.hpp"
+
+using namespace std;
+
+/**
+ * The best Depth levels of each side of a consolidated book at one point in time, in ticks.
+ * Aligned to a cache line so that a snapshot never straddles more lines than its size requires.
+ */
+template <size_t Depth>
+struct alignas(64) BookSnapshot {
+    uint64_t time = 0;                // Time the snapshot was taken, in nanoseconds
+    uint32_t bidLevels = 0;           // Number of bid levels filled in
+    uint32_t offerLevels = 0;         // Number of offer levels filled in
+    int64_t bidPrices[Depth] = {};    // Bid prices, best first
+    int64_t bidSizes[Depth] = {};     // Bid quantities, best first
+    int64_t offerPrices[Depth] = {};  // Offer prices, best first
+    int64_t offerSizes[Depth] = {};   // Offer quantities, best first
+};
+
+/**
+ * Listener on the market data service recording the consolidated top Depth levels of each product
+ * after every snapshot or delta. Books missing either side are not recorded.
+ * Queries look back over the newest _window snapshots of a product; results are in ticks.
+ * T: The product type. Depth: Number of levels kept per side.
+ */
+template <typename T, size_t Depth = 5>
+class BookHistory : public BookDeltaListener<T> {
+   public:
+    // Snapshots kept per product unless configured otherwise
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+
+    // Constructor taking the service holding the consolidated books, the snapshots kept per product
+    // (rounded up to a power of two) and the scheduler whose logical time stamps the snapshots;
+    // without a scheduler they are stamped with the steady clock
+    explicit BookHistory(BondMarketDataService<T>& _service, size_t _capacity = DEFAULT_CAPACITY,
+                         const Scheduler* _clock = nullptr);
+
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // Listener callback for a book removal
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+    // Append the current consolidated top of a product
+    void Record(const string& _productId);
+
+    // Snapshots kept per product
+    size_t GetCapacity() const;
+
+    // Number of snapshots currently held for a product
+    size_t GetSize(const string& _productId) const;
+
+    // Snapshot _ago records before the newest one; throws if it is no longer held
+    const BookSnapshot<Depth>& GetSnapshot(const string& _productId, size_t _ago = 0) const;
+
+    // Mean bid/offer spread over the window
+    double MeanSpread(const string& _productId, size_t _window) const;
+
+    // Spread weighted by how long each snapshot stood, over the window
+    double TimeWeightedSpread(const string& _productId, size_t _window) const;
+
+    // Volume-weighted price of the best bid and offer quantities over the window
+    double TopVwap(const string& _productId, size_t _window) const;
+
+    // Size-weighted mid of the best bid and offer, _ago records before the newest snapshot
+    double Microprice(const string& _productId, size_t _ago = 0) const;
+
+    // Change in microprice from the oldest to the newest snapshot of the window
+    double MicropriceDrift(const string& _productId, size_t _window) const;
+
+   private:
+    /**
+     * Ring of snapshots of one product with a column per derived quantity, all indexed by slot.
+     */
+    struct Ring {
+        vector<BookSnapshot<Depth>> snapshots;
+        vector<double> spreads;      // Offer minus bid
+        vector<double> microprices;  // Size-weighted mid
+        vector<double> notionals;    // Bid x bid size + offer x offer size
+        vector<double> sizes;        // Bid size + offer size
+        vector<double> durations;    // Time until the next snapshot, zero for the newest
+        uint64_t appended = 0;       // Snapshots ever appended
+    };
+
+    // Ring of a product; throws if the product has never been recorded
+    const Ring& Find(const string& _productId) const;
+
+    // Slot of the snapshot _ago records before the newest one
+    size_t Slot(const Ring& _ring, size_t _ago) const;
+
+    // Call _reduce(begin, end) for the one or two contiguous slot ranges holding the newest _window snapshots
+    template <typename F>
+    void ForWindow(const Ring& _ring, size_t _window, F&& _reduce) const;
+
+    // Sum of _count values
+    static double Sum(const double* _values, size_t _count);
+
+    // Sum of the products of _count pairs of values
+    static double Dot(const double* _values, const double* _weights, size_t _count);
+
+    BondMarketDataService<T>& service;      // Source of the consolidated books
+    size_t capacity;                        // Snapshots kept per product
+    const Scheduler* clock;                 // Source of logical time, if any
+    unordered_map<string, Ring> rings;      // Ring of each product
+};
+
+template <typename T, size_t Depth>
+BookHistory<T, Depth>::BookHistory(BondMarketDataService<T>& _service, size_t _capacity, const Scheduler* _clock)
+    : service(_service), capacity(bit_ceil(max<size_t>(_capacity, 1))), clock(_clock) {}
+
+template <typename T, size_t Depth>
+void BookHistory<T, Depth>::ProcessAdd(OrderBook<T>& _data) {
+    Record(_data.GetProduct().GetProductId());
+}
+
+template <typename T, size_t Depth>
+void BookHistory<T, Depth>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T, size_t Depth>
+void BookHistory<T, Depth>::ProcessUpdate(OrderBook<T>& _data) {
+    Record(_data.GetProduct().GetProductId());
+}
+
+template <typename T, size_t Depth>
+void BookHistory<T, Depth>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    Record(_book.GetProduct().GetProductId());
+}
+
+template <typename T, size_t Depth>
+void BookHistory<T, Depth>::Record(const string& _productId) {
+    const ConsolidatedBook<T>& book = service.GetConsolidatedBook(_productId);
+    const vector<ConsolidatedLevel>& bids = book.GetBidLevels();
+    const vector<ConsolidatedLevel>& offers = book.GetOfferLevels();
+    if (bids.empty() || offers.empty()) return;
+
+    auto [it, inserted] = rings.try_emplace(_productId);
+    Ring& ring = it->second;
+    if (inserted) {
+        ring.snapshots.resize(capacity);
+        ring.spreads.resize(capacity);
+        ring.microprices.resize(capacity);
+        ring.notionals.resize(capacity);
+        ring.sizes.resize(capacity);
+        ring.durations.resize(capacity);
+    }
+
+    size_t slot = ring.appended & (capacity - 1);
+    BookSnapshot<Depth>& snapshot = ring.snapshots[slot];
+    snapshot.time = clock ? clock->GetTime() : MetricsNow();
+    snapshot.bidLevels = static_cast<uint32_t>(min(bids.size(), Depth));
+    snapshot.offerLevels = static_cast<uint32_t>(min(offers.size(), Depth));
+    for (size_t i = 0; i < snapshot.bidLevels; ++i) {
+        snapshot.bidPrices[i] = bids[i].price.Count();
+        snapshot.bidSizes[i] = bids[i].quantity;
+    }
+    for (size_t i = 0; i < snapshot.offerLevels; ++i) {
+        snapshot.offerPrices[i] = offers[i].price.Count();
+        snapshot.offerSizes[i] = offers[i].quantity;
+    }
+
+    double bid = static_cast<double>(snapshot.bidPrices[0]);
+    double offer = static_cast<double>(snapshot.offerPrices[0]);
+    double bidSize = static_cast<double>(snapshot.bidSizes[0]);
+    double offerSize = static_cast<double>(snapshot.offerSizes[0]);
+    ring.spreads[slot] = offer - bid;
+    ring.microprices[slot] = (bid * offerSize + offer * bidSize) / (bidSize + offerSize);
+    ring.notionals[slot] = bid * bidSize + offer * offerSize;
+    ring.sizes[slot] = bidSize + offerSize;
+    ring.durations[slot] = 0;
+
+    // The previous snapshot stood until this one
+    if (ring.appended > 0) {
+        size_t previous = (ring.appended - 1) & (capacity - 1);
+        ring.durations[previous] = static_cast<double>(snapshot.time - ring.snapshots[previous].time);
+    }
+    ++ring.appended;
+}
+
+template <typename T, size_t Depth>
+size_t BookHistory<T, Depth>::GetCapacity() const {
+    return capacity;
+}
+
+template <typename T, size_t Depth>
+size_t BookHistory<T, Depth>::GetSize(const string& _productId) const {
+    auto it = rings.find(_productId);
+    return it == rings.end() ? 0 : static_cast<size_t>(min<uint64_t>(it->second.appended, capacity));
+}
+
+template <typename T, size_t Depth>
+const typename BookHistory<T, Depth>::Ring& BookHistory<T, Depth>::Find(const string& _productId) const {
+    auto it = rings.find(_productId);
+    if (it == rings.end()) throw std::invalid_argument("No book history for product: " + _productId);
+    return it->second;
+}
+
+template <typename T, size_t Depth>
+size_t BookHistory<T, Depth>::Slot(const Ring& _ring, size_t _ago) const {
+    if (_ago >= min<uint64_t>(_ring.appended, capacity)) throw std::out_of_range("Snapshot no longer held");
+    return (_ring.appended - 1 - _ago) & (capacity - 1);
+}
+
+template <typename T, size_t Depth>
+const BookSnapshot<Depth>& BookHistory<T, Depth>::GetSnapshot(const string& _productId, size_t _ago) const {
+    const Ring& ring = Find(_productId);
+    return ring.snapshots[Slot(ring, _ago)];
+}
+
+template <typename T, size_t Depth>
+template <typename F>
+void BookHistory<T, Depth>::ForWindow(const Ring& _ring, size_t _window, F&& _reduce) const {
+    size_t count = static_cast<size_t>(min<uint64_t>({_window, _ring.appended, capacity}));
+    if (count == 0) return;
+    size_t oldest = (_ring.appended - count) & (capacity - 1);
+    if (oldest + count <= capacity) {
+        _reduce(oldest, oldest + count);
+    } else {
+        _reduce(oldest, capacity);
+        _reduce(size_t{0}, oldest + count - capacity);
+    }
+}
+
+template <typename T, size_t Depth>
+double BookHistory<T, Depth>::Sum(const double* _values, size_t _count) {
+    double sum = 0;
+#pragma omp simd reduction(+ : sum)
+    for (size_t i = 0; i < _count; ++i) sum += _values[i];
+    return sum;
+}
+
+template <typename T, size_t Depth>
+double BookHistory<T, Depth>::Dot(const double* _values, const double* _weights, size_t _count) {
+    double sum = 0;
+#pragma omp simd reduction(+ : sum)
+    for (size_t i = 0; i < _count; ++i) sum += _values[i] * _weights[i];
+    return sum;
+}
+
+template <typename T, size_t Depth>
+double BookHistory<T, Depth>::MeanSpread(const string& _productId, size_t _window) const {
+    const Ring& ring = Find(_productId);
+    double total = 0;
+    size_t count = 0;
+    ForWindow(ring, _window, [&](size_t _begin, size_t _end) {
+        total += Sum(ring.spreads.data() + _begin, _end - _begin);
+        count += _end - _begin;
+    });
+    return count == 0 ? 0.0 : total / count;
+}
+
+template <typename T, size_t Depth>
+double BookHistory<T, Depth>::TimeWeightedSpread(const string& _productId, size_t _window) const {
+    const Ring& ring = Find(_productId);
+    double weighted = 0, time = 0;
+    ForWindow(ring, _window, [&](size_t _begin, size_t _end) {
+        weighted += Dot(ring.spreads.data() + _begin, ring.durations.data() + _begin, _end - _begin);
+        time += Sum(ring.durations.data() + _begin, _end - _begin);
+    });
+    // A window whose snapshots all share one timestamp falls back to the plain mean
+    return time == 0 ? MeanSpread(_productId, _window) : weighted / time;
+}
+
+template <typename T, size_t Depth>
+double BookHistory<T, Depth>::TopVwap(const string& _productId, size_t _window) const {
+    const Ring& ring = Find(_productId);
+    double notional = 0, size = 0;
+    ForWindow(ring, _window, [&](size_t _begin, size_t _end) {
+        notional += Sum(ring.notionals.data() + _begin, _end - _begin);
+        size += Sum(ring.sizes.data() + _begin, _end - _begin);
+    });
+    return size == 0 ? 0.0 : notional / size;
+}
+
+template <typename T, size_t Depth>
+double BookHistory<T, Depth>::Microprice(const string& _productId, size_t _ago) const {
+    const Ring& ring = Find(_productId);
+    return ring.microprices[Slot(ring, _ago)];
+}
+
+template <typename T, size_t Depth>
+double BookHistory<T, Depth>::MicropriceDrift(const string& _productId, size_t _window) const {
+    const Ring& ring = Find(_productId);
+    size_t count = static_cast<size_t>(min<uint64_t>({_window, ring.appended, capacity}));
+    if (count == 0) return 0.0;
+    return ring.microprices[Slot(ring, 0)] - ring.microprices[Slot(ring, count - 1)];
+}
+
+#endif
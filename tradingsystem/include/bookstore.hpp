@@ -0,0 +1,302 @@
+/**
+ * bookstore.hpp
+ * Defines BookStore, a columnar copy of the top of every consolidated book held by the market data service.
+ *
+ * Each product is given one dense row the first time one of its books is seen, holding the best bid
+ * and offer across all venues. Best bid and offer prices, their sizes and the bid/offer spread are kept
+ * in one contiguous int64 array per field, so scans across the whole universe ("every product with a
+ * spread of at most X", "total size on the bid") read a few cache lines per field instead of one map
+ * node and book per product.
+ *
+ * The scan kernels use AVX-512 or AVX2 when the compiler targets them (ENABLE_NATIVE_ARCH in
+ * CMakeLists.txt) and otherwise fall back to scalar loops with the same results.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef BOOK_STORE_HPP
+#define BOOK_STORE_HPP
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "marketdataservice.hpp"
+
+using namespace std;
+
+/**
+ * Listener on the market data service keeping the top of every consolidated book in columns indexed by
+ * row, where a row is one product.
+ * Prices and spreads are stored as tick counts. A side without orders has a price and size of zero,
+ * and a book missing either side has a spread of NO_SPREAD so that spread filters never select it.
+ * T: The product type.
+ */
+template <typename T>
+class BookStore : public BookDeltaListener<T> {
+   public:
+    // Spread recorded for a book without both a bid and an offer
+    static constexpr int64_t NO_SPREAD = numeric_limits<int64_t>::max();
+
+    // Constructor taking the service whose consolidated books are copied; register the store on it
+    explicit BookStore(BondMarketDataService<T>& _marketData);
+
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // Listener callback for a book removal; the product keeps its rows
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book; only a changed top is copied, as a level at
+    // the consolidated best is always at the top of its venue's book
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+    // Copy the top of the consolidated book of a book's product into its row, adding a row for a new product
+    void Update(const OrderBook<T>& _book);
+
+    // Number of rows in the store
+    size_t GetSize() const;
+
+    // Row of a product; throws if the product has never been seen
+    size_t IndexOf(const string& _productId) const;
+
+    // Product at a row
+    const string& GetProductId(size_t _index) const;
+
+    // Columns indexed by row
+    span<const int64_t> GetBidPrices() const;
+    span<const int64_t> GetOfferPrices() const;
+    span<const int64_t> GetBidSizes() const;
+    span<const int64_t> GetOfferSizes() const;
+    span<const int64_t> GetSpreads() const;
+
+    // Append the rows whose spread is at most _maxSpread to _rows; returns the number appended
+    size_t SelectSpreadAtMost(Ticks _maxSpread, vector<uint32_t>& _rows) const;
+
+    // Number of rows whose spread is at most _maxSpread
+    size_t CountSpreadAtMost(Ticks _maxSpread) const;
+
+    // Tightest spread across all products with both sides, or NO_SPREAD if there is none
+    Ticks MinSpread() const;
+
+    // Total size at the best bid and at the best offer across all products
+    int64_t TotalBidSize() const;
+    int64_t TotalOfferSize() const;
+
+   private:
+    // Call _emit with every index i where _values[i] <= _limit, in increasing order
+    template <typename F>
+    static void ScanAtMost(const int64_t* _values, size_t _count, int64_t _limit, F&& _emit);
+
+    // Smallest of _count values, or the largest int64 when _count is zero
+    static int64_t Min(const int64_t* _values, size_t _count);
+
+    // Sum of _count values
+    static int64_t Sum(const int64_t* _values, size_t _count);
+
+    BondMarketDataService<T>& marketData;  // Source of the consolidated books
+    unordered_map<string, uint32_t> rows;  // Row of each product
+    vector<string> productIds;             // Product of each row
+    vector<int64_t> bidPrices;             // Best bid price in ticks
+    vector<int64_t> offerPrices;           // Best offer price in ticks
+    vector<int64_t> bidSizes;              // Size at the best bid
+    vector<int64_t> offerSizes;            // Size at the best offer
+    vector<int64_t> spreads;               // Best offer minus best bid in ticks
+};
+
+template <typename T>
+BookStore<T>::BookStore(BondMarketDataService<T>& _marketData) : marketData(_marketData) {}
+
+template <typename T>
+void BookStore<T>::ProcessAdd(OrderBook<T>& _data) {
+    Update(_data);
+}
+
+template <typename T>
+void BookStore<T>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T>
+void BookStore<T>::ProcessUpdate(OrderBook<T>& _data) {
+    Update(_data);
+}
+
+template <typename T>
+void BookStore<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    if (_delta.ChangedTop(_book)) Update(_book);
+}
+
+template <typename T>
+void BookStore<T>::Update(const OrderBook<T>& _book) {
+    const string& productId = _book.GetProduct().GetProductId();
+    auto [it, inserted] = rows.try_emplace(productId, static_cast<uint32_t>(spreads.size()));
+    if (inserted) {
+        productIds.push_back(productId);
+        bidPrices.push_back(0);
+        offerPrices.push_back(0);
+        bidSizes.push_back(0);
+        offerSizes.push_back(0);
+        spreads.push_back(NO_SPREAD);
+    }
+
+    size_t row = it->second;
+    const ConsolidatedBook<T>& book = marketData.GetConsolidatedBook(productId);
+    const vector<ConsolidatedLevel>& bids = book.GetBidLevels();
+    const vector<ConsolidatedLevel>& offers = book.GetOfferLevels();
+    bidPrices[row] = bids.empty() ? 0 : bids.front().price.Count();
+    bidSizes[row] = bids.empty() ? 0 : bids.front().quantity;
+    offerPrices[row] = offers.empty() ? 0 : offers.front().price.Count();
+    offerSizes[row] = offers.empty() ? 0 : offers.front().quantity;
+    spreads[row] = !bids.empty() && !offers.empty() ? offerPrices[row] - bidPrices[row] : NO_SPREAD;
+}
+
+template <typename T>
+size_t BookStore<T>::GetSize() const {
+    return spreads.size();
+}
+
+template <typename T>
+size_t BookStore<T>::IndexOf(const string& _productId) const {
+    auto it = rows.find(_productId);
+    if (it == rows.end()) throw std::invalid_argument("Unknown product in book store: " + _productId);
+    return it->second;
+}
+
+template <typename T>
+const string& BookStore<T>::GetProductId(size_t _index) const {
+    return productIds[_index];
+}
+
+template <typename T>
+span<const int64_t> BookStore<T>::GetBidPrices() const {
+    return bidPrices;
+}
+
+template <typename T>
+span<const int64_t> BookStore<T>::GetOfferPrices() const {
+    return offerPrices;
+}
+
+template <typename T>
+span<const int64_t> BookStore<T>::GetBidSizes() const {
+    return bidSizes;
+}
+
+template <typename T>
+span<const int64_t> BookStore<T>::GetOfferSizes() const {
+    return offerSizes;
+}
+
+template <typename T>
+span<const int64_t> BookStore<T>::GetSpreads() const {
+    return spreads;
+}
+
+template <typename T>
+size_t BookStore<T>::SelectSpreadAtMost(Ticks _maxSpread, vector<uint32_t>& _rows) const {
+    size_t before = _rows.size();
+    ScanAtMost(spreads.data(), spreads.size(), _maxSpread.Count(),
+               [&](size_t _row) { _rows.push_back(static_cast<uint32_t>(_row)); });
+    return _rows.size() - before;
+}
+
+template <typename T>
+size_t BookStore<T>::CountSpreadAtMost(Ticks _maxSpread) const {
+    size_t count = 0;
+    ScanAtMost(spreads.data(), spreads.size(), _maxSpread.Count(), [&](size_t) { ++count; });
+    return count;
+}
+
+template <typename T>
+Ticks BookStore<T>::MinSpread() const {
+    return Ticks(Min(spreads.data(), spreads.size()));
+}
+
+template <typename T>
+int64_t BookStore<T>::TotalBidSize() const {
+    return Sum(bidSizes.data(), bidSizes.size());
+}
+
+template <typename T>
+int64_t BookStore<T>::TotalOfferSize() const {
+    return Sum(offerSizes.data(), offerSizes.size());
+}
+
+template <typename T>
+template <typename F>
+void BookStore<T>::ScanAtMost(const int64_t* _values, size_t _count, int64_t _limit, F&& _emit) {
+    size_t i = 0;
+#if defined(__AVX512F__)
+    const __m512i limit = _mm512_set1_epi64(_limit);
+    for (; i + 8 <= _count; i += 8) {
+        __mmask8 mask = _mm512_cmple_epi64_mask(_mm512_loadu_si512(_values + i), limit);
+        for (unsigned bits = mask; bits; bits &= bits - 1) _emit(i + countr_zero(bits));
+    }
+#elif defined(__AVX2__)
+    const __m256i limit = _mm256_set1_epi64x(_limit);
+    for (; i + 4 <= _count; i += 4) {
+        __m256i greater = _mm256_cmpgt_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_values + i)), limit);
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(greater))) & 0xF;
+        for (unsigned bits = mask; bits; bits &= bits - 1) _emit(i + countr_zero(bits));
+    }
+#endif
+    for (; i < _count; ++i) {
+        if (_values[i] <= _limit) _emit(i);
+    }
+}
+
+template <typename T>
+int64_t BookStore<T>::Min(const int64_t* _values, size_t _count) {
+    int64_t result = numeric_limits<int64_t>::max();
+    size_t i = 0;
+#if defined(__AVX512F__)
+    __m512i lanes = _mm512_set1_epi64(result);
+    for (; i + 8 <= _count; i += 8) lanes = _mm512_min_epi64(lanes, _mm512_loadu_si512(_values + i));
+    result = _mm512_reduce_min_epi64(lanes);
+#elif defined(__AVX2__)
+    __m256i lanes = _mm256_set1_epi64x(result);
+    for (; i + 4 <= _count; i += 4) {
+        __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_values + i));
+        lanes = _mm256_blendv_epi8(lanes, values, _mm256_cmpgt_epi64(lanes, values));
+    }
+    alignas(32) int64_t partial[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(partial), lanes);
+    for (int64_t value : partial) result = std::min(result, value);
+#endif
+    for (; i < _count; ++i) result = std::min(result, _values[i]);
+    return result;
+}
+
+template <typename T>
+int64_t BookStore<T>::Sum(const int64_t* _values, size_t _count) {
+    int64_t result = 0;
+    size_t i = 0;
+#if defined(__AVX512F__)
+    __m512i lanes = _mm512_setzero_si512();
+    for (; i + 8 <= _count; i += 8) lanes = _mm512_add_epi64(lanes, _mm512_loadu_si512(_values + i));
+    result = _mm512_reduce_add_epi64(lanes);
+#elif defined(__AVX2__)
+    __m256i lanes = _mm256_setzero_si256();
+    for (; i + 4 <= _count; i += 4) {
+        lanes = _mm256_add_epi64(lanes, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_values + i)));
+    }
+    alignas(32) int64_t partial[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(partial), lanes);
+    for (int64_t value : partial) result += value;
+#endif
+    for (; i < _count; ++i) result += _values[i];
+    return result;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * conflator.hpp
+ * Defines BookConflator, a conflation stage between the market data service and slower consumers.
+ *
+ * The conflator listens to the market data service and keeps only the latest book of each product
+ * and venue in a slot table. A slot is marked dirty when its book changes and stays in the dirty list until a
+ * consumer drains it, so a burst of updates to one product costs the consumer a single callback
+ * with the newest book instead of one per update.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef CONFLATOR_HPP
+#define CONFLATOR_HPP
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "coroutine.hpp"
+#include "marketdataservice.hpp"
+
+using namespace std;
+
+/**
+ * Conflating relay for order books. Register it as a listener on the market data service and
+ * register the downstream listeners on it; they receive the latest book of every changed product and
+ * venue through ProcessAdd whenever Drain is called, in the order the books first became dirty.
+ * T: The product type.
+ */
+template <typename T>
+class BookConflator : public BookDeltaListener<T> {
+   public:
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // Listener callback for a book removal; a removed book is not conflated
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+    // Add a downstream listener
+    void AddListener(ServiceListener<OrderBook<T>>* _listener);
+
+    // Publish up to _max dirty books to the downstream listeners; returns the number published
+    size_t Drain(size_t _max = numeric_limits<size_t>::max());
+
+    // Drain every _interval of logical time until _upstream is closed and empty and no slot is dirty
+    Task Pump(Scheduler& _scheduler, uint64_t _interval, const BoundedChannel<OrderBook<T>>& _upstream);
+
+    // Number of books waiting to be published
+    size_t GetDirtyCount() const;
+
+    // Number of book changes received from the market data service
+    uint64_t GetReceived() const;
+
+    // Number of books published downstream
+    uint64_t GetPublished() const;
+
+    // Book changes received per book published; 1 means nothing was conflated
+    double GetConflationRatio() const;
+
+   private:
+    /**
+     * Latest book of one product and whether it has changed since it was last published.
+     */
+    struct Slot {
+        OrderBook<T> book;
+        bool dirty = false;
+    };
+
+    // Store a book in its slot and mark the slot dirty
+    void Store(const OrderBook<T>& _book);
+
+    unordered_map<string, uint32_t> productSlots;      // First of the MARKET_COUNT slots of each product
+    vector<Slot> slots;                                // Latest book per product and venue
+    vector<uint32_t> dirtySlots;                       // Dirty slots in the order they became dirty
+    vector<ServiceListener<OrderBook<T>>*> listeners;  // Downstream listeners
+    uint64_t received = 0;                             // Book changes received
+    uint64_t published = 0;                            // Books published
+};
+
+template <typename T>
+void BookConflator<T>::ProcessAdd(OrderBook<T>& _data) {
+    Store(_data);
+}
+
+template <typename T>
+void BookConflator<T>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T>
+void BookConflator<T>::ProcessUpdate(OrderBook<T>& _data) {
+    Store(_data);
+}
+
+template <typename T>
+void BookConflator<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    Store(_book);
+}
+
+template <typename T>
+void BookConflator<T>::Store(const OrderBook<T>& _book) {
+    ++received;
+    const string& productId = _book.GetProduct().GetProductId();
+    auto [it, inserted] = productSlots.try_emplace(productId, static_cast<uint32_t>(slots.size()));
+    if (inserted) slots.resize(slots.size() + MARKET_COUNT);
+
+    // Assignment reuses the slot's stack capacity, so a warmed-up slot does not allocate
+    uint32_t index = it->second + _book.GetVenue();
+    Slot& slot = slots[index];
+    slot.book = _book;
+    if (!slot.dirty) {
+        slot.dirty = true;
+        dirtySlots.push_back(index);
+    }
+}
+
+template <typename T>
+void BookConflator<T>::AddListener(ServiceListener<OrderBook<T>>* _listener) {
+    listeners.push_back(_listener);
+}
+
+template <typename T>
+size_t BookConflator<T>::Drain(size_t _max) {
+    size_t count = min(_max, dirtySlots.size());
+    for (size_t i = 0; i < count; ++i) {
+        // Cleared before publishing so a change made by a listener is queued again
+        Slot& slot = slots[dirtySlots[i]];
+        slot.dirty = false;
+        ++published;
+        for (auto& l : listeners) l->ProcessAdd(slot.book);
+    }
+    dirtySlots.erase(dirtySlots.begin(), dirtySlots.begin() + count);
+    return count;
+}
+
+template <typename T>
+Task BookConflator<T>::Pump(Scheduler& _scheduler, uint64_t _interval, const BoundedChannel<OrderBook<T>>& _upstream) {
+    uint64_t time = 0;
+    while (!_upstream.IsClosed() || _upstream.GetSize() > 0 || !dirtySlots.empty()) {
+        Drain();
+        time += _interval;
+        co_await _scheduler.Yield(time);
+    }
+}
+
+template <typename T>
+size_t BookConflator<T>::GetDirtyCount() const {
+    return dirtySlots.size();
+}
+
+template <typename T>
+uint64_t BookConflator<T>::GetReceived() const {
+    return received;
+}
+
+template <typename T>
+uint64_t BookConflator<T>::GetPublished() const {
+    return published;
+}
+
+template <typename T>
+double BookConflator<T>::GetConflationRatio() const {
+    return published == 0 ? 1.0 : static_cast<double>(received) / published;
+}
+
+#endif
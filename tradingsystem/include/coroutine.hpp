@@ -0,0 +1,458 @@
+/**
+ * coroutine.hpp
+ * Defines a single-threaded cooperative runtime built on C++20 coroutines:
+ * a lazy Generator used by connectors to yield parsed messages, a Task type for long-running
+ * feeds and consumers, a Scheduler that interleaves tasks either round-robin or by logical
+ * timestamp, and a BoundedChannel whose Push suspends the producer until the consumer has
+ * capacity again.
+ *
+ * Every task is a root coroutine resumed only by the Scheduler, so no locking is needed. The
+ * ready queue and the channel wait lists are the only shared state, which keeps the door open
+ * to running one Scheduler per thread with work stealing between their ready queues.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef COROUTINE_HPP
+#define COROUTINE_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Lazy sequence of values produced by a coroutine with co_yield.
+ * The yielded object is only valid until the generator is advanced.
+ */
+template <typename T>
+class Generator {
+   public:
+    struct promise_type {
+        T* current = nullptr;
+        exception_ptr exception;
+
+        Generator get_return_object() { return Generator(coroutine_handle<promise_type>::from_promise(*this)); }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_always final_suspend() noexcept { return {}; }
+        suspend_always yield_value(T& _value) noexcept {
+            current = addressof(_value);
+            return {};
+        }
+        suspend_always yield_value(T&& _value) noexcept {
+            current = addressof(_value);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { exception = current_exception(); }
+    };
+
+    class Iterator {
+       public:
+        using iterator_category = input_iterator_tag;
+        using difference_type = ptrdiff_t;
+        using value_type = T;
+
+        Iterator() = default;
+        explicit Iterator(coroutine_handle<promise_type> _handle) : handle(_handle) {}
+
+        T& operator*() const { return *handle.promise().current; }
+        T* operator->() const { return handle.promise().current; }
+        Iterator& operator++() {
+            Advance(handle);
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+        bool operator==(default_sentinel_t) const { return !handle || handle.done(); }
+
+       private:
+        coroutine_handle<promise_type> handle;
+    };
+
+    Generator(Generator&& _other) noexcept : handle(exchange(_other.handle, nullptr)) {}
+    Generator& operator=(Generator&& _other) noexcept;
+    ~Generator();
+
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+
+    // Run the coroutine to its first value
+    Iterator begin();
+    default_sentinel_t end() { return default_sentinel; }
+
+   private:
+    explicit Generator(coroutine_handle<promise_type> _handle) : handle(_handle) {}
+
+    // Resume the coroutine and surface any exception it raised
+    static void Advance(coroutine_handle<promise_type> _handle);
+
+    coroutine_handle<promise_type> handle;
+};
+
+template <typename T>
+Generator<T>& Generator<T>::operator=(Generator&& _other) noexcept {
+    if (this != &_other) {
+        if (handle) handle.destroy();
+        handle = exchange(_other.handle, nullptr);
+    }
+    return *this;
+}
+
+template <typename T>
+Generator<T>::~Generator() {
+    if (handle) handle.destroy();
+}
+
+template <typename T>
+typename Generator<T>::Iterator Generator<T>::begin() {
+    if (handle) Advance(handle);
+    return Iterator(handle);
+}
+
+template <typename T>
+void Generator<T>::Advance(coroutine_handle<promise_type> _handle) {
+    _handle.resume();
+    if (_handle.promise().exception) rethrow_exception(_handle.promise().exception);
+}
+
+/**
+ * Long-running coroutine driven by a Scheduler.
+ * Tasks start suspended and only run once spawned; the Scheduler owns them from then on.
+ */
+class Task {
+   public:
+    struct promise_type {
+        exception_ptr exception;
+
+        Task get_return_object() { return Task(coroutine_handle<promise_type>::from_promise(*this)); }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { exception = current_exception(); }
+    };
+
+    using Handle = coroutine_handle<promise_type>;
+
+    Task(Task&& _other) noexcept : handle(exchange(_other.handle, nullptr)) {}
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    // Hand the coroutine over to a new owner
+    Handle Release() { return exchange(handle, nullptr); }
+
+   private:
+    explicit Task(Handle _handle) : handle(_handle) {}
+
+    Handle handle;
+};
+
+/**
+ * Order in which a Scheduler resumes ready tasks.
+ */
+enum SchedulePolicy { ROUND_ROBIN, TIMESTAMP };
+
+/**
+ * Single-threaded cooperative scheduler.
+ * Under ROUND_ROBIN ready tasks are resumed in the order they became ready; under TIMESTAMP the
+ * task that yielded the smallest logical timestamp runs next, ties broken in arrival order.
+ */
+class Scheduler {
+   public:
+    // Awaitable returned by Yield
+    struct YieldAwaiter {
+        Scheduler& scheduler;
+        uint64_t time;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(Task::Handle _handle) { scheduler.Schedule(_handle, time); }
+        void await_resume() const noexcept {}
+    };
+
+    explicit Scheduler(SchedulePolicy _policy = ROUND_ROBIN);
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // Take ownership of a task and make it ready at the given logical time
+    void Spawn(Task&& _task, uint64_t _time = 0);
+
+    // Make a suspended task ready again at the given logical time
+    void Schedule(Task::Handle _handle, uint64_t _time);
+
+    // Suspend the current task and requeue it at the given logical time
+    YieldAwaiter Yield(uint64_t _time = 0);
+
+    // Resume ready tasks until every task has finished
+    void Run();
+
+    // Logical time of the task currently running
+    uint64_t GetTime() const;
+
+    // Number of spawned tasks that have not finished
+    size_t GetLiveCount() const;
+
+   private:
+    struct Entry {
+        uint64_t time;
+        uint64_t sequence;
+        Task::Handle handle;
+
+        bool operator>(const Entry& _other) const {
+            return time != _other.time ? time > _other.time : sequence > _other.sequence;
+        }
+    };
+
+    SchedulePolicy policy;
+    priority_queue<Entry, vector<Entry>, greater<Entry>> ready;
+    vector<Task::Handle> tasks;
+    uint64_t nextSequence;
+    uint64_t now;
+};
+
+Scheduler::Scheduler(SchedulePolicy _policy) : policy(_policy), ready(), tasks(), nextSequence(0), now(0) {}
+
+Scheduler::~Scheduler() {
+    for (auto& handle : tasks) {
+        if (handle) handle.destroy();
+    }
+}
+
+void Scheduler::Spawn(Task&& _task, uint64_t _time) {
+    Task::Handle handle = _task.Release();
+    if (!handle) return;
+    tasks.push_back(handle);
+    Schedule(handle, _time);
+}
+
+void Scheduler::Schedule(Task::Handle _handle, uint64_t _time) {
+    ready.push(Entry{policy == TIMESTAMP ? _time : 0, nextSequence++, _handle});
+}
+
+Scheduler::YieldAwaiter Scheduler::Yield(uint64_t _time) { return YieldAwaiter{*this, _time}; }
+
+void Scheduler::Run() {
+    while (!ready.empty()) {
+        Entry entry = ready.top();
+        ready.pop();
+        if (entry.time > now) now = entry.time;
+
+        entry.handle.resume();
+        if (!entry.handle.done()) continue;
+
+        exception_ptr exception = entry.handle.promise().exception;
+        for (auto& handle : tasks) {
+            if (handle == entry.handle) {
+                handle = tasks.back();
+                tasks.pop_back();
+                break;
+            }
+        }
+        entry.handle.destroy();
+        if (exception) rethrow_exception(exception);
+    }
+
+    if (!tasks.empty()) {
+        throw std::logic_error("Scheduler stalled with tasks blocked on channels");
+    }
+}
+
+uint64_t Scheduler::GetTime() const { return now; }
+
+size_t Scheduler::GetLiveCount() const { return tasks.size(); }
+
+/**
+ * Bounded FIFO connecting a producing task to a consuming task on the same Scheduler.
+ * Push suspends while the channel is full and Pop suspends while it is empty; a suspended
+ * side is handed its value directly and requeued on the Scheduler, so capacity is never exceeded.
+ */
+template <typename T>
+class BoundedChannel {
+   public:
+    // Awaitable returned by Push
+    struct PushAwaiter {
+        BoundedChannel& channel;
+        T value;
+
+        bool await_ready();
+        void await_suspend(Task::Handle _handle);
+        void await_resume() const noexcept {}
+    };
+
+    // Awaitable returned by Pop; resumes with nullopt once the channel is closed and drained
+    struct PopAwaiter {
+        BoundedChannel& channel;
+        optional<T> value;
+
+        bool await_ready();
+        void await_suspend(Task::Handle _handle);
+        optional<T> await_resume() { return std::move(value); }
+    };
+
+    // Constructor taking the scheduler that runs both ends and the maximum number of queued values
+    BoundedChannel(Scheduler& _scheduler, size_t _capacity);
+
+    BoundedChannel(const BoundedChannel&) = delete;
+    BoundedChannel& operator=(const BoundedChannel&) = delete;
+
+    // Queue a value, suspending while the channel is full
+    PushAwaiter Push(T _value);
+
+    // Take the oldest value, suspending while the channel is empty
+    PopAwaiter Pop();
+
+    // Take the oldest value if one is queued, without suspending
+    optional<T> TryPop();
+
+    // Stop accepting values; consumers see nullopt once the queue is drained
+    void Close();
+
+    // Number of values currently queued
+    size_t GetSize() const;
+
+    // Maximum number of values queued at once
+    size_t GetCapacity() const;
+
+    // Whether Close has been called
+    bool IsClosed() const;
+
+   private:
+    // Move one blocked producer's value into the queue after space was freed
+    void AdmitProducer();
+
+    Scheduler& scheduler;
+    size_t capacity;
+    bool closed;
+    deque<T> values;
+    deque<pair<Task::Handle, PushAwaiter*>> producers;
+    deque<pair<Task::Handle, PopAwaiter*>> consumers;
+};
+
+template <typename T>
+BoundedChannel<T>::BoundedChannel(Scheduler& _scheduler, size_t _capacity)
+    : scheduler(_scheduler), capacity(_capacity == 0 ? 1 : _capacity), closed(false) {}
+
+template <typename T>
+bool BoundedChannel<T>::PushAwaiter::await_ready() {
+    if (channel.closed) throw std::logic_error("Push on a closed channel");
+
+    // A waiting consumer implies an empty queue, so hand the value over directly
+    if (!channel.consumers.empty()) {
+        auto [handle, consumer] = channel.consumers.front();
+        channel.consumers.pop_front();
+        consumer->value = std::move(value);
+        channel.scheduler.Schedule(handle, channel.scheduler.GetTime());
+        return true;
+    }
+    if (channel.values.size() < channel.capacity) {
+        channel.values.push_back(std::move(value));
+        return true;
+    }
+    return false;
+}
+
+template <typename T>
+void BoundedChannel<T>::PushAwaiter::await_suspend(Task::Handle _handle) {
+    channel.producers.emplace_back(_handle, this);
+}
+
+template <typename T>
+bool BoundedChannel<T>::PopAwaiter::await_ready() {
+    value = channel.TryPop();
+    return value.has_value() || channel.closed;
+}
+
+template <typename T>
+void BoundedChannel<T>::PopAwaiter::await_suspend(Task::Handle _handle) {
+    channel.consumers.emplace_back(_handle, this);
+}
+
+template <typename T>
+typename BoundedChannel<T>::PushAwaiter BoundedChannel<T>::Push(T _value) {
+    return PushAwaiter{*this, std::move(_value)};
+}
+
+template <typename T>
+typename BoundedChannel<T>::PopAwaiter BoundedChannel<T>::Pop() {
+    return PopAwaiter{*this, nullopt};
+}
+
+template <typename T>
+optional<T> BoundedChannel<T>::TryPop() {
+    if (values.empty()) return nullopt;
+    optional<T> value(std::move(values.front()));
+    values.pop_front();
+    AdmitProducer();
+    return value;
+}
+
+template <typename T>
+void BoundedChannel<T>::AdmitProducer() {
+    if (producers.empty()) return;
+    auto [handle, producer] = producers.front();
+    producers.pop_front();
+    values.push_back(std::move(producer->value));
+    scheduler.Schedule(handle, scheduler.GetTime());
+}
+
+template <typename T>
+void BoundedChannel<T>::Close() {
+    closed = true;
+    while (!consumers.empty()) {
+        scheduler.Schedule(consumers.front().first, scheduler.GetTime());
+        consumers.pop_front();
+    }
+}
+
+template <typename T>
+size_t BoundedChannel<T>::GetSize() const {
+    return values.size();
+}
+
+template <typename T>
+size_t BoundedChannel<T>::GetCapacity() const {
+    return capacity;
+}
+
+template <typename T>
+bool BoundedChannel<T>::IsClosed() const {
+    return closed;
+}
+
+/**
+ * Push every message of a generator into a channel, then close it.
+ * The feed advances its logical clock by _interval per message and yields to the scheduler every
+ * _quantum messages, which is where feeds on a TIMESTAMP scheduler interleave with each other.
+ */
+template <typename V>
+Task Feed(Scheduler& _scheduler, Generator<V> _source, BoundedChannel<V>& _channel, uint64_t _interval = 1,
+          size_t _quantum = 1) {
+    uint64_t time = 0;
+    size_t sinceYield = 0;
+    for (auto& message : _source) {
+        co_await _channel.Push(message);
+        time += _interval;
+        if (++sinceYield >= _quantum) {
+            sinceYield = 0;
+            co_await _scheduler.Yield(time);
+        }
+    }
+    _channel.Close();
+}
+
+#endif
@@ -0,0 +1,528 @@
+/**
+ * executionanalytics.hpp
+ * Defines ExecutionAnalytics, live measures of execution quality per product and per algo.
+ *
+ * Register GetExecutionListener on the execution service, GetFillListener wherever the fills of the orders
+ * the execution service sends are published (the order router, or the exchange without one) and
+ * GetMarketDataListener on the market data service. All measures are in ticks, signed so that a positive
+ * value is a cost and a negative one a gain, and relative to the consolidated mid:
+ *   slippage     fill price against the mid when the order was sent, per unit filled
+ *   shortfall    slippage of the filled part plus the move of the mid over the unfilled part up to the
+ *                order's end, per unit of the orders ended
+ *   fill ratio   quantity filled over quantity sent
+ *   markout      move of the mid from the fill price to the fill's time plus each horizon, per unit filled,
+ *                positive when the mid moved in the fill's favour
+ *
+ * Orders are grouped by the algo they are tagged with rather than by order type, since one algo sends orders
+ * of several types and several algos send orders of the same type. An amendment ends the order as it stood,
+ * adding its shortfall, and measures what it leaves open as sent again, against the mid at the amendment.
+ *
+ * Every measure is kept as running sums. A markout waits in a queue per product and horizon; fills arrive
+ * in time order, so each queue is ordered by due time and a book update of the product settles the markouts
+ * at its head that have come due, against the mid that stood until then. The cost per fill is one lookup and
+ * one append per horizon, whatever the number of orders and fills outstanding.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef EXECUTION_ANALYTICS_HPP
+#define EXECUTION_ANALYTICS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "algoexecutionservice.hpp"
+#include "coroutine.hpp"
+#include "marketdataservice.hpp"
+#include "orderstore.hpp"
+#include "simulatedexchange.hpp"
+#include "soa.hpp"
+
+using namespace std;
+
+// Largest number of markout horizons an ExecutionAnalytics measures
+constexpr size_t MAX_MARKOUT_HORIZONS = 4;
+
+/**
+ * Running sums of execution quality for one group of orders.
+ */
+struct ExecutionStats {
+    uint64_t orders = 0;                                     // Orders sent
+    long sentQuantity = 0;                                   // Quantity sent
+    long filledQuantity = 0;                                 // Quantity filled
+    double slippageCost = 0;                                 // Slippage x quantity, over fills
+    long endedQuantity = 0;                                  // Quantity of the orders ended
+    double shortfallCost = 0;                                // Shortfall x quantity, over orders ended
+    array<double, MAX_MARKOUT_HORIZONS> markoutGain{};       // Markout x quantity, per horizon
+    array<long, MAX_MARKOUT_HORIZONS> markoutQuantity{};     // Quantity marked out, per horizon
+
+    // Add the sums of another group
+    ExecutionStats& operator+=(const ExecutionStats& _other);
+
+    // Slippage per unit filled, in ticks
+    double GetSlippage() const;
+
+    // Implementation shortfall per unit of the orders ended, in ticks
+    double GetShortfall() const;
+
+    // Quantity filled over quantity sent
+    double GetFillRatio() const;
+
+    // Markout per unit filled at a horizon, in ticks
+    double GetMarkout(size_t _horizon) const;
+};
+
+ExecutionStats& ExecutionStats::operator+=(const ExecutionStats& _other) {
+    orders += _other.orders;
+    sentQuantity += _other.sentQuantity;
+    filledQuantity += _other.filledQuantity;
+    slippageCost += _other.slippageCost;
+    endedQuantity += _other.endedQuantity;
+    shortfallCost += _other.shortfallCost;
+    for (size_t h = 0; h < MAX_MARKOUT_HORIZONS; ++h) {
+        markoutGain[h] += _other.markoutGain[h];
+        markoutQuantity[h] += _other.markoutQuantity[h];
+    }
+    return *this;
+}
+
+double ExecutionStats::GetSlippage() const {
+    return filledQuantity == 0 ? 0 : slippageCost / filledQuantity;
+}
+
+double ExecutionStats::GetShortfall() const {
+    return endedQuantity == 0 ? 0 : shortfallCost / endedQuantity;
+}
+
+double ExecutionStats::GetFillRatio() const {
+    return sentQuantity == 0 ? 0 : static_cast<double>(filledQuantity) / sentQuantity;
+}
+
+double ExecutionStats::GetMarkout(size_t _horizon) const {
+    return markoutQuantity.at(_horizon) == 0 ? 0 : markoutGain[_horizon] / markoutQuantity[_horizon];
+}
+
+template <typename T>
+class ListenerAnalyticsToExecution;
+
+template <typename T>
+class ListenerAnalyticsToFills;
+
+template <typename T>
+class ListenerAnalyticsToMarketData;
+
+/**
+ * Execution quality of the orders of the execution service, per product and algo.
+ * T: The product type.
+ */
+template <typename T>
+class ExecutionAnalytics {
+   public:
+    // Constructor taking the service holding the consolidated books and the markout horizons in nanoseconds
+    explicit ExecutionAnalytics(BondMarketDataService<T>& _marketData, const vector<uint64_t>& _horizons);
+    virtual ~ExecutionAnalytics();
+
+    ExecutionAnalytics(const ExecutionAnalytics&) = delete;
+    ExecutionAnalytics& operator=(const ExecutionAnalytics&) = delete;
+
+    // Use the logical time of a scheduler for the markout horizons instead of the steady clock
+    void SetClock(const Scheduler* _clock);
+
+    // Retrieve the listener to register on the execution service
+    ListenerAnalyticsToExecution<T>* GetExecutionListener();
+
+    // Retrieve the listener to register where the fills of the execution service's orders are published
+    ListenerAnalyticsToFills<T>* GetFillListener();
+
+    // Retrieve the listener to register on the market data service
+    ListenerAnalyticsToMarketData<T>* GetMarketDataListener();
+
+    // Start measuring an order sent, against the current mid of its product
+    void OnOrder(const ExecutionOrder<T>& _order);
+
+    // End an order as it stood before an amendment and measure what it leaves open against the current mid
+    void OnAmend(const ExecutionOrder<T>& _order);
+
+    // Account for a fill of an order and queue its markouts
+    void OnFill(const Fill<T>& _fill);
+
+    // Account for the end of an order cancelled or rejected with quantity unfilled
+    void OnStatus(const ExecutionOrder<T>& _order, OrderState _state);
+
+    // Settle the markouts of a product that have come due and take its new mid
+    void OnBook(const string& _productId);
+
+    // Markout horizons in nanoseconds
+    const vector<uint64_t>& GetHorizons() const;
+
+    // Sums of a product's orders sent by one algo; throws if the product has never been seen
+    const ExecutionStats& GetStats(const string& _productId, ExecutionAlgo _algo) const;
+
+    // Sums of all orders sent by one algo
+    ExecutionStats GetStats(ExecutionAlgo _algo) const;
+
+    // Number of markouts waiting for their horizon
+    size_t GetPendingMarkouts() const;
+
+   private:
+    /**
+     * A markout waiting for its horizon.
+     */
+    struct Markout {
+        ExecutionStats* stats;
+        uint64_t due;       // Time the markout is taken
+        double price;       // Fill price in ticks
+        long quantity;      // Quantity filled
+        int direction;      // 1 for a buy, -1 for a sell
+    };
+
+    /**
+     * Sums, mid and queued markouts of one product.
+     */
+    struct ProductState {
+        array<ExecutionStats, EXECUTION_ALGO_COUNT> stats;        // Sums per algo
+        double mid = 0;                                           // Current consolidated mid in ticks
+        bool hasMid = false;                                      // Whether both sides have been quoted
+        array<deque<Markout>, MAX_MARKOUT_HORIZONS> markouts;     // Queued markouts per horizon, by due time
+    };
+
+    /**
+     * An order being measured.
+     */
+    struct OpenOrder {
+        ProductState* product;
+        ExecutionStats* stats;
+        double arrivalMid;   // Mid when the order was sent, in ticks
+        long quantity;       // Quantity sent
+        long leaves;         // Quantity not yet filled
+        double cost;         // Slippage x quantity of its fills so far
+        int direction;       // 1 for a buy, -1 for a sell
+    };
+
+    // Current time
+    uint64_t Now() const;
+
+    // Add the shortfall of an order as it stands to its sums
+    void AddShortfall(const OpenOrder& _order);
+
+    // End an order, adding its shortfall
+    void End(typename unordered_map<string, OpenOrder>::iterator _order);
+
+    BondMarketDataService<T>& marketData;             // Source of the consolidated books
+    vector<uint64_t> horizons;                        // Markout horizons
+    const Scheduler* clock = nullptr;                 // Source of logical time, if any
+    unordered_map<string, ProductState> products;     // State of each product
+    unordered_map<string, OpenOrder> orders;          // Orders not yet ended
+    size_t pendingMarkouts = 0;                       // Markouts queued
+    ListenerAnalyticsToExecution<T>* executionListener;
+    ListenerAnalyticsToFills<T>* fillListener;
+    ListenerAnalyticsToMarketData<T>* marketDataListener;
+};
+
+template <typename T>
+ExecutionAnalytics<T>::ExecutionAnalytics(BondMarketDataService<T>& _marketData, const vector<uint64_t>& _horizons)
+    : marketData(_marketData),
+      horizons(_horizons),
+      executionListener(new ListenerAnalyticsToExecution<T>(this)),
+      fillListener(new ListenerAnalyticsToFills<T>(this)),
+      marketDataListener(new ListenerAnalyticsToMarketData<T>(this)) {
+    if (_horizons.size() > MAX_MARKOUT_HORIZONS) {
+        throw std::invalid_argument("At most " + to_string(MAX_MARKOUT_HORIZONS) + " markout horizons");
+    }
+}
+
+template <typename T>
+ExecutionAnalytics<T>::~ExecutionAnalytics() {
+    delete executionListener;
+    delete fillListener;
+    delete marketDataListener;
+}
+
+template <typename T>
+void ExecutionAnalytics<T>::SetClock(const Scheduler* _clock) {
+    clock = _clock;
+}
+
+template <typename T>
+ListenerAnalyticsToExecution<T>* ExecutionAnalytics<T>::GetExecutionListener() {
+    return executionListener;
+}
+
+template <typename T>
+ListenerAnalyticsToFills<T>* ExecutionAnalytics<T>::GetFillListener() {
+    return fillListener;
+}
+
+template <typename T>
+ListenerAnalyticsToMarketData<T>* ExecutionAnalytics<T>::GetMarketDataListener() {
+    return marketDataListener;
+}
+
+template <typename T>
+uint64_t ExecutionAnalytics<T>::Now() const {
+    if (clock) return clock->GetTime();
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+void ExecutionAnalytics<T>::OnOrder(const ExecutionOrder<T>& _order) {
+    ProductState& product = products[_order.GetProduct().GetProductId()];
+    ExecutionStats& stats = product.stats[_order.GetAlgo()];
+    long quantity = _order.GetVisibleQuantity() + _order.GetHiddenQuantity();
+    ++stats.orders;
+    stats.sentQuantity += quantity;
+
+    // Without a quoted mid the order is measured against its own price
+    double arrival = product.hasMid ? product.mid : static_cast<double>(_order.GetPrice().Count());
+    int direction = _order.GetPriceSide() == OFFER ? 1 : -1;
+    orders.try_emplace(_order.GetOrderId(), OpenOrder{&product, &stats, arrival, quantity, quantity, 0, direction});
+}
+
+template <typename T>
+void ExecutionAnalytics<T>::OnAmend(const ExecutionOrder<T>& _order) {
+    auto it = orders.find(_order.GetOrderId());
+    if (it == orders.end()) return;
+    OpenOrder& order = it->second;
+    AddShortfall(order);
+
+    // The new quantity caps what is left open, as it does at the venue, and that part is measured again
+    order.leaves = min(order.leaves, _order.GetVisibleQuantity() + _order.GetHiddenQuantity());
+    order.quantity = order.leaves;
+    order.arrivalMid = order.product->hasMid ? order.product->mid : static_cast<double>(_order.GetPrice().Count());
+    order.cost = 0;
+}
+
+template <typename T>
+void ExecutionAnalytics<T>::OnFill(const Fill<T>& _fill) {
+    auto it = orders.find(_fill.GetOrderId());
+    if (it == orders.end()) return;
+    OpenOrder& order = it->second;
+    double price = static_cast<double>(_fill.GetPrice().Count());
+    double cost = order.direction * (price - order.arrivalMid) * _fill.GetQuantity();
+    order.stats->filledQuantity += _fill.GetQuantity();
+    order.stats->slippageCost += cost;
+    order.cost += cost;
+    order.leaves -= _fill.GetQuantity();
+
+    uint64_t now = Now();
+    for (size_t h = 0; h < horizons.size(); ++h) {
+        order.product->markouts[h].push_back({order.stats, now + horizons[h], price, _fill.GetQuantity(), order.direction});
+    }
+    pendingMarkouts += horizons.size();
+    if (order.leaves <= 0) End(it);
+}
+
+template <typename T>
+void ExecutionAnalytics<T>::OnStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    if (_state != ORDER_CANCELLED && _state != ORDER_REJECTED) return;
+    auto it = orders.find(_order.GetOrderId());
+    if (it != orders.end()) End(it);
+}
+
+template <typename T>
+void ExecutionAnalytics<T>::AddShortfall(const OpenOrder& _order) {
+    // The unfilled part is charged the move of the mid since the order was sent
+    double mid = _order.product->hasMid ? _order.product->mid : _order.arrivalMid;
+    _order.stats->shortfallCost += _order.cost + _order.direction * (mid - _order.arrivalMid) * _order.leaves;
+    _order.stats->endedQuantity += _order.quantity;
+}
+
+template <typename T>
+void ExecutionAnalytics<T>::End(typename unordered_map<string, OpenOrder>::iterator _order) {
+    AddShortfall(_order->second);
+    orders.erase(_order);
+}
+
+template <typename T>
+void ExecutionAnalytics<T>::OnBook(const string& _productId) {
+    ProductState& product = products[_productId];
+
+    // Markouts due by now are taken against the mid that stood until this update
+    if (product.hasMid) {
+        uint64_t now = Now();
+        for (size_t h = 0; h < horizons.size(); ++h) {
+            auto& queue = product.markouts[h];
+            while (!queue.empty() && queue.front().due <= now) {
+                const Markout& markout = queue.front();
+                markout.stats->markoutGain[h] += markout.direction * (product.mid - markout.price) * markout.quantity;
+                markout.stats->markoutQuantity[h] += markout.quantity;
+                queue.pop_front();
+                --pendingMarkouts;
+            }
+        }
+    }
+
+    const ConsolidatedBook<T>& book = marketData.GetConsolidatedBook(_productId);
+    if (book.GetBidLevels().empty() || book.GetOfferLevels().empty()) return;
+    product.mid = (static_cast<double>(book.GetBidLevels().front().price.Count()) +
+                   static_cast<double>(book.GetOfferLevels().front().price.Count())) / 2;
+    product.hasMid = true;
+}
+
+template <typename T>
+const vector<uint64_t>& ExecutionAnalytics<T>::GetHorizons() const {
+    return horizons;
+}
+
+template <typename T>
+const ExecutionStats& ExecutionAnalytics<T>::GetStats(const string& _productId, ExecutionAlgo _algo) const {
+    auto it = products.find(_productId);
+    if (it == products.end()) throw std::out_of_range("No executions for product: " + _productId);
+    return it->second.stats[_algo];
+}
+
+template <typename T>
+ExecutionStats ExecutionAnalytics<T>::GetStats(ExecutionAlgo _algo) const {
+    ExecutionStats total;
+    for (const auto& [productId, product] : products) total += product.stats[_algo];
+    return total;
+}
+
+template <typename T>
+size_t ExecutionAnalytics<T>::GetPendingMarkouts() const {
+    return pendingMarkouts;
+}
+
+/**
+ * Listener starting the measurement of each order the execution service sends.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerAnalyticsToExecution : public ServiceListener<ExecutionOrder<T>> {
+   public:
+    // Constructor taking the analytics
+    explicit ListenerAnalyticsToExecution(ExecutionAnalytics<T>* _analytics);
+    virtual ~ListenerAnalyticsToExecution() = default;
+
+    // Listener callback for an order sent by the execution service
+    void ProcessAdd(ExecutionOrder<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(ExecutionOrder<T>& _data);
+
+    // Listener callback for an amendment of an order sent by the execution service
+    void ProcessUpdate(ExecutionOrder<T>& _data);
+
+   private:
+    ExecutionAnalytics<T>* analytics;  // Analytics to update
+};
+
+template <typename T>
+ListenerAnalyticsToExecution<T>::ListenerAnalyticsToExecution(ExecutionAnalytics<T>* _analytics)
+    : analytics(_analytics) {}
+
+template <typename T>
+void ListenerAnalyticsToExecution<T>::ProcessAdd(ExecutionOrder<T>& _data) {
+    analytics->OnOrder(_data);
+}
+
+template <typename T>
+void ListenerAnalyticsToExecution<T>::ProcessRemove(ExecutionOrder<T>& _data) {}
+
+template <typename T>
+void ListenerAnalyticsToExecution<T>::ProcessUpdate(ExecutionOrder<T>& _data) {
+    analytics->OnAmend(_data);
+}
+
+/**
+ * Listener accounting for the fills and ends of the orders measured.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerAnalyticsToFills : public OrderStatusListener<T> {
+   public:
+    // Constructor taking the analytics
+    explicit ListenerAnalyticsToFills(ExecutionAnalytics<T>* _analytics);
+    virtual ~ListenerAnalyticsToFills() = default;
+
+    // Listener callback for a fill
+    void ProcessAdd(Fill<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(Fill<T>& _data);
+
+    // No implementation needed for update event
+    void ProcessUpdate(Fill<T>& _data);
+
+    // Listener callback for an acknowledgement, cancellation or rejection of an order
+    void ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state);
+
+   private:
+    ExecutionAnalytics<T>* analytics;  // Analytics to update
+};
+
+template <typename T>
+ListenerAnalyticsToFills<T>::ListenerAnalyticsToFills(ExecutionAnalytics<T>* _analytics) : analytics(_analytics) {}
+
+template <typename T>
+void ListenerAnalyticsToFills<T>::ProcessAdd(Fill<T>& _data) {
+    analytics->OnFill(_data);
+}
+
+template <typename T>
+void ListenerAnalyticsToFills<T>::ProcessRemove(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerAnalyticsToFills<T>::ProcessUpdate(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerAnalyticsToFills<T>::ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    analytics->OnStatus(_order, _state);
+}
+
+/**
+ * Listener on the market data service settling markouts and following the mid of each product.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerAnalyticsToMarketData : public BookDeltaListener<T> {
+   public:
+    // Constructor taking the analytics
+    explicit ListenerAnalyticsToMarketData(ExecutionAnalytics<T>* _analytics);
+    virtual ~ListenerAnalyticsToMarketData() = default;
+
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+   private:
+    ExecutionAnalytics<T>* analytics;  // Analytics to update
+};
+
+template <typename T>
+ListenerAnalyticsToMarketData<T>::ListenerAnalyticsToMarketData(ExecutionAnalytics<T>* _analytics)
+    : analytics(_analytics) {}
+
+template <typename T>
+void ListenerAnalyticsToMarketData<T>::ProcessAdd(OrderBook<T>& _data) {
+    analytics->OnBook(_data.GetProduct().GetProductId());
+}
+
+template <typename T>
+void ListenerAnalyticsToMarketData<T>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T>
+void ListenerAnalyticsToMarketData<T>::ProcessUpdate(OrderBook<T>& _data) {
+    analytics->OnBook(_data.GetProduct().GetProductId());
+}
+
+template <typename T>
+void ListenerAnalyticsToMarketData<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    analytics->OnBook(_book.GetProduct().GetProductId());
+}
+
+#endif
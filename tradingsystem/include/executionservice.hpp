@@ -12,6 +12,8 @@
 #include <string>
 #include "algoexecutionservice.hpp"
 #include "marketdataservice.hpp"
+#include "orderstore.hpp"
+#include "simulatedexchange.hpp"
 #include "soa.hpp"
 #include "utils.hpp"
 
@@ -19,6 +21,9 @@
 template <typename T>
 class ListenerExeToAlgoExe;
 
+template <typename T>
+class ListenerExeToExchange;
+
 
 template <typename T>
 class ExecutionService : public Service<string, ExecutionOrder<T>> {
@@ -42,13 +47,24 @@ class ExecutionService : public Service<string, ExecutionOrder<T>> {
     // Get the listener of the service
     ListenerExeToAlgoExe<T>* GetListener();
 
+    // Get the listener following orders through the fills and states reported by the exchange
+    ListenerExeToExchange<T>* GetExchangeListener();
+
+    // Get the lifecycle state of the orders sent, keyed by order id
+    OrderStore<T>& GetOrderStore();
+
     // Execute an order on a market
     void ProcessExecution(ExecutionOrder<T>& _executionOrder);
 
+    // Amend an open order on its market; an order that has finished in the meantime is left as it is
+    void ProcessAmendment(ExecutionOrder<T>& _executionOrder);
+
    private:
     map<string, ExecutionOrder<T>> executionOrders;
     vector<ServiceListener<ExecutionOrder<T>>*> listeners;
     ListenerExeToAlgoExe<T>* listener;
+    ListenerExeToExchange<T>* exchangeListener;
+    OrderStore<T> orderStore;
 };
 
 template <typename T>
@@ -56,6 +72,7 @@ ExecutionService<T>::ExecutionService() {
     executionOrders = map<string, ExecutionOrder<T>>();
     listeners = vector<ServiceListener<ExecutionOrder<T>>*>();
     listener = new ListenerExeToAlgoExe<T>(this);
+    exchangeListener = new ListenerExeToExchange<T>(this);
 }
 
 template <typename T>
@@ -65,6 +82,7 @@ ExecutionOrder<T>& ExecutionService<T>::GetData(string key) {
 
 template <typename T>
 void ExecutionService<T>::OnMessage(ExecutionOrder<T>& data) {
+    auto timer = this->TrackMessage();
     executionOrders[data.GetProduct().GetProductId()] = data;
 }
 
@@ -83,14 +101,34 @@ ListenerExeToAlgoExe<T>* ExecutionService<T>::GetListener() {
     return listener;
 }
 
+template <typename T>
+ListenerExeToExchange<T>* ExecutionService<T>::GetExchangeListener() {
+    return exchangeListener;
+}
+
+template <typename T>
+OrderStore<T>& ExecutionService<T>::GetOrderStore() {
+    return orderStore;
+}
+
 template <typename T>
 void ExecutionService<T>::ProcessExecution(ExecutionOrder<T>& _executionOrder) {
+    LatencyTracer::Instance().Record(TRACE_EXECUTION, _executionOrder.GetTrace());
     string _productId = _executionOrder.GetProduct().GetProductId();
     executionOrders[_productId] = _executionOrder;
+    orderStore.Add(_executionOrder);
 
-    for (auto& l : listeners) {
-        l->ProcessAdd(_executionOrder);
-    }
+    this->NotifyAdd(listeners, _executionOrder);
+}
+
+template <typename T>
+void ExecutionService<T>::ProcessAmendment(ExecutionOrder<T>& _executionOrder) {
+    const OrderRecord<T>* record = orderStore.Find(_executionOrder.GetOrderId());
+    if (!record || !IsOpen(record->state)) return;
+    executionOrders[_executionOrder.GetProduct().GetProductId()] = _executionOrder;
+    orderStore.Amend(_executionOrder);
+
+    this->NotifyUpdate(listeners, _executionOrder);
 }
 
 
@@ -130,6 +168,66 @@ template <typename T>
 void ListenerExeToAlgoExe<T>::ProcessRemove(AlgoExecution<T>& _data) {}
 
 template <typename T>
-void ListenerExeToAlgoExe<T>::ProcessUpdate(AlgoExecution<T>& _data) {}
+void ListenerExeToAlgoExe<T>::ProcessUpdate(AlgoExecution<T>& _data) {
+    service->ProcessAmendment(*_data.RetrieveExecutionOrder());
+}
+
+
+template <typename T>
+class ListenerExeToExchange : public OrderStatusListener<T> {
+   public:
+    // Connector and Destructor
+    ListenerExeToExchange(ExecutionService<T>* newService);
+    virtual ~ListenerExeToExchange() = default;
+
+    // Listener callback to process a fill of an order
+    void ProcessAdd(Fill<T>& data);
+
+    // Listener callback to process a remove event to the Service
+    void ProcessRemove(Fill<T>& data);
+
+    // Listener callback to process an update event to the Service
+    void ProcessUpdate(Fill<T>& data);
+
+    // Listener callback to process an acknowledgement, cancellation or rejection of an order
+    void ProcessStatus(const ExecutionOrder<T>& order, OrderState state);
+
+   private:
+    ExecutionService<T>* service;
+};
+
+template <typename T>
+ListenerExeToExchange<T>::ListenerExeToExchange(ExecutionService<T>* newService) : service(newService)
+{
+}
+
+template <typename T>
+void ListenerExeToExchange<T>::ProcessAdd(Fill<T>& _data) {
+    service->GetOrderStore().ApplyFill(_data.GetOrderId(), _data.GetQuantity());
+}
+
+template <typename T>
+void ListenerExeToExchange<T>::ProcessRemove(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerExeToExchange<T>::ProcessUpdate(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerExeToExchange<T>::ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    OrderStore<T>& orderStore = service->GetOrderStore();
+    switch (_state) {
+        case ORDER_ACKNOWLEDGED:
+            orderStore.Acknowledge(_order.GetOrderId());
+            break;
+        case ORDER_CANCELLED:
+            orderStore.Cancel(_order.GetOrderId());
+            break;
+        case ORDER_REJECTED:
+            orderStore.Reject(_order.GetOrderId());
+            break;
+        default:
+            throw std::invalid_argument("Fills are reported through ProcessAdd");
+    }
+}
 
 #endif
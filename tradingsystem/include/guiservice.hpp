@@ -91,6 +91,7 @@ Price<T>& GUIService<T>::GetData(string _key)
 template<typename T>
 void GUIService<T>::OnMessage(Price<T>& _data)
 {
+	auto timer = this->TrackMessage();
 	guis[_data.GetProduct().GetProductId()] = _data;
 	connector->Publish(_data);
 }
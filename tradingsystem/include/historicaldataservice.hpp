@@ -2,14 +2,22 @@
 * historicaldataservice.hpp
 * Defines types and services for managing historical data.
 *
+* Records are written through RecordWriter into a buffer the connector reuses, to a file it keeps
+* open, so persisting a record allocates nothing once the buffer has grown to the largest batch.
+*
 * @author Breman Thuraisingham, Fangtong Wang
 */
 
 #ifndef HISTORICAL_DATA_SERVICE_HPP
 #define HISTORICAL_DATA_SERVICE_HPP
 
+#include "recordwriter.hpp"
 #include "soa.hpp"
+#include "utils.hpp"
+#include <fstream>
 #include <map>
+#include <string_view>
+#include <type_traits>
 
 enum ServiceType { POSITION, RISK, EXECUTION, STREAMING, INQUIRY };
 
@@ -39,6 +47,7 @@ public:
     ServiceListener<T>* GetListener();  // Access the listener
     ServiceType GetServiceType() const;  // Get the service type
     void PersistData(string persistKey, T& data);  // Save data
+    void PersistDataBatch(span<T> data);  // Save a batch of data with one write
 
 private:
     std::map<string, T> historicalDatas;  // Data storage
@@ -76,6 +85,7 @@ T& HistoricalDataService<T>::GetData(string _key)
 template<typename T>
 void HistoricalDataService<T>::OnMessage(T& _data)
 {
+    auto timer = this->TrackMessage();
     historicalDatas[_data.GetProduct().GetProductId()] = _data;
 }
 
@@ -107,6 +117,13 @@ void HistoricalDataService<T>::PersistData(string persistKey, T& data)
     connector->Publish(data);
 }
 
+// Persist a batch of data using the connector
+template<typename T>
+void HistoricalDataService<T>::PersistDataBatch(span<T> data)
+{
+    connector->PublishBatch(data);
+}
+
 // Retrieve all registered listeners
 template<typename T>
 const vector<ServiceListener<T>*>& HistoricalDataService<T>::GetListeners() const
@@ -132,19 +149,27 @@ public:
     HistoricalDataConnector(HistoricalDataService<T>* _service);  // Constructor
     virtual ~HistoricalDataConnector() = default;  // Default destructor
     void Publish(T& _data);  // Save data
+    void PublishBatch(span<T> _data);  // Save a batch of data with one file open and one write
     void Subscribe(ifstream& _data);  // Placeholder for subscription
 private:
+    const char* GetFileName() const;  // Output file for the service type, or nullptr
+    bool Open();  // Open the output file for appending on first use; false if there is none
+    void Write(string_view _timestamp, const T& _data);  // Format a record into the buffer
+    void Flush();  // Write the buffer to the file and clear it
+    void RecordPersisted(T& _data) const;  // Close the trace of a persisted message
     HistoricalDataService<T>* service;  // Parent service
+    std::ofstream outputFile;  // Output file, once opened
+    string buffer;  // Records formatted and not yet written
 };
 
 // Constructor to initialize the connector with the parent service
 template<typename T>
 HistoricalDataConnector<T>::HistoricalDataConnector(HistoricalDataService<T>* newService) : service(newService) {}
 
-// Save data to a file based on service type
+// Output file for the service type
 template<typename T>
-void HistoricalDataConnector<T>::Publish(T& data) {
-    std::unordered_map<ServiceType, std::string> fileMap = {
+const char* HistoricalDataConnector<T>::GetFileName() const {
+    static const std::unordered_map<ServiceType, const char*> fileMap = {
         {POSITION, "positions.txt"},
         {RISK, "risk.txt"},
         {EXECUTION, "executions.txt"},
@@ -152,23 +177,83 @@ void HistoricalDataConnector<T>::Publish(T& data) {
         {INQUIRY, "allinquiries.txt"}
     };
 
-    ServiceType serviceType = service->GetServiceType();
-    auto it = fileMap.find(serviceType);
+    auto it = fileMap.find(service->GetServiceType());
+    return it == fileMap.end() ? nullptr : it->second;
+}
+
+// Traced messages end their chain once written out
+template<typename T>
+void HistoricalDataConnector<T>::RecordPersisted(T& data) const {
+    if constexpr (is_base_of_v<Traced, T>) {
+        ServiceType serviceType = service->GetServiceType();
+        if (serviceType == EXECUTION) LatencyTracer::Instance().Record(TRACE_EXECUTION_PERSIST, data.GetTrace());
+        if (serviceType == STREAMING) LatencyTracer::Instance().Record(TRACE_STREAMING_PERSIST, data.GetTrace());
+    }
+}
+
+// Open the output file once and keep it open
+template<typename T>
+bool HistoricalDataConnector<T>::Open() {
+    if (outputFile.is_open()) {
+        return true;
+    }
+    const char* fileName = GetFileName();
+    if (!fileName) {
+        return false; // Skip invalid service type
+    }
+    outputFile.open(fileName, std::ios::app);
+    return outputFile.is_open();
+}
+
+// Format one record: the timestamp, then the fields of the data
+template<typename T>
+void HistoricalDataConnector<T>::Write(string_view _timestamp, const T& data) {
+    RecordWriter writer(buffer);
+    writer.Field(_timestamp);
+    data.Write(writer);
+    writer.End();
+}
+
+// Write out what has been formatted; the buffer keeps its capacity for the next records
+template<typename T>
+void HistoricalDataConnector<T>::Flush() {
+    outputFile.write(buffer.data(), buffer.size());
+    outputFile.flush();
+    buffer.clear();
+}
+
+// Save data to a file based on service type
+template<typename T>
+void HistoricalDataConnector<T>::Publish(T& data) {
+    if (!Open()) {
+        return; // Skip if there is no file or it cannot be opened
+    }
+
+    char timestamp[TIME_STRING_CHARS];
+    Write(string_view(timestamp, FormatCurrentTime(timestamp)), data);
+    Flush();
 
-    if (it == fileMap.end()) {
-        return; // Skip invalid service type
+    RecordPersisted(data);
+}
+
+// Save a batch of data: the timestamp is formatted once and all records are formatted
+// into one buffer written with a single call
+template<typename T>
+void HistoricalDataConnector<T>::PublishBatch(span<T> data) {
+    if (data.empty() || !Open()) {
+        return; // Skip an empty batch, or if there is no file or it cannot be opened
     }
 
-    std::ofstream outputFile(it->second, std::ios::app);
-    if (!outputFile.is_open()) {
-        return; // Skip if file cannot be opened
+    char timestamp[TIME_STRING_CHARS];
+    string_view time(timestamp, FormatCurrentTime(timestamp));
+    for (const auto& record : data) {
+        Write(time, record);
     }
+    Flush();
 
-    outputFile << CurrentTimeString() << ",";
-    for (const auto& element : data.ToStrings()) {
-        outputFile << element << ",";
+    for (auto& record : data) {
+        RecordPersisted(record);
     }
-    outputFile << "\n";
 }
 
 // Placeholder for subscription implementation
@@ -186,6 +271,7 @@ public:
     HistoricalDataListener(HistoricalDataService<T>* _service);  // Constructor
     virtual ~HistoricalDataListener() = default;  // Default destructor
     void ProcessAdd(T& _data);  // Handle add events
+    void ProcessAddBatch(span<T> _data) override;  // Handle a batch of add events
     void ProcessRemove(T& _data);  // Handle remove events
     void ProcessUpdate(T& _data);  // Handle update events
 private:
@@ -204,6 +290,13 @@ void HistoricalDataListener<T>::ProcessAdd(T& _data)
     service->PersistData(_persistKey, _data);
 }
 
+// Handle a batch of new data and persist it with one write
+template<typename T>
+void HistoricalDataListener<T>::ProcessAddBatch(span<T> _data)
+{
+    service->PersistDataBatch(_data);
+}
+
 // Placeholder for removing data
 template<typename T>
 void HistoricalDataListener<T>::ProcessRemove(T& _data) {}
@@ -8,12 +8,21 @@
 #ifndef INQUIRY_SERVICE_HPP
 #define INQUIRY_SERVICE_HPP
 
+#include <string_view>
+
+#include "recordwriter.hpp"
 #include "soa.hpp"
 
 // Various inqyury states
 enum InquiryState { RECEIVED, QUOTED, DONE, REJECTED, CUSTOMER_REJECTED };
 enum Side { BUY, SELL };
 
+// Name of each inquiry state, indexed by InquiryState
+constexpr string_view INQUIRY_STATE_NAMES[] = {"RECEIVED", "QUOTED", "DONE", "REJECTED", "CUSTOMER_REJECTED"};
+
+// Name of each side, indexed by Side
+constexpr string_view SIDE_NAMES[] = {"BUY", "SELL"};
+
 using namespace std;
 
 /**
@@ -27,7 +36,7 @@ class Inquiry {
     Inquiry() = default;
 
     // Constructor that initializes all fields
-    Inquiry(const string &iqId, const T &theProduct, Side inSide, long qty, double inPrice, InquiryState st);
+    Inquiry(const string &iqId, const T &theProduct, Side inSide, long qty, Ticks inPrice, InquiryState st);
 
     // Virtual destructor
     virtual ~Inquiry() = default;
@@ -45,10 +54,10 @@ class Inquiry {
     long GetQuantity() const;
 
     // Get the price that we have responded back with
-    double GetPrice() const;
+    Ticks GetPrice() const;
 
     // Set the price that we have responded back with
-    void SetPrice(double _price);
+    void SetPrice(Ticks _price);
 
     // Get the current state on the inquiry
     InquiryState GetState() const;
@@ -59,18 +68,21 @@ class Inquiry {
     // Convert inquiry info into a vector of strings
     vector<string> ToStrings() const;
 
+    // Write inquiry info as the fields of a persisted record
+    void Write(RecordWriter& _writer) const;
+
    private:
     string inquiryId;
     T product;
     Side side;
     long quantity;
-    double price;
+    Ticks price;
     InquiryState state;
 };
 
 // Implementation of Inquiry constructor
 template <typename T>
-Inquiry<T>::Inquiry(const string &iqId, const T &theProduct, Side inSide, long qty, double inPrice, InquiryState st)
+Inquiry<T>::Inquiry(const string &iqId, const T &theProduct, Side inSide, long qty, Ticks inPrice, InquiryState st)
     : inquiryId(iqId), product(theProduct), side(inSide), quantity(qty), price(inPrice), state(st) {}
 
 // Getter implementations
@@ -95,7 +107,7 @@ long Inquiry<T>::GetQuantity() const {
 }
 
 template <typename T>
-double Inquiry<T>::GetPrice() const {
+Ticks Inquiry<T>::GetPrice() const {
     return price;
 }
 
@@ -106,7 +118,7 @@ InquiryState Inquiry<T>::GetState() const {
 
 // Setter implementations
 template <typename T>
-void Inquiry<T>::SetPrice(double newPrice) {
+void Inquiry<T>::SetPrice(Ticks newPrice) {
     price = newPrice;
 }
 
@@ -117,57 +129,18 @@ void Inquiry<T>::SetState(InquiryState newState) {
 
 template <typename T>
 vector<string> Inquiry<T>::ToStrings() const {
-    // inquiryId
-    string strId = inquiryId;
-
-    // productId
-    string prodId = product.GetProductId();
-
-    // side
-    string strSide;
-    switch (side) {
-        case BUY:
-            strSide = "BUY";
-            break;
-        case SELL:
-            strSide = "SELL";
-            break;
-    }
-
-    // quantity
-    string strQty = to_string(quantity);
-
-    // price
-    string strPrice = FormatPrice(price);
-
-    // state
-    string strState;
-    switch (state) {
-        case RECEIVED:
-            strState = "RECEIVED";
-            break;
-        case QUOTED:
-            strState = "QUOTED";
-            break;
-        case DONE:
-            strState = "DONE";
-            break;
-        case REJECTED:
-            strState = "REJECTED";
-            break;
-        case CUSTOMER_REJECTED:
-            strState = "CUSTOMER_REJECTED";
-            break;
-    }
+    return {inquiryId, product.GetProductId(), string(SIDE_NAMES[side]), to_string(quantity), price.ToString(),
+            string(INQUIRY_STATE_NAMES[state])};
+}
 
-    vector<string> fields;
-    fields.push_back(strId);
-    fields.push_back(prodId);
-    fields.push_back(strSide);
-    fields.push_back(strQty);
-    fields.push_back(strPrice);
-    fields.push_back(strState);
-    return fields;
+template <typename T>
+void Inquiry<T>::Write(RecordWriter& _writer) const {
+    _writer.Field(inquiryId)
+        .Field(product.GetProductId())
+        .Field(SIDE_NAMES[side])
+        .Field(quantity)
+        .Field(price)
+        .Field(INQUIRY_STATE_NAMES[state]);
 }
 
 /**
@@ -184,7 +157,7 @@ class InquiryService : public Service<string, Inquiry<T>> {
     virtual ~InquiryService() = default;
 
     // Send a quote back to the client
-    virtual void SendQuote(const string &inquiryId, double price) = 0;
+    virtual void SendQuote(const string &inquiryId, Ticks price) = 0;
 
     // Reject an inquiry from the client
     virtual void RejectInquiry(const string &inquiryId) = 0;
@@ -223,7 +196,7 @@ class BondInquiryService : public InquiryService<T> {
     InquiryConnector<T> *GetConnector();
 
     // Send a quote back to the client
-    void SendQuote(const string &inquiryId, double price) override;
+    void SendQuote(const string &inquiryId, Ticks price) override;
 
     // Reject an inquiry
     void RejectInquiry(const string &inquiryId) override;
@@ -252,11 +225,12 @@ Inquiry<T> &BondInquiryService<T>::GetData(string key) {
 
 template <typename T>
 void BondInquiryService<T>::OnMessage(Inquiry<T> &msg) {
+    auto timer = this->TrackMessage();
     InquiryState curState = msg.GetState();
     switch (curState) {
         case RECEIVED: {
             // Example: set a default price to 100 if state is RECEIVED
-            msg.SetPrice(100);
+            msg.SetPrice(Ticks::FromPoints(100));
             inquiryRecords[msg.GetInquiryId()] = msg;
             // Then publish
             connectorPtr->Publish(msg);
@@ -267,9 +241,7 @@ void BondInquiryService<T>::OnMessage(Inquiry<T> &msg) {
             msg.SetState(DONE);
             inquiryRecords[msg.GetInquiryId()] = msg;
             // Notify all listeners
-            for (auto &ls : listenerCollection) {
-                ls->ProcessAdd(msg);
-            }
+            this->NotifyAdd(listenerCollection, msg);
             break;
         }
         default:
@@ -294,12 +266,10 @@ InquiryConnector<T> *BondInquiryService<T>::GetConnector() {
 }
 
 template <typename T>
-void BondInquiryService<T>::SendQuote(const string &inquiryId, double price) {
+void BondInquiryService<T>::SendQuote(const string &inquiryId, Ticks price) {
     Inquiry<T> &inq = inquiryRecords[inquiryId];
     inq.SetPrice(price);
-    for (auto &ls : listenerCollection) {
-        ls->ProcessAdd(inq);
-    }
+    this->NotifyAdd(listenerCollection, inq);
 }
 
 template <typename T>
@@ -329,6 +299,9 @@ class InquiryConnector : public Connector<Inquiry<T>> {
     // An overload for direct Inquiry subscription
     void Subscribe(Inquiry<T> &msg);
 
+    // Parse the input one inquiry at a time
+    Generator<Inquiry<T>> Read(ifstream &inputFile);
+
    private:
     BondInquiryService<T> *servicePtr;
 };
@@ -349,6 +322,13 @@ void InquiryConnector<T>::Publish(Inquiry<T> &msg) {
 
 template <typename T>
 void InquiryConnector<T>::Subscribe(ifstream &inputFile) {
+    for (auto &inquiry : Read(inputFile)) {
+        servicePtr->OnMessage(inquiry);
+    }
+}
+
+template <typename T>
+Generator<Inquiry<T>> InquiryConnector<T>::Read(ifstream &inputFile) {
     string fileLine;
     while (getline(inputFile, fileLine)) {
         stringstream lineStream(fileLine);
@@ -386,8 +366,8 @@ void InquiryConnector<T>::Subscribe(ifstream &inputFile) {
         T theBond = BondInfo(prodId);
 
         // For new inquiries from file, let's assume price=0 (or any placeholder)
-        Inquiry<T> newInquiry(iqId, theBond, s, qty, 0.0, st);
-        servicePtr->OnMessage(newInquiry);
+        Inquiry<T> newInquiry(iqId, theBond, s, qty, Ticks(), st);
+        co_yield newInquiry;
     }
 }
 
@@ -8,13 +8,17 @@
 #ifndef MARKET_DATA_SERVICE_HPP
 #define MARKET_DATA_SERVICE_HPP
 
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <sstream>
 #include <fstream>
 #include <tuple>
 #include <limits>
+#include <algorithm>
+#include <span>
 #include "soa.hpp"
 
 using namespace std;
@@ -26,6 +30,46 @@ using namespace std;
  */
 enum PricingSide { BID, OFFER };
 
+// Name of each pricing side, indexed by PricingSide
+constexpr string_view PRICING_SIDE_NAMES[] = {"BID", "OFFER"};
+
+/**
+ * Enum for supported trading markets.
+ */
+enum Market { BROKERTEC, ESPEED, CME };
+
+// Number of values of Market
+constexpr size_t MARKET_COUNT = 3;
+
+// Name of a market as written in market data files
+string MarketName(Market _market);
+
+// Parse a market name; throws on an unknown name
+Market ParseMarket(string_view _name);
+
+string MarketName(Market _market) {
+    switch (_market) {
+        case BROKERTEC:
+            return "BROKERTEC";
+        case ESPEED:
+            return "ESPEED";
+        case CME:
+            return "CME";
+    }
+    throw std::invalid_argument("Unknown market");
+}
+
+Market ParseMarket(string_view _name) {
+    if (_name == "BROKERTEC") return BROKERTEC;
+    if (_name == "ESPEED") return ESPEED;
+    if (_name == "CME") return CME;
+    throw std::invalid_argument("Unknown market: " + string(_name));
+}
+
+// Orders per side of an order book unless another depth is chosen at compile time; the simulator
+// generates books of this depth
+constexpr size_t DEFAULT_BOOK_DEPTH = 5;
+
 /**
  * Represents a market data order with attributes for price, quantity, and side.
  */
@@ -35,10 +79,10 @@ class Order {
     Order() = default;
 
     // Constructor to initialize an order
-    Order(double _price, long _quantity, PricingSide _side);
+    Order(Ticks _price, long _quantity, PricingSide _side);
 
     // Retrieve the price of the order
-    double GetPrice() const;
+    Ticks GetPrice() const;
 
     // Retrieve the quantity of the order
     long GetQuantity() const;
@@ -47,18 +91,18 @@ class Order {
     PricingSide GetSide() const;
 
    private:
-    double price;        // Price of the order
+    Ticks price;         // Price of the order
     long quantity;       // Quantity of the order
     PricingSide side;    // Side of the order (BID or OFFER)
 };
 
-Order::Order(double _price, long _quantity, PricingSide _side) {
+Order::Order(Ticks _price, long _quantity, PricingSide _side) {
     price = _price;
     quantity = _quantity;
     side = _side;
 }
 
-double Order::GetPrice() const { return price; }
+Ticks Order::GetPrice() const { return price; }
 
 long Order::GetQuantity() const { return quantity; }
 
@@ -96,250 +140,846 @@ const Order& BidOffer::GetBidOrder() const { return bidOrder; }
 const Order& BidOffer::GetOfferOrder() const { return offerOrder; }
 
 /**
- * Represents an order book with a bid and offer stack for a specific product.
- * T: The type of the product associated with the order book.
+ * Represents an order book with a bid and offer stack for a specific product on one venue.
+ * Each stack holds at most Depth orders inline, so a book never allocates. Both are kept sorted
+ * best-first: bids by descending price and offers by ascending price, with orders at the same
+ * price kept in arrival order. The best bid and offer are therefore always the first element of
+ * each stack, and scans over a stack run over a compile-time number of slots that the compiler unrolls.
+ * T: The type of the product associated with the order book. Depth: Maximum orders per side.
  */
-template <typename T>
-class OrderBook {
+template <typename T, size_t Depth = DEFAULT_BOOK_DEPTH>
+class OrderBook : public Traced {
    public:
+    static_assert(Depth > 0, "An order book holds at least one order per side");
+
+    // Maximum number of orders held on each side; beyond it the worst order is dropped
+    static constexpr size_t MAX_LEVELS = Depth;
+
     // Default constructor
     OrderBook() = default;
 
-    // Constructor to initialize an order book with product and bid/offer stacks
-    OrderBook(const T& _product, const vector<Order>& _bidStack, const vector<Order>& _offerStack);
+    // Constructor to initialize an order book with product and bid/offer stacks in any order
+    OrderBook(const T& _product, span<const Order> _bidStack, span<const Order> _offerStack,
+              Market _venue = BROKERTEC);
 
     virtual ~OrderBook() = default;
 
     // Retrieve the product associated with the order book
     const T& GetProduct() const;
 
-    // Retrieve the bid stack
-    const vector<Order>& GetBidStack() const;
+    // Retrieve the venue the order book is quoted on
+    Market GetVenue() const;
+
+    // Retrieve the bid stack, best bid first
+    span<const Order> GetBidStack() const;
 
-    // Retrieve the offer stack
-    const vector<Order>& GetOfferStack() const;
+    // Retrieve the offer stack, best offer first
+    span<const Order> GetOfferStack() const;
 
     // Retrieve the best bid and offer orders
     BidOffer GetBestBidOffer() const;
 
+    // Retrieve the best bid, or an empty order when there are no bids
+    const Order& GetBestBid() const;
+
+    // Retrieve the best offer, or an empty order when there are no offers
+    const Order& GetBestOffer() const;
+
+    // Insert an order at its sorted position on its side
+    void AddOrder(const Order& _order);
+
+    // Set the quantity of the first order at a price, inserting it if absent and removing it if zero
+    void UpdateLevel(PricingSide _side, Ticks _price, long _quantity);
+
+    // Remove the first order at a price; returns false if there is none
+    bool RemoveLevel(PricingSide _side, Ticks _price);
+
+    // Total quantity of the orders at a price
+    long GetQuantityAt(PricingSide _side, Ticks _price) const;
+
+    // Identifies the book contents: changes whenever the book is built or modified, and is shared by copies
+    uint64_t GetVersion() const;
+
    private:
-    T product;               // The product associated with the order book
-    vector<Order> bidStack;  // Stack of bid orders
-    vector<Order> offerStack; // Stack of offer orders
+    /**
+     * One side of the book: the orders in the first count slots, best first.
+     */
+    struct Stack {
+        array<Order, Depth> orders;
+        size_t count = 0;
+    };
+
+    // Stack holding the given side
+    Stack& SideStack(PricingSide _side);
+    const Stack& SideStack(PricingSide _side) const;
+
+    // Number of orders strictly ahead of a price, which is the position of the first order at it
+    static size_t LowerBound(const Stack& _stack, PricingSide _side, Ticks _price);
+
+    // Number of orders at or ahead of a price, which is where a new order at it queues
+    static size_t UpperBound(const Stack& _stack, PricingSide _side, Ticks _price);
+
+    // Insert an order at a position, dropping the worst order when full; returns false if it did not fit
+    static bool Insert(Stack& _stack, size_t _index, const Order& _order);
+
+    // Remove the order at a position
+    static void Erase(Stack& _stack, size_t _index);
+
+    // Fill a stack with the best Depth orders of an input in any order
+    static void Fill(Stack& _stack, span<const Order> _orders, PricingSide _side);
+
+    // Whether a price ranks strictly ahead of another on the given side
+    static bool Better(PricingSide _side, Ticks _price, Ticks _other);
+
+    // Next value of the version counter shared by the books of this product type built on the calling thread
+    static uint64_t NextVersion();
+
+    T product;                 // The product associated with the order book
+    Stack bids;                // Bid orders
+    Stack offers;              // Offer orders
+    Market venue = BROKERTEC;  // The venue quoting the book
+    uint64_t version = 0;      // Version of the contents
+};
+
+template <typename T, size_t Depth>
+OrderBook<T, Depth>::OrderBook(const T& _product, span<const Order> _bidStack, span<const Order> _offerStack,
+                               Market _venue)
+    : product(_product), venue(_venue), version(NextVersion()) {
+    Fill(bids, _bidStack, BID);
+    Fill(offers, _offerStack, OFFER);
+}
+
+template <typename T, size_t Depth>
+uint64_t OrderBook<T, Depth>::NextVersion() {
+    // Versions are only compared on the thread that built the books, so each thread counts on its own
+    static thread_local uint64_t counter = 0;
+    return ++counter;
+}
+
+template <typename T, size_t Depth>
+uint64_t OrderBook<T, Depth>::GetVersion() const {
+    return version;
+}
+
+template <typename T, size_t Depth>
+const T& OrderBook<T, Depth>::GetProduct() const {
+    return product;
+}
+
+template <typename T, size_t Depth>
+Market OrderBook<T, Depth>::GetVenue() const {
+    return venue;
+}
+
+template <typename T, size_t Depth>
+span<const Order> OrderBook<T, Depth>::GetBidStack() const {
+    return span<const Order>(bids.orders.data(), bids.count);
+}
+
+template <typename T, size_t Depth>
+span<const Order> OrderBook<T, Depth>::GetOfferStack() const {
+    return span<const Order>(offers.orders.data(), offers.count);
+}
+
+template <typename T, size_t Depth>
+BidOffer OrderBook<T, Depth>::GetBestBidOffer() const {
+    return BidOffer(GetBestBid(), GetBestOffer());
+}
+
+template <typename T, size_t Depth>
+const Order& OrderBook<T, Depth>::GetBestBid() const {
+    static const Order empty{};
+    return bids.count == 0 ? empty : bids.orders[0];
+}
+
+template <typename T, size_t Depth>
+const Order& OrderBook<T, Depth>::GetBestOffer() const {
+    static const Order empty{};
+    return offers.count == 0 ? empty : offers.orders[0];
+}
+
+template <typename T, size_t Depth>
+bool OrderBook<T, Depth>::Better(PricingSide _side, Ticks _price, Ticks _other) {
+    return _side == BID ? _price > _other : _price < _other;
+}
+
+template <typename T, size_t Depth>
+typename OrderBook<T, Depth>::Stack& OrderBook<T, Depth>::SideStack(PricingSide _side) {
+    return _side == BID ? bids : offers;
+}
+
+template <typename T, size_t Depth>
+const typename OrderBook<T, Depth>::Stack& OrderBook<T, Depth>::SideStack(PricingSide _side) const {
+    return _side == BID ? bids : offers;
+}
+
+template <typename T, size_t Depth>
+size_t OrderBook<T, Depth>::LowerBound(const Stack& _stack, PricingSide _side, Ticks _price) {
+    // The stack is sorted, so counting over every slot gives the position without a data-dependent branch
+    size_t index = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < Depth; ++i) {
+        index += i < _stack.count && Better(_side, _stack.orders[i].GetPrice(), _price);
+    }
+    return index;
+}
+
+template <typename T, size_t Depth>
+size_t OrderBook<T, Depth>::UpperBound(const Stack& _stack, PricingSide _side, Ticks _price) {
+    size_t index = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < Depth; ++i) {
+        index += i < _stack.count && !Better(_side, _price, _stack.orders[i].GetPrice());
+    }
+    return index;
+}
+
+template <typename T, size_t Depth>
+bool OrderBook<T, Depth>::Insert(Stack& _stack, size_t _index, const Order& _order) {
+    if (_stack.count == Depth) {
+        if (_index == Depth) return false;
+        --_stack.count;
+    }
+    for (size_t i = _stack.count; i > _index; --i) _stack.orders[i] = _stack.orders[i - 1];
+    _stack.orders[_index] = _order;
+    ++_stack.count;
+    return true;
+}
+
+template <typename T, size_t Depth>
+void OrderBook<T, Depth>::Erase(Stack& _stack, size_t _index) {
+    for (size_t i = _index + 1; i < _stack.count; ++i) _stack.orders[i - 1] = _stack.orders[i];
+    --_stack.count;
+}
+
+template <typename T, size_t Depth>
+void OrderBook<T, Depth>::Fill(Stack& _stack, span<const Order> _orders, PricingSide _side) {
+    // Feeds list levels best-first already, so this is normally a straight copy
+    auto better = [&](const Order& a, const Order& b) { return Better(_side, a.GetPrice(), b.GetPrice()); };
+    if (is_sorted(_orders.begin(), _orders.end(), better)) {
+        _stack.count = min(_orders.size(), Depth);
+        copy_n(_orders.begin(), _stack.count, _stack.orders.begin());
+        return;
+    }
+    _stack.count = 0;
+    for (const auto& order : _orders) Insert(_stack, UpperBound(_stack, _side, order.GetPrice()), order);
+}
+
+template <typename T, size_t Depth>
+void OrderBook<T, Depth>::AddOrder(const Order& _order) {
+    // Orders at an equal price queue behind the existing ones
+    Stack& stack = SideStack(_order.GetSide());
+    if (Insert(stack, UpperBound(stack, _order.GetSide(), _order.GetPrice()), _order)) version = NextVersion();
+}
+
+template <typename T, size_t Depth>
+void OrderBook<T, Depth>::UpdateLevel(PricingSide _side, Ticks _price, long _quantity) {
+    Stack& stack = SideStack(_side);
+    size_t index = LowerBound(stack, _side, _price);
+    if (index == stack.count || stack.orders[index].GetPrice() != _price) {
+        if (_quantity > 0) AddOrder(Order(_price, _quantity, _side));
+        return;
+    }
+    if (_quantity > 0) {
+        stack.orders[index] = Order(_price, _quantity, _side);
+    } else {
+        Erase(stack, index);
+    }
+    version = NextVersion();
+}
+
+template <typename T, size_t Depth>
+bool OrderBook<T, Depth>::RemoveLevel(PricingSide _side, Ticks _price) {
+    Stack& stack = SideStack(_side);
+    size_t index = LowerBound(stack, _side, _price);
+    if (index == stack.count || stack.orders[index].GetPrice() != _price) return false;
+    Erase(stack, index);
+    version = NextVersion();
+    return true;
+}
+
+template <typename T, size_t Depth>
+long OrderBook<T, Depth>::GetQuantityAt(PricingSide _side, Ticks _price) const {
+    const Stack& stack = SideStack(_side);
+    long quantity = 0;
+#pragma GCC unroll 16
+    for (size_t i = 0; i < Depth; ++i) {
+        if (i < stack.count && stack.orders[i].GetPrice() == _price) quantity += stack.orders[i].GetQuantity();
+    }
+    return quantity;
+}
+
+/**
+ * Kind of change carried by a BookDelta.
+ */
+enum BookAction { ADD_LEVEL, MODIFY_LEVEL, DELETE_LEVEL };
+
+/**
+ * An incremental change to one price level of an order book.
+ * T: The type of the product associated with the order book.
+ */
+template <typename T>
+class BookDelta : public Traced {
+   public:
+    // Default constructor
+    BookDelta() = default;
+
+    // Constructor taking the product, the change, the order at the affected level and the venue of the book
+    BookDelta(const T& _product, BookAction _action, const Order& _order, Market _venue = BROKERTEC);
+
+    // Retrieve the product of the book being changed
+    const T& GetProduct() const;
+
+    // Retrieve the kind of change
+    BookAction GetAction() const;
+
+    // Retrieve the order at the affected level; its quantity is ignored for deletes
+    const Order& GetOrder() const;
+
+    // Retrieve the venue of the book being changed
+    Market GetVenue() const;
+
+    // Apply the change to a book in place, noting whether a delete or zero-quantity modify found its level
+    template <size_t Depth>
+    void ApplyTo(OrderBook<T, Depth>& _book);
+
+    // Whether the change, once applied to the book, altered its best bid or offer
+    template <size_t Depth>
+    bool ChangedTop(const OrderBook<T, Depth>& _book) const;
+
+   private:
+    T product;             // The product of the book being changed
+    BookAction action;     // The kind of change
+    Order order;           // The order at the affected level
+    Market venue;          // The venue of the book being changed
+    bool removed = false;  // Whether a delete or zero-quantity modify removed a level when applied
 };
 
 template <typename T>
-OrderBook<T>::OrderBook(const T& _product, const vector<Order>& _bidStack, const vector<Order>& _offerStack)
-    : product(_product), bidStack(_bidStack), offerStack(_offerStack) {}
+BookDelta<T>::BookDelta(const T& _product, BookAction _action, const Order& _order, Market _venue)
+    : product(_product), action(_action), order(_order), venue(_venue) {}
 
 template <typename T>
-const T& OrderBook<T>::GetProduct() const {
+const T& BookDelta<T>::GetProduct() const {
     return product;
 }
 
 template <typename T>
-const vector<Order>& OrderBook<T>::GetBidStack() const {
-    return bidStack;
+BookAction BookDelta<T>::GetAction() const {
+    return action;
 }
 
 template <typename T>
-const vector<Order>& OrderBook<T>::GetOfferStack() const {
-    return offerStack;
+const Order& BookDelta<T>::GetOrder() const {
+    return order;
 }
 
 template <typename T>
-BidOffer OrderBook<T>::GetBestBidOffer() const {
-    double bestBidPrice = numeric_limits<double>::lowest();
-    Order bestBid;
-    for (const auto& b : bidStack) {
-        double px = b.GetPrice();
-        if (px > bestBidPrice) {
-            bestBidPrice = px;
-            bestBid = b;
-        }
+Market BookDelta<T>::GetVenue() const {
+    return venue;
+}
+
+template <typename T>
+template <size_t Depth>
+void BookDelta<T>::ApplyTo(OrderBook<T, Depth>& _book) {
+    switch (action) {
+        case ADD_LEVEL:
+            _book.AddOrder(order);
+            break;
+        case MODIFY_LEVEL:
+            // A modify to zero quantity deletes the level, so it is noted like a delete
+            if (order.GetQuantity() > 0)
+                _book.UpdateLevel(order.GetSide(), order.GetPrice(), order.GetQuantity());
+            else
+                removed = _book.RemoveLevel(order.GetSide(), order.GetPrice());
+            break;
+        case DELETE_LEVEL:
+            removed = _book.RemoveLevel(order.GetSide(), order.GetPrice());
+            break;
     }
+}
 
-    double bestOfferPrice = numeric_limits<double>::max();
-    Order bestOffer;
-    for (const auto& o : offerStack) {
-        double px = o.GetPrice();
-        if (px < bestOfferPrice) {
-            bestOfferPrice = px;
-            bestOffer = o;
-        }
+template <typename T>
+template <size_t Depth>
+bool BookDelta<T>::ChangedTop(const OrderBook<T, Depth>& _book) const {
+    // Deleting a level the book did not have changed nothing
+    bool deletes = action == DELETE_LEVEL || (action == MODIFY_LEVEL && order.GetQuantity() <= 0);
+    if (deletes && !removed) return false;
+    PricingSide side = order.GetSide();
+    span<const Order> stack = side == BID ? _book.GetBidStack() : _book.GetOfferStack();
+    if (stack.empty()) return true;
+
+    // An added or modified level is on top if it is the best; a deleted one was if it was at least as good
+    Ticks best = stack.front().GetPrice();
+    if (!deletes) return order.GetPrice() == best;
+    return side == BID ? order.GetPrice() >= best : order.GetPrice() <= best;
+}
+
+/**
+ * Listener that consumes incremental book updates.
+ * Listeners registered on the market data service that derive from this class receive each
+ * BookDelta together with a reference to the live book it was applied to; all other listeners
+ * receive the live book through ProcessUpdate.
+ */
+template <typename T, size_t Depth = DEFAULT_BOOK_DEPTH>
+class BookDeltaListener : public ServiceListener<OrderBook<T, Depth>> {
+   public:
+    // Listener callback to process a delta that has been applied to the live book
+    virtual void ProcessDelta(BookDelta<T>& _delta, OrderBook<T, Depth>& _book) = 0;
+};
+
+/**
+ * One price level of a consolidated book: the quantity at the price summed over all venues,
+ * and the share of it quoted on each venue.
+ */
+struct ConsolidatedLevel {
+    Ticks price;                                  // Price of the level
+    long quantity = 0;                            // Quantity across all venues
+    array<long, MARKET_COUNT> venueQuantities{};  // Quantity on each venue, indexed by Market
+};
+
+/**
+ * Cross-venue order book of one product, kept up to date from changes to the per-venue books
+ * rather than rebuilt from them. Levels are sorted best-first like the OrderBook stacks.
+ * T: The type of the product associated with the book.
+ */
+template <typename T>
+class ConsolidatedBook {
+   public:
+    // Default constructor
+    ConsolidatedBook() = default;
+
+    // Constructor for an empty book of a product
+    explicit ConsolidatedBook(const T& _product);
+
+    // Retrieve the product associated with the book
+    const T& GetProduct() const;
+
+    // Retrieve the bid levels, best first
+    const vector<ConsolidatedLevel>& GetBidLevels() const;
+
+    // Retrieve the offer levels, best first
+    const vector<ConsolidatedLevel>& GetOfferLevels() const;
+
+    // Retrieve the best bid and offer with their quantities across all venues
+    BidOffer GetBestBidOffer() const;
+
+    // Retrieve the venue quoting the most quantity at the best level of a side; throws if the side is empty
+    Market GetBestVenue(PricingSide _side) const;
+
+    // Identifies the book contents: changes whenever a level changes
+    uint64_t GetVersion() const;
+
+    // Add a change in one venue's quantity at a price, creating or removing the level as needed
+    void Apply(Market _venue, PricingSide _side, Ticks _price, long _change);
+
+    // Replace one venue's side given its previous and new best-first stacks, touching only the prices that differ
+    void Replace(Market _venue, PricingSide _side, span<const Order> _previous, span<const Order> _current);
+
+   private:
+    // Whether a price ranks strictly ahead of another on the given side
+    static bool Better(PricingSide _side, Ticks _price, Ticks _other);
+
+    T product;                         // The product associated with the book
+    vector<ConsolidatedLevel> bids;    // Bid levels, best first
+    vector<ConsolidatedLevel> offers;  // Offer levels, best first
+    uint64_t version = 0;              // Number of level changes applied
+};
+
+template <typename T>
+ConsolidatedBook<T>::ConsolidatedBook(const T& _product) : product(_product) {}
+
+template <typename T>
+const T& ConsolidatedBook<T>::GetProduct() const {
+    return product;
+}
+
+template <typename T>
+const vector<ConsolidatedLevel>& ConsolidatedBook<T>::GetBidLevels() const {
+    return bids;
+}
+
+template <typename T>
+const vector<ConsolidatedLevel>& ConsolidatedBook<T>::GetOfferLevels() const {
+    return offers;
+}
+
+template <typename T>
+BidOffer ConsolidatedBook<T>::GetBestBidOffer() const {
+    Order bid = bids.empty() ? Order() : Order(bids.front().price, bids.front().quantity, BID);
+    Order offer = offers.empty() ? Order() : Order(offers.front().price, offers.front().quantity, OFFER);
+    return BidOffer(bid, offer);
+}
+
+template <typename T>
+Market ConsolidatedBook<T>::GetBestVenue(PricingSide _side) const {
+    const vector<ConsolidatedLevel>& levels = _side == BID ? bids : offers;
+    if (levels.empty()) throw std::logic_error("No levels on this side of " + product.GetProductId());
+    const auto& quantities = levels.front().venueQuantities;
+    return static_cast<Market>(max_element(quantities.begin(), quantities.end()) - quantities.begin());
+}
+
+template <typename T>
+uint64_t ConsolidatedBook<T>::GetVersion() const {
+    return version;
+}
+
+template <typename T>
+bool ConsolidatedBook<T>::Better(PricingSide _side, Ticks _price, Ticks _other) {
+    return _side == BID ? _price > _other : _price < _other;
+}
+
+template <typename T>
+void ConsolidatedBook<T>::Apply(Market _venue, PricingSide _side, Ticks _price, long _change) {
+    if (_change == 0) return;
+    vector<ConsolidatedLevel>& levels = _side == BID ? bids : offers;
+    auto it = partition_point(levels.begin(), levels.end(),
+                              [&](const ConsolidatedLevel& l) { return Better(_side, l.price, _price); });
+    ++version;
+
+    if (it == levels.end() || it->price != _price) {
+        if (_change < 0) return;
+        ConsolidatedLevel level;
+        level.price = _price;
+        level.quantity = _change;
+        level.venueQuantities[_venue] = _change;
+        levels.insert(it, level);
+        return;
     }
 
-    return BidOffer(bestBid, bestOffer);
+    it->quantity += _change;
+    it->venueQuantities[_venue] += _change;
+    if (it->quantity <= 0) levels.erase(it);
 }
 
-// Forward declaration
 template <typename T>
+void ConsolidatedBook<T>::Replace(Market _venue, PricingSide _side, span<const Order> _previous,
+                                  span<const Order> _current) {
+    // Both stacks are best-first, so one merge pass visits every price once in book order
+    size_t i = 0, j = 0;
+    while (i < _previous.size() || j < _current.size()) {
+        Ticks price;
+        if (j == _current.size() ||
+            (i < _previous.size() && !Better(_side, _current[j].GetPrice(), _previous[i].GetPrice())))
+            price = _previous[i].GetPrice();
+        else
+            price = _current[j].GetPrice();
+
+        long change = 0;
+        for (; i < _previous.size() && _previous[i].GetPrice() == price; ++i) change -= _previous[i].GetQuantity();
+        for (; j < _current.size() && _current[j].GetPrice() == price; ++j) change += _current[j].GetQuantity();
+        Apply(_venue, _side, price, change);
+    }
+}
+
+// Forward declaration
+template <typename T, size_t Depth = DEFAULT_BOOK_DEPTH>
 class BondMarketDataConnector;
 
+/**
+ * Read-only view of aggregated price levels, one Order per distinct price with the quantity summed
+ * over all orders and venues, best price first. The view stays valid until the book it was taken from next changes.
+ */
+struct DepthView {
+    span<const Order> bids;    // Aggregated bid levels, best first
+    span<const Order> offers;  // Aggregated offer levels, best first
+};
+
 /**
  * Abstract base class for a market data service that distributes market data.
- * Keyed by product identifier. T: The product type.
+ * Keyed by product identifier. T: The product type. Depth: Maximum orders per side of its books.
  */
-template <typename T>
-class MarketDataService : public Service<string, OrderBook<T>> {
+template <typename T, size_t Depth = DEFAULT_BOOK_DEPTH>
+class MarketDataService : public Service<string, OrderBook<T, Depth>> {
    public:
-    // Retrieve the best bid and offer orders for a specific product
+    // Retrieve the best bid and offer orders across all venues for a specific product
     virtual BidOffer GetBestBidOffer(const string& productId) = 0;
 
-    // Aggregate the order book depth
-    virtual OrderBook<T> AggregateDepth(const string& productId) = 0;
+    // Aggregate the order book depth across all venues
+    virtual OrderBook<T, Depth> AggregateDepth(const string& productId) = 0;
 };
 
 /**
  * Concrete implementation of a market data service for bond products.
+ * Holds one resident book per product and venue, and a consolidated book per product that is
+ * updated with the difference each snapshot or delta makes to its venue's book.
+ * T: The product type. Depth: Maximum orders per side of its books.
  */
-template <typename T>
-class BondMarketDataService : public MarketDataService<T> {
+template <typename T, size_t Depth = DEFAULT_BOOK_DEPTH>
+class BondMarketDataService : public MarketDataService<T, Depth> {
    public:
     // Constructor and destructor
     BondMarketDataService();
     virtual ~BondMarketDataService() = default;
 
-    // Retrieve data for a specific product
-    OrderBook<T>& GetData(string _key);
+    // Retrieve the book of a product on the venue that last updated it
+    OrderBook<T, Depth>& GetData(string _key);
+
+    // Retrieve the book of a product on one venue
+    OrderBook<T, Depth>& GetVenueBook(const string& _productId, Market _venue);
+
+    // Retrieve the cross-venue book of a product
+    const ConsolidatedBook<T>& GetConsolidatedBook(const string& _productId);
 
-    // Callback invoked by a connector with new or updated data
-    void OnMessage(OrderBook<T>& _data);
+    // Callback invoked by a connector with a full book snapshot, which replaces the resident book of its venue
+    void OnMessage(OrderBook<T, Depth>& _data);
+
+    // Callback invoked by a connector with an incremental update to the resident book of its venue
+    void OnDelta(BookDelta<T>& _delta);
 
     // Add a listener for data updates
-    void AddListener(ServiceListener<OrderBook<T>>* _listener);
+    void AddListener(ServiceListener<OrderBook<T, Depth>>* _listener);
 
     // Retrieve all listeners for the service
-    const vector<ServiceListener<OrderBook<T>>*>& GetListeners() const;
+    const vector<ServiceListener<OrderBook<T, Depth>>*>& GetListeners() const;
 
     // Retrieve the connector associated with the service
-    BondMarketDataConnector<T>* GetConnector();
+    BondMarketDataConnector<T, Depth>* GetConnector();
 
-    // Retrieve the depth of the order book
-    int GetBookDepth() const;
+    // Retrieve the depth of the order book, fixed at compile time
+    static constexpr int GetBookDepth();
 
-    // Retrieve the best bid and offer for a product
+    // Retrieve the best bid and offer across all venues for a product
     BidOffer GetBestBidOffer(const string& _productId);
 
-    // Aggregate the order book depth
-    OrderBook<T> AggregateDepth(const string& _productId);
+    // Aggregate the order book depth across all venues, keeping the best Depth levels per side
+    OrderBook<T, Depth> AggregateDepth(const string& _productId);
+
+    // View the aggregated depth of a product without copying, limited to the best _levels per side
+    DepthView AggregateDepthView(const string& _productId, size_t _levels = numeric_limits<size_t>::max());
 
    private:
-    map<string, OrderBook<T>> orderBooks;                    // Map of product ID to order book
-    vector<ServiceListener<OrderBook<T>>*> listeners;        // Listeners for data updates
-    BondMarketDataConnector<T>* connector;                  // Connector for the service
-    int bookDepth;                                           // Depth of the order book
+    /**
+     * Aggregated levels of one product, reused across calls and rebuilt only when the consolidated book changes.
+     */
+    struct AggregatedDepth {
+        uint64_t version = 0;
+        vector<Order> bids;
+        vector<Order> offers;
+    };
+
+    /**
+     * Everything the service holds for one product.
+     */
+    struct ProductBooks {
+        array<OrderBook<T, Depth>, MARKET_COUNT> venues;  // Resident book per venue, indexed by Market
+        ConsolidatedBook<T> consolidated;          // Cross-venue book
+        Market lastVenue = BROKERTEC;              // Venue of the latest snapshot or delta
+        AggregatedDepth aggregated;                // Cached aggregation of the consolidated book
+    };
+
+    // Books of a product, setting up empty venue books the first time the product is seen
+    ProductBooks& Books(const T& _product);
+
+    // Copy consolidated levels into a reused buffer of orders
+    static void CopyLevels(const vector<ConsolidatedLevel>& _levels, PricingSide _side, vector<Order>& _orders);
+
+    map<string, ProductBooks> productBooks;                  // Map of product ID to its books
+    vector<ServiceListener<OrderBook<T, Depth>>*> listeners;        // Listeners for data updates
+    vector<BookDeltaListener<T, Depth>*> deltaListeners;            // Listeners consuming deltas
+    vector<ServiceListener<OrderBook<T, Depth>>*> bookListeners;    // Listeners given the live book on a delta
+    BondMarketDataConnector<T, Depth>* connector;                  // Connector for the service
 };
 
-template <typename T>
-BondMarketDataService<T>::BondMarketDataService() {
-    orderBooks = map<string, OrderBook<T>>();
-    listeners = vector<ServiceListener<OrderBook<T>>*>();
-    connector = new BondMarketDataConnector<T>(this);
-    bookDepth = 5;
+template <typename T, size_t Depth>
+BondMarketDataService<T, Depth>::BondMarketDataService() {
+    productBooks = map<string, ProductBooks>();
+    listeners = vector<ServiceListener<OrderBook<T, Depth>>*>();
+    connector = new BondMarketDataConnector<T, Depth>(this);
 }
 
-template <typename T>
-OrderBook<T>& BondMarketDataService<T>::GetData(string _key) {
-    return orderBooks[_key];
+template <typename T, size_t Depth>
+typename BondMarketDataService<T, Depth>::ProductBooks& BondMarketDataService<T, Depth>::Books(const T& _product) {
+    const string& productId = _product.GetProductId();
+    ProductBooks& books = productBooks[productId];
+    if (books.consolidated.GetProduct().GetProductId() != productId) {
+        for (size_t v = 0; v < MARKET_COUNT; ++v) {
+            books.venues[v] = OrderBook<T, Depth>(_product, {}, {}, static_cast<Market>(v));
+        }
+        books.consolidated = ConsolidatedBook<T>(_product);
+    }
+    return books;
 }
 
-template <typename T>
-void BondMarketDataService<T>::OnMessage(OrderBook<T>& _data) {
-    orderBooks[_data.GetProduct().GetProductId()] = _data;
+template <typename T, size_t Depth>
+OrderBook<T, Depth>& BondMarketDataService<T, Depth>::GetData(string _key) {
+    ProductBooks& books = productBooks[_key];
+    return books.venues[books.lastVenue];
+}
+
+template <typename T, size_t Depth>
+OrderBook<T, Depth>& BondMarketDataService<T, Depth>::GetVenueBook(const string& _productId, Market _venue) {
+    return productBooks[_productId].venues[_venue];
+}
+
+template <typename T, size_t Depth>
+const ConsolidatedBook<T>& BondMarketDataService<T, Depth>::GetConsolidatedBook(const string& _productId) {
+    return productBooks[_productId].consolidated;
+}
+
+template <typename T, size_t Depth>
+void BondMarketDataService<T, Depth>::OnMessage(OrderBook<T, Depth>& _data) {
+    auto timer = this->TrackMessage();
+    LatencyTracer::Instance().Record(TRACE_MARKET_DATA, _data.GetTrace());
 
-    for (auto& listener : listeners) {
-        listener->ProcessAdd(_data);
+    ProductBooks& books = Books(_data.GetProduct());
+    Market venue = _data.GetVenue();
+    OrderBook<T, Depth>& resident = books.venues[venue];
+    books.consolidated.Replace(venue, BID, resident.GetBidStack(), _data.GetBidStack());
+    books.consolidated.Replace(venue, OFFER, resident.GetOfferStack(), _data.GetOfferStack());
+    resident = _data;
+    books.lastVenue = venue;
+
+    this->NotifyAdd(listeners, _data);
+}
+
+template <typename T, size_t Depth>
+void BondMarketDataService<T, Depth>::OnDelta(BookDelta<T>& _delta) {
+    auto timer = this->TrackMessage();
+    LatencyTracer::Instance().Record(TRACE_MARKET_DATA, _delta.GetTrace());
+
+    ProductBooks& books = Books(_delta.GetProduct());
+    Market venue = _delta.GetVenue();
+    OrderBook<T, Depth>& book = books.venues[venue];
+    PricingSide side = _delta.GetOrder().GetSide();
+    Ticks price = _delta.GetOrder().GetPrice();
+    span<const Order> stack = side == BID ? book.GetBidStack() : book.GetOfferStack();
+
+    if (stack.size() < OrderBook<T, Depth>::MAX_LEVELS) {
+        // Below the level cap a delta only changes the quantity at its own price
+        long before = book.GetQuantityAt(side, price);
+        _delta.ApplyTo(book);
+        books.consolidated.Apply(venue, side, price, book.GetQuantityAt(side, price) - before);
+    } else {
+        // A full stack may also drop its worst order, so diff the whole side
+        // The stack views the book's storage, so copy it before the delta lands
+        array<Order, Depth> previous;
+        copy(stack.begin(), stack.end(), previous.begin());
+        _delta.ApplyTo(book);
+        books.consolidated.Replace(venue, side, span<const Order>(previous.data(), stack.size()),
+                                  side == BID ? book.GetBidStack() : book.GetOfferStack());
     }
+    book.SetTrace(_delta.GetTrace());
+    books.lastVenue = venue;
+
+    for (auto& l : deltaListeners) l->ProcessDelta(_delta, book);
+    for (auto& l : bookListeners) l->ProcessUpdate(book);
 }
 
-template <typename T>
-void BondMarketDataService<T>::AddListener(ServiceListener<OrderBook<T>>* _listener) {
+template <typename T, size_t Depth>
+void BondMarketDataService<T, Depth>::AddListener(ServiceListener<OrderBook<T, Depth>>* _listener) {
     listeners.push_back(_listener);
+    if (auto deltaListener = dynamic_cast<BookDeltaListener<T, Depth>*>(_listener)) {
+        deltaListeners.push_back(deltaListener);
+    } else {
+        bookListeners.push_back(_listener);
+    }
 }
 
-template <typename T>
-const vector<ServiceListener<OrderBook<T>>*>& BondMarketDataService<T>::GetListeners() const {
+template <typename T, size_t Depth>
+const vector<ServiceListener<OrderBook<T, Depth>>*>& BondMarketDataService<T, Depth>::GetListeners() const {
     return listeners;
 }
 
-template <typename T>
-BondMarketDataConnector<T>* BondMarketDataService<T>::GetConnector() {
+template <typename T, size_t Depth>
+BondMarketDataConnector<T, Depth>* BondMarketDataService<T, Depth>::GetConnector() {
     return connector;
 }
 
-template <typename T>
-int BondMarketDataService<T>::GetBookDepth() const {
-    return bookDepth;
+template <typename T, size_t Depth>
+constexpr int BondMarketDataService<T, Depth>::GetBookDepth() {
+    return static_cast<int>(Depth);
 }
 
-template <typename T>
-BidOffer BondMarketDataService<T>::GetBestBidOffer(const string& _productId) {
-    auto& currOrderBook = orderBooks[_productId];
-    return currOrderBook.GetBestBidOffer();
+template <typename T, size_t Depth>
+BidOffer BondMarketDataService<T, Depth>::GetBestBidOffer(const string& _productId) {
+    return productBooks[_productId].consolidated.GetBestBidOffer();
 }
 
-template <typename T>
-OrderBook<T> BondMarketDataService<T>::AggregateDepth(const string& productId) {
-    auto aggregateStack = [](const vector<Order>& stack, PricingSide side) {
-        unordered_map<double, long> priceQuantityMap;
-        for (const auto& order : stack) {
-            priceQuantityMap[order.GetPrice()] += order.GetQuantity();
-        }
-
-        vector<Order> aggregatedOrders;
-        for (const auto& [price, quantity] : priceQuantityMap) {
-            aggregatedOrders.emplace_back(price, quantity, side);
-        }
-
-        return aggregatedOrders;
-    };
+template <typename T, size_t Depth>
+OrderBook<T, Depth> BondMarketDataService<T, Depth>::AggregateDepth(const string& productId) {
+    DepthView view = AggregateDepthView(productId);
+    return OrderBook<T, Depth>(productBooks[productId].consolidated.GetProduct(),
+                        vector<Order>(view.bids.begin(), view.bids.end()),
+                        vector<Order>(view.offers.begin(), view.offers.end()));
+}
 
-    const auto& bidStack = orderBooks[productId].GetBidStack();
-    const auto& offerStack = orderBooks[productId].GetOfferStack();
+template <typename T, size_t Depth>
+DepthView BondMarketDataService<T, Depth>::AggregateDepthView(const string& _productId, size_t _levels) {
+    ProductBooks& books = productBooks[_productId];
+    AggregatedDepth& depth = books.aggregated;
+    if (depth.version != books.consolidated.GetVersion()) {
+        CopyLevels(books.consolidated.GetBidLevels(), BID, depth.bids);
+        CopyLevels(books.consolidated.GetOfferLevels(), OFFER, depth.offers);
+        depth.version = books.consolidated.GetVersion();
+    }
 
-    vector<Order> aggregatedBidStack = aggregateStack(bidStack, BID);
-    vector<Order> aggregatedOfferStack = aggregateStack(offerStack, OFFER);
+    span<const Order> bids(depth.bids);
+    span<const Order> offers(depth.offers);
+    return DepthView{bids.first(min(_levels, bids.size())), offers.first(min(_levels, offers.size()))};
+}
 
-    return OrderBook<T>(orderBooks[productId].GetProduct(), aggregatedBidStack, aggregatedOfferStack);
+template <typename T, size_t Depth>
+void BondMarketDataService<T, Depth>::CopyLevels(const vector<ConsolidatedLevel>& _levels, PricingSide _side,
+                                          vector<Order>& _orders) {
+    // The consolidated levels already hold one entry per price
+    _orders.clear();
+    for (const auto& level : _levels) _orders.emplace_back(level.price, level.quantity, _side);
 }
 
 /**
  * Connector for the BondMarketDataService, used to subscribe and publish data.
+ * Reads books of the service's compile-time depth: 2 x Depth lines per book.
  */
-template <typename T>
-class BondMarketDataConnector : public Connector<OrderBook<T>> {
+template <typename T, size_t Depth>
+class BondMarketDataConnector : public Connector<OrderBook<T, Depth>> {
    private:
-    BondMarketDataService<T>* service;  // Associated market data service
+    BondMarketDataService<T, Depth>* service;  // Associated market data service
 
    public:
     // Constructor and destructor
-    BondMarketDataConnector(BondMarketDataService<T>* _service);
+    BondMarketDataConnector(BondMarketDataService<T, Depth>* _service);
     virtual ~BondMarketDataConnector();
 
     // Publish data to the connector
-    void Publish(OrderBook<T>& _data);
+    void Publish(OrderBook<T, Depth>& _data);
 
     // Subscribe to data from the connector
     void Subscribe(ifstream& _data);
+
+    // Parse the input one order book at a time, from "productId,price,quantity,BID|OFFER[,venue]" lines;
+    // every line of a book names the same venue, BROKERTEC when omitted
+    Generator<OrderBook<T, Depth>> Read(ifstream& _data);
+
+    // Subscribe to incremental updates from the connector
+    void SubscribeDeltas(ifstream& _data);
+
+    // Parse incremental updates, one "productId,ADD|MODIFY|DELETE,price,quantity,BID|OFFER[,venue]" line at a time
+    Generator<BookDelta<T>> ReadDeltas(ifstream& _data);
 };
 
-template <typename T>
-BondMarketDataConnector<T>::BondMarketDataConnector(BondMarketDataService<T>* _service) : service(_service) {}
+template <typename T, size_t Depth>
+BondMarketDataConnector<T, Depth>::BondMarketDataConnector(BondMarketDataService<T, Depth>* _service) : service(_service) {}
 
-template <typename T>
-BondMarketDataConnector<T>::~BondMarketDataConnector() {}
+template <typename T, size_t Depth>
+BondMarketDataConnector<T, Depth>::~BondMarketDataConnector() {}
 
-template <typename T>
-void BondMarketDataConnector<T>::Publish(OrderBook<T>& _data) {}
+template <typename T, size_t Depth>
+void BondMarketDataConnector<T, Depth>::Publish(OrderBook<T, Depth>& _data) {}
 
-template <typename T>
-void BondMarketDataConnector<T>::Subscribe(ifstream& dataStream) {
-    const int bookDepth = service->GetBookDepth();
-    const int batchSize = bookDepth * 2;
+template <typename T, size_t Depth>
+void BondMarketDataConnector<T, Depth>::Subscribe(ifstream& dataStream) {
+    for (auto& orderBook : Read(dataStream)) {
+        service->OnMessage(orderBook);
+    }
+}
+
+template <typename T, size_t Depth>
+Generator<OrderBook<T, Depth>> BondMarketDataConnector<T, Depth>::Read(ifstream& dataStream) {
+    const int batchSize = BondMarketDataService<T, Depth>::GetBookDepth() * 2;
     vector<Order> bidOrders, offerOrders;
 
-    auto parseOrder = [](const string& line) -> tuple<string, Order> {
+    auto parseOrder = [](const string& line) -> tuple<string, Order, Market> {
         stringstream ss(line);
         vector<string> tokens;
         string token;
@@ -349,17 +989,27 @@ void BondMarketDataConnector<T>::Subscribe(ifstream& dataStream) {
         }
 
         string productId = tokens[0];
-        double price = ParsePrice(tokens[1]);
+        Ticks price = Ticks::Parse(tokens[1]);
         long quantity = stol(tokens[2]);
         PricingSide side = (tokens[3] == "BID") ? BID : OFFER;
+        Market venue = tokens.size() > 4 ? ParseMarket(tokens[4]) : BROKERTEC;
 
-        return {productId, Order(price, quantity, side)};
+        return {productId, Order(price, quantity, side), venue};
     };
 
     long orderCount = 0;
     string line;
+    TraceContext trace;
+    Market bookVenue = BROKERTEC;
     while (getline(dataStream, line)) {
-        auto [productId, order] = parseOrder(line);
+        auto [productId, order, venue] = parseOrder(line);
+        if (orderCount % batchSize == 0) {
+            // The book is traced from the moment its first line is read
+            trace = LatencyTracer::Instance().Begin();
+            bookVenue = venue;
+        } else if (venue != bookVenue) {
+            throw std::invalid_argument("Market data book mixes venues: " + line);
+        }
 
         if (order.GetSide() == BID) {
             bidOrders.push_back(order);
@@ -369,8 +1019,9 @@ void BondMarketDataConnector<T>::Subscribe(ifstream& dataStream) {
 
         if (++orderCount % batchSize == 0) {
             T product = BondInfo(productId);
-            OrderBook<T> orderBook(product, bidOrders, offerOrders);
-            service->OnMessage(orderBook);
+            OrderBook<T, Depth> orderBook(product, bidOrders, offerOrders, bookVenue);
+            orderBook.SetTrace(trace);
+            co_yield orderBook;
 
             bidOrders.clear();
             offerOrders.clear();
@@ -378,4 +1029,36 @@ void BondMarketDataConnector<T>::Subscribe(ifstream& dataStream) {
     }
 }
 
+template <typename T, size_t Depth>
+void BondMarketDataConnector<T, Depth>::SubscribeDeltas(ifstream& _data) {
+    for (auto& delta : ReadDeltas(_data)) {
+        service->OnDelta(delta);
+    }
+}
+
+template <typename T, size_t Depth>
+Generator<BookDelta<T>> BondMarketDataConnector<T, Depth>::ReadDeltas(ifstream& _data) {
+    string line;
+    while (getline(_data, line)) {
+        TraceContext trace = LatencyTracer::Instance().Begin();
+        stringstream ss(line);
+        vector<string> tokens;
+        string token;
+        while (getline(ss, token, ',')) {
+            tokens.push_back(token);
+        }
+
+        BookAction action = ADD_LEVEL;
+        if (tokens[1] == "MODIFY") action = MODIFY_LEVEL;
+        else if (tokens[1] == "DELETE") action = DELETE_LEVEL;
+        PricingSide side = (tokens[4] == "BID") ? BID : OFFER;
+        Order order(Ticks::Parse(tokens[2]), stol(tokens[3]), side);
+        Market venue = tokens.size() > 5 ? ParseMarket(tokens[5]) : BROKERTEC;
+
+        BookDelta<T> delta(BondInfo(tokens[0]), action, order, venue);
+        delta.SetTrace(trace);
+        co_yield delta;
+    }
+}
+
 #endif
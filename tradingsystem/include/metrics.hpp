@@ -0,0 +1,344 @@
+/**
+ * metrics.hpp
+ * Defines the instrumentation layer used by the Service and ServiceListener base classes:
+ * per-service message counters, HDR-style latency histograms for OnMessage and listener
+ * callbacks, and queue depth gauges, together with a summary table and a JSON report.
+ *
+ * The hooks in soa.hpp only record anything when ENABLE_METRICS is defined at compile time.
+ * Without it they reduce to empty inline functions and the notification loops are unchanged.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <typeinfo>
+
+using namespace std;
+
+/**
+ * Log-linear latency histogram in the style of HdrHistogram.
+ * Values below 32 are recorded exactly; above that every power of two is split into
+ * 16 sub-buckets, so a bucket spans at most 1/16 of its lower edge and any reported
+ * percentile is within about 6% of the true value.
+ */
+class LatencyHistogram {
+   public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+    static constexpr int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    // Record one value (nanoseconds)
+    void Record(uint64_t _value);
+
+    // Record the same value several times
+    void Record(uint64_t _value, uint64_t _times);
+
+    // Number of recorded values
+    uint64_t GetCount() const;
+
+    // Smallest recorded value
+    uint64_t GetMin() const;
+
+    // Largest recorded value
+    uint64_t GetMax() const;
+
+    // Mean of recorded values
+    double GetMean() const;
+
+    // Value at the given percentile (0-100), reported as the upper edge of its bucket
+    uint64_t GetPercentile(double _percentile) const;
+
+    // Write the histogram summary as a JSON object
+    void WriteJson(ostream& _out) const;
+
+   private:
+    static int BucketIndex(uint64_t _value);
+    static uint64_t BucketUpperBound(int _index);
+
+    array<uint64_t, BUCKET_COUNT> counts;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+};
+
+LatencyHistogram::LatencyHistogram() : counts{}, count(0), sum(0), min(numeric_limits<uint64_t>::max()), max(0) {}
+
+int LatencyHistogram::BucketIndex(uint64_t _value) {
+    if (_value < SUB_BUCKETS) return static_cast<int>(_value);
+    int msb = 63 - countl_zero(_value);
+    int shift = msb - (SUB_BUCKET_BITS - 1);
+    return shift * HALF_SUB_BUCKETS + static_cast<int>(_value >> shift);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(int _index) {
+    if (_index < SUB_BUCKETS) return static_cast<uint64_t>(_index);
+    int shift = _index / HALF_SUB_BUCKETS - 1;
+    uint64_t sub = static_cast<uint64_t>(_index % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t _value) { Record(_value, 1); }
+
+void LatencyHistogram::Record(uint64_t _value, uint64_t _times) {
+    counts[BucketIndex(_value)] += _times;
+    count += _times;
+    sum += _value * _times;
+    if (_value < min) min = _value;
+    if (_value > max) max = _value;
+}
+
+uint64_t LatencyHistogram::GetCount() const { return count; }
+
+uint64_t LatencyHistogram::GetMin() const { return count == 0 ? 0 : min; }
+
+uint64_t LatencyHistogram::GetMax() const { return max; }
+
+double LatencyHistogram::GetMean() const { return count == 0 ? 0.0 : static_cast<double>(sum) / count; }
+
+uint64_t LatencyHistogram::GetPercentile(double _percentile) const {
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(_percentile / 100.0 * count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return std::min(BucketUpperBound(i), max);
+    }
+    return max;
+}
+
+void LatencyHistogram::WriteJson(ostream& _out) const {
+    _out << "{\"count\":" << count << ",\"min\":" << GetMin() << ",\"mean\":" << fixed << setprecision(1) << GetMean()
+         << ",\"p50\":" << GetPercentile(50) << ",\"p90\":" << GetPercentile(90) << ",\"p99\":" << GetPercentile(99)
+         << ",\"p999\":" << GetPercentile(99.9) << ",\"max\":" << max << "}";
+}
+
+/**
+ * Counters recorded for one Service.
+ */
+struct ServiceMetrics {
+    string name;                 // Demangled service type name
+    uint64_t messages = 0;       // OnMessage calls
+    uint64_t published = 0;      // Add events published to listeners
+    uint64_t updated = 0;        // Update events published to listeners
+    size_t queueDepth = 0;       // Last observed depth of the service's input queue
+    size_t maxQueueDepth = 0;    // Largest observed depth of the service's input queue
+    LatencyHistogram onMessage;  // Inclusive OnMessage latency in nanoseconds
+};
+
+/**
+ * Counters recorded for one listener registered on a Service.
+ */
+struct ListenerMetrics {
+    string name;                     // Demangled listener type name
+    string service;                  // Name of the service notifying this listener
+    uint64_t calls = 0;              // ProcessAdd invocations
+    LatencyHistogram processAdd;     // ProcessAdd latency in nanoseconds
+    uint64_t updates = 0;            // ProcessUpdate invocations
+    LatencyHistogram processUpdate;  // ProcessUpdate latency in nanoseconds
+};
+
+/**
+ * Process-wide registry of service and listener metrics.
+ * Entries are created lazily the first time a service or listener is observed and are
+ * never removed, so references handed out stay valid for the life of the process.
+ */
+class MetricsRegistry {
+   public:
+    // Access the process-wide registry
+    static MetricsRegistry& Instance();
+
+    // Create the metrics entry for a service
+    ServiceMetrics& RegisterService(const string& _name);
+
+    // Create the metrics entry for a listener of a service
+    ListenerMetrics& RegisterListener(const string& _name, const string& _service);
+
+    // Write a human readable summary table
+    void Report(ostream& _out) const;
+
+    // Write all metrics as a JSON document
+    void ReportJson(ostream& _out) const;
+
+    // Write the summary table and JSON report to <_prefix>.txt and <_prefix>.json
+    void Dump(const string& _prefix = "metrics") const;
+
+    // Dump the report whenever the process receives the given signal
+    void InstallSignalHandler(int _signal = SIGUSR1);
+
+    // Dump the report if a signal arrived since the last poll
+    void Poll() const;
+
+    // Demangle a type name for display
+    static string TypeName(const type_info& _type);
+
+   private:
+    MetricsRegistry() = default;
+
+    static void HandleSignal(int _signal);
+    static volatile sig_atomic_t dumpRequested;
+
+    deque<ServiceMetrics> services;
+    deque<ListenerMetrics> listeners;
+};
+
+volatile sig_atomic_t MetricsRegistry::dumpRequested = 0;
+
+MetricsRegistry& MetricsRegistry::Instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+ServiceMetrics& MetricsRegistry::RegisterService(const string& _name) {
+    services.emplace_back();
+    services.back().name = _name;
+    return services.back();
+}
+
+ListenerMetrics& MetricsRegistry::RegisterListener(const string& _name, const string& _service) {
+    listeners.emplace_back();
+    listeners.back().name = _name;
+    listeners.back().service = _service;
+    return listeners.back();
+}
+
+void MetricsRegistry::Report(ostream& _out) const {
+    _out << left << setw(48) << "SERVICE" << right << setw(12) << "MESSAGES" << setw(12) << "PUBLISHED" << setw(10)
+         << "UPDATED" << setw(10) << "MAXQUEUE" << setw(10) << "P50(ns)" << setw(10) << "P99(ns)" << setw(12)
+         << "MAX(ns)" << "\n";
+    for (const auto& s : services) {
+        _out << left << setw(48) << s.name << right << setw(12) << s.messages << setw(12) << s.published << setw(10)
+             << s.updated << setw(10) << s.maxQueueDepth << setw(10) << s.onMessage.GetPercentile(50) << setw(10)
+             << s.onMessage.GetPercentile(99) << setw(12) << s.onMessage.GetMax() << "\n";
+    }
+
+    _out << "\n"
+         << left << setw(48) << "LISTENER" << right << setw(12) << "CALLS" << setw(10) << "MEAN(ns)" << setw(10)
+         << "P50(ns)" << setw(10) << "P99(ns)" << setw(10) << "P99.9(ns)" << setw(12) << "MAX(ns)" << setw(10)
+         << "UPDATES" << setw(10) << "UPD P99" << "\n";
+    for (const auto& l : listeners) {
+        _out << left << setw(48) << l.name << right << setw(12) << l.calls << setw(10) << fixed << setprecision(0)
+             << l.processAdd.GetMean() << setw(10) << l.processAdd.GetPercentile(50) << setw(10)
+             << l.processAdd.GetPercentile(99) << setw(10) << l.processAdd.GetPercentile(99.9) << setw(12)
+             << l.processAdd.GetMax() << setw(10) << l.updates << setw(10) << l.processUpdate.GetPercentile(99)
+             << "\n";
+    }
+}
+
+void MetricsRegistry::ReportJson(ostream& _out) const {
+    _out << "{\"services\":[";
+    for (size_t i = 0; i < services.size(); ++i) {
+        const auto& s = services[i];
+        _out << (i ? "," : "") << "{\"name\":\"" << s.name << "\",\"messages\":" << s.messages
+             << ",\"published\":" << s.published << ",\"updated\":" << s.updated << ",\"queueDepth\":" << s.queueDepth
+             << ",\"maxQueueDepth\":" << s.maxQueueDepth << ",\"onMessageNs\":";
+        s.onMessage.WriteJson(_out);
+        _out << "}";
+    }
+    _out << "],\"listeners\":[";
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        const auto& l = listeners[i];
+        _out << (i ? "," : "") << "{\"name\":\"" << l.name << "\",\"service\":\"" << l.service
+             << "\",\"calls\":" << l.calls << ",\"processAddNs\":";
+        l.processAdd.WriteJson(_out);
+        _out << ",\"updates\":" << l.updates << ",\"processUpdateNs\":";
+        l.processUpdate.WriteJson(_out);
+        _out << "}";
+    }
+    _out << "]}\n";
+}
+
+void MetricsRegistry::Dump(const string& _prefix) const {
+    ofstream table(_prefix + ".txt", ios::trunc);
+    Report(table);
+    ofstream json(_prefix + ".json", ios::trunc);
+    ReportJson(json);
+}
+
+void MetricsRegistry::InstallSignalHandler(int _signal) { signal(_signal, &MetricsRegistry::HandleSignal); }
+
+void MetricsRegistry::HandleSignal(int) { dumpRequested = 1; }
+
+void MetricsRegistry::Poll() const {
+    if (dumpRequested) {
+        dumpRequested = 0;
+        Dump();
+    }
+}
+
+string MetricsRegistry::TypeName(const type_info& _type) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(_type.name(), nullptr, nullptr, &status);
+    string name = (status == 0 && demangled) ? demangled : _type.name();
+    free(demangled);
+    return name;
+}
+
+/**
+ * Monotonic nanosecond clock used to time callbacks.
+ */
+inline uint64_t MetricsNow() {
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#ifdef ENABLE_METRICS
+
+/**
+ * Scope guard recording the inclusive latency of one OnMessage call.
+ * A guard covering a batch records the amortized latency once per message.
+ */
+class MessageTimer {
+   public:
+    explicit MessageTimer(ServiceMetrics& _metrics, uint64_t _messages = 1)
+        : metrics(_metrics), messages(_messages), start(MetricsNow()) {
+        metrics.messages += messages;
+    }
+    ~MessageTimer() {
+        if (messages) metrics.onMessage.Record((MetricsNow() - start) / messages, messages);
+    }
+
+    MessageTimer(const MessageTimer&) = delete;
+    MessageTimer& operator=(const MessageTimer&) = delete;
+
+   private:
+    ServiceMetrics& metrics;
+    uint64_t messages;
+    uint64_t start;
+};
+
+#else
+
+/**
+ * Empty stand-in for MessageTimer when metrics are compiled out. The user-provided destructor makes it a guard
+ * like the real one, so the compiler does not warn of the unused timer at every call site.
+ */
+class MessageTimer {
+   public:
+    ~MessageTimer() {}
+};
+
+#endif
+
+#endif
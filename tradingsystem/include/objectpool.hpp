@@ -0,0 +1,241 @@
+/**
+ * objectpool.hpp
+ * Defines a slab-backed object pool with recycled slots and a reference-counted handle into it.
+ *
+ * Slots are carved out of fixed-size chunks and returned to a free list when the last handle
+ * referring to them goes away, so a steady stream of short-lived payloads reuses the same few
+ * slots instead of allocating (or leaking) a heap object per message.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+template <typename T>
+class PoolPtr;
+
+/**
+ * Pool of T objects stored in chunks of slots that are never returned to the heap until the
+ * pool itself is destroyed. All handles must be released before the pool goes away.
+ */
+template <typename T>
+class ObjectPool {
+   public:
+    // Constructor taking the number of slots allocated per chunk
+    explicit ObjectPool(size_t _chunkSize = 64);
+    ~ObjectPool() = default;
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Construct an object in a recycled slot and return a shared handle to it
+    template <typename... Args>
+    PoolPtr<T> Make(Args&&... _args);
+
+    // Number of objects currently alive
+    size_t GetLiveCount() const;
+
+    // Number of slots allocated so far
+    size_t GetCapacity() const;
+
+    // Number of objects ever constructed by the pool
+    uint64_t GetConstructedCount() const;
+
+    // Process-wide pool used when no owner-specific pool is supplied
+    static ObjectPool& Default();
+
+   private:
+    friend class PoolPtr<T>;
+
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        uint32_t references;
+        Slot* next;
+
+        T* Get() { return reinterpret_cast<T*>(storage); }
+    };
+
+    // Take a slot from the free list, growing by one chunk when it is empty
+    Slot* Acquire();
+
+    // Destroy the object in a slot and put the slot back on the free list
+    void Release(Slot* _slot);
+
+    size_t chunkSize;
+    vector<unique_ptr<Slot[]>> chunks;
+    Slot* freeList;
+    size_t liveCount;
+    uint64_t constructedCount;
+};
+
+/**
+ * Reference-counted handle to an object living in an ObjectPool.
+ * Copies share the object; the slot is recycled when the last copy is destroyed.
+ */
+template <typename T>
+class PoolPtr {
+   public:
+    PoolPtr() = default;
+    PoolPtr(const PoolPtr& _other);
+    PoolPtr(PoolPtr&& _other) noexcept;
+    ~PoolPtr();
+
+    PoolPtr& operator=(const PoolPtr& _other);
+    PoolPtr& operator=(PoolPtr&& _other) noexcept;
+
+    // Access the pooled object
+    T* Get() const;
+    T* operator->() const;
+    T& operator*() const;
+    explicit operator bool() const;
+
+   private:
+    friend class ObjectPool<T>;
+    using Slot = typename ObjectPool<T>::Slot;
+
+    PoolPtr(ObjectPool<T>* _pool, Slot* _slot);
+    void Reset();
+
+    ObjectPool<T>* pool = nullptr;
+    Slot* slot = nullptr;
+};
+
+template <typename T>
+ObjectPool<T>::ObjectPool(size_t _chunkSize)
+    : chunkSize(_chunkSize == 0 ? 1 : _chunkSize), chunks(), freeList(nullptr), liveCount(0), constructedCount(0) {}
+
+template <typename T>
+template <typename... Args>
+PoolPtr<T> ObjectPool<T>::Make(Args&&... _args) {
+    Slot* slot = Acquire();
+    new (slot->storage) T(std::forward<Args>(_args)...);
+    slot->references = 0;
+    ++liveCount;
+    ++constructedCount;
+    return PoolPtr<T>(this, slot);
+}
+
+template <typename T>
+typename ObjectPool<T>::Slot* ObjectPool<T>::Acquire() {
+    if (!freeList) {
+        chunks.emplace_back(new Slot[chunkSize]);
+        Slot* chunk = chunks.back().get();
+        for (size_t i = 0; i < chunkSize; ++i) {
+            chunk[i].next = freeList;
+            freeList = &chunk[i];
+        }
+    }
+    Slot* slot = freeList;
+    freeList = slot->next;
+    return slot;
+}
+
+template <typename T>
+void ObjectPool<T>::Release(Slot* _slot) {
+    _slot->Get()->~T();
+    _slot->next = freeList;
+    freeList = _slot;
+    --liveCount;
+}
+
+template <typename T>
+size_t ObjectPool<T>::GetLiveCount() const {
+    return liveCount;
+}
+
+template <typename T>
+size_t ObjectPool<T>::GetCapacity() const {
+    return chunks.size() * chunkSize;
+}
+
+template <typename T>
+uint64_t ObjectPool<T>::GetConstructedCount() const {
+    return constructedCount;
+}
+
+template <typename T>
+ObjectPool<T>& ObjectPool<T>::Default() {
+    static ObjectPool<T> pool;
+    return pool;
+}
+
+template <typename T>
+PoolPtr<T>::PoolPtr(ObjectPool<T>* _pool, Slot* _slot) : pool(_pool), slot(_slot) {
+    ++slot->references;
+}
+
+template <typename T>
+PoolPtr<T>::PoolPtr(const PoolPtr& _other) : pool(_other.pool), slot(_other.slot) {
+    if (slot) ++slot->references;
+}
+
+template <typename T>
+PoolPtr<T>::PoolPtr(PoolPtr&& _other) noexcept : pool(_other.pool), slot(_other.slot) {
+    _other.pool = nullptr;
+    _other.slot = nullptr;
+}
+
+template <typename T>
+PoolPtr<T>::~PoolPtr() {
+    Reset();
+}
+
+template <typename T>
+PoolPtr<T>& PoolPtr<T>::operator=(const PoolPtr& _other) {
+    if (_other.slot) ++_other.slot->references;
+    Reset();
+    pool = _other.pool;
+    slot = _other.slot;
+    return *this;
+}
+
+template <typename T>
+PoolPtr<T>& PoolPtr<T>::operator=(PoolPtr&& _other) noexcept {
+    if (this != &_other) {
+        Reset();
+        pool = _other.pool;
+        slot = _other.slot;
+        _other.pool = nullptr;
+        _other.slot = nullptr;
+    }
+    return *this;
+}
+
+template <typename T>
+void PoolPtr<T>::Reset() {
+    if (slot && --slot->references == 0) pool->Release(slot);
+    pool = nullptr;
+    slot = nullptr;
+}
+
+template <typename T>
+T* PoolPtr<T>::Get() const {
+    return slot ? slot->Get() : nullptr;
+}
+
+template <typename T>
+T* PoolPtr<T>::operator->() const {
+    return Get();
+}
+
+template <typename T>
+T& PoolPtr<T>::operator*() const {
+    return *Get();
+}
+
+template <typename T>
+PoolPtr<T>::operator bool() const {
+    return slot != nullptr;
+}
+
+#endif
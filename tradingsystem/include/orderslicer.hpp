@@ -0,0 +1,495 @@
+/**
+ * orderslicer.hpp
+ * Defines OrderSlicer, which works parent orders by publishing child orders through the algo
+ * execution service on TWAP, VWAP or iceberg schedules.
+ *
+ * The working state of each parent lives in an ObjectPool slot and embeds a TimerNode, so the next
+ * slice of every parent sits on one TimerWheel. Advancing time only touches parents whose slice has
+ * fallen due, and each slice costs O(1) however many parents are working.
+ *
+ * An iceberg is one child showing the display quantity, with the rest of the parent as hidden quantity.
+ * The venue shows the hidden quantity a display quantity at a time, each from the back of the queue once the
+ * one before has filled, as SimulatedExchange does for any resting order with hidden quantity. The fills of that child, fed back through OnChildFill and
+ * OnChildEnd (by ListenerExchangeToSlicer in slicerfeedback.hpp for a SimulatedExchange), finish the parent
+ * once it has filled completely; a child cancelled or rejected is sent again with what it left open, so the
+ * children of a parent never add up to more than its quantity.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef ORDER_SLICER_HPP
+#define ORDER_SLICER_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "algoexecutionservice.hpp"
+#include "coroutine.hpp"
+#include "marketdataservice.hpp"
+#include "objectpool.hpp"
+#include "timerwheel.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+/**
+ * Schedule on which a parent order is sliced.
+ *   TWAP     equal slices every interval from the start to the end time
+ *   VWAP     slices sized by the market volume seen during each interval against the volume expected
+ *            for the intervals left, finishing by the end time
+ *   ICEBERG  one child showing the display quantity with the rest hidden, the venue showing the next display
+ *            quantity, behind the queue, as each fills; a child cancelled or rejected is sent again with its
+ *            open quantity an interval later
+ */
+enum SliceStrategy { TWAP, VWAP, ICEBERG };
+
+/**
+ * A parent order to be worked in child orders. Times are logical nanoseconds.
+ * T: The product type.
+ */
+template <typename T>
+class ParentOrder {
+   public:
+    // Constructor initializing the order; _endTime is not used by ICEBERG and _displayQuantity only by ICEBERG
+    ParentOrder(const T& _product, const string& _parentOrderId, PricingSide _side, long _quantity, Ticks _limitPrice,
+                SliceStrategy _strategy, uint64_t _startTime, uint64_t _endTime, uint64_t _interval,
+                long _displayQuantity = 0);
+
+    // Retrieve the product of the order
+    const T& GetProduct() const;
+
+    // Retrieve the identifier of the order, carried by its children
+    const string& GetParentOrderId() const;
+
+    // Retrieve the side of the order
+    PricingSide GetSide() const;
+
+    // Retrieve the total quantity to work
+    long GetQuantity() const;
+
+    // Retrieve the price of every child order
+    Ticks GetLimitPrice() const;
+
+    // Retrieve the slicing schedule
+    SliceStrategy GetStrategy() const;
+
+    // Retrieve the time of the first slice
+    uint64_t GetStartTime() const;
+
+    // Retrieve the time by which TWAP and VWAP orders are fully sliced
+    uint64_t GetEndTime() const;
+
+    // Retrieve the time between slices
+    uint64_t GetInterval() const;
+
+    // Retrieve the visible quantity of an iceberg
+    long GetDisplayQuantity() const;
+
+   private:
+    T product;               // Product of the order
+    string parentOrderId;    // Identifier carried by the children
+    PricingSide side;        // Side of the order
+    long quantity;           // Total quantity to work
+    Ticks limitPrice;        // Price of every child
+    SliceStrategy strategy;  // Slicing schedule
+    uint64_t startTime;      // Time of the first slice
+    uint64_t endTime;        // Time by which TWAP and VWAP orders are fully sliced
+    uint64_t interval;       // Time between slices
+    long displayQuantity;    // Visible quantity of an iceberg
+};
+
+template <typename T>
+ParentOrder<T>::ParentOrder(const T& _product, const string& _parentOrderId, PricingSide _side, long _quantity,
+                            Ticks _limitPrice, SliceStrategy _strategy, uint64_t _startTime, uint64_t _endTime,
+                            uint64_t _interval, long _displayQuantity)
+    : product(_product),
+      parentOrderId(_parentOrderId),
+      side(_side),
+      quantity(_quantity),
+      limitPrice(_limitPrice),
+      strategy(_strategy),
+      startTime(_startTime),
+      endTime(_endTime),
+      interval(_interval),
+      displayQuantity(_displayQuantity) {}
+
+template <typename T>
+const T& ParentOrder<T>::GetProduct() const {
+    return product;
+}
+
+template <typename T>
+const string& ParentOrder<T>::GetParentOrderId() const {
+    return parentOrderId;
+}
+
+template <typename T>
+PricingSide ParentOrder<T>::GetSide() const {
+    return side;
+}
+
+template <typename T>
+long ParentOrder<T>::GetQuantity() const {
+    return quantity;
+}
+
+template <typename T>
+Ticks ParentOrder<T>::GetLimitPrice() const {
+    return limitPrice;
+}
+
+template <typename T>
+SliceStrategy ParentOrder<T>::GetStrategy() const {
+    return strategy;
+}
+
+template <typename T>
+uint64_t ParentOrder<T>::GetStartTime() const {
+    return startTime;
+}
+
+template <typename T>
+uint64_t ParentOrder<T>::GetEndTime() const {
+    return endTime;
+}
+
+template <typename T>
+uint64_t ParentOrder<T>::GetInterval() const {
+    return interval;
+}
+
+template <typename T>
+long ParentOrder<T>::GetDisplayQuantity() const {
+    return displayQuantity;
+}
+
+/**
+ * Slicing engine publishing the child orders of working parents through AlgoExecutionService::ExecuteChildOrder.
+ * Register it on the market data service (or a conflator) for VWAP volume: the size at the best bid and
+ * offer of every book received counts as market volume for its product. A child carries the trace of the last
+ * book received for its product, the market it was sent into.
+ * T: The product type.
+ */
+template <typename T>
+class OrderSlicer : public BookDeltaListener<T> {
+   public:
+    // Tick length and slot count of the timer wheel unless configured otherwise: 1 ms ticks, 4.096 s per turn
+    static constexpr uint64_t DEFAULT_RESOLUTION = 1'000'000;
+    static constexpr size_t DEFAULT_SLOTS = 4096;
+
+    // Weight kept by the expected VWAP volume per interval at each slice
+    static constexpr double VOLUME_DECAY = 0.8;
+
+    // Constructor taking the service publishing the children and the timer wheel's tick length and slot count
+    explicit OrderSlicer(AlgoExecutionService<T>& _execution, uint64_t _resolution = DEFAULT_RESOLUTION,
+                         size_t _slots = DEFAULT_SLOTS);
+    ~OrderSlicer();
+
+    OrderSlicer(const OrderSlicer&) = delete;
+    OrderSlicer& operator=(const OrderSlicer&) = delete;
+
+    // Start working a parent order; throws if its identifier is already working or it cannot be sliced
+    void Submit(const ParentOrder<T>& _parent);
+
+    // Stop working a parent order; returns false if it is not working. A resting iceberg child is left as it is.
+    bool Cancel(const string& _parentOrderId);
+
+    // Take the leaves quantity of a fill of a child; an iceberg child left with nothing open finishes its parent
+    // on the next tick
+    void OnChildFill(const string& _orderId, long _leavesQuantity);
+
+    // Take back the open quantity of an iceberg child that has been cancelled or rejected, to send again an
+    // interval later
+    void OnChildEnd(const string& _orderId);
+
+    // Publish every slice that has fallen due by time _now
+    void Advance(uint64_t _now);
+
+    // Advance every tick of logical time until _upstream is closed and empty and no parent is working
+    Task Pump(Scheduler& _scheduler, const BoundedChannel<OrderBook<T>>& _upstream);
+
+    // Quantity of a working parent not yet sent in children; throws if it is not working
+    long GetRemaining(const string& _parentOrderId) const;
+
+    // Number of parents working
+    size_t GetWorkingCount() const;
+
+    // Number of child orders published
+    uint64_t GetChildCount() const;
+
+    // Number of pooled slots allocated for working parents
+    size_t GetStateCapacity() const;
+
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // Listener callback for a book removal
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+   private:
+    /**
+     * Market seen for one product: its cumulative volume and the trace of its last book.
+     */
+    struct Market : Traced {
+        uint64_t volume = 0;
+    };
+
+    /**
+     * Working state of one parent; the timer node comes first so a fired node is the state itself.
+     */
+    struct State : TimerNode {
+        State(const ParentOrder<T>& _parent, const Market* _market);
+
+        ParentOrder<T> parent;
+        const Market* market;          // Market of the parent's product
+        long sent = 0;                 // Quantity sent in children, less what iceberg children ended without filling
+        string clipOrderId;            // Order id of the resting iceberg child, empty when there is none
+        long clipLeaves = 0;           // Quantity of the resting iceberg child still open
+        uint64_t slices;               // Slices from start to end time (TWAP and VWAP)
+        uint64_t slicesLeft;           // Slices left, including the next one
+        uint64_t lastVolume;           // Cumulative volume at the previous slice
+        double expectedVolume = 0;     // Expected volume per interval (VWAP)
+    };
+
+    // Publish the slice of a parent that has fallen due and schedule the next one, or finish the parent
+    void Slice(State& _state);
+
+    // Send what is open of an iceberg as one child unless one is resting, or finish the iceberg once it has filled
+    void Clip(State& _state);
+
+    // Quantity of the slice due now
+    long SliceQuantity(State& _state);
+
+    // Add the top-of-book size of a book to its product's volume and keep the book's trace
+    void AddVolume(const OrderBook<T>& _book);
+
+    AlgoExecutionService<T>& execution;                   // Service publishing the children
+    TimerWheel wheel;                                     // Next slice of every working parent
+    ObjectPool<State> statePool;                          // Storage of the working parents
+    unordered_map<string, PoolPtr<State>> working;        // Working parents by identifier
+    unordered_map<string, Market> markets;                // Market seen by product
+    unordered_map<string, State*> clips;                  // Icebergs by the order id of their resting child
+    uint64_t time = 0;                                    // Time last advanced to
+    uint64_t children = 0;                                // Child orders published
+};
+
+template <typename T>
+OrderSlicer<T>::State::State(const ParentOrder<T>& _parent, const Market* _market)
+    : parent(_parent), market(_market), lastVolume(_market->volume) {
+    uint64_t span = _parent.GetStrategy() == ICEBERG ? 0 : _parent.GetEndTime() - _parent.GetStartTime();
+    slices = max<uint64_t>(1, (span + _parent.GetInterval() - 1) / _parent.GetInterval());
+    slicesLeft = slices;
+}
+
+template <typename T>
+OrderSlicer<T>::OrderSlicer(AlgoExecutionService<T>& _execution, uint64_t _resolution, size_t _slots)
+    : execution(_execution), wheel(_resolution, _slots), statePool(256) {}
+
+template <typename T>
+OrderSlicer<T>::~OrderSlicer() {
+    for (auto& [id, state] : working) wheel.Cancel(state.Get());
+}
+
+template <typename T>
+void OrderSlicer<T>::Submit(const ParentOrder<T>& _parent) {
+    if (_parent.GetQuantity() <= 0) throw std::invalid_argument("Parent order quantity must be positive");
+    if (_parent.GetInterval() == 0) throw std::invalid_argument("Parent order slice interval must be positive");
+    if (_parent.GetStrategy() == ICEBERG ? _parent.GetDisplayQuantity() <= 0
+                                         : _parent.GetEndTime() <= _parent.GetStartTime())
+        throw std::invalid_argument("Parent order cannot be sliced: " + _parent.GetParentOrderId());
+
+    auto [it, inserted] = working.try_emplace(_parent.GetParentOrderId());
+    if (!inserted) throw std::invalid_argument("Parent order already working: " + _parent.GetParentOrderId());
+    it->second = statePool.Make(_parent, &markets[_parent.GetProduct().GetProductId()]);
+    wheel.Schedule(it->second.Get(), _parent.GetStartTime());
+}
+
+template <typename T>
+bool OrderSlicer<T>::Cancel(const string& _parentOrderId) {
+    auto it = working.find(_parentOrderId);
+    if (it == working.end()) return false;
+    wheel.Cancel(it->second.Get());
+    clips.erase(it->second->clipOrderId);
+    working.erase(it);
+    return true;
+}
+
+template <typename T>
+void OrderSlicer<T>::OnChildFill(const string& _orderId, long _leavesQuantity) {
+    auto it = clips.find(_orderId);
+    if (it == clips.end()) return;
+    State& state = *it->second;
+    state.clipLeaves = _leavesQuantity;
+    if (_leavesQuantity > 0) return;
+
+    // Finished from Advance rather than here, so the parent is not erased while the exchange publishes a fill
+    clips.erase(it);
+    state.clipOrderId.clear();
+    wheel.Schedule(&state, time);
+}
+
+template <typename T>
+void OrderSlicer<T>::OnChildEnd(const string& _orderId) {
+    auto it = clips.find(_orderId);
+    if (it == clips.end()) return;
+    State& state = *it->second;
+    state.sent -= state.clipLeaves;
+    state.clipLeaves = 0;
+    clips.erase(it);
+    state.clipOrderId.clear();
+    wheel.Schedule(&state, time + state.parent.GetInterval());
+}
+
+template <typename T>
+void OrderSlicer<T>::Advance(uint64_t _now) {
+    time = max(time, _now);
+    wheel.Advance(_now, [this](TimerNode* _node) { Slice(*static_cast<State*>(_node)); });
+}
+
+template <typename T>
+Task OrderSlicer<T>::Pump(Scheduler& _scheduler, const BoundedChannel<OrderBook<T>>& _upstream) {
+    uint64_t time = 0;
+    while (!_upstream.IsClosed() || _upstream.GetSize() > 0 || !working.empty()) {
+        Advance(time);
+        time += wheel.GetResolution();
+        co_await _scheduler.Yield(time);
+    }
+}
+
+template <typename T>
+void OrderSlicer<T>::Slice(State& _state) {
+    const ParentOrder<T>& parent = _state.parent;
+    if (parent.GetStrategy() == ICEBERG) {
+        Clip(_state);
+        return;
+    }
+
+    long quantity = SliceQuantity(_state);
+    if (quantity > 0) {
+        _state.sent += quantity;
+        ++children;
+        execution.ExecuteChildOrder(parent.GetProduct(), parent.GetSide(), GenerateUniqueId(),
+                                    parent.GetParentOrderId(), LIMIT, parent.GetLimitPrice(), quantity, 0,
+                                    _state.market->GetTrace());
+    }
+
+    if (_state.sent >= parent.GetQuantity()) {
+        // Erasing the handle returns the state's slot to the pool
+        working.erase(parent.GetParentOrderId());
+        return;
+    }
+    wheel.Schedule(&_state, _state.deadline + parent.GetInterval());
+}
+
+template <typename T>
+void OrderSlicer<T>::Clip(State& _state) {
+    const ParentOrder<T>& parent = _state.parent;
+    if (!_state.clipOrderId.empty()) return;
+    if (_state.sent >= parent.GetQuantity()) {
+        working.erase(parent.GetParentOrderId());
+        return;
+    }
+
+    // The child is registered before it is sent, as an exchange without latency fills it within the call
+    long quantity = SliceQuantity(_state);
+    long visible = min(parent.GetDisplayQuantity(), quantity);
+    _state.sent += quantity;
+    _state.clipLeaves = quantity;
+    _state.clipOrderId = GenerateUniqueId();
+    clips[_state.clipOrderId] = &_state;
+    ++children;
+    execution.ExecuteChildOrder(parent.GetProduct(), parent.GetSide(), _state.clipOrderId,
+                                parent.GetParentOrderId(), LIMIT, parent.GetLimitPrice(), visible, quantity - visible,
+                                _state.market->GetTrace());
+}
+
+template <typename T>
+long OrderSlicer<T>::SliceQuantity(State& _state) {
+    const ParentOrder<T>& parent = _state.parent;
+    long remaining = parent.GetQuantity() - _state.sent;
+    switch (parent.GetStrategy()) {
+        case TWAP: {
+            // Cumulative target after this slice is the elapsed share of the total
+            auto done = static_cast<long>(_state.slices - _state.slicesLeft + 1);
+            --_state.slicesLeft;
+            return parent.GetQuantity() * done / static_cast<long>(_state.slices) - _state.sent;
+        }
+        case VWAP: {
+            uint64_t volume = _state.market->volume - _state.lastVolume;
+            _state.lastVolume = _state.market->volume;
+            long quantity = remaining;
+            if (_state.slicesLeft > 1) {
+                // Without a volume history yet, or with no volume at all, fall back to an equal share
+                double expected = _state.expectedVolume * (_state.slicesLeft - 1);
+                double share = expected > 0 ? volume / (volume + expected) : 1.0 / _state.slicesLeft;
+                quantity = static_cast<long>(remaining * share);
+            }
+            _state.expectedVolume = _state.expectedVolume == 0
+                                        ? static_cast<double>(volume)
+                                        : VOLUME_DECAY * _state.expectedVolume + (1 - VOLUME_DECAY) * volume;
+            --_state.slicesLeft;
+            return quantity;
+        }
+        case ICEBERG:
+            return remaining;
+    }
+    return 0;
+}
+
+template <typename T>
+long OrderSlicer<T>::GetRemaining(const string& _parentOrderId) const {
+    auto it = working.find(_parentOrderId);
+    if (it == working.end()) throw std::invalid_argument("Parent order not working: " + _parentOrderId);
+    return it->second->parent.GetQuantity() - it->second->sent;
+}
+
+template <typename T>
+size_t OrderSlicer<T>::GetWorkingCount() const {
+    return working.size();
+}
+
+template <typename T>
+uint64_t OrderSlicer<T>::GetChildCount() const {
+    return children;
+}
+
+template <typename T>
+size_t OrderSlicer<T>::GetStateCapacity() const {
+    return statePool.GetCapacity();
+}
+
+template <typename T>
+void OrderSlicer<T>::AddVolume(const OrderBook<T>& _book) {
+    Market& market = markets[_book.GetProduct().GetProductId()];
+    if (!_book.GetBidStack().empty()) market.volume += _book.GetBestBid().GetQuantity();
+    if (!_book.GetOfferStack().empty()) market.volume += _book.GetBestOffer().GetQuantity();
+    market.SetTrace(_book.GetTrace());
+}
+
+template <typename T>
+void OrderSlicer<T>::ProcessAdd(OrderBook<T>& _data) {
+    AddVolume(_data);
+}
+
+template <typename T>
+void OrderSlicer<T>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T>
+void OrderSlicer<T>::ProcessUpdate(OrderBook<T>& _data) {
+    AddVolume(_data);
+}
+
+template <typename T>
+void OrderSlicer<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    if (_delta.ChangedTop(_book)) AddVolume(_book);
+}
+
+#endif
@@ -0,0 +1,354 @@
+/**
+ * orderstore.hpp
+ * Defines OrderStore, the lifecycle state of execution orders keyed by order identifier.
+ *
+ * Records live in a dense slot table with a free list, found through an index from order identifier
+ * to slot, so every lifecycle event is one hash lookup. Open orders of each product are linked through
+ * their slots, so they are enumerated without visiting other products or finished orders. An order
+ * that finishes stays queryable until the most recent finished orders beyond the retention limit push
+ * it out and its slot is reused.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef ORDER_STORE_HPP
+#define ORDER_STORE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "algoexecutionservice.hpp"
+
+using namespace std;
+
+/**
+ * Lifecycle state of an execution order.
+ */
+enum OrderState {
+    ORDER_NEW,
+    ORDER_ACKNOWLEDGED,
+    ORDER_PARTIALLY_FILLED,
+    ORDER_FILLED,
+    ORDER_CANCELLED,
+    ORDER_REJECTED
+};
+
+// Number of values of OrderState
+constexpr size_t ORDER_STATE_COUNT = 6;
+
+// Transitions allowed from each state (rows) to each state (columns)
+constexpr bool ORDER_TRANSITIONS[ORDER_STATE_COUNT][ORDER_STATE_COUNT] = {
+    // NEW   ACK    PART   FILLED CANCEL REJECT
+    {false, true, true, true, true, true},       // NEW
+    {false, false, true, true, true, false},     // ACKNOWLEDGED
+    {false, false, true, true, true, false},     // PARTIALLY_FILLED
+    {false, false, false, false, false, false},  // FILLED
+    {false, false, false, false, false, false},  // CANCELLED
+    {false, false, false, false, false, false},  // REJECTED
+};
+
+// Whether an order may move from state _from to state _to
+constexpr bool CanTransition(OrderState _from, OrderState _to) {
+    return ORDER_TRANSITIONS[_from][_to];
+}
+
+// Whether an order in state _state can still trade
+constexpr bool IsOpen(OrderState _state) {
+    return _state == ORDER_NEW || _state == ORDER_ACKNOWLEDGED || _state == ORDER_PARTIALLY_FILLED;
+}
+
+// Name of an order state
+string OrderStateName(OrderState _state);
+
+string OrderStateName(OrderState _state) {
+    switch (_state) {
+        case ORDER_NEW:
+            return "NEW";
+        case ORDER_ACKNOWLEDGED:
+            return "ACKNOWLEDGED";
+        case ORDER_PARTIALLY_FILLED:
+            return "PARTIALLY_FILLED";
+        case ORDER_FILLED:
+            return "FILLED";
+        case ORDER_CANCELLED:
+            return "CANCELLED";
+        case ORDER_REJECTED:
+            return "REJECTED";
+    }
+    throw std::invalid_argument("Unknown order state");
+}
+
+/**
+ * An execution order with its lifecycle state.
+ * T: The product type.
+ */
+template <typename T>
+struct OrderRecord {
+    ExecutionOrder<T> order;       // Order as sent
+    OrderState state = ORDER_NEW;  // Lifecycle state
+    long filledQuantity = 0;       // Quantity filled so far
+    long leavesQuantity = 0;       // Quantity still open
+};
+
+/**
+ * Lifecycle state of execution orders keyed by order identifier. Events on unknown orders throw
+ * std::out_of_range and events the state machine does not allow throw std::logic_error. Records
+ * returned stay valid until the next Add.
+ * T: The product type.
+ */
+template <typename T>
+class OrderStore {
+   public:
+    static constexpr size_t DEFAULT_RETAINED = 4096;
+
+    // Constructor taking the number of finished orders kept queryable
+    explicit OrderStore(size_t _retained = DEFAULT_RETAINED);
+
+    OrderStore(const OrderStore&) = delete;
+    OrderStore& operator=(const OrderStore&) = delete;
+
+    // Record a new order; throws if its identifier is already known
+    const OrderRecord<T>& Add(const ExecutionOrder<T>& _order);
+
+    // Record the venue's acknowledgement of an order
+    const OrderRecord<T>& Acknowledge(const string& _orderId);
+
+    // Record a fill of _quantity; the order is partially filled or filled depending on what is left
+    const OrderRecord<T>& ApplyFill(const string& _orderId, long _quantity);
+
+    // Record an amendment of an open order to a new price and quantity; the new quantity caps what is left open
+    const OrderRecord<T>& Amend(const ExecutionOrder<T>& _order);
+
+    // Record the cancellation of what is left of an order
+    const OrderRecord<T>& Cancel(const string& _orderId);
+
+    // Record the venue's rejection of an order
+    const OrderRecord<T>& Reject(const string& _orderId);
+
+    // Retrieve an order; throws if it is unknown
+    const OrderRecord<T>& Get(const string& _orderId) const;
+
+    // Retrieve an order, or nullptr if it is unknown
+    const OrderRecord<T>* Find(const string& _orderId) const;
+
+    // Call _visit(record) for every open order of a product, most recent first
+    template <typename F>
+    void ForEachOpen(const string& _productId, F&& _visit) const;
+
+    // Number of open orders of a product
+    size_t GetOpenCount(const string& _productId) const;
+
+    // Number of open orders
+    size_t GetOpenCount() const;
+
+    // Number of orders held, open and finished
+    size_t GetSize() const;
+
+    // Number of slots allocated
+    size_t GetCapacity() const;
+
+   private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    /**
+     * A slot of the table, linked into its product's open list while the order is open.
+     */
+    struct Slot {
+        OrderRecord<T> record;
+        uint32_t prev = NONE;  // Previous open order of the product
+        uint32_t next = NONE;  // Next open order of the product
+    };
+
+    /**
+     * Open orders of one product.
+     */
+    struct OpenList {
+        uint32_t head = NONE;
+        size_t count = 0;
+    };
+
+    // Slot of an order; throws if it is unknown
+    uint32_t SlotOf(const string& _orderId) const;
+
+    // Move an order to a new state; throws if the transition is not allowed
+    void Transition(uint32_t _slot, OrderState _state);
+
+    // Free the slots of the oldest finished orders beyond the retention limit
+    void Retire();
+
+    size_t retained;                              // Finished orders kept queryable
+    vector<Slot> slots;                           // Slot table
+    vector<uint32_t> freeSlots;                   // Slots not in use
+    unordered_map<string, uint32_t> index;        // Slot of each order identifier
+    unordered_map<string, OpenList> open;         // Open orders of each product
+    deque<uint32_t> finished;                     // Slots of finished orders, oldest first
+    size_t openCount = 0;                         // Open orders over all products
+};
+
+template <typename T>
+OrderStore<T>::OrderStore(size_t _retained) : retained(_retained) {}
+
+template <typename T>
+const OrderRecord<T>& OrderStore<T>::Add(const ExecutionOrder<T>& _order) {
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+    if (!index.emplace(_order.GetOrderId(), slot).second) {
+        freeSlots.push_back(slot);
+        throw std::invalid_argument("Order " + _order.GetOrderId() + " is already known");
+    }
+
+    Slot& s = slots[slot];
+    s.record = OrderRecord<T>{_order, ORDER_NEW, 0, _order.GetVisibleQuantity() + _order.GetHiddenQuantity()};
+
+    // Link at the head of the product's open list
+    OpenList& list = open[_order.GetProduct().GetProductId()];
+    s.prev = NONE;
+    s.next = list.head;
+    if (list.head != NONE) slots[list.head].prev = slot;
+    list.head = slot;
+    ++list.count;
+    ++openCount;
+    return s.record;
+}
+
+template <typename T>
+const OrderRecord<T>& OrderStore<T>::Acknowledge(const string& _orderId) {
+    uint32_t slot = SlotOf(_orderId);
+    Transition(slot, ORDER_ACKNOWLEDGED);
+    return slots[slot].record;
+}
+
+template <typename T>
+const OrderRecord<T>& OrderStore<T>::ApplyFill(const string& _orderId, long _quantity) {
+    uint32_t slot = SlotOf(_orderId);
+    OrderRecord<T>& record = slots[slot].record;
+    if (_quantity <= 0 || _quantity > record.leavesQuantity) {
+        throw std::logic_error("Fill of " + to_string(_quantity) + " on order " + _orderId + " with " +
+                               to_string(record.leavesQuantity) + " open");
+    }
+    Transition(slot, _quantity == record.leavesQuantity ? ORDER_FILLED : ORDER_PARTIALLY_FILLED);
+    record.filledQuantity += _quantity;
+    record.leavesQuantity -= _quantity;
+    return record;
+}
+
+template <typename T>
+const OrderRecord<T>& OrderStore<T>::Amend(const ExecutionOrder<T>& _order) {
+    uint32_t slot = SlotOf(_order.GetOrderId());
+    OrderRecord<T>& record = slots[slot].record;
+    if (!IsOpen(record.state)) {
+        throw std::logic_error("Order " + _order.GetOrderId() + " cannot be amended when " +
+                               OrderStateName(record.state));
+    }
+    record.order = _order;
+    record.leavesQuantity = min(record.leavesQuantity, _order.GetVisibleQuantity() + _order.GetHiddenQuantity());
+    return record;
+}
+
+template <typename T>
+const OrderRecord<T>& OrderStore<T>::Cancel(const string& _orderId) {
+    uint32_t slot = SlotOf(_orderId);
+    Transition(slot, ORDER_CANCELLED);
+    slots[slot].record.leavesQuantity = 0;
+    return slots[slot].record;
+}
+
+template <typename T>
+const OrderRecord<T>& OrderStore<T>::Reject(const string& _orderId) {
+    uint32_t slot = SlotOf(_orderId);
+    Transition(slot, ORDER_REJECTED);
+    slots[slot].record.leavesQuantity = 0;
+    return slots[slot].record;
+}
+
+template <typename T>
+const OrderRecord<T>& OrderStore<T>::Get(const string& _orderId) const {
+    return slots[SlotOf(_orderId)].record;
+}
+
+template <typename T>
+const OrderRecord<T>* OrderStore<T>::Find(const string& _orderId) const {
+    auto it = index.find(_orderId);
+    return it == index.end() ? nullptr : &slots[it->second].record;
+}
+
+template <typename T>
+template <typename F>
+void OrderStore<T>::ForEachOpen(const string& _productId, F&& _visit) const {
+    auto it = open.find(_productId);
+    if (it == open.end()) return;
+    for (uint32_t slot = it->second.head; slot != NONE; slot = slots[slot].next) _visit(slots[slot].record);
+}
+
+template <typename T>
+size_t OrderStore<T>::GetOpenCount(const string& _productId) const {
+    auto it = open.find(_productId);
+    return it == open.end() ? 0 : it->second.count;
+}
+
+template <typename T>
+size_t OrderStore<T>::GetOpenCount() const {
+    return openCount;
+}
+
+template <typename T>
+size_t OrderStore<T>::GetSize() const {
+    return index.size();
+}
+
+template <typename T>
+size_t OrderStore<T>::GetCapacity() const {
+    return slots.size();
+}
+
+template <typename T>
+uint32_t OrderStore<T>::SlotOf(const string& _orderId) const {
+    auto it = index.find(_orderId);
+    if (it == index.end()) throw std::out_of_range("Order " + _orderId + " is unknown");
+    return it->second;
+}
+
+template <typename T>
+void OrderStore<T>::Transition(uint32_t _slot, OrderState _state) {
+    Slot& s = slots[_slot];
+    OrderState from = s.record.state;
+    if (!CanTransition(from, _state)) {
+        throw std::logic_error("Order " + s.record.order.GetOrderId() + " cannot move from " + OrderStateName(from) +
+                               " to " + OrderStateName(_state));
+    }
+    s.record.state = _state;
+    if (IsOpen(_state)) return;
+
+    // Unlink from the product's open list and queue the slot for retirement
+    OpenList& list = open[s.record.order.GetProduct().GetProductId()];
+    if (s.prev != NONE) slots[s.prev].next = s.next;
+    else list.head = s.next;
+    if (s.next != NONE) slots[s.next].prev = s.prev;
+    s.prev = s.next = NONE;
+    --list.count;
+    --openCount;
+    finished.push_back(_slot);
+    Retire();
+}
+
+template <typename T>
+void OrderStore<T>::Retire() {
+    while (finished.size() > retained) {
+        uint32_t slot = finished.front();
+        finished.pop_front();
+        index.erase(slots[slot].record.order.GetOrderId());
+        freeSlots.push_back(slot);
+    }
+}
+
+#endif
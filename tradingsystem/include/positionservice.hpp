@@ -11,6 +11,7 @@
 #include <string>
 #include <map>
 #include <vector>
+#include "recordwriter.hpp"
 #include "soa.hpp"
 #include "tradebookingservice.hpp"
 
@@ -22,7 +23,7 @@ using namespace std;
  * @tparam T The type of the product.
  */
 template<typename T>
-class Position
+class Position : public Traced
 {
 public:
     // Default constructor
@@ -49,6 +50,9 @@ public:
     // Convert attributes to string representations
     vector<string> ToStrings() const;
 
+    // Write attributes as the fields of a persisted record
+    void Write(RecordWriter& _writer) const;
+
 private:
     T product;                       ///< Product associated with the position
     map<string, long> positions;     ///< Map of book identifiers to position quantities
@@ -112,6 +116,16 @@ vector<string> Position<T>::ToStrings() const
     return _strings;
 }
 
+template<typename T>
+void Position<T>::Write(RecordWriter& _writer) const
+{
+    _writer.Field(product.GetProductId());
+    for (auto& p : positions)
+    {
+        _writer.Field(p.first).Field(p.second);
+    }
+}
+
 template<typename T>
 class ListenerPosToTradeBooking;
 
@@ -127,6 +141,7 @@ private:
     map<string, Position<T>> positions;                              ///< Map of product identifiers to positions
     vector<ServiceListener<Position<T>>*> listeners;                 ///< List of listeners for service events
     ListenerPosToTradeBooking<T>* listener;                     ///< Listener for trade booking service
+    vector<Position<T>> positionBatch;                               ///< Reused buffer of snapshots published by AddTrades
 
 public:
     // Constructor and destructor
@@ -150,6 +165,9 @@ public:
 
     // Add a trade to update positions
     virtual void AddTrade(const Trade<T>& _trade);
+
+    // Add a batch of trades, publishing one position snapshot per trade in a single batch
+    virtual void AddTrades(span<Trade<T>> _trades);
 };
 
 // Implementation of PositionService class methods
@@ -173,6 +191,7 @@ Position<T>& PositionService<T>::GetData(string _key)
 template<typename T>
 void PositionService<T>::OnMessage(Position<T>& _data)
 {
+    auto timer = this->TrackMessage();
     positions[_data.GetProduct().GetProductId()] = _data;
 }
 
@@ -199,7 +218,6 @@ void PositionService<T>::AddTrade(const Trade<T>& _trade)
 {
     T _product = _trade.GetProduct();
     string _productId = _product.GetProductId();
-    double _price = _trade.GetPrice();
     string _book = _trade.GetBook();
     long _quantity = _trade.GetQuantity();
     Side _side = _trade.GetSide();
@@ -222,12 +240,42 @@ void PositionService<T>::AddTrade(const Trade<T>& _trade)
         _quantity = p.second;
         _positionTo.AddPosition(_book, _quantity);
     }
+    _positionTo.SetTrace(_trade.GetTrace());
+    LatencyTracer::Instance().Record(TRACE_POSITION, _positionTo.GetTrace());
     positions[_productId] = _positionTo;
 
-    for (auto& l : listeners)
+    this->NotifyAdd(listeners, _positionTo);
+}
+
+template<typename T>
+void PositionService<T>::AddTrades(span<Trade<T>> _trades)
+{
+    positionBatch.clear();
+    positionBatch.reserve(_trades.size());
+
+    // Trades for one product tend to arrive together, so keep the last map entry at hand
+    auto _entry = positions.end();
+    for (auto& _trade : _trades)
     {
-        l->ProcessAdd(_positionTo);
+        const string& _productId = _trade.GetProduct().GetProductId();
+        if (_entry == positions.end() || _entry->first != _productId)
+        {
+            _entry = positions.find(_productId);
+            if (_entry == positions.end())
+            {
+                _entry = positions.emplace(_productId, Position<T>(_trade.GetProduct())).first;
+            }
+        }
+
+        string _book = _trade.GetBook();
+        long _quantity = _trade.GetQuantity();
+        _entry->second.AddPosition(_book, _trade.GetSide() == BUY ? _quantity : -_quantity);
+        _entry->second.SetTrace(_trade.GetTrace());
+        LatencyTracer::Instance().Record(TRACE_POSITION, _entry->second.GetTrace());
+        positionBatch.push_back(_entry->second);
     }
+
+    this->NotifyAddBatch(listeners, positionBatch);
 }
 
 /**
@@ -249,6 +297,9 @@ public:
     // Process add events from the trade booking service
     void ProcessAdd(Trade<T>& _data);
 
+    // Process a batch of add events from the trade booking service
+    void ProcessAddBatch(span<Trade<T>> _data) override;
+
     // Process remove events (unused in this context)
     void ProcessRemove(Trade<T>& _data);
 
@@ -269,6 +320,12 @@ void ListenerPosToTradeBooking<T>::ProcessAdd(Trade<T>& _data)
     service->AddTrade(_data);
 }
 
+template<typename T>
+void ListenerPosToTradeBooking<T>::ProcessAddBatch(span<Trade<T>> _data)
+{
+    service->AddTrades(_data);
+}
+
 template<typename T>
 void ListenerPosToTradeBooking<T>::ProcessRemove(Trade<T>& _data) {}
 
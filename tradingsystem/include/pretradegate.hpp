@@ -0,0 +1,507 @@
+/**
+ * pretradegate.hpp
+ * Defines PreTradeGate, the pre-trade risk check on the hop from AlgoExecutionService to ExecutionService.
+ *
+ * Register the gate on the algo execution service in place of the execution service's listener, and that
+ * listener on the gate; orders that pass every check are forwarded and the others are dropped. Amendments
+ * are checked as orders of their new price and quantity, and one that fails is dropped, leaving the order
+ * as it was. Every order or amendment dropped is reported as ORDER_REJECTED to the status listeners, so
+ * that the algo that sent it does not take it to be working. An order is checked against, in order:
+ *   position    the product's aggregate position after the order fills in full
+ *   book        the product's position in each book after the order, as the trade may be booked in any
+ *   PV01        the product's PV01 after the order
+ *   price band  the distance of the order's price from the mid of the consolidated book
+ *   rate        the orders passed for the product in the current rate window, windows being consecutive
+ *               multiples of the window length
+ * A BID order sells and an OFFER order buys, as the trade booking service books them. An order reducing
+ * the product's aggregate position skips the position, book and PV01 checks, so that books pushed apart
+ * by the booking rotation cannot stop the product from trading back towards flat.
+ *
+ * The check reads per-product counters that the gate's listeners on the position, risk and market data
+ * services keep up to date with relaxed atomic stores; the counters of each product are laid out on their
+ * own cache lines and the product index is built once at construction, so the check takes no lock and
+ * allocates nothing.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef PRE_TRADE_GATE_HPP
+#define PRE_TRADE_GATE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "algoexecutionservice.hpp"
+#include "coroutine.hpp"
+#include "marketdataservice.hpp"
+#include "positionservice.hpp"
+#include "riskservice.hpp"
+#include "simulatedexchange.hpp"
+#include "soa.hpp"
+
+using namespace std;
+
+/**
+ * Outcome of a pre-trade check.
+ */
+enum PreTradeResult {
+    PRE_TRADE_PASSED,
+    PRE_TRADE_UNKNOWN_PRODUCT,
+    PRE_TRADE_POSITION_LIMIT,
+    PRE_TRADE_BOOK_LIMIT,
+    PRE_TRADE_PV01_LIMIT,
+    PRE_TRADE_PRICE_BAND,
+    PRE_TRADE_RATE_LIMIT
+};
+
+// Number of values of PreTradeResult
+constexpr size_t PRE_TRADE_RESULT_COUNT = 7;
+
+// Name of a pre-trade check outcome
+string PreTradeResultName(PreTradeResult _result);
+
+string PreTradeResultName(PreTradeResult _result) {
+    switch (_result) {
+        case PRE_TRADE_PASSED:
+            return "PASSED";
+        case PRE_TRADE_UNKNOWN_PRODUCT:
+            return "UNKNOWN_PRODUCT";
+        case PRE_TRADE_POSITION_LIMIT:
+            return "POSITION_LIMIT";
+        case PRE_TRADE_BOOK_LIMIT:
+            return "BOOK_LIMIT";
+        case PRE_TRADE_PV01_LIMIT:
+            return "PV01_LIMIT";
+        case PRE_TRADE_PRICE_BAND:
+            return "PRICE_BAND";
+        case PRE_TRADE_RATE_LIMIT:
+            return "RATE_LIMIT";
+    }
+    throw std::invalid_argument("Unknown pre-trade result");
+}
+
+/**
+ * Limits enforced by a PreTradeGate, each per product.
+ */
+struct PreTradeLimits {
+    long maxPosition;              // Largest absolute aggregate position
+    long maxBookPosition;          // Largest absolute position in any one book
+    double maxPV01;                // Largest absolute PV01
+    Ticks priceBand;               // Largest distance of an order's price from the mid
+    uint32_t maxOrdersPerWindow;   // Orders passed per rate window, below 2^24
+    uint64_t rateWindow;           // Length of the rate window in nanoseconds
+};
+
+template <typename T>
+class ListenerGateToPosition;
+
+template <typename T>
+class ListenerGateToRisk;
+
+template <typename T>
+class ListenerGateToMarketData;
+
+/**
+ * Pre-trade risk check forwarding the algo executions that pass it to its downstream listeners.
+ * T: The product type.
+ */
+template <typename T>
+class PreTradeGate : public ServiceListener<AlgoExecution<T>> {
+   public:
+    // Largest number of books a gate tracks per product
+    static constexpr size_t MAX_BOOKS = 8;
+
+    // Bits of a product's rate word counting the orders passed in its window; the bits above number the window
+    static constexpr int WINDOW_COUNT_BITS = 24;
+
+    // Constructor taking the service whose consolidated books give the mid, the limits, the products traded
+    // and the books trades are booked in
+    PreTradeGate(BondMarketDataService<T>& _marketData, const PreTradeLimits& _limits,
+                 const vector<string>& _productIds, const vector<string>& _books = {"TRSY1", "TRSY2", "TRSY3"});
+    virtual ~PreTradeGate();
+
+    PreTradeGate(const PreTradeGate&) = delete;
+    PreTradeGate& operator=(const PreTradeGate&) = delete;
+
+    // Check an algo execution and forward it downstream if it passes
+    void ProcessAdd(AlgoExecution<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(AlgoExecution<T>& _data);
+
+    // Check an amendment of an algo execution and forward it downstream if it passes
+    void ProcessUpdate(AlgoExecution<T>& _data);
+
+    // Add a downstream listener
+    void AddListener(ServiceListener<AlgoExecution<T>>* _listener);
+
+    // Add a listener told of each order and amendment the gate rejects, as ORDER_REJECTED
+    void AddStatusListener(OrderStatusListener<T>* _listener);
+
+    // Use the logical time of a scheduler for the rate windows instead of the steady clock
+    void SetClock(const Scheduler* _clock);
+
+    // Check an order against the limits; counts it towards the rate limit if it passes
+    PreTradeResult Check(const ExecutionOrder<T>& _order);
+
+    // Retrieve the listener to register on the position service
+    ListenerGateToPosition<T>* GetPositionListener();
+
+    // Retrieve the listener to register on the risk service
+    ListenerGateToRisk<T>* GetRiskListener();
+
+    // Retrieve the listener to register on the market data service
+    ListenerGateToMarketData<T>* GetMarketDataListener();
+
+    // Number of algo executions checked with a given outcome
+    uint64_t GetCount(PreTradeResult _result) const;
+
+    // Record a position published by the position service
+    void OnPosition(Position<T>& _position);
+
+    // Record a PV01 published by the risk service
+    void OnRisk(const PV01<T>& _pv01);
+
+    // Record the mid of a product's consolidated book
+    void OnBook(const string& _productId);
+
+   private:
+    /**
+     * Counters of one product, alone on their cache lines.
+     */
+    struct alignas(64) Counters {
+        atomic<long> position{0};                   // Aggregate position
+        array<atomic<long>, MAX_BOOKS> books{};     // Position per book
+        atomic<double> pv01{0};                     // PV01 of the position
+        atomic<double> unitPV01{0};                 // PV01 per unit of position
+        atomic<int64_t> midTwice{0};                // Best bid plus best offer, in ticks
+        atomic<bool> hasMid{false};                 // Whether both sides have been seen
+        atomic<uint64_t> window{0};                 // Rate window and the orders passed in it
+    };
+
+    // Current time for the rate windows
+    uint64_t Now() const;
+
+    // Check an order, count the outcome and tell the status listeners if it is rejected; true if it passed
+    bool Pass(const ExecutionOrder<T>& _order);
+
+    BondMarketDataService<T>& marketData;                         // Source of the mids
+    PreTradeLimits limits;                                        // Limits enforced
+    vector<string> books;                                         // Books tracked, by index
+    unique_ptr<Counters[]> counters;                              // Counters per product
+    unordered_map<string, Counters*> index;                       // Counters of each product, fixed after construction
+    const Scheduler* clock = nullptr;                             // Source of logical time, if any
+    array<atomic<uint64_t>, PRE_TRADE_RESULT_COUNT> results{};    // Executions checked per outcome
+    vector<ServiceListener<AlgoExecution<T>>*> listeners;         // Downstream listeners
+    vector<OrderStatusListener<T>*> statusListeners;              // Listeners on rejected orders
+    ListenerGateToPosition<T>* positionListener;                  // Listener on the position service
+    ListenerGateToRisk<T>* riskListener;                          // Listener on the risk service
+    ListenerGateToMarketData<T>* marketDataListener;              // Listener on the market data service
+};
+
+template <typename T>
+PreTradeGate<T>::PreTradeGate(BondMarketDataService<T>& _marketData, const PreTradeLimits& _limits,
+                              const vector<string>& _productIds, const vector<string>& _books)
+    : marketData(_marketData),
+      limits(_limits),
+      books(_books),
+      counters(new Counters[_productIds.size()]),
+      positionListener(new ListenerGateToPosition<T>(this)),
+      riskListener(new ListenerGateToRisk<T>(this)),
+      marketDataListener(new ListenerGateToMarketData<T>(this)) {
+    if (_books.size() > MAX_BOOKS) throw std::invalid_argument("A pre-trade gate tracks at most 8 books");
+    if (_limits.rateWindow == 0) throw std::invalid_argument("Rate window must be positive");
+    if (_limits.maxOrdersPerWindow >= 1u << WINDOW_COUNT_BITS) {
+        throw std::invalid_argument("A pre-trade gate passes fewer than 2^24 orders per rate window");
+    }
+    for (size_t i = 0; i < _productIds.size(); ++i) {
+        index.emplace(_productIds[i], &counters[i]);
+        counters[i].unitPV01.store(PV01Info(_productIds[i]), memory_order_relaxed);
+    }
+}
+
+template <typename T>
+PreTradeGate<T>::~PreTradeGate() {
+    delete positionListener;
+    delete riskListener;
+    delete marketDataListener;
+}
+
+template <typename T>
+void PreTradeGate<T>::ProcessAdd(AlgoExecution<T>& _data) {
+    if (!Pass(*_data.RetrieveExecutionOrder())) return;
+    for (auto& l : listeners) l->ProcessAdd(_data);
+}
+
+template <typename T>
+void PreTradeGate<T>::ProcessRemove(AlgoExecution<T>& _data) {}
+
+template <typename T>
+void PreTradeGate<T>::ProcessUpdate(AlgoExecution<T>& _data) {
+    if (!Pass(*_data.RetrieveExecutionOrder())) return;
+    for (auto& l : listeners) l->ProcessUpdate(_data);
+}
+
+template <typename T>
+bool PreTradeGate<T>::Pass(const ExecutionOrder<T>& _order) {
+    PreTradeResult result = Check(_order);
+    results[result].fetch_add(1, memory_order_relaxed);
+    if (result == PRE_TRADE_PASSED) return true;
+    for (auto& l : statusListeners) l->ProcessStatus(_order, ORDER_REJECTED);
+    return false;
+}
+
+template <typename T>
+void PreTradeGate<T>::AddListener(ServiceListener<AlgoExecution<T>>* _listener) {
+    listeners.push_back(_listener);
+}
+
+template <typename T>
+void PreTradeGate<T>::AddStatusListener(OrderStatusListener<T>* _listener) {
+    statusListeners.push_back(_listener);
+}
+
+template <typename T>
+void PreTradeGate<T>::SetClock(const Scheduler* _clock) {
+    clock = _clock;
+}
+
+template <typename T>
+PreTradeResult PreTradeGate<T>::Check(const ExecutionOrder<T>& _order) {
+    auto it = index.find(_order.GetProduct().GetProductId());
+    if (it == index.end()) return PRE_TRADE_UNKNOWN_PRODUCT;
+    Counters& c = *it->second;
+
+    long quantity = _order.GetVisibleQuantity() + _order.GetHiddenQuantity();
+    long delta = _order.GetPriceSide() == BID ? -quantity : quantity;
+
+    // Orders reducing the position are never held back by the exposure limits
+    long position = c.position.load(memory_order_relaxed);
+    if (labs(position + delta) >= labs(position)) {
+        if (labs(position + delta) > limits.maxPosition) return PRE_TRADE_POSITION_LIMIT;
+        for (size_t b = 0; b < books.size(); ++b) {
+            if (labs(c.books[b].load(memory_order_relaxed) + delta) > limits.maxBookPosition) return PRE_TRADE_BOOK_LIMIT;
+        }
+        double pv01 = c.pv01.load(memory_order_relaxed) + c.unitPV01.load(memory_order_relaxed) * delta;
+        if (abs(pv01) > limits.maxPV01) return PRE_TRADE_PV01_LIMIT;
+    }
+
+    // Compared at twice the scale so a mid between two ticks stays exact
+    if (c.hasMid.load(memory_order_acquire)) {
+        int64_t distance = 2 * _order.GetPrice().Count() - c.midTwice.load(memory_order_relaxed);
+        if (abs(distance) > 2 * limits.priceBand.Count()) return PRE_TRADE_PRICE_BAND;
+    }
+
+    // The window and its count share one word: rolling it to a new window with zero orders is one
+    // compare-exchange, and taking a place in the window one fetch_add whose result is the orders before.
+    // Windows are compared by their signed difference, so the word may wrap and a thread that read the
+    // clock late never rolls it back.
+    constexpr uint64_t COUNT_MASK = (1ULL << WINDOW_COUNT_BITS) - 1;
+    uint64_t window = (Now() / limits.rateWindow) << WINDOW_COUNT_BITS;
+    uint64_t current = c.window.load(memory_order_relaxed);
+    while (static_cast<int64_t>(window - (current & ~COUNT_MASK)) > 0 &&
+           !c.window.compare_exchange_weak(current, window, memory_order_relaxed)) {
+    }
+    uint64_t before = c.window.fetch_add(1, memory_order_relaxed);
+    if ((before & COUNT_MASK) >= limits.maxOrdersPerWindow) {
+        // Give the place back so that rejected orders cannot carry the count into the window bits
+        c.window.fetch_sub(1, memory_order_relaxed);
+        return PRE_TRADE_RATE_LIMIT;
+    }
+    return PRE_TRADE_PASSED;
+}
+
+template <typename T>
+ListenerGateToPosition<T>* PreTradeGate<T>::GetPositionListener() {
+    return positionListener;
+}
+
+template <typename T>
+ListenerGateToRisk<T>* PreTradeGate<T>::GetRiskListener() {
+    return riskListener;
+}
+
+template <typename T>
+ListenerGateToMarketData<T>* PreTradeGate<T>::GetMarketDataListener() {
+    return marketDataListener;
+}
+
+template <typename T>
+uint64_t PreTradeGate<T>::GetCount(PreTradeResult _result) const {
+    return results[_result].load(memory_order_relaxed);
+}
+
+template <typename T>
+void PreTradeGate<T>::OnPosition(Position<T>& _position) {
+    auto it = index.find(_position.GetProduct().GetProductId());
+    if (it == index.end()) return;
+    Counters& c = *it->second;
+    c.position.store(_position.GetAggregatePosition(), memory_order_relaxed);
+
+    // Position::GetPosition would add the books it has not seen, so read from a copy
+    map<string, long> positions = _position.GetPositions();
+    for (size_t b = 0; b < books.size(); ++b) {
+        auto book = positions.find(books[b]);
+        c.books[b].store(book == positions.end() ? 0 : book->second, memory_order_relaxed);
+    }
+}
+
+template <typename T>
+void PreTradeGate<T>::OnRisk(const PV01<T>& _pv01) {
+    auto it = index.find(_pv01.GetProduct().GetProductId());
+    if (it == index.end()) return;
+    it->second->unitPV01.store(_pv01.GetPV01(), memory_order_relaxed);
+    it->second->pv01.store(_pv01.GetPV01() * _pv01.GetQuantity(), memory_order_relaxed);
+}
+
+template <typename T>
+void PreTradeGate<T>::OnBook(const string& _productId) {
+    auto it = index.find(_productId);
+    if (it == index.end()) return;
+    const ConsolidatedBook<T>& book = marketData.GetConsolidatedBook(_productId);
+    if (book.GetBidLevels().empty() || book.GetOfferLevels().empty()) return;
+    Counters& c = *it->second;
+    c.midTwice.store((book.GetBidLevels().front().price + book.GetOfferLevels().front().price).Count(),
+                     memory_order_relaxed);
+    c.hasMid.store(true, memory_order_release);
+}
+
+template <typename T>
+uint64_t PreTradeGate<T>::Now() const {
+    if (clock) return clock->GetTime();
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Listener updating the position counters of a PreTradeGate from the position service.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerGateToPosition : public ServiceListener<Position<T>> {
+   public:
+    // Constructor taking the gate
+    explicit ListenerGateToPosition(PreTradeGate<T>* _gate);
+    virtual ~ListenerGateToPosition() = default;
+
+    // Listener callback for a new position
+    void ProcessAdd(Position<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(Position<T>& _data);
+
+    // No implementation needed for update event
+    void ProcessUpdate(Position<T>& _data);
+
+   private:
+    PreTradeGate<T>* gate;  // Gate to update
+};
+
+template <typename T>
+ListenerGateToPosition<T>::ListenerGateToPosition(PreTradeGate<T>* _gate) : gate(_gate) {}
+
+template <typename T>
+void ListenerGateToPosition<T>::ProcessAdd(Position<T>& _data) {
+    gate->OnPosition(_data);
+}
+
+template <typename T>
+void ListenerGateToPosition<T>::ProcessRemove(Position<T>& _data) {}
+
+template <typename T>
+void ListenerGateToPosition<T>::ProcessUpdate(Position<T>& _data) {}
+
+/**
+ * Listener updating the PV01 counters of a PreTradeGate from the risk service.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerGateToRisk : public ServiceListener<PV01<T>> {
+   public:
+    // Constructor taking the gate
+    explicit ListenerGateToRisk(PreTradeGate<T>* _gate);
+    virtual ~ListenerGateToRisk() = default;
+
+    // Listener callback for a new PV01
+    void ProcessAdd(PV01<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(PV01<T>& _data);
+
+    // No implementation needed for update event
+    void ProcessUpdate(PV01<T>& _data);
+
+   private:
+    PreTradeGate<T>* gate;  // Gate to update
+};
+
+template <typename T>
+ListenerGateToRisk<T>::ListenerGateToRisk(PreTradeGate<T>* _gate) : gate(_gate) {}
+
+template <typename T>
+void ListenerGateToRisk<T>::ProcessAdd(PV01<T>& _data) {
+    gate->OnRisk(_data);
+}
+
+template <typename T>
+void ListenerGateToRisk<T>::ProcessRemove(PV01<T>& _data) {}
+
+template <typename T>
+void ListenerGateToRisk<T>::ProcessUpdate(PV01<T>& _data) {}
+
+/**
+ * Listener updating the mids of a PreTradeGate from the market data service.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerGateToMarketData : public BookDeltaListener<T> {
+   public:
+    // Constructor taking the gate
+    explicit ListenerGateToMarketData(PreTradeGate<T>* _gate);
+    virtual ~ListenerGateToMarketData() = default;
+
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book; only deltas changing the top move the mid
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+   private:
+    PreTradeGate<T>* gate;  // Gate to update
+};
+
+template <typename T>
+ListenerGateToMarketData<T>::ListenerGateToMarketData(PreTradeGate<T>* _gate) : gate(_gate) {}
+
+template <typename T>
+void ListenerGateToMarketData<T>::ProcessAdd(OrderBook<T>& _data) {
+    gate->OnBook(_data.GetProduct().GetProductId());
+}
+
+template <typename T>
+void ListenerGateToMarketData<T>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T>
+void ListenerGateToMarketData<T>::ProcessUpdate(OrderBook<T>& _data) {
+    gate->OnBook(_data.GetProduct().GetProductId());
+}
+
+template <typename T>
+void ListenerGateToMarketData<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    if (_delta.ChangedTop(_book)) gate->OnBook(_book.GetProduct().GetProductId());
+}
+
+#endif
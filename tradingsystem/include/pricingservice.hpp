@@ -14,14 +14,14 @@
 #include "soa.hpp"
 
 /**
- * A price object consisting of mid and bid/offer spread.
+ * A price object consisting of a bid and an offer, exposed as mid and bid/offer spread.
  * Type T is the product type.
  */
 template <typename T>
-class Price {
+class Price : public Traced {
    public:
     // ctor for a price
-    Price(const T& _product, double _mid, double _bidOfferSpread);
+    Price(const T& _product, Ticks _bid, Ticks _offer);
 
     Price() = default;
     virtual ~Price() = default;
@@ -29,25 +29,31 @@ class Price {
     // Get the product
     const T& GetProduct() const;
 
-    // Get the mid price
-    double GetMid() const;
+    // Get the bid price
+    Ticks GetBid() const;
+
+    // Get the offer price
+    Ticks GetOffer() const;
+
+    // Get the mid price, rounded down to a whole tick when it falls between two ticks
+    Ticks GetMid() const;
 
     // Get the bid/offer spread around the mid
-    double GetBidOfferSpread() const;
+    Ticks GetBidOfferSpread() const;
 
     // Get String
     vector<string> ToStrings() const;
 
    private:
     T product;
-    double mid;
-    double bidOfferSpread;
+    Ticks bid;
+    Ticks offer;
 };
 
 template <typename T>
-Price<T>::Price(const T& _product, double _mid, double _bidOfferSpread) : product(_product) {
-    mid = _mid;
-    bidOfferSpread = _bidOfferSpread;
+Price<T>::Price(const T& _product, Ticks _bid, Ticks _offer) : product(_product) {
+    bid = _bid;
+    offer = _offer;
 }
 
 template <typename T>
@@ -56,13 +62,24 @@ const T& Price<T>::GetProduct() const {
 }
 
 template <typename T>
-double Price<T>::GetMid() const {
-    return mid;
+Ticks Price<T>::GetBid() const {
+    return bid;
 }
 
 template <typename T>
-double Price<T>::GetBidOfferSpread() const {
-    return bidOfferSpread;
+Ticks Price<T>::GetOffer() const {
+    return offer;
+}
+
+template <typename T>
+Ticks Price<T>::GetMid() const {
+    int64_t sum = bid.Count() + offer.Count();
+    return Ticks(sum >= 0 ? sum / 2 : (sum - 1) / 2);
+}
+
+template <typename T>
+Ticks Price<T>::GetBidOfferSpread() const {
+    return offer - bid;
 }
 
 template <typename T>
@@ -70,8 +87,8 @@ vector<string> Price<T>::ToStrings() const {
     vector<string> outputStrings;
 
     // Format mid price and bid-offer spread as strings
-    string midPriceStr = FormatPrice(mid);
-    string spreadStr = FormatPrice(bidOfferSpread);
+    string midPriceStr = GetMid().ToString();
+    string spreadStr = GetBidOfferSpread().ToString();
 
     // Extract product ID
     string productId = product.GetProductId();
@@ -105,6 +122,9 @@ public:
     // Handle new or updated data from connectors
     virtual void OnMessage(Price<T>& data);
 
+    // Handle a batch of new or updated data from connectors
+    virtual void OnMessageBatch(span<Price<T>> data);
+
     // Add a listener to the service
     virtual void AddListener(ServiceListener<Price<T>>* listener);
 
@@ -133,11 +153,29 @@ Price<T>& PricingService<T>::GetData(string key) {
 
 template <typename T>
 void PricingService<T>::OnMessage(Price<T>& data) {
+    auto timer = this->TrackMessage();
+    LatencyTracer::Instance().Record(TRACE_PRICE, data.GetTrace());
     priceData[data.GetProduct().GetProductId()] = data;
 
-    for (auto& listener : serviceListeners) {
-        listener->ProcessAdd(data);
+    this->NotifyAdd(serviceListeners, data);
+}
+
+template <typename T>
+void PricingService<T>::OnMessageBatch(span<Price<T>> data) {
+    auto timer = this->TrackMessageBatch(data.size());
+
+    // Input is grouped by product, so consecutive prices usually share one map entry
+    auto entry = priceData.end();
+    for (auto& price : data) {
+        LatencyTracer::Instance().Record(TRACE_PRICE, price.GetTrace());
+        const string& productId = price.GetProduct().GetProductId();
+        if (entry == priceData.end() || entry->first != productId) {
+            entry = priceData.try_emplace(productId).first;
+        }
+        entry->second = price;
     }
+
+    this->NotifyAddBatch(serviceListeners, data);
 }
 
 template <typename T>
@@ -188,11 +226,11 @@ Price<T>& BondPricingService<T>::GetData(string key) {
 
 template <typename T>
 void BondPricingService<T>::OnMessage(Price<T>& data) {
+    auto timer = this->TrackMessage();
+    LatencyTracer::Instance().Record(TRACE_PRICE, data.GetTrace());
     this->priceData[data.GetProduct().GetProductId()] = data;
 
-    for (auto& listener : this->serviceListeners) {
-        listener->ProcessAdd(data);
-    }
+    this->NotifyAdd(this->serviceListeners, data);
 }
 
 template <typename T>
@@ -227,6 +265,12 @@ class PricingConnector : public Connector<Price<T>> {
     // Subscribe data from the Connector
     virtual void Subscribe(ifstream& inputData);
 
+    // Parse the input one price at a time
+    Generator<Price<T>> Read(ifstream& inputData);
+
+    // Number of prices delivered to the service per OnMessageBatch call
+    static constexpr size_t BATCH_SIZE = 256;
+
    private:
     PricingService<T>* service;
 };
@@ -270,9 +314,29 @@ void PricingConnector<T>::Publish(Price<T>& priceData)
 
 template <typename T>
 void PricingConnector<T>::Subscribe(ifstream& inputData) {
+    vector<Price<T>> batch;
+    batch.reserve(BATCH_SIZE);
+
+    for (auto& priceObject : Read(inputData)) {
+        // Notify the associated service with the new price data once a batch is complete
+        batch.push_back(priceObject);
+        if (batch.size() == BATCH_SIZE) {
+            this->service->OnMessageBatch(batch);
+            batch.clear();
+        }
+    }
+
+    if (!batch.empty()) {
+        this->service->OnMessageBatch(batch);
+    }
+}
+
+template <typename T>
+Generator<Price<T>> PricingConnector<T>::Read(ifstream& inputData) {
     string lineBuffer;
 
     while (getline(inputData, lineBuffer)) {
+        TraceContext trace = LatencyTracer::Instance().Begin();
         stringstream lineStream(lineBuffer);
         string cell;
         vector<string> parsedFields;
@@ -284,17 +348,14 @@ void PricingConnector<T>::Subscribe(ifstream& inputData) {
 
         // Extract individual fields from parsed data
         string productId = parsedFields[0];
-        double bidPrice = ParsePrice(parsedFields[1]);
-        double offerPrice = ParsePrice(parsedFields[2]);
-        double midPrice = (bidPrice + offerPrice) / 2.0;
-        double bidOfferSpread = offerPrice - bidPrice;
+        Ticks bidPrice = Ticks::Parse(parsedFields[1]);
+        Ticks offerPrice = Ticks::Parse(parsedFields[2]);
 
         // Create a product object (e.g., bond) and price instance
         T productInstance = BondInfo(productId);
-        Price<T> priceObject(productInstance, midPrice, bidOfferSpread);
-
-        // Notify the associated service with the new price data
-        this->service->OnMessage(priceObject);
+        Price<T> priceObject(productInstance, bidPrice, offerPrice);
+        priceObject.SetTrace(trace);
+        co_yield priceObject;
     }
 }
 
@@ -0,0 +1,89 @@
+/**
+ * recordwriter.hpp
+ * Defines RecordWriter, which formats the comma-terminated fields of a persisted record straight into a
+ * caller's buffer.
+ *
+ * The historical data connector reuses one buffer across records, so once its capacity has grown to the
+ * largest record or batch, formatting allocates nothing. Numbers are formatted with to_chars and enums are
+ * named through constexpr tables, giving the same text as the ToStrings of each type.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef RECORD_WRITER_HPP
+#define RECORD_WRITER_HPP
+
+#include <charconv>
+#include <concepts>
+#include <string>
+#include <string_view>
+
+#include "ticks.hpp"
+
+using namespace std;
+
+/**
+ * Appends the fields of records to a buffer, each followed by a comma, and ends records with a newline.
+ */
+class RecordWriter {
+   public:
+    // Constructor taking the buffer appended to
+    explicit RecordWriter(string& _buffer);
+
+    // Append a text field
+    RecordWriter& Field(string_view _text);
+
+    // Append an integer field
+    template <integral I>
+    RecordWriter& Field(I _value);
+
+    // Append a decimal field with six decimals, as to_string formats it
+    RecordWriter& Field(double _value);
+
+    // Append a price field in the fractional format
+    RecordWriter& Field(Ticks _price);
+
+    // End the record
+    void End();
+
+   private:
+    string& buffer;  // Buffer appended to
+};
+
+RecordWriter::RecordWriter(string& _buffer) : buffer(_buffer) {}
+
+RecordWriter& RecordWriter::Field(string_view _text) {
+    buffer.append(_text);
+    buffer += ',';
+    return *this;
+}
+
+template <integral I>
+RecordWriter& RecordWriter::Field(I _value) {
+    char text[24];
+    buffer.append(text, to_chars(text, text + sizeof(text), _value).ptr);
+    buffer += ',';
+    return *this;
+}
+
+RecordWriter& RecordWriter::Field(double _value) {
+    char text[64];
+    auto result = to_chars(text, text + sizeof(text), _value, chars_format::fixed, 6);
+    if (result.ec != errc()) return Field(string_view(to_string(_value)));
+    buffer.append(text, result.ptr);
+    buffer += ',';
+    return *this;
+}
+
+RecordWriter& RecordWriter::Field(Ticks _price) {
+    char text[Ticks::MAX_CHARS];
+    buffer.append(text, _price.Format(text));
+    buffer += ',';
+    return *this;
+}
+
+void RecordWriter::End() {
+    buffer += '\n';
+}
+
+#endif
@@ -8,6 +8,7 @@
 #ifndef RISK_SERVICE_HPP
 #define RISK_SERVICE_HPP
 
+#include "recordwriter.hpp"
 #include "soa.hpp"
 #include "positionservice.hpp"
 
@@ -17,7 +18,7 @@
  * @tparam T The type of the product.
  */
 template<typename T>
-class PV01
+class PV01 : public Traced
 {
 
 public:
@@ -43,6 +44,9 @@ public:
     // Convert PV01 attributes into string representations
     vector<string> ToStrings() const;
 
+    // Write PV01 attributes as the fields of a persisted record
+    void Write(RecordWriter& _writer) const;
+
 private:
     T product;     ///< The product associated with this PV01
     double pv01;   ///< The PV01 value
@@ -90,6 +94,12 @@ vector<string> PV01<T>::ToStrings() const
     return {_product, _pv01, _quantity};
 }
 
+template<typename T>
+void PV01<T>::Write(RecordWriter& _writer) const
+{
+    _writer.Field(product.GetProductId()).Field(pv01).Field(quantity);
+}
+
 /**
  * @class BucketedSector
  * @brief Groups multiple securities into a sector for aggregated risk analysis.
@@ -206,6 +216,7 @@ PV01<T>& RiskService<T>::GetData(string _key)
 template<typename T>
 void RiskService<T>::OnMessage(PV01<T>& _data)
 {
+    auto timer = this->TrackMessage();
     pv01s[_data.GetProduct().GetProductId()] = _data;
 }
 
@@ -235,12 +246,11 @@ void RiskService<T>::AddPosition(Position<T>& _position)
     double _pv01Value = PV01Info(_productId);
     long _quantity = _position.GetAggregatePosition();
     PV01<T> _pv01(_product, _pv01Value, _quantity);
+    _pv01.SetTrace(_position.GetTrace());
+    LatencyTracer::Instance().Record(TRACE_RISK, _pv01.GetTrace());
     pv01s[_productId] = _pv01;
 
-    for (auto& l : listeners)
-    {
-        l->ProcessAdd(_pv01);
-    }
+    this->NotifyAdd(listeners, _pv01);
 }
 
 template<typename T>
@@ -0,0 +1,450 @@
+/**
+ * signalservice.hpp
+ * Defines SignalService, which derives market microstructure signals from the consolidated books of the
+ * market data service as they change and publishes them to its own listeners.
+ *
+ * Every signal is maintained incrementally per product: the top-of-book quantities are recomputed from
+ * the best levels, the volatility of the mid is an exponentially weighted moving average of squared mid
+ * changes, and the spread percentiles come from P² quantile sketches (Jain and Chlamtac, 1985), which
+ * track a quantile with five markers instead of keeping the observations. An update therefore costs the
+ * same however long the run has lasted.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef SIGNAL_SERVICE_HPP
+#define SIGNAL_SERVICE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "soa.hpp"
+#include "marketdataservice.hpp"
+
+using namespace std;
+
+/**
+ * Streaming estimate of one quantile using the P² algorithm. Until five observations have been seen
+ * the exact quantile of those observations is returned.
+ */
+class P2Quantile {
+   public:
+    // Constructor taking the probability of the quantile to track, strictly between 0 and 1
+    explicit P2Quantile(double _probability = 0.5);
+
+    // Add an observation
+    void Add(double _value);
+
+    // Current estimate of the quantile, or zero before any observation
+    double Get() const;
+
+    // Number of observations added
+    uint64_t GetCount() const;
+
+   private:
+    // Piecewise-parabolic prediction of marker _i moved by _step positions
+    double Parabolic(int _i, double _step) const;
+
+    // Linear prediction of marker _i moved by _step positions
+    double Linear(int _i, int _step) const;
+
+    double probability;                 // Probability of the tracked quantile
+    array<double, 5> heights{};         // Marker heights: minimum, p/2, p, (1+p)/2 and maximum quantiles
+    array<double, 5> positions{};       // Actual marker positions
+    array<double, 5> desired{};         // Desired marker positions
+    array<double, 5> increments{};      // Desired position increment per observation
+    uint64_t count = 0;                 // Observations added
+};
+
+P2Quantile::P2Quantile(double _probability) : probability(_probability) {
+    if (!(_probability > 0 && _probability < 1))
+        throw std::invalid_argument("Quantile probability must be between 0 and 1");
+    desired = {0, 2 * _probability, 4 * _probability, 2 + 2 * _probability, 4};
+    increments = {0, _probability / 2, _probability, (1 + _probability) / 2, 1};
+}
+
+void P2Quantile::Add(double _value) {
+    // The first five observations become the initial markers
+    if (count < 5) {
+        heights[count++] = _value;
+        if (count == 5) {
+            sort(heights.begin(), heights.end());
+            positions = {0, 1, 2, 3, 4};
+        }
+        return;
+    }
+    ++count;
+
+    // Find the cell holding the observation, extending the extremes if needed
+    int cell;
+    if (_value < heights[0]) {
+        heights[0] = _value;
+        cell = 0;
+    } else if (_value >= heights[4]) {
+        heights[4] = _value;
+        cell = 3;
+    } else {
+        cell = 0;
+        while (_value >= heights[cell + 1]) ++cell;
+    }
+    for (int i = cell + 1; i < 5; ++i) positions[i] += 1;
+    for (int i = 0; i < 5; ++i) desired[i] += increments[i];
+
+    // Move each middle marker at most one position towards where it should be
+    for (int i = 1; i < 4; ++i) {
+        double offset = desired[i] - positions[i];
+        if ((offset >= 1 && positions[i + 1] - positions[i] > 1) || (offset <= -1 && positions[i - 1] - positions[i] < -1)) {
+            int step = offset >= 0 ? 1 : -1;
+            double height = Parabolic(i, step);
+            heights[i] = heights[i - 1] < height && height < heights[i + 1] ? height : Linear(i, step);
+            positions[i] += step;
+        }
+    }
+}
+
+double P2Quantile::Get() const {
+    if (count == 0) return 0.0;
+    if (count < 5) {
+        array<double, 5> seen = heights;
+        sort(seen.begin(), seen.begin() + count);
+        return seen[static_cast<size_t>(lround(probability * (count - 1)))];
+    }
+    return heights[2];
+}
+
+uint64_t P2Quantile::GetCount() const {
+    return count;
+}
+
+double P2Quantile::Parabolic(int _i, double _step) const {
+    double below = positions[_i] - positions[_i - 1];
+    double above = positions[_i + 1] - positions[_i];
+    return heights[_i] + _step / (positions[_i + 1] - positions[_i - 1]) *
+                             ((below + _step) * (heights[_i + 1] - heights[_i]) / above +
+                              (above - _step) * (heights[_i] - heights[_i - 1]) / below);
+}
+
+double P2Quantile::Linear(int _i, int _step) const {
+    return heights[_i] + _step * (heights[_i + _step] - heights[_i]) / (positions[_i + _step] - positions[_i]);
+}
+
+/**
+ * Microstructure signals of one product, derived from its consolidated book. Prices, spreads and the
+ * volatility are in ticks; the volatility is per book change of the top.
+ * T: The product type.
+ */
+template <typename T>
+class MarketSignal {
+   public:
+    // Default constructor
+    MarketSignal() = default;
+
+    // Constructor initializing every signal
+    MarketSignal(const T& _product, double _mid, double _spread, double _imbalance, double _microprice,
+                 double _volatility, double _spreadMedian, double _spreadP90, double _spreadP99, uint64_t _updates);
+
+    // Retrieve the product the signals belong to
+    const T& GetProduct() const;
+
+    // Midpoint of the best bid and offer
+    double GetMid() const;
+
+    // Best offer minus best bid
+    double GetSpread() const;
+
+    // Best bid size minus best offer size over their sum, from -1 (all offer) to 1 (all bid)
+    double GetImbalance() const;
+
+    // Mid weighted towards the side with less size
+    double GetMicroprice() const;
+
+    // Exponentially weighted standard deviation of mid changes
+    double GetVolatility() const;
+
+    // Streaming estimates of the median, 90th and 99th percentile spread
+    double GetSpreadMedian() const;
+    double GetSpreadP90() const;
+    double GetSpreadP99() const;
+
+    // Number of top-of-book changes the signals have seen
+    uint64_t GetUpdates() const;
+
+    // Convert the signals to strings for display
+    vector<string> ToStrings() const;
+
+   private:
+    T product;                  // Product the signals belong to
+    double mid = 0;             // Midpoint of the best bid and offer
+    double spread = 0;          // Best offer minus best bid
+    double imbalance = 0;       // Top-level size imbalance
+    double microprice = 0;      // Size-weighted mid
+    double volatility = 0;      // EWMA standard deviation of mid changes
+    double spreadMedian = 0;    // Median spread
+    double spreadP90 = 0;       // 90th percentile spread
+    double spreadP99 = 0;       // 99th percentile spread
+    uint64_t updates = 0;       // Top-of-book changes seen
+};
+
+template <typename T>
+MarketSignal<T>::MarketSignal(const T& _product, double _mid, double _spread, double _imbalance, double _microprice,
+                              double _volatility, double _spreadMedian, double _spreadP90, double _spreadP99,
+                              uint64_t _updates)
+    : product(_product),
+      mid(_mid),
+      spread(_spread),
+      imbalance(_imbalance),
+      microprice(_microprice),
+      volatility(_volatility),
+      spreadMedian(_spreadMedian),
+      spreadP90(_spreadP90),
+      spreadP99(_spreadP99),
+      updates(_updates) {}
+
+template <typename T>
+const T& MarketSignal<T>::GetProduct() const {
+    return product;
+}
+
+template <typename T>
+double MarketSignal<T>::GetMid() const {
+    return mid;
+}
+
+template <typename T>
+double MarketSignal<T>::GetSpread() const {
+    return spread;
+}
+
+template <typename T>
+double MarketSignal<T>::GetImbalance() const {
+    return imbalance;
+}
+
+template <typename T>
+double MarketSignal<T>::GetMicroprice() const {
+    return microprice;
+}
+
+template <typename T>
+double MarketSignal<T>::GetVolatility() const {
+    return volatility;
+}
+
+template <typename T>
+double MarketSignal<T>::GetSpreadMedian() const {
+    return spreadMedian;
+}
+
+template <typename T>
+double MarketSignal<T>::GetSpreadP90() const {
+    return spreadP90;
+}
+
+template <typename T>
+double MarketSignal<T>::GetSpreadP99() const {
+    return spreadP99;
+}
+
+template <typename T>
+uint64_t MarketSignal<T>::GetUpdates() const {
+    return updates;
+}
+
+template <typename T>
+vector<string> MarketSignal<T>::ToStrings() const {
+    auto format = [](double _value) {
+        ostringstream out;
+        out << fixed << setprecision(3) << _value;
+        return out.str();
+    };
+    return {product.GetProductId(), format(mid),          format(spread),       format(imbalance),
+            format(microprice),     format(volatility),   format(spreadMedian), format(spreadP90),
+            format(spreadP99),      to_string(updates)};
+}
+
+template <typename T>
+class ListenerSignalToMarketData;
+
+/**
+ * Service keeping the latest MarketSignal of every product, keyed by product identifier. Register the
+ * listener from GetListener on the market data service; each change to the top of a product's
+ * consolidated book updates its signals in O(1) and publishes them through ProcessAdd.
+ * T: The product type.
+ */
+template <typename T>
+class SignalService : public Service<string, MarketSignal<T>> {
+   public:
+    // Decay of the volatility average per top-of-book change unless configured otherwise
+    static constexpr double DEFAULT_DECAY = 0.94;
+
+    // Constructor taking the service holding the consolidated books and the volatility decay
+    explicit SignalService(BondMarketDataService<T>& _marketData, double _decay = DEFAULT_DECAY);
+    virtual ~SignalService();
+
+    // Retrieve the latest signals of a product
+    MarketSignal<T>& GetData(string _key);
+
+    // Store signals computed elsewhere and publish them
+    void OnMessage(MarketSignal<T>& _data);
+
+    // Add a listener to the service
+    void AddListener(ServiceListener<MarketSignal<T>>* _listener);
+
+    // Retrieve all listeners
+    const vector<ServiceListener<MarketSignal<T>>*>& GetListeners() const;
+
+    // Retrieve the listener to register on the market data service
+    BookDeltaListener<T>* GetListener();
+
+    // Update the signals of a product from its consolidated book and publish them
+    void Update(const string& _productId);
+
+   private:
+    /**
+     * Running state of one product alongside its latest signals.
+     */
+    struct State {
+        MarketSignal<T> signal;
+        array<P2Quantile, 3> spreadQuantiles{P2Quantile(0.5), P2Quantile(0.9), P2Quantile(0.99)};
+        double variance = 0;      // EWMA of squared mid changes
+        double lastMid = 0;       // Mid at the previous update
+        uint64_t updates = 0;     // Updates seen
+    };
+
+    BondMarketDataService<T>& marketData;                 // Source of the consolidated books
+    double decay;                                         // Weight kept by the volatility average per update
+    unordered_map<string, State> states;                  // State of each product
+    vector<ServiceListener<MarketSignal<T>>*> listeners;  // Listeners on the signals
+    ListenerSignalToMarketData<T>* listener;              // Listener on the market data service
+};
+
+template <typename T>
+SignalService<T>::SignalService(BondMarketDataService<T>& _marketData, double _decay)
+    : marketData(_marketData), decay(_decay), listener(new ListenerSignalToMarketData<T>(this)) {
+    if (!(_decay >= 0 && _decay < 1)) throw std::invalid_argument("Volatility decay must be in [0, 1)");
+}
+
+template <typename T>
+SignalService<T>::~SignalService() {
+    delete listener;
+}
+
+template <typename T>
+MarketSignal<T>& SignalService<T>::GetData(string _key) {
+    auto it = states.find(_key);
+    if (it == states.end()) throw std::invalid_argument("No market signals for product: " + _key);
+    return it->second.signal;
+}
+
+template <typename T>
+void SignalService<T>::OnMessage(MarketSignal<T>& _data) {
+    auto timer = this->TrackMessage();
+    State& state = states[_data.GetProduct().GetProductId()];
+    state.signal = _data;
+    this->NotifyAdd(listeners, state.signal);
+}
+
+template <typename T>
+void SignalService<T>::AddListener(ServiceListener<MarketSignal<T>>* _listener) {
+    listeners.push_back(_listener);
+}
+
+template <typename T>
+const vector<ServiceListener<MarketSignal<T>>*>& SignalService<T>::GetListeners() const {
+    return listeners;
+}
+
+template <typename T>
+BookDeltaListener<T>* SignalService<T>::GetListener() {
+    return listener;
+}
+
+template <typename T>
+void SignalService<T>::Update(const string& _productId) {
+    const ConsolidatedBook<T>& book = marketData.GetConsolidatedBook(_productId);
+    const vector<ConsolidatedLevel>& bids = book.GetBidLevels();
+    const vector<ConsolidatedLevel>& offers = book.GetOfferLevels();
+    if (bids.empty() || offers.empty()) return;
+
+    auto timer = this->TrackMessage();
+    double bid = static_cast<double>(bids.front().price.Count());
+    double offer = static_cast<double>(offers.front().price.Count());
+    double bidSize = static_cast<double>(bids.front().quantity);
+    double offerSize = static_cast<double>(offers.front().quantity);
+    double mid = (bid + offer) / 2;
+    double spread = offer - bid;
+
+    State& state = states[_productId];
+    if (state.updates > 0) {
+        double change = mid - state.lastMid;
+        state.variance = decay * state.variance + (1 - decay) * change * change;
+    }
+    state.lastMid = mid;
+    ++state.updates;
+    for (auto& quantile : state.spreadQuantiles) quantile.Add(spread);
+
+    state.signal = MarketSignal<T>(book.GetProduct(), mid, spread, (bidSize - offerSize) / (bidSize + offerSize),
+                                   (bid * offerSize + offer * bidSize) / (bidSize + offerSize), sqrt(state.variance),
+                                   state.spreadQuantiles[0].Get(), state.spreadQuantiles[1].Get(),
+                                   state.spreadQuantiles[2].Get(), state.updates);
+    this->NotifyAdd(listeners, state.signal);
+}
+
+/**
+ * Listener on the market data service updating the signals of a product when the top of its book
+ * changes. Deltas below the top leave the consolidated top unchanged and are skipped.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerSignalToMarketData : public BookDeltaListener<T> {
+   public:
+    // Constructor taking the service to update
+    explicit ListenerSignalToMarketData(SignalService<T>* _service);
+    virtual ~ListenerSignalToMarketData() = default;
+
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // Listener callback for a book removal
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+   private:
+    SignalService<T>* service;  // Service receiving the updates
+};
+
+template <typename T>
+ListenerSignalToMarketData<T>::ListenerSignalToMarketData(SignalService<T>* _service) : service(_service) {}
+
+template <typename T>
+void ListenerSignalToMarketData<T>::ProcessAdd(OrderBook<T>& _data) {
+    service->Update(_data.GetProduct().GetProductId());
+}
+
+template <typename T>
+void ListenerSignalToMarketData<T>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T>
+void ListenerSignalToMarketData<T>::ProcessUpdate(OrderBook<T>& _data) {
+    service->Update(_data.GetProduct().GetProductId());
+}
+
+template <typename T>
+void ListenerSignalToMarketData<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    if (_delta.ChangedTop(_book)) service->Update(_book.GetProduct().GetProductId());
+}
+
+#endif
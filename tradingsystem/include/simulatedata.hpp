@@ -17,6 +17,7 @@
 #include <algorithm>
 #include "utils.hpp"
 #include "products.hpp"
+#include "marketdataservice.hpp"
 
 using namespace std;
 
@@ -30,13 +31,14 @@ public:
     static constexpr int PRICES_PER_SECURITY = 1000000; // 1,000,000 prices per security
     static constexpr int TOTAL_SECURITIES = 7;
     static constexpr int TRADES_PER_SECURITY = 10; // 10 trades per security
-    static constexpr int ORDER_BOOK_DEPTH = 5;
+    static constexpr int ORDER_BOOK_DEPTH = static_cast<int>(DEFAULT_BOOK_DEPTH); // Levels the market data service reads per side
     static constexpr int INQUIRIES_PER_SECURITY = 10;
 
 private:
     // Data Members
     std::vector<std::string> CUSIPS;
     std::vector<std::string> BOOK_LIST = {"TRSY1", "TRSY2", "TRSY3"};
+    std::vector<std::string> VENUE_LIST = {"BROKERTEC", "ESPEED", "CME"};
 
 public:
     // Constructor
@@ -57,6 +59,8 @@ public:
             bool ascending = true;
 
             for (int updateIndex = 1; updateIndex <= PRICES_PER_SECURITY; ++updateIndex) {
+                // Successive books of a security rotate across the venues
+                const std::string& venue = VENUE_LIST[updateIndex % VENUE_LIST.size()];
                 double topSpread = spreadCycle[spreadCycleIndex];
                 spreadCycleIndex = (spreadCycleIndex + 1) % spreadCycle.size();
 
@@ -73,11 +77,11 @@ public:
 
                     marketFile << currentCUSIP << "," 
                                << FormatPrice(bidPrice) << "," 
-                               << quantity << ",BID\n";
+                               << quantity << ",BID," << venue << "\n";
 
                     marketFile << currentCUSIP << "," 
                                << FormatPrice(offerPrice) << "," 
-                               << quantity << ",OFFER\n";
+                               << quantity << ",OFFER," << venue << "\n";
                 }
 
                 midPrice = UpdateMidPrice(midPrice, ascending);
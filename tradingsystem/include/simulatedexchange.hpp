@@ -0,0 +1,895 @@
+/**
+ * simulatedexchange.hpp
+ * Defines SimulatedExchange, an in-process matching venue filling ExecutionOrders against the live
+ * consolidated books of the market data service, and the Fill events it publishes.
+ *
+ * An order hits the side named by its PricingSide, as the trade booking listener books it: a BID
+ * order sells into the bids and an OFFER order buys from the offers. Orders arrive after a
+ * configurable latency and match best price first against the displayed levels:
+ *   MARKET  takes whatever is displayed, up to its quantity, and drops the rest
+ *   IOC     as MARKET, limited to levels at or better than its price
+ *   FOK     fills in full at or better than its price, or not at all
+ *   LIMIT   as IOC, then rests at its price on the other side of the book until filled or cancelled
+ *
+ * A resting order joins the queue at its price behind a configurable share of the displayed size.
+ * Decreases of the displayed size at its price are taken as trades against the queue ahead of it, unless
+ * the price has just come back within the displayed depth. The order fills once that queue is used up,
+ * or when the opposite side trades through its price.
+ * An order with hidden quantity rests as an iceberg: only its visible quantity fills from the queue, and
+ * once that has filled the next visible quantity is shown from the back of the queue at its price. A trade
+ * through its price fills the hidden quantity too.
+ * Resting orders fill in price-time priority. An amendment arrives with the same latency as orders: a
+ * smaller quantity keeps the order's place, a new price matches what is left again as a new order.
+ * Liquidity an order takes stays consumed until the product's book next changes, so orders arriving in
+ * between cannot take the same size twice.
+ * An order tagged with a venue matches, and queues behind, only the share of each level quoted on that
+ * venue; an untagged order takes from every venue.
+ *
+ * Listeners deriving from OrderStatusListener are also told of acknowledgements, cancellations and
+ * rejections, so they can follow each order's lifecycle together with its fills.
+ *
+ * Per market data update only the resting orders of the updated product within the displayed depth, or
+ * crossed by the other side, are visited, so orders parked away from the market cost nothing.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef SIMULATED_EXCHANGE_HPP
+#define SIMULATED_EXCHANGE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "algoexecutionservice.hpp"
+#include "coroutine.hpp"
+#include "marketdataservice.hpp"
+#include "orderstore.hpp"
+#include "soa.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+/**
+ * A fill of an ExecutionOrder on the simulated exchange.
+ * T: The product type.
+ */
+template <typename T>
+class Fill : public Traced {
+   public:
+    // Default constructor
+    Fill() = default;
+
+    // Constructor initializing every attribute
+    Fill(const T& _product, const string& _fillId, const string& _orderId, PricingSide _side, Ticks _price,
+         long _quantity, long _leavesQuantity, bool _passive, uint64_t _time);
+
+    // Retrieve the product
+    const T& GetProduct() const;
+
+    // Retrieve the identifier of the fill
+    const string& GetFillId() const;
+
+    // Retrieve the identifier of the order filled
+    const string& GetOrderId() const;
+
+    // Retrieve the side of the order filled
+    PricingSide GetSide() const;
+
+    // Retrieve the price of the fill
+    Ticks GetPrice() const;
+
+    // Retrieve the quantity filled
+    long GetQuantity() const;
+
+    // Retrieve the quantity of the order still open after this fill
+    long GetLeavesQuantity() const;
+
+    // Whether the order was resting when it filled
+    bool IsPassive() const;
+
+    // Retrieve the logical time of the fill
+    uint64_t GetTime() const;
+
+    // Convert attributes to strings for display
+    vector<string> ToStrings() const;
+
+   private:
+    T product;                 // Product filled
+    string fillId;             // Identifier of the fill
+    string orderId;            // Identifier of the order filled
+    PricingSide side;          // Side of the order filled
+    Ticks price;               // Price of the fill
+    long quantity;             // Quantity filled
+    long leavesQuantity;       // Quantity still open
+    bool passive;              // Whether the order was resting
+    uint64_t time;             // Logical time of the fill
+};
+
+template <typename T>
+Fill<T>::Fill(const T& _product, const string& _fillId, const string& _orderId, PricingSide _side, Ticks _price,
+              long _quantity, long _leavesQuantity, bool _passive, uint64_t _time)
+    : product(_product),
+      fillId(_fillId),
+      orderId(_orderId),
+      side(_side),
+      price(_price),
+      quantity(_quantity),
+      leavesQuantity(_leavesQuantity),
+      passive(_passive),
+      time(_time) {}
+
+template <typename T>
+const T& Fill<T>::GetProduct() const {
+    return product;
+}
+
+template <typename T>
+const string& Fill<T>::GetFillId() const {
+    return fillId;
+}
+
+template <typename T>
+const string& Fill<T>::GetOrderId() const {
+    return orderId;
+}
+
+template <typename T>
+PricingSide Fill<T>::GetSide() const {
+    return side;
+}
+
+template <typename T>
+Ticks Fill<T>::GetPrice() const {
+    return price;
+}
+
+template <typename T>
+long Fill<T>::GetQuantity() const {
+    return quantity;
+}
+
+template <typename T>
+long Fill<T>::GetLeavesQuantity() const {
+    return leavesQuantity;
+}
+
+template <typename T>
+bool Fill<T>::IsPassive() const {
+    return passive;
+}
+
+template <typename T>
+uint64_t Fill<T>::GetTime() const {
+    return time;
+}
+
+template <typename T>
+vector<string> Fill<T>::ToStrings() const {
+    return {product.GetProductId(), fillId,   orderId, side == BID ? "BID" : "OFFER", price.ToString(),
+            to_string(quantity),    to_string(leavesQuantity), passive ? "PASSIVE" : "AGGRESSIVE", to_string(time)};
+}
+
+/**
+ * Listener on the fills of a SimulatedExchange that is also told when an order is acknowledged on
+ * arrival, cancelled (the unfilled rest of FOK, IOC and MARKET orders, or by Cancel) or rejected.
+ * T: The product type.
+ */
+template <typename T>
+class OrderStatusListener : public ServiceListener<Fill<T>> {
+   public:
+    // Listener callback for a change of an order's state other than a fill
+    virtual void ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state) = 0;
+};
+
+template <typename T>
+class ListenerExchangeToExecution;
+
+template <typename T>
+class ListenerExchangeToMarketData;
+
+/**
+ * Simulated matching venue publishing Fill events. Keyed on product identifier, holding the latest fill.
+ * Register GetListener on the execution service and GetMarketDataListener on the market data service.
+ * T: The product type.
+ */
+template <typename T>
+class SimulatedExchange : public Service<string, Fill<T>> {
+   public:
+    // Constructor taking the service holding the books matched against, the scheduler whose logical time
+    // orders arrive in (without one orders arrive immediately), the latency from submission to arrival
+    // and the share of the displayed size at its price that a resting order queues behind
+    explicit SimulatedExchange(BondMarketDataService<T>& _marketData, const Scheduler* _clock = nullptr,
+                               uint64_t _latency = 0, double _queueShare = 1.0);
+    virtual ~SimulatedExchange();
+
+    // Retrieve the latest fill of a product
+    Fill<T>& GetData(string _key);
+
+    // Store a fill and publish it
+    void OnMessage(Fill<T>& _data);
+
+    // Add a listener to the service
+    void AddListener(ServiceListener<Fill<T>>* _listener);
+
+    // Retrieve all listeners
+    const vector<ServiceListener<Fill<T>>*>& GetListeners() const;
+
+    // Retrieve the listener to register on the execution service
+    ListenerExchangeToExecution<T>* GetListener();
+
+    // Retrieve the listener to register on the market data service
+    ListenerExchangeToMarketData<T>* GetMarketDataListener();
+
+    // Send an order to the exchange; it arrives after the configured latency
+    void Submit(const ExecutionOrder<T>& _order);
+
+    // Cancel a resting order; returns false if it is not resting
+    bool Cancel(const string& _orderId);
+
+    // Amend a resting order to the price of _order and at most its quantity; it arrives after the configured
+    // latency, and is dropped if the order is no longer resting by then
+    void Amend(const ExecutionOrder<T>& _order);
+
+    // Match the orders that have arrived by time _now
+    void Advance(uint64_t _now);
+
+    // Match resting orders of a product against its current book
+    void Rematch(const string& _productId);
+
+    // Advance every _interval of logical time until _upstream is closed and empty and nothing is in flight
+    Task Pump(Scheduler& _scheduler, uint64_t _interval, const BoundedChannel<OrderBook<T>>& _upstream);
+
+    // Number of orders resting
+    size_t GetRestingCount() const;
+
+    // Number of fills published
+    uint64_t GetFillCount() const;
+
+    // Total quantity filled
+    uint64_t GetFilledQuantity() const;
+
+    // Number of orders that arrived and were not filled at all (unfilled FOK, IOC and MARKET, unsupported types)
+    uint64_t GetUnfilledCount() const;
+
+    // Number of amendments applied to resting orders
+    uint64_t GetAmendedCount() const;
+
+   private:
+    /**
+     * An order resting on the book.
+     */
+    struct Resting {
+        ExecutionOrder<T> order;
+        long leaves;         // Quantity still open
+        long shown;          // Part of leaves displayed, the rest being hidden
+        long queueAhead;     // Displayed size ahead of the order at its price
+        long lastSeen;       // Displayed size at its price when last visited
+        uint64_t seenAt;     // Rematch of the product at which lastSeen was taken
+    };
+
+    /**
+     * An order on its way to the exchange.
+     */
+    struct Pending {
+        ExecutionOrder<T> order;
+        uint64_t arrival;
+        bool amendment = false;  // Whether the order amends one resting
+    };
+
+    /**
+     * Resting orders and consumed liquidity of one product.
+     */
+    struct ProductState {
+        vector<Resting> resting[2];                  // Resting orders by side, lowest priority first
+        uint64_t bookVersion = 0;                    // Book version the consumed sizes apply to
+        uint64_t rematches = 0;                      // Rematches of the product so far
+        vector<pair<int64_t, array<long, MARKET_COUNT>>> consumed[2];  // Size taken per price and venue, by side
+    };
+
+    // Match an order that has arrived
+    void Match(const ExecutionOrder<T>& _order);
+
+    // Apply an amendment that has arrived
+    void ApplyAmendment(const ExecutionOrder<T>& _order);
+
+    // Take what crosses the price of a LIMIT order with _leaves open, and rest the rest; returns the size taken
+    long Place(ProductState& _state, const ConsolidatedBook<T>& _book, const ExecutionOrder<T>& _order, long _leaves);
+
+    // Size an order can reach at or better than _limit, less what has been consumed
+    long Available(ProductState& _state, const ConsolidatedBook<T>& _book, const ExecutionOrder<T>& _order,
+                   Ticks _limit) const;
+
+    // Take up to _quantity from one side at or better than _limit, publishing a fill per level; returns the size taken
+    long Take(ProductState& _state, const ConsolidatedBook<T>& _book, const ExecutionOrder<T>& _order, Ticks _limit,
+              long _quantity, long _filledBefore, bool _passive);
+
+    // Size consumed at a price on one side per venue, created at zero
+    static array<long, MARKET_COUNT>& Consumed(ProductState& _state, PricingSide _side, Ticks _price);
+
+    // Displayed size at a price on one side on the venues an order can reach
+    static long Displayed(const ConsolidatedBook<T>& _book, PricingSide _side, Ticks _price,
+                          const ExecutionOrder<T>& _order);
+
+    // Range [first, last) of the venues an order can reach
+    static pair<size_t, size_t> Venues(const ExecutionOrder<T>& _order);
+
+    // Whether _price is at or better than _limit for an order hitting _side
+    static bool Crosses(PricingSide _side, Ticks _price, Ticks _limit);
+
+    // State of a product, with consumed sizes cleared if its book has changed
+    ProductState& State(const string& _productId, const ConsolidatedBook<T>& _book);
+
+    // Tell the status listeners of a change of an order's state other than a fill
+    void PublishStatus(const ExecutionOrder<T>& _order, OrderState _state);
+
+    // Publish a fill
+    void Publish(const ExecutionOrder<T>& _order, Ticks _price, long _quantity, long _leaves, bool _passive);
+
+    BondMarketDataService<T>& marketData;              // Books matched against
+    const Scheduler* clock;                            // Source of logical time, if any
+    uint64_t latency;                                  // Time from submission to arrival
+    double queueShare;                                 // Share of displayed size queued behind
+    deque<Pending> inFlight;                           // Orders not yet arrived, in arrival order
+    unordered_map<string, ProductState> products;      // State of each product
+    map<string, Fill<T>> latestFills;                  // Latest fill of each product
+    vector<ServiceListener<Fill<T>>*> listeners;       // Listeners on fills
+    vector<OrderStatusListener<T>*> statusListeners;   // Listeners also on order states
+    ListenerExchangeToExecution<T>* executionListener; // Listener on the execution service
+    ListenerExchangeToMarketData<T>* marketDataListener;  // Listener on the market data service
+    size_t restingCount = 0;                           // Orders resting
+    uint64_t fillCount = 0;                            // Fills published
+    uint64_t filledQuantity = 0;                       // Quantity filled
+    uint64_t unfilledCount = 0;                        // Orders that arrived and never filled
+    uint64_t amendedCount = 0;                         // Amendments applied
+};
+
+template <typename T>
+SimulatedExchange<T>::SimulatedExchange(BondMarketDataService<T>& _marketData, const Scheduler* _clock,
+                                        uint64_t _latency, double _queueShare)
+    : marketData(_marketData),
+      clock(_clock),
+      latency(_latency),
+      queueShare(_queueShare),
+      executionListener(new ListenerExchangeToExecution<T>(this)),
+      marketDataListener(new ListenerExchangeToMarketData<T>(this)) {
+    if (!(_queueShare >= 0 && _queueShare <= 1)) throw std::invalid_argument("Queue share must be in [0, 1]");
+}
+
+template <typename T>
+SimulatedExchange<T>::~SimulatedExchange() {
+    delete executionListener;
+    delete marketDataListener;
+}
+
+template <typename T>
+Fill<T>& SimulatedExchange<T>::GetData(string _key) {
+    return latestFills[_key];
+}
+
+template <typename T>
+void SimulatedExchange<T>::OnMessage(Fill<T>& _data) {
+    auto timer = this->TrackMessage();
+    Fill<T>& latest = latestFills[_data.GetProduct().GetProductId()];
+    latest = _data;
+    this->NotifyAdd(listeners, latest);
+}
+
+template <typename T>
+void SimulatedExchange<T>::AddListener(ServiceListener<Fill<T>>* _listener) {
+    listeners.push_back(_listener);
+    if (auto statusListener = dynamic_cast<OrderStatusListener<T>*>(_listener)) {
+        statusListeners.push_back(statusListener);
+    }
+}
+
+template <typename T>
+const vector<ServiceListener<Fill<T>>*>& SimulatedExchange<T>::GetListeners() const {
+    return listeners;
+}
+
+template <typename T>
+ListenerExchangeToExecution<T>* SimulatedExchange<T>::GetListener() {
+    return executionListener;
+}
+
+template <typename T>
+ListenerExchangeToMarketData<T>* SimulatedExchange<T>::GetMarketDataListener() {
+    return marketDataListener;
+}
+
+template <typename T>
+void SimulatedExchange<T>::Submit(const ExecutionOrder<T>& _order) {
+    if (!clock || latency == 0) {
+        Match(_order);
+        return;
+    }
+    inFlight.push_back({_order, clock->GetTime() + latency});
+}
+
+template <typename T>
+bool SimulatedExchange<T>::Cancel(const string& _orderId) {
+    for (auto& [productId, state] : products) {
+        for (auto& resting : state.resting) {
+            auto it = find_if(resting.begin(), resting.end(),
+                              [&](const Resting& _r) { return _r.order.GetOrderId() == _orderId; });
+            if (it != resting.end()) {
+                ExecutionOrder<T> order = it->order;
+                resting.erase(it);
+                --restingCount;
+                PublishStatus(order, ORDER_CANCELLED);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+template <typename T>
+void SimulatedExchange<T>::Amend(const ExecutionOrder<T>& _order) {
+    if (!clock || latency == 0) {
+        ApplyAmendment(_order);
+        return;
+    }
+    inFlight.push_back({_order, clock->GetTime() + latency, true});
+}
+
+template <typename T>
+void SimulatedExchange<T>::Advance(uint64_t _now) {
+    // A constant latency keeps orders and amendments in flight in arrival order
+    while (!inFlight.empty() && inFlight.front().arrival <= _now) {
+        Pending pending = std::move(inFlight.front());
+        inFlight.pop_front();
+        if (pending.amendment) {
+            ApplyAmendment(pending.order);
+        } else {
+            Match(pending.order);
+        }
+    }
+}
+
+template <typename T>
+Task SimulatedExchange<T>::Pump(Scheduler& _scheduler, uint64_t _interval,
+                                const BoundedChannel<OrderBook<T>>& _upstream) {
+    uint64_t time = 0;
+    while (!_upstream.IsClosed() || _upstream.GetSize() > 0 || !inFlight.empty()) {
+        Advance(time);
+        time += _interval;
+        co_await _scheduler.Yield(time);
+    }
+}
+
+template <typename T>
+typename SimulatedExchange<T>::ProductState& SimulatedExchange<T>::State(const string& _productId,
+                                                                         const ConsolidatedBook<T>& _book) {
+    ProductState& state = products[_productId];
+    if (state.bookVersion != _book.GetVersion()) {
+        state.bookVersion = _book.GetVersion();
+        state.consumed[BID].clear();
+        state.consumed[OFFER].clear();
+    }
+    return state;
+}
+
+template <typename T>
+bool SimulatedExchange<T>::Crosses(PricingSide _side, Ticks _price, Ticks _limit) {
+    // Selling into the bids needs a bid at or above the limit; buying from the offers an offer at or below it
+    return _side == BID ? _price >= _limit : _price <= _limit;
+}
+
+template <typename T>
+array<long, MARKET_COUNT>& SimulatedExchange<T>::Consumed(ProductState& _state, PricingSide _side, Ticks _price) {
+    auto& consumed = _state.consumed[_side];
+    for (auto& [price, sizes] : consumed) {
+        if (price == _price.Count()) return sizes;
+    }
+    return consumed.emplace_back(_price.Count(), array<long, MARKET_COUNT>{}).second;
+}
+
+template <typename T>
+pair<size_t, size_t> SimulatedExchange<T>::Venues(const ExecutionOrder<T>& _order) {
+    if (!_order.HasVenue()) return {0, MARKET_COUNT};
+    return {static_cast<size_t>(_order.GetVenue()), static_cast<size_t>(_order.GetVenue()) + 1};
+}
+
+template <typename T>
+long SimulatedExchange<T>::Displayed(const ConsolidatedBook<T>& _book, PricingSide _side, Ticks _price,
+                                     const ExecutionOrder<T>& _order) {
+    for (const auto& level : _side == BID ? _book.GetBidLevels() : _book.GetOfferLevels()) {
+        if (level.price == _price) return _order.HasVenue() ? level.venueQuantities[_order.GetVenue()] : level.quantity;
+    }
+    return 0;
+}
+
+template <typename T>
+long SimulatedExchange<T>::Available(ProductState& _state, const ConsolidatedBook<T>& _book,
+                                     const ExecutionOrder<T>& _order, Ticks _limit) const {
+    PricingSide side = _order.GetPriceSide();
+    auto [first, last] = Venues(_order);
+    long available = 0;
+    for (const auto& level : side == BID ? _book.GetBidLevels() : _book.GetOfferLevels()) {
+        if (!Crosses(side, level.price, _limit)) break;
+        const auto& consumed = Consumed(_state, side, level.price);
+        for (size_t v = first; v < last; ++v) available += max(0L, level.venueQuantities[v] - consumed[v]);
+    }
+    return available;
+}
+
+template <typename T>
+long SimulatedExchange<T>::Take(ProductState& _state, const ConsolidatedBook<T>& _book, const ExecutionOrder<T>& _order,
+                                Ticks _limit, long _quantity, long _filledBefore, bool _passive) {
+    PricingSide side = _order.GetPriceSide();
+    long total = _order.GetVisibleQuantity() + _order.GetHiddenQuantity();
+    auto [first, last] = Venues(_order);
+    long taken = 0;
+    for (const auto& level : side == BID ? _book.GetBidLevels() : _book.GetOfferLevels()) {
+        if (taken == _quantity || !Crosses(side, level.price, _limit)) break;
+        auto& consumed = Consumed(_state, side, level.price);
+        long size = 0;
+        for (size_t v = first; v < last; ++v) {
+            long part = min(_quantity - taken - size, level.venueQuantities[v] - consumed[v]);
+            if (part <= 0) continue;
+            consumed[v] += part;
+            size += part;
+        }
+        if (size == 0) continue;
+        taken += size;
+        // An aggressive order trades at the resting price; a resting order at its own price
+        Publish(_order, _passive ? _order.GetPrice() : level.price, size, total - _filledBefore - taken, _passive);
+    }
+    return taken;
+}
+
+template <typename T>
+void SimulatedExchange<T>::Match(const ExecutionOrder<T>& _order) {
+    const string& productId = _order.GetProduct().GetProductId();
+    const ConsolidatedBook<T>& book = marketData.GetConsolidatedBook(productId);
+    ProductState& state = State(productId, book);
+    PricingSide side = _order.GetPriceSide();
+    long quantity = _order.GetVisibleQuantity() + _order.GetHiddenQuantity();
+    Ticks limit = _order.GetPrice();
+
+    // Stop orders are not supported
+    if (_order.GetOrderType() == STOP) {
+        ++unfilledCount;
+        PublishStatus(_order, ORDER_REJECTED);
+        return;
+    }
+    PublishStatus(_order, ORDER_ACKNOWLEDGED);
+
+    long filled = 0;
+    switch (_order.GetOrderType()) {
+        case MARKET:
+            limit = side == BID ? Ticks(numeric_limits<int64_t>::lowest()) : Ticks(numeric_limits<int64_t>::max());
+            filled = Take(state, book, _order, limit, quantity, 0, false);
+            break;
+        case IOC:
+            filled = Take(state, book, _order, limit, quantity, 0, false);
+            break;
+        case FOK:
+            if (Available(state, book, _order, limit) >= quantity) filled = Take(state, book, _order, limit, quantity, 0, false);
+            break;
+        case LIMIT:
+            filled = Place(state, book, _order, quantity);
+            if (filled == quantity) break;
+            return;
+        default:
+            break;
+    }
+    if (filled == 0) ++unfilledCount;
+    if (filled < quantity) PublishStatus(_order, ORDER_CANCELLED);
+}
+
+template <typename T>
+long SimulatedExchange<T>::Place(ProductState& _state, const ConsolidatedBook<T>& _book, const ExecutionOrder<T>& _order,
+                                 long _leaves) {
+    PricingSide side = _order.GetPriceSide();
+    Ticks limit = _order.GetPrice();
+    long total = _order.GetVisibleQuantity() + _order.GetHiddenQuantity();
+    long taken = Take(_state, _book, _order, limit, _leaves, total - _leaves, false);
+    if (taken == _leaves) return taken;
+
+    // The rest queues on the other side of the book behind its share of the displayed size, and behind
+    // every order resting at its price or better. Kept lowest priority first, orders near the touch are
+    // inserted and removed at the end.
+    long displayed = Displayed(_book, side == BID ? OFFER : BID, limit, _order);
+    auto& resting = _state.resting[side];
+    auto at = partition_point(resting.begin(), resting.end(),
+                              [&](const Resting& _r) { return !Crosses(side, limit, _r.order.GetPrice()); });
+    long leaves = _leaves - taken;
+    resting.insert(at, Resting{_order, leaves, min(_order.GetVisibleQuantity(), leaves),
+                               static_cast<long>(displayed * queueShare), displayed, _state.rematches});
+    ++restingCount;
+    return taken;
+}
+
+template <typename T>
+void SimulatedExchange<T>::ApplyAmendment(const ExecutionOrder<T>& _order) {
+    const string& productId = _order.GetProduct().GetProductId();
+    if (products.find(productId) == products.end()) return;
+    const ConsolidatedBook<T>& book = marketData.GetConsolidatedBook(productId);
+    ProductState& state = State(productId, book);
+
+    // An order that has filled or been cancelled in the meantime is not amended
+    auto& resting = state.resting[_order.GetPriceSide()];
+    auto r = find_if(resting.begin(), resting.end(),
+                     [&](const Resting& _r) { return _r.order.GetOrderId() == _order.GetOrderId(); });
+    if (r == resting.end()) return;
+    ++amendedCount;
+
+    // The new quantity caps what is left open; at the same price the order keeps its place in the queue
+    long leaves = min(r->leaves, _order.GetVisibleQuantity() + _order.GetHiddenQuantity());
+    if (leaves <= 0) {
+        // Nothing left open cancels the order
+        ExecutionOrder<T> order = r->order;
+        resting.erase(r);
+        --restingCount;
+        PublishStatus(order, ORDER_CANCELLED);
+        return;
+    }
+    if (r->order.GetPrice() == _order.GetPrice()) {
+        r->order = _order;
+        r->leaves = leaves;
+        r->shown = min({r->shown, _order.GetVisibleQuantity(), leaves});
+        return;
+    }
+
+    // At a new price what is left matches again as a new order, behind everything resting there
+    resting.erase(r);
+    --restingCount;
+    Place(state, book, _order, leaves);
+}
+
+template <typename T>
+void SimulatedExchange<T>::Rematch(const string& _productId) {
+    auto it = products.find(_productId);
+    if (it == products.end() || (it->second.resting[BID].empty() && it->second.resting[OFFER].empty())) return;
+    const ConsolidatedBook<T>& book = marketData.GetConsolidatedBook(_productId);
+    ProductState& state = State(_productId, book);
+
+    // Orders beyond the displayed depth of their side that the other side does not reach cannot fill, and
+    // neither can any order behind them in priority, so only the orders in reach are visited
+    uint64_t previous = state.rematches++;
+    for (PricingSide side : {BID, OFFER}) {
+        auto& resting = state.resting[side];
+        const auto& own = side == BID ? book.GetOfferLevels() : book.GetBidLevels();
+        const auto& other = side == BID ? book.GetBidLevels() : book.GetOfferLevels();
+        if (resting.empty() || (own.empty() && other.empty())) continue;
+        Ticks reach = own.empty() ? other.front().price : own.back().price;
+        if (!other.empty() && Crosses(side, other.front().price, reach)) reach = other.front().price;
+
+        uint64_t fillsBefore = fillCount;
+        auto r = resting.rbegin();
+        for (; r != resting.rend() && Crosses(side, reach, r->order.GetPrice()); ++r) {
+            long total = r->order.GetVisibleQuantity() + r->order.GetHiddenQuantity();
+
+            // The opposite side has traded through the order's price, filling the displayed part first
+            long traded = Take(state, book, r->order, r->order.GetPrice(), r->leaves, total - r->leaves, true);
+            r->leaves -= traded;
+            r->shown -= min(r->shown, traded);
+
+            // Size leaving the order's own level trades against the queue ahead of it first, provided the
+            // level was in reach at the previous update too
+            long displayed = Displayed(book, side == BID ? OFFER : BID, r->order.GetPrice(), r->order);
+            if (r->seenAt == previous && displayed < r->lastSeen && r->shown > 0) {
+                r->queueAhead -= r->lastSeen - displayed;
+                if (r->queueAhead < 0) {
+                    long size = min(-r->queueAhead, r->shown);
+                    r->leaves -= size;
+                    r->shown -= size;
+                    r->queueAhead = 0;
+                    Publish(r->order, r->order.GetPrice(), size, r->leaves, true);
+                }
+            }
+
+            // An iceberg whose displayed part has filled shows the next from the back of the queue
+            if (r->shown == 0 && r->leaves > 0) {
+                r->shown = min(r->order.GetVisibleQuantity(), r->leaves);
+                r->queueAhead = static_cast<long>(displayed * queueShare);
+            }
+            r->lastSeen = displayed;
+            r->seenAt = state.rematches;
+        }
+
+        // Only the orders visited can have filled
+        if (fillCount == fillsBefore) continue;
+        auto filled = remove_if(r.base(), resting.end(), [](const Resting& _r) { return _r.leaves <= 0; });
+        restingCount -= resting.end() - filled;
+        resting.erase(filled, resting.end());
+    }
+}
+
+template <typename T>
+void SimulatedExchange<T>::Publish(const ExecutionOrder<T>& _order, Ticks _price, long _quantity, long _leaves,
+                                   bool _passive) {
+    ++fillCount;
+    filledQuantity += _quantity;
+    Fill<T> fill(_order.GetProduct(), GenerateUniqueId(), _order.GetOrderId(), _order.GetPriceSide(), _price, _quantity,
+                 _leaves, _passive, clock ? clock->GetTime() : 0);
+    fill.SetTrace(_order.GetTrace());
+    OnMessage(fill);
+}
+
+template <typename T>
+void SimulatedExchange<T>::PublishStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    for (auto& l : statusListeners) l->ProcessStatus(_order, _state);
+}
+
+template <typename T>
+size_t SimulatedExchange<T>::GetRestingCount() const {
+    return restingCount;
+}
+
+template <typename T>
+uint64_t SimulatedExchange<T>::GetFillCount() const {
+    return fillCount;
+}
+
+template <typename T>
+uint64_t SimulatedExchange<T>::GetFilledQuantity() const {
+    return filledQuantity;
+}
+
+template <typename T>
+uint64_t SimulatedExchange<T>::GetUnfilledCount() const {
+    return unfilledCount;
+}
+
+template <typename T>
+uint64_t SimulatedExchange<T>::GetAmendedCount() const {
+    return amendedCount;
+}
+
+/**
+ * Listener sending the orders of the execution service to the simulated exchange.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerExchangeToExecution : public ServiceListener<ExecutionOrder<T>> {
+   public:
+    // Constructor taking the exchange
+    explicit ListenerExchangeToExecution(SimulatedExchange<T>* _exchange);
+    virtual ~ListenerExchangeToExecution() = default;
+
+    // Listener callback for an order sent by the execution service
+    void ProcessAdd(ExecutionOrder<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(ExecutionOrder<T>& _data);
+
+    // Listener callback for an amendment of an order sent
+    void ProcessUpdate(ExecutionOrder<T>& _data);
+
+   private:
+    SimulatedExchange<T>* exchange;  // Exchange receiving the orders
+};
+
+template <typename T>
+ListenerExchangeToExecution<T>::ListenerExchangeToExecution(SimulatedExchange<T>* _exchange) : exchange(_exchange) {}
+
+template <typename T>
+void ListenerExchangeToExecution<T>::ProcessAdd(ExecutionOrder<T>& _data) {
+    exchange->Submit(_data);
+}
+
+template <typename T>
+void ListenerExchangeToExecution<T>::ProcessRemove(ExecutionOrder<T>& _data) {}
+
+template <typename T>
+void ListenerExchangeToExecution<T>::ProcessUpdate(ExecutionOrder<T>& _data) {
+    exchange->Amend(_data);
+}
+
+/**
+ * Listener on the market data service rematching resting orders when a product's book changes.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerExchangeToMarketData : public BookDeltaListener<T> {
+   public:
+    // Constructor taking the exchange
+    explicit ListenerExchangeToMarketData(SimulatedExchange<T>* _exchange);
+    virtual ~ListenerExchangeToMarketData() = default;
+
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+   private:
+    // Rematch the resting orders of the book's product
+    void OnBook(const OrderBook<T>& _book);
+
+    SimulatedExchange<T>* exchange;  // Exchange to update
+};
+
+template <typename T>
+ListenerExchangeToMarketData<T>::ListenerExchangeToMarketData(SimulatedExchange<T>* _exchange) : exchange(_exchange) {}
+
+template <typename T>
+void ListenerExchangeToMarketData<T>::ProcessAdd(OrderBook<T>& _data) {
+    OnBook(_data);
+}
+
+template <typename T>
+void ListenerExchangeToMarketData<T>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T>
+void ListenerExchangeToMarketData<T>::ProcessUpdate(OrderBook<T>& _data) {
+    OnBook(_data);
+}
+
+template <typename T>
+void ListenerExchangeToMarketData<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    OnBook(_book);
+}
+
+template <typename T>
+void ListenerExchangeToMarketData<T>::OnBook(const OrderBook<T>& _book) {
+    exchange->Rematch(_book.GetProduct().GetProductId());
+}
+
+/**
+ * Listener on the exchange telling an AlgoExecutionService that makes markets of the fills and ends of its
+ * quotes, so that it replaces them. Register it on a PreTradeGate too, so that quotes and amendments the gate
+ * rejects are taken back. Defined here rather than with the service, as fills are defined here.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerAlgoToExchange : public OrderStatusListener<T> {
+   public:
+    // Constructor taking the service quoting
+    explicit ListenerAlgoToExchange(AlgoExecutionService<T>* _service);
+    virtual ~ListenerAlgoToExchange() = default;
+
+    // Listener callback for a fill
+    void ProcessAdd(Fill<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(Fill<T>& _data);
+
+    // No implementation needed for update event
+    void ProcessUpdate(Fill<T>& _data);
+
+    // Listener callback for an acknowledgement, cancellation or rejection of an order
+    void ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state);
+
+   private:
+    AlgoExecutionService<T>* service;  // Service quoting
+};
+
+template <typename T>
+ListenerAlgoToExchange<T>::ListenerAlgoToExchange(AlgoExecutionService<T>* _service) : service(_service) {}
+
+template <typename T>
+void ListenerAlgoToExchange<T>::ProcessAdd(Fill<T>& _data) {
+    service->OnQuoteFill(_data.GetProduct().GetProductId(), _data.GetOrderId(), _data.GetLeavesQuantity());
+}
+
+template <typename T>
+void ListenerAlgoToExchange<T>::ProcessRemove(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerAlgoToExchange<T>::ProcessUpdate(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerAlgoToExchange<T>::ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    if (_state == ORDER_CANCELLED) service->OnQuoteEnd(_order.GetProduct().GetProductId(), _order.GetOrderId());
+    if (_state == ORDER_REJECTED) service->OnQuoteRejected(_order.GetProduct().GetProductId(), _order.GetOrderId());
+}
+
+#endif
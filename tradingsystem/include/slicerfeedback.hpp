@@ -0,0 +1,66 @@
+/**
+ * slicerfeedback.hpp
+ * Defines ListenerExchangeToSlicer, which feeds the fills and order states of a SimulatedExchange back to an
+ * OrderSlicer. It lives apart from both so that the slicer does not depend on the venue simulator.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef SLICER_FEEDBACK_HPP
+#define SLICER_FEEDBACK_HPP
+
+#include "orderslicer.hpp"
+#include "orderstore.hpp"
+#include "simulatedexchange.hpp"
+
+using namespace std;
+
+/**
+ * Listener feeding the fills and order states of a SimulatedExchange back to an OrderSlicer, so that its
+ * icebergs finish once their child has filled and resend it if it ends unfilled. Register it on the exchange.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerExchangeToSlicer : public OrderStatusListener<T> {
+   public:
+    // Constructor taking the slicer working the parents
+    explicit ListenerExchangeToSlicer(OrderSlicer<T>* _slicer);
+    virtual ~ListenerExchangeToSlicer() = default;
+
+    // Listener callback for a fill
+    void ProcessAdd(Fill<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(Fill<T>& _data);
+
+    // No implementation needed for update event
+    void ProcessUpdate(Fill<T>& _data);
+
+    // Listener callback for an acknowledgement, cancellation or rejection of an order
+    void ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state);
+
+   private:
+    OrderSlicer<T>* slicer;  // Slicer working the parents
+};
+
+template <typename T>
+ListenerExchangeToSlicer<T>::ListenerExchangeToSlicer(OrderSlicer<T>* _slicer) : slicer(_slicer) {}
+
+template <typename T>
+void ListenerExchangeToSlicer<T>::ProcessAdd(Fill<T>& _data) {
+    slicer->OnChildFill(_data.GetOrderId(), _data.GetLeavesQuantity());
+}
+
+template <typename T>
+void ListenerExchangeToSlicer<T>::ProcessRemove(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerExchangeToSlicer<T>::ProcessUpdate(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerExchangeToSlicer<T>::ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    if (_state != ORDER_CANCELLED && _state != ORDER_REJECTED) return;
+    slicer->OnChildEnd(_order.GetOrderId());
+}
+
+#endif
@@ -0,0 +1,570 @@
+/**
+ * smartorderrouter.hpp
+ * Defines SmartOrderRouter, the stage between ExecutionService and the exchange that splits each execution
+ * order into child orders tagged with the venue they execute on.
+ *
+ * Register GetListener on the execution service in place of the exchange's listener, the exchange's listener
+ * on the router, GetExchangeListener on the exchange and GetMarketDataListener on the market data service.
+ * The listeners added with AddFillListener then see the order the execution service sent, not its children:
+ * fills of a child are reported as fills of its parent, the parent is acknowledged when its first child is,
+ * and what is left of it is cancelled, or rejected if no child was acknowledged, once every child is done.
+ *
+ * An order is routed from the top of book of each venue, kept per product in arrays indexed by Market that
+ * the market data listener refreshes on every book update. Venues showing size on the side the order hits
+ * are ranked by price net of their fee, then by the size they are expected to fill. Each venue crossing the
+ * order's limit is given, best first, its displayed size scaled by its fill rate, then what it displays
+ * beyond that; the rest goes to the best venue. A FOK order is not split, and goes to the best venue that
+ * displays all of it if there is one. Fill rates are running averages of the share of each child filled.
+ *
+ * An amendment of a routed order is passed on to its children still open: each moves to the new price and keeps
+ * what it has open, in the order they were routed, until the new quantity of the parent runs out.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef SMART_ORDER_ROUTER_HPP
+#define SMART_ORDER_ROUTER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "algoexecutionservice.hpp"
+#include "marketdataservice.hpp"
+#include "orderstore.hpp"
+#include "simulatedexchange.hpp"
+#include "soa.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+template <typename T>
+class ListenerRouterToExecution;
+
+template <typename T>
+class ListenerRouterToExchange;
+
+template <typename T>
+class ListenerRouterToMarketData;
+
+/**
+ * Router splitting execution orders across venues and following their children back to the parent.
+ * T: The product type.
+ */
+template <typename T>
+class SmartOrderRouter {
+   public:
+    // Weight of the latest child in a venue's fill rate
+    static constexpr double FILL_RATE_WEIGHT = 0.1;
+
+    // Constructor taking each venue's fee per unit of quantity, in ticks of price, indexed by Market
+    explicit SmartOrderRouter(const array<double, MARKET_COUNT>& _fees = {});
+    virtual ~SmartOrderRouter();
+
+    SmartOrderRouter(const SmartOrderRouter&) = delete;
+    SmartOrderRouter& operator=(const SmartOrderRouter&) = delete;
+
+    // Add a downstream listener for the child orders
+    void AddListener(ServiceListener<ExecutionOrder<T>>* _listener);
+
+    // Add a listener for the fills of parent orders; an OrderStatusListener is also told of their states
+    void AddFillListener(ServiceListener<Fill<T>>* _listener);
+
+    // Retrieve the listener to register on the execution service
+    ListenerRouterToExecution<T>* GetListener();
+
+    // Retrieve the listener to register on the exchange
+    ListenerRouterToExchange<T>* GetExchangeListener();
+
+    // Retrieve the listener to register on the market data service
+    ListenerRouterToMarketData<T>* GetMarketDataListener();
+
+    // Split an order's quantity across venues, indexed by Market
+    array<long, MARKET_COUNT> Allocate(const ExecutionOrder<T>& _order) const;
+
+    // Split an order and send its children downstream; throws if its identifier is already routed
+    void Route(const ExecutionOrder<T>& _order);
+
+    // Send an amendment of a routed order downstream as amendments of its open children; an order whose
+    // children are all done is left as it is
+    void Amend(const ExecutionOrder<T>& _order);
+
+    // Refresh the top of book of a venue
+    void OnBook(const OrderBook<T>& _book);
+
+    // Report a fill of a child as a fill of its parent
+    void OnFill(const Fill<T>& _fill);
+
+    // Follow a change of a child's state other than a fill
+    void OnStatus(const ExecutionOrder<T>& _order, OrderState _state);
+
+    // Number of parent orders routed
+    uint64_t GetParentCount() const;
+
+    // Number of child orders sent
+    uint64_t GetChildCount() const;
+
+    // Quantity sent to a venue
+    uint64_t GetRoutedQuantity(Market _venue) const;
+
+    // Quantity filled on a venue
+    uint64_t GetFilledQuantity(Market _venue) const;
+
+    // Running share of the quantity of a venue's children filled
+    double GetFillRate(Market _venue) const;
+
+   private:
+    /**
+     * Top of book of one product on every venue.
+     */
+    struct VenueTops {
+        array<int64_t, MARKET_COUNT> price[2]{};  // Best price per venue, by side of the book
+        array<long, MARKET_COUNT> size[2]{};      // Size at it per venue, zero when the side is empty
+    };
+
+    /**
+     * A parent order with children open.
+     */
+    struct Parent {
+        ExecutionOrder<T> order;
+        long leaves;            // Quantity not yet filled
+        uint32_t open;          // Children not yet done
+        bool acknowledged;      // Whether a child has been acknowledged
+        vector<string> childIds;  // Children in the order they were routed
+    };
+
+    /**
+     * A child order not yet done.
+     */
+    struct Child {
+        string parentId;
+        Market venue;
+        long quantity;          // Quantity sent
+        long filled;            // Quantity filled so far
+    };
+
+    // Whether _price is at or better than _limit for an order hitting _side
+    static bool Crosses(PricingSide _side, int64_t _price, Ticks _limit);
+
+    // Retire a child, updating its venue's fill rate and finishing its parent with the last child
+    void Done(typename unordered_map<string, Child>::iterator _child);
+
+    // Tell the status listeners of a change of a parent's state other than a fill
+    void PublishStatus(const ExecutionOrder<T>& _order, OrderState _state);
+
+    array<double, MARKET_COUNT> fees;                 // Fee per unit of quantity in ticks, per venue
+    array<double, MARKET_COUNT> fillRates;            // Running fill rate per venue
+    array<uint64_t, MARKET_COUNT> routedQuantity{};   // Quantity sent per venue
+    array<uint64_t, MARKET_COUNT> filledQuantity{};   // Quantity filled per venue
+    unordered_map<string, VenueTops> tops;            // Top of book of each product
+    unordered_map<string, Parent> parents;            // Parents with children open
+    unordered_map<string, Child> children;            // Children not yet done
+    vector<ServiceListener<ExecutionOrder<T>>*> listeners;  // Downstream listeners on child orders
+    vector<ServiceListener<Fill<T>>*> fillListeners;        // Listeners on parent fills
+    vector<OrderStatusListener<T>*> statusListeners;        // Listeners also on parent states
+    ListenerRouterToExecution<T>* executionListener;
+    ListenerRouterToExchange<T>* exchangeListener;
+    ListenerRouterToMarketData<T>* marketDataListener;
+    uint64_t parentCount = 0;                         // Parents routed
+    uint64_t childCount = 0;                          // Children sent
+};
+
+template <typename T>
+SmartOrderRouter<T>::SmartOrderRouter(const array<double, MARKET_COUNT>& _fees)
+    : fees(_fees),
+      executionListener(new ListenerRouterToExecution<T>(this)),
+      exchangeListener(new ListenerRouterToExchange<T>(this)),
+      marketDataListener(new ListenerRouterToMarketData<T>(this)) {
+    fillRates.fill(1.0);
+}
+
+template <typename T>
+SmartOrderRouter<T>::~SmartOrderRouter() {
+    delete executionListener;
+    delete exchangeListener;
+    delete marketDataListener;
+}
+
+template <typename T>
+void SmartOrderRouter<T>::AddListener(ServiceListener<ExecutionOrder<T>>* _listener) {
+    listeners.push_back(_listener);
+}
+
+template <typename T>
+void SmartOrderRouter<T>::AddFillListener(ServiceListener<Fill<T>>* _listener) {
+    fillListeners.push_back(_listener);
+    if (auto statusListener = dynamic_cast<OrderStatusListener<T>*>(_listener)) {
+        statusListeners.push_back(statusListener);
+    }
+}
+
+template <typename T>
+ListenerRouterToExecution<T>* SmartOrderRouter<T>::GetListener() {
+    return executionListener;
+}
+
+template <typename T>
+ListenerRouterToExchange<T>* SmartOrderRouter<T>::GetExchangeListener() {
+    return exchangeListener;
+}
+
+template <typename T>
+ListenerRouterToMarketData<T>* SmartOrderRouter<T>::GetMarketDataListener() {
+    return marketDataListener;
+}
+
+template <typename T>
+bool SmartOrderRouter<T>::Crosses(PricingSide _side, int64_t _price, Ticks _limit) {
+    // Selling into the bids needs a bid at or above the limit; buying from the offers an offer at or below it
+    return _side == BID ? _price >= _limit.Count() : _price <= _limit.Count();
+}
+
+template <typename T>
+array<long, MARKET_COUNT> SmartOrderRouter<T>::Allocate(const ExecutionOrder<T>& _order) const {
+    array<long, MARKET_COUNT> split{};
+    long quantity = _order.GetVisibleQuantity() + _order.GetHiddenQuantity();
+    auto it = tops.find(_order.GetProduct().GetProductId());
+    if (it == tops.end()) {
+        split[BROKERTEC] = quantity;
+        return split;
+    }
+    PricingSide side = _order.GetPriceSide();
+    const auto& price = it->second.price[side];
+    const auto& size = it->second.size[side];
+
+    // Best venue first: showing size, then the better price net of fees, then the larger expected fill
+    array<size_t, MARKET_COUNT> rank;
+    iota(rank.begin(), rank.end(), 0);
+    auto net = [&](size_t _v) { return side == BID ? price[_v] - fees[_v] : -(price[_v] + fees[_v]); };
+    sort(rank.begin(), rank.end(), [&](size_t _a, size_t _b) {
+        if ((size[_a] > 0) != (size[_b] > 0)) return size[_a] > 0;
+        if (net(_a) != net(_b)) return net(_a) > net(_b);
+        return size[_a] * fillRates[_a] > size[_b] * fillRates[_b];
+    });
+    auto eligible = [&](size_t _v) {
+        return size[_v] > 0 && (_order.GetOrderType() == MARKET || Crosses(side, price[_v], _order.GetPrice()));
+    };
+
+    if (_order.GetOrderType() == FOK) {
+        size_t venue = rank[0];
+        for (size_t v : rank) {
+            if (eligible(v) && size[v] >= quantity) {
+                venue = v;
+                break;
+            }
+        }
+        split[venue] = quantity;
+        return split;
+    }
+
+    long remaining = quantity;
+    for (size_t v : rank) {
+        if (!eligible(v)) continue;
+        long part = min(remaining, static_cast<long>(size[v] * fillRates[v]));
+        split[v] += part;
+        remaining -= part;
+    }
+    for (size_t v : rank) {
+        if (!eligible(v)) continue;
+        long part = min(remaining, size[v] - split[v]);
+        split[v] += part;
+        remaining -= part;
+    }
+    split[rank[0]] += remaining;
+    return split;
+}
+
+template <typename T>
+void SmartOrderRouter<T>::Route(const ExecutionOrder<T>& _order) {
+    array<long, MARKET_COUNT> split = Allocate(_order);
+    uint32_t count = 0;
+    for (long part : split) count += part > 0;
+    auto [parent, added] = parents.emplace(
+        _order.GetOrderId(), Parent{_order, _order.GetVisibleQuantity() + _order.GetHiddenQuantity(), count, false, {}});
+    if (!added) throw std::invalid_argument("Order " + _order.GetOrderId() + " is already routed");
+    ++parentCount;
+
+    // Every child is registered before any is sent, as the exchange may finish one before the next is built
+    vector<ExecutionOrder<T>> orders;
+    orders.reserve(count);
+    long visible = _order.GetVisibleQuantity();
+    for (size_t v = 0; v < MARKET_COUNT; ++v) {
+        if (split[v] == 0) continue;
+        long shown = min(visible, split[v]);
+        visible -= shown;
+        ExecutionOrder<T>& child = orders.emplace_back(_order.GetProduct(), _order.GetPriceSide(), GenerateUniqueId(),
+                                                       _order.GetOrderType(), _order.GetPrice(), shown,
+                                                       split[v] - shown, _order.GetOrderId(), true);
+        child.SetVenue(static_cast<Market>(v));
+        child.SetTrace(_order.GetTrace());
+        children.emplace(child.GetOrderId(), Child{_order.GetOrderId(), static_cast<Market>(v), split[v], 0});
+        parent->second.childIds.push_back(child.GetOrderId());
+        routedQuantity[v] += split[v];
+    }
+    childCount += count;
+    for (auto& child : orders) {
+        for (auto& l : listeners) l->ProcessAdd(child);
+    }
+}
+
+template <typename T>
+void SmartOrderRouter<T>::Amend(const ExecutionOrder<T>& _order) {
+    auto parent = parents.find(_order.GetOrderId());
+    if (parent == parents.end()) return;
+    Parent& p = parent->second;
+    p.order = _order;
+    p.leaves = min(p.leaves, _order.GetVisibleQuantity() + _order.GetHiddenQuantity());
+
+    // Built before any is sent, as the exchange may finish a child, and with the last one the parent, in between
+    vector<ExecutionOrder<T>> orders;
+    long quantity = p.leaves;
+    long visible = _order.GetVisibleQuantity();
+    for (const string& childId : p.childIds) {
+        auto child = children.find(childId);
+        if (child == children.end()) continue;
+        Child& c = child->second;
+        long open = min(c.quantity - c.filled, quantity);
+        quantity -= open;
+        c.quantity = c.filled + open;
+        long shown = min(visible, open);
+        visible -= shown;
+        ExecutionOrder<T>& order = orders.emplace_back(_order.GetProduct(), _order.GetPriceSide(), childId,
+                                                       _order.GetOrderType(), _order.GetPrice(), shown, open - shown,
+                                                       _order.GetOrderId(), true);
+        order.SetVenue(c.venue);
+        order.SetTrace(_order.GetTrace());
+    }
+    for (auto& order : orders) {
+        for (auto& l : listeners) l->ProcessUpdate(order);
+    }
+}
+
+template <typename T>
+void SmartOrderRouter<T>::OnBook(const OrderBook<T>& _book) {
+    VenueTops& venueTops = tops[_book.GetProduct().GetProductId()];
+    Market venue = _book.GetVenue();
+    span<const Order> bids = _book.GetBidStack();
+    span<const Order> offers = _book.GetOfferStack();
+    venueTops.price[BID][venue] = bids.empty() ? 0 : bids[0].GetPrice().Count();
+    venueTops.size[BID][venue] = bids.empty() ? 0 : bids[0].GetQuantity();
+    venueTops.price[OFFER][venue] = offers.empty() ? 0 : offers[0].GetPrice().Count();
+    venueTops.size[OFFER][venue] = offers.empty() ? 0 : offers[0].GetQuantity();
+}
+
+template <typename T>
+void SmartOrderRouter<T>::OnFill(const Fill<T>& _fill) {
+    auto child = children.find(_fill.GetOrderId());
+    if (child == children.end()) throw std::out_of_range("Order " + _fill.GetOrderId() + " was not routed");
+    Parent& parent = parents.at(child->second.parentId);
+    child->second.filled += _fill.GetQuantity();
+    parent.leaves -= _fill.GetQuantity();
+    filledQuantity[child->second.venue] += _fill.GetQuantity();
+
+    Fill<T> fill(_fill.GetProduct(), _fill.GetFillId(), parent.order.GetOrderId(), _fill.GetSide(), _fill.GetPrice(),
+                 _fill.GetQuantity(), parent.leaves, _fill.IsPassive(), _fill.GetTime());
+    fill.SetTrace(_fill.GetTrace());
+    for (auto& l : fillListeners) l->ProcessAdd(fill);
+    if (_fill.GetLeavesQuantity() == 0) Done(child);
+}
+
+template <typename T>
+void SmartOrderRouter<T>::OnStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    auto child = children.find(_order.GetOrderId());
+    if (child == children.end()) throw std::out_of_range("Order " + _order.GetOrderId() + " was not routed");
+    if (_state == ORDER_ACKNOWLEDGED) {
+        Parent& parent = parents.at(child->second.parentId);
+        if (!parent.acknowledged) {
+            parent.acknowledged = true;
+            PublishStatus(parent.order, ORDER_ACKNOWLEDGED);
+        }
+        return;
+    }
+    Done(child);
+}
+
+template <typename T>
+void SmartOrderRouter<T>::Done(typename unordered_map<string, Child>::iterator _child) {
+    const Child& child = _child->second;
+    // A child amended down to nothing before it traded says nothing about its venue
+    double& rate = fillRates[child.venue];
+    if (child.quantity > 0) rate += FILL_RATE_WEIGHT * (static_cast<double>(child.filled) / child.quantity - rate);
+
+    auto parent = parents.find(child.parentId);
+    children.erase(_child);
+    if (--parent->second.open > 0) return;
+    if (parent->second.leaves > 0) {
+        PublishStatus(parent->second.order, parent->second.acknowledged ? ORDER_CANCELLED : ORDER_REJECTED);
+    }
+    parents.erase(parent);
+}
+
+template <typename T>
+void SmartOrderRouter<T>::PublishStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    for (auto& l : statusListeners) l->ProcessStatus(_order, _state);
+}
+
+template <typename T>
+uint64_t SmartOrderRouter<T>::GetParentCount() const {
+    return parentCount;
+}
+
+template <typename T>
+uint64_t SmartOrderRouter<T>::GetChildCount() const {
+    return childCount;
+}
+
+template <typename T>
+uint64_t SmartOrderRouter<T>::GetRoutedQuantity(Market _venue) const {
+    return routedQuantity[_venue];
+}
+
+template <typename T>
+uint64_t SmartOrderRouter<T>::GetFilledQuantity(Market _venue) const {
+    return filledQuantity[_venue];
+}
+
+template <typename T>
+double SmartOrderRouter<T>::GetFillRate(Market _venue) const {
+    return fillRates[_venue];
+}
+
+/**
+ * Listener routing the orders of the execution service.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerRouterToExecution : public ServiceListener<ExecutionOrder<T>> {
+   public:
+    // Constructor taking the router
+    explicit ListenerRouterToExecution(SmartOrderRouter<T>* _router);
+    virtual ~ListenerRouterToExecution() = default;
+
+    // Listener callback for an order sent by the execution service
+    void ProcessAdd(ExecutionOrder<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(ExecutionOrder<T>& _data);
+
+    // Listener callback for an amendment of an order sent by the execution service
+    void ProcessUpdate(ExecutionOrder<T>& _data);
+
+   private:
+    SmartOrderRouter<T>* router;  // Router splitting the orders
+};
+
+template <typename T>
+ListenerRouterToExecution<T>::ListenerRouterToExecution(SmartOrderRouter<T>* _router) : router(_router) {}
+
+template <typename T>
+void ListenerRouterToExecution<T>::ProcessAdd(ExecutionOrder<T>& _data) {
+    router->Route(_data);
+}
+
+template <typename T>
+void ListenerRouterToExecution<T>::ProcessRemove(ExecutionOrder<T>& _data) {}
+
+template <typename T>
+void ListenerRouterToExecution<T>::ProcessUpdate(ExecutionOrder<T>& _data) {
+    router->Amend(_data);
+}
+
+/**
+ * Listener on the exchange following the fills and states of child orders.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerRouterToExchange : public OrderStatusListener<T> {
+   public:
+    // Constructor taking the router
+    explicit ListenerRouterToExchange(SmartOrderRouter<T>* _router);
+    virtual ~ListenerRouterToExchange() = default;
+
+    // Listener callback for a fill of a child order
+    void ProcessAdd(Fill<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(Fill<T>& _data);
+
+    // No implementation needed for update event
+    void ProcessUpdate(Fill<T>& _data);
+
+    // Listener callback for an acknowledgement, cancellation or rejection of a child order
+    void ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state);
+
+   private:
+    SmartOrderRouter<T>* router;  // Router following the children
+};
+
+template <typename T>
+ListenerRouterToExchange<T>::ListenerRouterToExchange(SmartOrderRouter<T>* _router) : router(_router) {}
+
+template <typename T>
+void ListenerRouterToExchange<T>::ProcessAdd(Fill<T>& _data) {
+    router->OnFill(_data);
+}
+
+template <typename T>
+void ListenerRouterToExchange<T>::ProcessRemove(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerRouterToExchange<T>::ProcessUpdate(Fill<T>& _data) {}
+
+template <typename T>
+void ListenerRouterToExchange<T>::ProcessStatus(const ExecutionOrder<T>& _order, OrderState _state) {
+    router->OnStatus(_order, _state);
+}
+
+/**
+ * Listener on the market data service keeping the router's per-venue top of book up to date.
+ * T: The product type.
+ */
+template <typename T>
+class ListenerRouterToMarketData : public BookDeltaListener<T> {
+   public:
+    // Constructor taking the router
+    explicit ListenerRouterToMarketData(SmartOrderRouter<T>* _router);
+    virtual ~ListenerRouterToMarketData() = default;
+
+    // Listener callback for a book snapshot
+    void ProcessAdd(OrderBook<T>& _data);
+
+    // No implementation needed for remove event
+    void ProcessRemove(OrderBook<T>& _data);
+
+    // Listener callback for a book update
+    void ProcessUpdate(OrderBook<T>& _data);
+
+    // Listener callback for a delta applied to the live book
+    void ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book);
+
+   private:
+    SmartOrderRouter<T>* router;  // Router to update
+};
+
+template <typename T>
+ListenerRouterToMarketData<T>::ListenerRouterToMarketData(SmartOrderRouter<T>* _router) : router(_router) {}
+
+template <typename T>
+void ListenerRouterToMarketData<T>::ProcessAdd(OrderBook<T>& _data) {
+    router->OnBook(_data);
+}
+
+template <typename T>
+void ListenerRouterToMarketData<T>::ProcessRemove(OrderBook<T>& _data) {}
+
+template <typename T>
+void ListenerRouterToMarketData<T>::ProcessUpdate(OrderBook<T>& _data) {
+    router->OnBook(_data);
+}
+
+template <typename T>
+void ListenerRouterToMarketData<T>::ProcessDelta(BookDelta<T>& _delta, OrderBook<T>& _book) {
+    if (_delta.ChangedTop(_book)) router->OnBook(_book);
+}
+
+#endif
@@ -9,12 +9,19 @@
 #define SOA_HPP
 
 #include <vector>
+#include <span>
 #include <fstream>
 #include <unordered_map>
 #include "utils.hpp"
+#include "coroutine.hpp"
+#include "metrics.hpp"
+#include "tracing.hpp"
 
 using namespace std;
 
+template<typename K, typename V>
+class Service;
+
 /**
 * Definition of a generic base class ServiceListener to listen to add, update, and remove
 * events on a Service. This listener should be registered on a Service for the Service
@@ -35,6 +42,19 @@ public:
 	// Listener callback to process an update event to the Service
 	virtual void ProcessUpdate(V& _data) = 0;
 
+	// Listener callback to process a batch of add events to the Service.
+	// Defaults to one ProcessAdd per element; listeners that can amortize work across a batch override it.
+	virtual void ProcessAddBatch(span<V> _data);
+
+private:
+
+	template<typename K, typename U>
+	friend class Service;
+
+#ifdef ENABLE_METRICS
+	ListenerMetrics* metrics = nullptr;
+#endif
+
 };
 
 /**
@@ -53,6 +73,10 @@ public:
 	// The callback that a Connector should invoke for any new or updated data
 	virtual void OnMessage(V& _data) = 0;
 
+	// The callback that a Connector may invoke with a batch of new or updated data.
+	// Defaults to one OnMessage per element.
+	virtual void OnMessageBatch(span<V> _data);
+
 	// Add a listener to the Service for callbacks on add, remove, and update events
  	// for data to the Service.
 	virtual void AddListener(ServiceListener<V>* _listener) = 0;
@@ -60,8 +84,210 @@ public:
 	// Get all listeners on the Service.
 	virtual const vector<ServiceListener<V>*>& GetListeners() const = 0;
 
+	// Consume a channel until it is closed. Whatever is queued, up to _batchSize messages,
+	// is delivered per call: OnMessage when _batchSize is 1, otherwise OnMessageBatch.
+	Task Drain(BoundedChannel<V>& _channel, size_t _batchSize = 1);
+
+protected:
+
+	// Notify listeners of an add event, timing each callback when metrics are enabled
+	void NotifyAdd(const vector<ServiceListener<V>*>& _listeners, V& _data);
+
+	// Notify listeners of a batch of add events through ProcessAddBatch
+	void NotifyAddBatch(const vector<ServiceListener<V>*>& _listeners, span<V> _data);
+
+	// Notify listeners of an update event, timing each callback when metrics are enabled
+	void NotifyUpdate(const vector<ServiceListener<V>*>& _listeners, V& _data);
+
+	// Count an OnMessage call; the returned guard times the call when metrics are enabled
+	MessageTimer TrackMessage();
+
+	// Count an OnMessageBatch call covering _count messages
+	MessageTimer TrackMessageBatch(size_t _count);
+
+	// Record the current depth of the input queue feeding this Service
+	void TrackQueueDepth(size_t _depth);
+
+private:
+
+#ifdef ENABLE_METRICS
+	// Metrics entry of this Service, registered under its dynamic type name on first use
+	ServiceMetrics& Metrics();
+
+	ServiceMetrics* metrics = nullptr;
+#endif
+
 };
 
+template<typename V>
+void ServiceListener<V>::ProcessAddBatch(span<V> _data)
+{
+	for (auto& d : _data)
+	{
+		ProcessAdd(d);
+	}
+}
+
+template<typename K, typename V>
+void Service<K, V>::OnMessageBatch(span<V> _data)
+{
+	for (auto& d : _data)
+	{
+		OnMessage(d);
+	}
+}
+
+template<typename K, typename V>
+Task Service<K, V>::Drain(BoundedChannel<V>& _channel, size_t _batchSize)
+{
+	vector<V> _batch;
+	_batch.reserve(_batchSize);
+	while (optional<V> _message = co_await _channel.Pop())
+	{
+		TrackQueueDepth(_channel.GetSize() + 1);
+		_batch.push_back(std::move(*_message));
+		while (_batch.size() < _batchSize)
+		{
+			optional<V> _next = _channel.TryPop();
+			if (!_next) break;
+			_batch.push_back(std::move(*_next));
+		}
+
+		if (_batchSize == 1) OnMessage(_batch.front());
+		else OnMessageBatch(_batch);
+		_batch.clear();
+	}
+}
+
+#ifdef ENABLE_METRICS
+
+template<typename K, typename V>
+ServiceMetrics& Service<K, V>::Metrics()
+{
+	if (!metrics) metrics = &MetricsRegistry::Instance().RegisterService(MetricsRegistry::TypeName(typeid(*this)));
+	return *metrics;
+}
+
+template<typename K, typename V>
+void Service<K, V>::NotifyAdd(const vector<ServiceListener<V>*>& _listeners, V& _data)
+{
+	ServiceMetrics& serviceMetrics = Metrics();
+	++serviceMetrics.published;
+	for (auto& l : _listeners)
+	{
+		if (!l->metrics)
+			l->metrics = &MetricsRegistry::Instance().RegisterListener(MetricsRegistry::TypeName(typeid(*l)), serviceMetrics.name);
+		uint64_t start = MetricsNow();
+		l->ProcessAdd(_data);
+		++l->metrics->calls;
+		l->metrics->processAdd.Record(MetricsNow() - start);
+	}
+	MetricsRegistry::Instance().Poll();
+}
+
+template<typename K, typename V>
+void Service<K, V>::NotifyAddBatch(const vector<ServiceListener<V>*>& _listeners, span<V> _data)
+{
+	if (_data.empty()) return;
+	ServiceMetrics& serviceMetrics = Metrics();
+	serviceMetrics.published += _data.size();
+	for (auto& l : _listeners)
+	{
+		if (!l->metrics)
+			l->metrics = &MetricsRegistry::Instance().RegisterListener(MetricsRegistry::TypeName(typeid(*l)), serviceMetrics.name);
+		uint64_t start = MetricsNow();
+		l->ProcessAddBatch(_data);
+		// A batch is recorded as its amortized per-message latency
+		l->metrics->calls += _data.size();
+		l->metrics->processAdd.Record((MetricsNow() - start) / _data.size(), _data.size());
+	}
+	MetricsRegistry::Instance().Poll();
+}
+
+template<typename K, typename V>
+void Service<K, V>::NotifyUpdate(const vector<ServiceListener<V>*>& _listeners, V& _data)
+{
+	ServiceMetrics& serviceMetrics = Metrics();
+	++serviceMetrics.updated;
+	for (auto& l : _listeners)
+	{
+		if (!l->metrics)
+			l->metrics = &MetricsRegistry::Instance().RegisterListener(MetricsRegistry::TypeName(typeid(*l)), serviceMetrics.name);
+		uint64_t start = MetricsNow();
+		l->ProcessUpdate(_data);
+		++l->metrics->updates;
+		l->metrics->processUpdate.Record(MetricsNow() - start);
+	}
+	MetricsRegistry::Instance().Poll();
+}
+
+template<typename K, typename V>
+MessageTimer Service<K, V>::TrackMessage()
+{
+	return MessageTimer(Metrics());
+}
+
+template<typename K, typename V>
+MessageTimer Service<K, V>::TrackMessageBatch(size_t _count)
+{
+	return MessageTimer(Metrics(), _count);
+}
+
+template<typename K, typename V>
+void Service<K, V>::TrackQueueDepth(size_t _depth)
+{
+	ServiceMetrics& serviceMetrics = Metrics();
+	serviceMetrics.queueDepth = _depth;
+	if (_depth > serviceMetrics.maxQueueDepth) serviceMetrics.maxQueueDepth = _depth;
+}
+
+#else
+
+template<typename K, typename V>
+inline void Service<K, V>::NotifyAdd(const vector<ServiceListener<V>*>& _listeners, V& _data)
+{
+	for (auto& l : _listeners)
+	{
+		l->ProcessAdd(_data);
+	}
+}
+
+template<typename K, typename V>
+inline void Service<K, V>::NotifyAddBatch(const vector<ServiceListener<V>*>& _listeners, span<V> _data)
+{
+	if (_data.empty()) return;
+	for (auto& l : _listeners)
+	{
+		l->ProcessAddBatch(_data);
+	}
+}
+
+template<typename K, typename V>
+inline void Service<K, V>::NotifyUpdate(const vector<ServiceListener<V>*>& _listeners, V& _data)
+{
+	for (auto& l : _listeners)
+	{
+		l->ProcessUpdate(_data);
+	}
+}
+
+template<typename K, typename V>
+inline MessageTimer Service<K, V>::TrackMessage()
+{
+	return MessageTimer();
+}
+
+template<typename K, typename V>
+inline MessageTimer Service<K, V>::TrackMessageBatch(size_t)
+{
+	return MessageTimer();
+}
+
+template<typename K, typename V>
+inline void Service<K, V>::TrackQueueDepth(size_t) {}
+
+#endif
+
 /**
  * Definition of a Connector class.
  * This will invoke the Service.OnMessage() method for subscriber Connectors
@@ -38,6 +38,7 @@ public:
     const vector<ServiceListener<PriceStream<T>>*>& GetListeners() const;  // Get all listeners
     ServiceListener<AlgoStream<T>>* GetListener();  // Get the listener for AlgoStream
     void PublishPrice(PriceStream<T>& _priceStream);  // Notify listeners of new price streams
+    void PublishPrices(span<PriceStream<T>> _priceStreams);  // Notify listeners of a batch of price streams
 };
 
 template<typename T>
@@ -57,6 +58,7 @@ PriceStream<T>& StreamingService<T>::GetData(string _key)
 template<typename T>
 void StreamingService<T>::OnMessage(PriceStream<T>& _data)
 {
+    auto timer = this->TrackMessage();
     priceStreams[_data.GetProduct().GetProductId()] = _data;
 }
 
@@ -81,10 +83,18 @@ ServiceListener<AlgoStream<T>>* StreamingService<T>::GetListener()
 template<typename T>
 void StreamingService<T>::PublishPrice(PriceStream<T>& _priceStream)
 {
-    for (auto& l : listeners)
+    LatencyTracer::Instance().Record(TRACE_STREAMING, _priceStream.GetTrace());
+    this->NotifyAdd(listeners, _priceStream);
+}
+
+template<typename T>
+void StreamingService<T>::PublishPrices(span<PriceStream<T>> _priceStreams)
+{
+    for (auto& priceStream : _priceStreams)
     {
-        l->ProcessAdd(_priceStream);
+        LatencyTracer::Instance().Record(TRACE_STREAMING, priceStream.GetTrace());
     }
+    this->NotifyAddBatch(listeners, _priceStreams);
 }
 
 /**
@@ -97,12 +107,14 @@ class ListenerStreamToAlgoStream : public ServiceListener<AlgoStream<T>>
 
 private:
     StreamingService<T>* service; // Reference to the parent StreamingService
+    vector<PriceStream<T>> batch; // Reused buffer of price streams forwarded as one batch
 
 public:
     ListenerStreamToAlgoStream(StreamingService<T>* _service);  // Constructor
     virtual ~ListenerStreamToAlgoStream() = default;  // Default destructor
 
     void ProcessAdd(AlgoStream<T>& _data);  // Handle new AlgoStream additions
+    void ProcessAddBatch(span<AlgoStream<T>> _data) override;  // Handle a batch of AlgoStream additions
     void ProcessRemove(AlgoStream<T>& _data);  // Handle AlgoStream removals (not implemented)
     void ProcessUpdate(AlgoStream<T>& _data);  // Handle AlgoStream updates (not implemented)
 };
@@ -120,6 +132,20 @@ void ListenerStreamToAlgoStream<T>::ProcessAdd(AlgoStream<T>& _data)
     service->PublishPrice(*_priceStream);  // Notify listeners of the new price stream
 }
 
+template<typename T>
+void ListenerStreamToAlgoStream<T>::ProcessAddBatch(span<AlgoStream<T>> _data)
+{
+    batch.clear();
+    batch.reserve(_data.size());
+    for (auto& algoStream : _data)
+    {
+        PriceStream<T>* _priceStream = algoStream.GetPriceStream();
+        service->OnMessage(*_priceStream);
+        batch.push_back(*_priceStream);
+    }
+    service->PublishPrices(batch);
+}
+
 template<typename T>
 void ListenerStreamToAlgoStream<T>::ProcessRemove(AlgoStream<T>& _data) {}
 
@@ -0,0 +1,133 @@
+/**
+ * ticks.hpp
+ * Defines Ticks, the integer price type used by orders, prices, trades and inquiries.
+ *
+ * US Treasury prices are quoted in 32nds with an optional eighth of a 32nd, so every price in the
+ * system is an exact multiple of 1/256. Holding the count of 1/256ths in an int64 keeps comparisons,
+ * spreads and hashing exact, where the previous double representation relied on float equality.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef TICKS_HPP
+#define TICKS_HPP
+
+#include <charconv>
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/**
+ * A price or price difference counted in 1/256ths of a point.
+ */
+class Ticks {
+   public:
+    static constexpr int64_t PER_POINT = 256;  // Ticks in one price point
+    static constexpr int64_t PER_32ND = 8;     // Ticks in one 32nd
+
+    constexpr Ticks() = default;
+    constexpr explicit Ticks(int64_t _count) : count(_count) {}
+
+    // A whole number of price points
+    static constexpr Ticks FromPoints(int64_t _points) { return Ticks(_points * PER_POINT); }
+
+    // The nearest tick to a decimal price
+    static Ticks FromDouble(double _price) { return Ticks(llround(_price * PER_POINT)); }
+
+    // Parse the fractional format "X-YZa": whole points, two digits of 32nds, and an optional
+    // eighth of a 32nd where '+' stands for 4
+    static Ticks Parse(string_view _text);
+
+    // Characters Format writes at most
+    static constexpr size_t MAX_CHARS = 24;
+
+    // Format in the fractional format "X-YZa"
+    string ToString() const;
+
+    // Format in the fractional format into _buffer, which must hold MAX_CHARS characters; returns the length
+    size_t Format(char* _buffer) const;
+
+    // Number of 1/256ths
+    constexpr int64_t Count() const { return count; }
+
+    // Decimal value of the price
+    constexpr double ToDouble() const { return static_cast<double>(count) / PER_POINT; }
+
+    constexpr Ticks operator+(Ticks _other) const { return Ticks(count + _other.count); }
+    constexpr Ticks operator-(Ticks _other) const { return Ticks(count - _other.count); }
+    constexpr Ticks operator-() const { return Ticks(-count); }
+    constexpr Ticks operator*(int64_t _factor) const { return Ticks(count * _factor); }
+    constexpr Ticks& operator+=(Ticks _other) {
+        count += _other.count;
+        return *this;
+    }
+    constexpr Ticks& operator-=(Ticks _other) {
+        count -= _other.count;
+        return *this;
+    }
+
+    constexpr auto operator<=>(const Ticks&) const = default;
+
+   private:
+    int64_t count = 0;
+};
+
+Ticks Ticks::Parse(string_view _text) {
+    auto digit = [&](char _c) -> int64_t {
+        if (_c < '0' || _c > '9') throw std::invalid_argument("Malformed price: " + string(_text));
+        return _c - '0';
+    };
+
+    size_t dash = _text.find('-');
+    string_view whole = _text.substr(0, dash);
+    if (whole.empty()) throw std::invalid_argument("Malformed price: " + string(_text));
+
+    int64_t points = 0;
+    for (char c : whole) points = points * 10 + digit(c);
+    if (dash == string_view::npos) return FromPoints(points);
+
+    string_view fraction = _text.substr(dash + 1);
+    if (fraction.size() < 2 || fraction.size() > 3) throw std::invalid_argument("Malformed price: " + string(_text));
+    int64_t thirtySeconds = digit(fraction[0]) * 10 + digit(fraction[1]);
+    int64_t eighths = fraction.size() == 3 ? (fraction[2] == '+' ? 4 : digit(fraction[2])) : 0;
+    if (thirtySeconds >= 32 || eighths >= PER_32ND) throw std::invalid_argument("Malformed price: " + string(_text));
+
+    return Ticks(points * PER_POINT + thirtySeconds * PER_32ND + eighths);
+}
+
+string Ticks::ToString() const {
+    char buffer[MAX_CHARS];
+    return string(buffer, Format(buffer));
+}
+
+size_t Ticks::Format(char* _buffer) const {
+    // Floor division so that negative values keep a non-negative fraction
+    int64_t points = count / PER_POINT;
+    int64_t fraction = count % PER_POINT;
+    if (fraction < 0) {
+        fraction += PER_POINT;
+        --points;
+    }
+    int64_t thirtySeconds = fraction / PER_32ND;
+    int64_t eighths = fraction % PER_32ND;
+
+    char* end = to_chars(_buffer, _buffer + MAX_CHARS - 4, points).ptr;
+    *end++ = '-';
+    *end++ = static_cast<char>('0' + thirtySeconds / 10);
+    *end++ = static_cast<char>('0' + thirtySeconds % 10);
+    *end++ = eighths == 4 ? '+' : static_cast<char>('0' + eighths);
+    return end - _buffer;
+}
+
+template <>
+struct std::hash<Ticks> {
+    size_t operator()(Ticks _ticks) const noexcept { return std::hash<int64_t>()(_ticks.Count()); }
+};
+
+#endif
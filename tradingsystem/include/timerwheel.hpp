@@ -0,0 +1,158 @@
+/**
+ * timerwheel.hpp
+ * Defines TimerWheel, a hashed timing wheel for scheduling many timers in logical time.
+ *
+ * Time is divided into ticks of a fixed resolution and the wheel has a power-of-two number of slots,
+ * one per tick modulo the slot count. A timer is an intrusive node linked into the slot of the tick it
+ * falls due in, so scheduling and cancelling are O(1) and advancing by one tick only visits the timers
+ * of one slot. Timers further away than one turn of the wheel share slots with nearer ones and are
+ * skipped until their turn comes round.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Intrusive link of a timer. Embed it in the object being scheduled; a node may be on one wheel at a time.
+ */
+struct TimerNode {
+    TimerNode* next = nullptr;  // Next node in the slot, or nullptr when not scheduled
+    TimerNode* prev = nullptr;  // Previous node in the slot
+    uint64_t deadline = 0;      // Time the timer falls due
+
+    // Whether the node is on a wheel
+    bool IsScheduled() const { return next != nullptr; }
+};
+
+/**
+ * Hashed timing wheel over intrusive TimerNodes. The wheel does not own the nodes; a node must be
+ * cancelled before it is destroyed.
+ */
+class TimerWheel {
+   public:
+    // Constructor taking the length of a tick and the number of slots (rounded up to a power of two)
+    TimerWheel(uint64_t _resolution, size_t _slots);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Schedule a node to fall due at _deadline, moving it if already scheduled. A deadline that has
+    // already passed falls due on the next tick.
+    void Schedule(TimerNode* _node, uint64_t _deadline);
+
+    // Remove a node from the wheel; does nothing if it is not scheduled
+    void Cancel(TimerNode* _node);
+
+    // Advance to time _now and call _fire(node) for every node that has fallen due, after unlinking it.
+    // _fire may schedule the node again.
+    template <typename F>
+    void Advance(uint64_t _now, F&& _fire);
+
+    // Length of a tick
+    uint64_t GetResolution() const;
+
+    // Number of scheduled nodes
+    size_t GetSize() const;
+
+   private:
+    // Link a node at the front of a slot
+    void Link(TimerNode* _node, size_t _slot);
+
+    // Unlink a node from its slot
+    static void Unlink(TimerNode* _node);
+
+    uint64_t resolution;       // Length of a tick
+    uint64_t mask;             // Slot count minus one
+    uint64_t tick = 0;         // Last tick advanced through
+    size_t size = 0;           // Nodes scheduled
+    vector<TimerNode> slots;   // Sentinel of the circular list of each slot
+};
+
+TimerWheel::TimerWheel(uint64_t _resolution, size_t _slots)
+    : resolution(_resolution), mask(bit_ceil(max<size_t>(_slots, 1)) - 1), slots(mask + 1) {
+    if (_resolution == 0) throw std::invalid_argument("Timer wheel resolution must be positive");
+    for (auto& slot : slots) slot.next = slot.prev = &slot;
+}
+
+void TimerWheel::Schedule(TimerNode* _node, uint64_t _deadline) {
+    Cancel(_node);
+    _node->deadline = _deadline;
+    // A node is due once the wheel has advanced through the first tick starting at or after its deadline
+    uint64_t due = _deadline / resolution + (_deadline % resolution != 0);
+    Link(_node, max(due, tick + 1) & mask);
+}
+
+void TimerWheel::Cancel(TimerNode* _node) {
+    if (!_node->IsScheduled()) return;
+    Unlink(_node);
+    --size;
+}
+
+template <typename F>
+void TimerWheel::Advance(uint64_t _now, F&& _fire) {
+    uint64_t target = _now / resolution;
+    if (target <= tick) return;
+
+    // One turn visits every slot, so a longer jump needs no more steps than there are slots
+    uint64_t steps = min<uint64_t>(target - tick, mask + 1);
+    TimerNode due;
+    due.next = due.prev = &due;
+    for (uint64_t t = tick + 1; t <= tick + steps; ++t) {
+        TimerNode& slot = slots[t & mask];
+        for (TimerNode* node = slot.next; node != &slot;) {
+            TimerNode* next = node->next;
+            if (node->deadline <= _now) {
+                Unlink(node);
+                node->next = due.next;
+                node->prev = &due;
+                due.next->prev = node;
+                due.next = node;
+            }
+            node = next;
+        }
+    }
+    tick = target;
+
+    // Fire in the order the ticks came round; a node is unlinked before its callback so it can be rescheduled
+    while (due.prev != &due) {
+        TimerNode* node = due.prev;
+        Unlink(node);
+        --size;
+        _fire(node);
+    }
+}
+
+uint64_t TimerWheel::GetResolution() const {
+    return resolution;
+}
+
+size_t TimerWheel::GetSize() const {
+    return size;
+}
+
+void TimerWheel::Link(TimerNode* _node, size_t _slot) {
+    TimerNode& head = slots[_slot];
+    _node->next = head.next;
+    _node->prev = &head;
+    head.next->prev = _node;
+    head.next = _node;
+    ++size;
+}
+
+void TimerWheel::Unlink(TimerNode* _node) {
+    _node->prev->next = _node->next;
+    _node->next->prev = _node->prev;
+    _node->next = _node->prev = nullptr;
+}
+
+#endif
@@ -0,0 +1,247 @@
+/**
+ * tracing.hpp
+ * Defines end-to-end latency tracing across the service chain.
+ *
+ * A message entering the system through a connector is stamped with a sequence id and a
+ * TSC-based origin timestamp. Every derived message (OrderBook -> AlgoExecution -> ExecutionOrder
+ * -> Trade -> Position -> PV01, and Price -> AlgoStream -> PriceStream) carries the same trace
+ * context, and each stage it reaches records both the hop latency since the previous stage and
+ * the end-to-end latency since the origin.
+ *
+ * Stamping and recording are compiled in only when ENABLE_TRACING is defined; otherwise the
+ * trace context is an empty base and every hook is an empty inline function.
+ *
+ * @author Fangtong Wang
+ */
+
+#ifndef TRACING_HPP
+#define TRACING_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "metrics.hpp"
+
+using namespace std;
+
+/**
+ * Time stamp counter clock calibrated against steady_clock.
+ * Falls back to steady_clock nanoseconds on targets without a TSC.
+ */
+class TscClock {
+   public:
+    // Read the raw counter
+    static uint64_t Now();
+
+    // Convert a counter delta to nanoseconds
+    static uint64_t ToNanos(uint64_t _ticks);
+
+    // Nanoseconds per counter tick, measured once on first use
+    static double NanosPerTick();
+};
+
+inline uint64_t TscClock::Now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+inline uint64_t TscClock::ToNanos(uint64_t _ticks) { return static_cast<uint64_t>(_ticks * NanosPerTick()); }
+
+double TscClock::NanosPerTick() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double nanosPerTick = [] {
+        auto wallStart = chrono::steady_clock::now();
+        uint64_t tscStart = __rdtsc();
+        this_thread::sleep_for(chrono::milliseconds(20));
+        auto wallEnd = chrono::steady_clock::now();
+        uint64_t tscEnd = __rdtsc();
+        double nanos = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(wallEnd - wallStart).count());
+        return nanos / static_cast<double>(tscEnd - tscStart);
+    }();
+    return nanosPerTick;
+#else
+    return 1.0;
+#endif
+}
+
+/**
+ * Trace context carried by a message and everything derived from it.
+ * A sequence id of zero marks a message that did not enter through a traced connector.
+ */
+struct TraceContext {
+    uint64_t sequence = 0;   // Sequence id assigned at the origin
+    uint64_t originTsc = 0;  // Counter value when the originating input was read
+    uint64_t hopTsc = 0;     // Counter value at the last recorded stage
+};
+
+/**
+ * Stages recorded along the market data and price chains.
+ */
+enum TraceStage {
+    TRACE_MARKET_DATA,
+    TRACE_ALGO_EXECUTION,
+    TRACE_EXECUTION,
+    TRACE_EXECUTION_PERSIST,
+    TRACE_TRADE_BOOKING,
+    TRACE_POSITION,
+    TRACE_RISK,
+    TRACE_PRICE,
+    TRACE_ALGO_STREAM,
+    TRACE_STREAMING,
+    TRACE_STREAMING_PERSIST,
+    TRACE_STAGE_COUNT
+};
+
+/**
+ * Base class for messages that carry a trace context.
+ * Empty when tracing is compiled out, so it adds nothing to the derived type.
+ */
+class Traced {
+   public:
+#ifdef ENABLE_TRACING
+    // Get the trace context
+    const TraceContext& GetTrace() const { return trace; }
+    TraceContext& GetTrace() { return trace; }
+
+    // Adopt the trace context of the message this one was derived from
+    void SetTrace(const TraceContext& _trace) { trace = _trace; }
+
+   private:
+    TraceContext trace;
+#else
+    // Get the trace context
+    const TraceContext& GetTrace() const { return empty; }
+    TraceContext& GetTrace() { return empty; }
+
+    // Adopt the trace context of the message this one was derived from
+    void SetTrace(const TraceContext&) {}
+
+   private:
+    static inline TraceContext empty;
+#endif
+};
+
+/**
+ * Process-wide recorder of per-hop and end-to-end latencies for every TraceStage.
+ */
+class LatencyTracer {
+   public:
+    // Access the process-wide tracer
+    static LatencyTracer& Instance();
+
+    // Start a new trace at an input boundary
+    TraceContext Begin();
+
+    // Record that a traced message reached a stage, and advance its hop timestamp
+    void Record(TraceStage _stage, TraceContext& _trace);
+
+    // Write per-stage hop and end-to-end latency percentiles
+    void Report(ostream& _out) const;
+
+    // Write per-stage hop and end-to-end latency histograms as JSON
+    void ReportJson(ostream& _out) const;
+
+    // Write the table and JSON report to <_prefix>.txt and <_prefix>.json
+    void Dump(const string& _prefix = "latency") const;
+
+    // Display name of a stage
+    static const char* StageName(TraceStage _stage);
+
+   private:
+    LatencyTracer();
+
+    uint64_t nextSequence = 1;
+    array<LatencyHistogram, TRACE_STAGE_COUNT> hopLatency;
+    array<LatencyHistogram, TRACE_STAGE_COUNT> endToEndLatency;
+};
+
+// Calibrate the clock up front so the first traced messages do not pay for it
+LatencyTracer::LatencyTracer() {
+#ifdef ENABLE_TRACING
+    TscClock::NanosPerTick();
+#endif
+}
+
+LatencyTracer& LatencyTracer::Instance() {
+    static LatencyTracer tracer;
+    return tracer;
+}
+
+#ifdef ENABLE_TRACING
+
+inline TraceContext LatencyTracer::Begin() {
+    uint64_t now = TscClock::Now();
+    return TraceContext{nextSequence++, now, now};
+}
+
+inline void LatencyTracer::Record(TraceStage _stage, TraceContext& _trace) {
+    if (_trace.sequence == 0) return;
+    uint64_t now = TscClock::Now();
+    hopLatency[_stage].Record(TscClock::ToNanos(now - _trace.hopTsc));
+    endToEndLatency[_stage].Record(TscClock::ToNanos(now - _trace.originTsc));
+    _trace.hopTsc = now;
+}
+
+#else
+
+inline TraceContext LatencyTracer::Begin() { return TraceContext(); }
+
+inline void LatencyTracer::Record(TraceStage, TraceContext&) {}
+
+#endif
+
+const char* LatencyTracer::StageName(TraceStage _stage) {
+    static const char* names[TRACE_STAGE_COUNT] = {
+        "marketdata",  "algoexecution", "execution", "executions.txt", "tradebooking", "position",
+        "risk",        "pricing",       "algostream", "streaming",     "streaming.txt"};
+    return names[_stage];
+}
+
+void LatencyTracer::Report(ostream& _out) const {
+    _out << left << setw(16) << "STAGE" << right << setw(12) << "COUNT" << setw(12) << "HOP P50" << setw(12)
+         << "HOP P99" << setw(12) << "E2E P50" << setw(12) << "E2E P99" << setw(12) << "E2E P99.9" << setw(14)
+         << "E2E MAX" << "\n";
+    for (int s = 0; s < TRACE_STAGE_COUNT; ++s) {
+        const auto& hop = hopLatency[s];
+        const auto& e2e = endToEndLatency[s];
+        _out << left << setw(16) << StageName(TraceStage(s)) << right << setw(12) << e2e.GetCount() << setw(12)
+             << hop.GetPercentile(50) << setw(12) << hop.GetPercentile(99) << setw(12) << e2e.GetPercentile(50)
+             << setw(12) << e2e.GetPercentile(99) << setw(12) << e2e.GetPercentile(99.9) << setw(14) << e2e.GetMax()
+             << "\n";
+    }
+}
+
+void LatencyTracer::ReportJson(ostream& _out) const {
+    _out << "{\"unit\":\"ns\",\"stages\":[";
+    for (int s = 0; s < TRACE_STAGE_COUNT; ++s) {
+        _out << (s ? "," : "") << "{\"stage\":\"" << StageName(TraceStage(s)) << "\",\"hop\":";
+        hopLatency[s].WriteJson(_out);
+        _out << ",\"endToEnd\":";
+        endToEndLatency[s].WriteJson(_out);
+        _out << "}";
+    }
+    _out << "]}\n";
+}
+
+void LatencyTracer::Dump(const string& _prefix) const {
+    ofstream table(_prefix + ".txt", ios::trunc);
+    Report(table);
+    ofstream json(_prefix + ".json", ios::trunc);
+    ReportJson(json);
+}
+
+#endif
@@ -12,6 +12,8 @@
 #include <vector>
 #include "soa.hpp"
 #include "executionservice.hpp"
+#include "inquiryservice.hpp"
+#include "simulatedexchange.hpp"
 
 
 /**
@@ -19,7 +21,7 @@
 * Type T is the product type.
 */
 template<typename T>
-class Trade
+class Trade : public Traced
 {
 
 public:
@@ -28,7 +30,7 @@ public:
 	Trade() = default;
 
 	// ctor for a trade
-	Trade(const T& _product, string _tradeId, double _price, string _book, long _quantity, Side _side);
+	Trade(const T& _product, string _tradeId, Ticks _price, string _book, long _quantity, Side _side);
 
 	// Get the product
 	const T& GetProduct() const;
@@ -37,7 +39,7 @@ public:
 	const string& GetTradeId() const;
 
 	// Get the mid price
-	double GetPrice() const;
+	Ticks GetPrice() const;
 
 	// Get the book
 	const string& GetBook() const;
@@ -52,7 +54,7 @@ private:
 
 	T product;
 	string tradeId;
-	double price;
+	Ticks price;
 	string book;
 	long quantity;
 	Side side;
@@ -60,7 +62,7 @@ private:
 };
 
 template<typename T>
-Trade<T>::Trade(const T& _product, string _tradeId, double _price, string _book, long _quantity, Side _side) :
+Trade<T>::Trade(const T& _product, string _tradeId, Ticks _price, string _book, long _quantity, Side _side) :
 	product(_product)
 {
 	tradeId = _tradeId;
@@ -83,7 +85,7 @@ const string& Trade<T>::GetTradeId() const
 }
 
 template<typename T>
-double Trade<T>::GetPrice() const
+Ticks Trade<T>::GetPrice() const
 {
 	return price;
 }
@@ -113,6 +115,8 @@ template<typename T>
 class TradeBookingConnector;
 template<typename T>
 class TradeBookingToExecutionListener;
+template<typename T>
+class TradeBookingToFillListener;
 
 /**
 * Trade Booking Service to book trades to a particular book.
@@ -129,6 +133,7 @@ private:
 	vector<ServiceListener<Trade<T>>*> listeners;
 	TradeBookingConnector<T>* connector;
 	TradeBookingToExecutionListener<T>* listener;
+	TradeBookingToFillListener<T>* fillListener;
 
 public:
 
@@ -142,6 +147,9 @@ public:
 	// The callback that a Connector should invoke for any new or updated data
 	void OnMessage(Trade<T>& _data);
 
+	// The callback that a Connector should invoke for a batch of new or updated data
+	void OnMessageBatch(span<Trade<T>> _data);
+
 	// Add a listener to the Service for callbacks on add, remove, and update events for data to the Service
 	void AddListener(ServiceListener<Trade<T>>* _listener);
 
@@ -154,6 +162,9 @@ public:
 	// Get the listener of the service
 	TradeBookingToExecutionListener<T>* GetListener();
 
+	// Get the listener booking fills of the simulated exchange
+	TradeBookingToFillListener<T>* GetFillListener();
+
 	// Book the trade
 	void BookTrade(Trade<T>& _trade);
 
@@ -166,6 +177,7 @@ TradeBookingService<T>::TradeBookingService()
 	listeners = vector<ServiceListener<Trade<T>>*>();
 	connector = new TradeBookingConnector<T>(this);
 	listener = new TradeBookingToExecutionListener<T>(this);
+	fillListener = new TradeBookingToFillListener<T>(this);
 }
 
 template<typename T>
@@ -180,12 +192,22 @@ Trade<T>& TradeBookingService<T>::GetData(string _key)
 template<typename T>
 void TradeBookingService<T>::OnMessage(Trade<T>& _data)
 {
+	auto timer = this->TrackMessage();
 	trades[_data.GetTradeId()] = _data;
 
-	for (auto& l : listeners)
+	this->NotifyAdd(listeners, _data);
+}
+
+template<typename T>
+void TradeBookingService<T>::OnMessageBatch(span<Trade<T>> _data)
+{
+	auto timer = this->TrackMessageBatch(_data.size());
+	for (auto& _trade : _data)
 	{
-		l->ProcessAdd(_data);
+		trades[_trade.GetTradeId()] = _trade;
 	}
+
+	this->NotifyAddBatch(listeners, _data);
 }
 
 template<typename T>
@@ -212,13 +234,16 @@ TradeBookingToExecutionListener<T>* TradeBookingService<T>::GetListener()
 	return listener;
 }
 
+template<typename T>
+TradeBookingToFillListener<T>* TradeBookingService<T>::GetFillListener()
+{
+	return fillListener;
+}
+
 template<typename T>
 void TradeBookingService<T>::BookTrade(Trade<T>& _trade)
 {
-	for (auto& l : listeners)
-	{
-		l->ProcessAdd(_trade);
-	}
+	this->NotifyAdd(listeners, _trade);
 }
 
 /**
@@ -245,6 +270,12 @@ public:
 	// Subscribe data from the Connector
 	void Subscribe(ifstream& _data);
 
+	// Parse the input one trade at a time
+	Generator<Trade<T>> Read(ifstream& _data);
+
+	// Number of trades delivered to the service per OnMessageBatch call
+	static constexpr size_t BATCH_SIZE = 256;
+
 };
 
 template<typename T>
@@ -261,6 +292,27 @@ void TradeBookingConnector<T>::Publish(Trade<T>& _data) {}
 
 template<typename T>
 void TradeBookingConnector<T>::Subscribe(ifstream& _data)
+{
+	vector<Trade<T>> _batch;
+	_batch.reserve(BATCH_SIZE);
+	for (auto& _trade : Read(_data))
+	{
+		_batch.push_back(_trade);
+		if (_batch.size() == BATCH_SIZE)
+		{
+			service->OnMessageBatch(_batch);
+			_batch.clear();
+		}
+	}
+
+	if (!_batch.empty())
+	{
+		service->OnMessageBatch(_batch);
+	}
+}
+
+template<typename T>
+Generator<Trade<T>> TradeBookingConnector<T>::Read(ifstream& _data)
 {
 	string _line;
 	while (getline(_data, _line))
@@ -275,15 +327,14 @@ void TradeBookingConnector<T>::Subscribe(ifstream& _data)
 
 		string _productId = _cells[0];
 		string _tradeId = _cells[1];
-		double _price = ParsePrice(_cells[2]);
+		Ticks _price = Ticks::Parse(_cells[2]);
 		string _book = _cells[3];
 		long _quantity = stol(_cells[4]);
 		Side _side;
 		if (_cells[5] == "BUY") _side = BUY;
 		else if (_cells[5] == "SELL") _side = SELL;
 		T _product = BondInfo(_productId);
-		Trade<T> _trade(_product, _tradeId, _price, _book, _quantity, _side);
-		service->OnMessage(_trade);
+		co_yield Trade<T>(_product, _tradeId, _price, _book, _quantity, _side);
 	}
 }
 
@@ -334,7 +385,7 @@ void TradeBookingToExecutionListener<T>::ProcessAdd(ExecutionOrder<T>& _data)
 	T _product = _data.GetProduct();
 	PricingSide _pricingSide = _data.GetPriceSide();
 	string _orderId = _data.GetOrderId();
-	double _price = _data.GetPrice();
+	Ticks _price = _data.GetPrice();
 	long _visibleQuantity = _data.GetVisibleQuantity();
 	long _hiddenQuantity = _data.GetHiddenQuantity();
 
@@ -364,6 +415,8 @@ void TradeBookingToExecutionListener<T>::ProcessAdd(ExecutionOrder<T>& _data)
 	long _quantity = _visibleQuantity + _hiddenQuantity;
 
 	Trade<T> _trade(_product, _orderId, _price, _book, _quantity, _side);
+	_trade.SetTrace(_data.GetTrace());
+	LatencyTracer::Instance().Record(TRACE_TRADE_BOOKING, _trade.GetTrace());
 	service->OnMessage(_trade);
 	service->BookTrade(_trade);
 }
@@ -374,4 +427,77 @@ void TradeBookingToExecutionListener<T>::ProcessRemove(ExecutionOrder<T>& _data)
 template<typename T>
 void TradeBookingToExecutionListener<T>::ProcessUpdate(ExecutionOrder<T>& _data) {}
 
+/**
+* Trade Booking Service Listener booking the fills of the Simulated Exchange, one trade per fill.
+* Unlike TradeBookingToExecutionListener, only the quantity that actually filled is booked, at the fill price.
+* Type T is the product type.
+*/
+template<typename T>
+class TradeBookingToFillListener : public ServiceListener<Fill<T>>
+{
+
+private:
+
+	TradeBookingService<T>* service;
+	long count;
+
+public:
+
+	// Connector and Destructor
+	TradeBookingToFillListener(TradeBookingService<T>* _service);
+	~TradeBookingToFillListener();
+
+	// Listener callback to process an add event to the Service
+	void ProcessAdd(Fill<T>& _data);
+
+	// Listener callback to process a remove event to the Service
+	void ProcessRemove(Fill<T>& _data);
+
+	// Listener callback to process an update event to the Service
+	void ProcessUpdate(Fill<T>& _data);
+
+};
+
+template<typename T>
+TradeBookingToFillListener<T>::TradeBookingToFillListener(TradeBookingService<T>* _service)
+{
+	service = _service;
+	count = 0;
+}
+
+template<typename T>
+TradeBookingToFillListener<T>::~TradeBookingToFillListener() {}
+
+template<typename T>
+void TradeBookingToFillListener<T>::ProcessAdd(Fill<T>& _data)
+{
+	count++;
+	Side _side = _data.GetSide() == BID ? SELL : BUY;
+	string _book;
+	switch (count % 3)
+	{
+	case 0:
+		_book = "TRSY1";
+		break;
+	case 1:
+		_book = "TRSY2";
+		break;
+	case 2:
+		_book = "TRSY3";
+		break;
+	}
+
+	Trade<T> _trade(_data.GetProduct(), _data.GetFillId(), _data.GetPrice(), _book, _data.GetQuantity(), _side);
+	_trade.SetTrace(_data.GetTrace());
+	LatencyTracer::Instance().Record(TRACE_TRADE_BOOKING, _trade.GetTrace());
+	service->OnMessage(_trade);
+	service->BookTrade(_trade);
+}
+
+template<typename T>
+void TradeBookingToFillListener<T>::ProcessRemove(Fill<T>& _data) {}
+
+template<typename T>
+void TradeBookingToFillListener<T>::ProcessUpdate(Fill<T>& _data) {}
+
 #endif
@@ -12,36 +12,52 @@
 #define UTILS_HPP
 
 #include <chrono>
+#include <ctime>
 #include <iostream>
 #include <random>
 #include <sstream>
 #include <string>
 #include <unordered_map>
 
+#include "idgenerator.hpp"
 #include "products.hpp"
+#include "ticks.hpp"
 
 using namespace std;
 using namespace chrono;
 
 
+// Characters FormatCurrentTime writes at most
+constexpr size_t TIME_STRING_CHARS = 32;
+
 /**
- * Gets the current system time as a string with millisecond precision.
- * @return A string representing the current time in the format "YYYY-MM-DD HH:MM:SS.sss".
+ * Writes the current system time with millisecond precision into a buffer, without allocating.
+ * @param _buffer A buffer of at least TIME_STRING_CHARS characters.
+ * @return The number of characters written, in the format "YYYY-MM-DD HH:MM:SS.sss".
  */
-std::string CurrentTimeString() {
-    using namespace std::chrono;
-
+size_t FormatCurrentTime(char* _buffer) {
     auto now = system_clock::now();
     auto secPart = time_point_cast<seconds>(now);
     auto msPart = duration_cast<milliseconds>(now - secPart);
 
     std::time_t rawTime = system_clock::to_time_t(now);
-    char buffer[24];
-    std::strftime(buffer, sizeof(buffer), "%F %T", std::localtime(&rawTime));
+    size_t length = std::strftime(_buffer, TIME_STRING_CHARS, "%F %T", std::localtime(&rawTime));
+
+    long millis = msPart.count();
+    _buffer[length++] = '.';
+    _buffer[length++] = static_cast<char>('0' + millis / 100);
+    _buffer[length++] = static_cast<char>('0' + millis / 10 % 10);
+    _buffer[length++] = static_cast<char>('0' + millis % 10);
+    return length;
+}
 
-    std::ostringstream result;
-    result << buffer << "." << std::setfill('0') << std::setw(3) << msPart.count();
-    return result.str();
+/**
+ * Gets the current system time as a string with millisecond precision.
+ * @return A string representing the current time in the format "YYYY-MM-DD HH:MM:SS.sss".
+ */
+std::string CurrentTimeString() {
+    char buffer[TIME_STRING_CHARS];
+    return std::string(buffer, FormatCurrentTime(buffer));
 }
 
 /**
@@ -57,25 +73,11 @@ long CurrentMillSecond() {
 
 /**
  * Generates a unique 12-character alphanumeric identifier.
+ * Identifiers never repeat within or across threads, or across restarts; see IdGenerator.
  * @return A string representing the unique identifier.
  */
 std::string GenerateUniqueId() {
-    std::string baseChars;
-    for (char c = '0'; c <= '9'; ++c) baseChars.push_back(c);
-    for (char c = 'A'; c <= 'Z'; ++c) baseChars.push_back(c);
-
-    unsigned long seed = static_cast<unsigned long>(std::chrono::steady_clock::now().time_since_epoch().count());
-    std::mt19937_64 rng(seed);
-    std::uniform_real_distribution<double> dist(0.0, 1.0);
-
-    std::string id;
-    id.reserve(12);
-    for (int i = 0; i < 12; ++i) {
-        int index = static_cast<int>(dist(rng) * baseChars.size());
-        id.push_back(baseChars[index % baseChars.size()]);
-    }
-
-    return id;
+    return IdGenerator::Next().ToString();
 }
 
 /**
@@ -153,49 +155,17 @@ Bond BondInfo(const std::string& _cusip) {
  * @return The parsed price as a double.
  */
 double ParsePrice(const std::string& inputPrice) {
-    std::string partWhole, part32, part8;
-    int dashCount = 0;
-
-    for (char ch : inputPrice) {
-        if (ch == '-') {
-            dashCount++;
-            continue;
-        }
-        if (dashCount == 0)
-            partWhole.push_back(ch);
-        else if (dashCount > 0 && dashCount < 3)
-            part32.push_back(ch), dashCount++;
-        else if (dashCount == 3)
-            part8.push_back(ch == '+' ? '4' : ch);
-    }
-
-    double wholeVal = partWhole.empty() ? 0.0 : std::stod(partWhole);
-    double val32 = part32.empty() ? 0.0 : std::stod(part32);
-    double val8 = part8.empty() ? 0.0 : std::stod(part8);
-
-    return wholeVal + val32 / 32.0 + val8 / 256.0;
+    return Ticks::Parse(inputPrice).ToDouble();
 }
 
 /**
  * Formats a decimal price into a string representation in the format "X-YZ+a".
+ * Prices between two ticks are rounded down.
  * @param price The price as a double.
  * @return The formatted price string.
  */
 std::string FormatPrice(double price) {
-    int integerPart = static_cast<int>(std::floor(price));
-    double fraction = price - integerPart;
-
-    int fraction256 = static_cast<int>(std::floor(fraction * 256.0));
-    int fraction32 = fraction256 / 8;
-    int fraction8 = fraction256 % 8;
-
-    std::ostringstream oss32;
-    oss32 << (fraction32 < 10 ? "0" : "") << fraction32;
-    std::string part8 = (fraction8 == 4) ? "+" : std::to_string(fraction8);
-
-    std::ostringstream result;
-    result << integerPart << "-" << oss32.str() << part8;
-    return result.str();
+    return Ticks(static_cast<int64_t>(std::floor(price * Ticks::PER_POINT))).ToString();
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,323 @@
+/**
+ * backtest.cpp
+ * Replays recorded market data into a single AlgoExecutionService for each configuration of a grid of execution
+ * parameters, crossing the spread and making markets, and reports the PnL, fills and replay rate of each, and
+ * for market making the amendments per book update and the time per quoting decision.
+ *
+ * The books are read once, from the market data file of the trading system or from a binary capture written
+ * by an earlier run, and shared by all configurations. Each configuration runs on a worker thread of its own
+ * with its own market data service, algo and SimulatedExchange as the fill model, so nothing is shared but the
+ * books. The replay is a coroutine on a scheduler per configuration, spreading the books evenly over a trading
+ * session of logical time, and orders reach the exchange after the configuration's latency in that time.
+ * PnL is in dollars of face value, from the fills plus the position left marked to the last consolidated mid
+ * quoted on both sides.
+ * Metrics and tracing record into process-wide state, so with either compiled in the grid runs on one thread.
+ *
+ * Usage: backtest [marketdata.txt | capture.bin] [threads] [capture to write]
+ *
+ * @author Fangtong Wang
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "algoexecutionservice.hpp"
+#include "bookcapture.hpp"
+#include "coroutine.hpp"
+#include "marketdataservice.hpp"
+#include "products.hpp"
+#include "simulatedexchange.hpp"
+#include "utils.hpp"
+
+using namespace std;
+
+// Logical length of the session the books are spread over, as in the trading system
+constexpr uint64_t SESSION_NANOS = 6'500'000'000'000ULL;
+
+/**
+ * One configuration of the grid.
+ */
+struct BacktestConfig {
+    AlgoExecutionParameters parameters;  // Execution logic
+    uint64_t latency;                    // Latency from order to exchange in nanoseconds
+};
+
+/**
+ * Outcome of replaying the books under one configuration.
+ */
+struct BacktestResult {
+    uint64_t orders = 0;          // Orders sent by the algo
+    uint64_t fills = 0;           // Fills published by the exchange
+    long filledQuantity = 0;      // Quantity filled
+    double pnl = 0;               // Dollars of face value, marked to the last two-sided mid
+    double booksPerSecond = 0;    // Replay rate
+    double amendsPerBook = 0;     // Quote amendments per book update quoted on
+    uint64_t decisionP50 = 0;     // Median time per quoting decision in nanoseconds
+    uint64_t decisionP99 = 0;     // 99th percentile time per quoting decision in nanoseconds
+    exception_ptr error;          // Failure of the replay, if any
+};
+
+/**
+ * Listener sending each order and amendment of the algo to the exchange.
+ */
+class AlgoToExchange : public ServiceListener<AlgoExecution<Bond>> {
+   public:
+    explicit AlgoToExchange(SimulatedExchange<Bond>& _exchange) : exchange(_exchange) {}
+
+    void ProcessAdd(AlgoExecution<Bond>& _data) {
+        exchange.Submit(*_data.RetrieveExecutionOrder());
+        ++orders;
+    }
+    void ProcessRemove(AlgoExecution<Bond>& _data) {}
+    void ProcessUpdate(AlgoExecution<Bond>& _data) { exchange.Amend(*_data.RetrieveExecutionOrder()); }
+
+    SimulatedExchange<Bond>& exchange;
+    uint64_t orders = 0;
+};
+
+/**
+ * Listener accounting for the cash and position of each product from the fills.
+ */
+class FillAccount : public ServiceListener<Fill<Bond>> {
+   public:
+    void ProcessAdd(Fill<Bond>& _data) {
+        // A BID order sells into the bids, an OFFER order buys from the offers
+        long quantity = _data.GetSide() == BID ? -_data.GetQuantity() : _data.GetQuantity();
+        Account& account = accounts[_data.GetProduct().GetProductId()];
+        account.position += quantity;
+        account.cash -= Dollars(_data.GetPrice().Count(), quantity);
+        filledQuantity += _data.GetQuantity();
+        ++fills;
+    }
+    void ProcessRemove(Fill<Bond>& _data) {}
+    void ProcessUpdate(Fill<Bond>& _data) {}
+
+    // Value in dollars of a quantity of face value at a price in ticks
+    static double Dollars(double _ticks, long _quantity) {
+        return _ticks / Ticks::PER_POINT / 100 * static_cast<double>(_quantity);
+    }
+
+    struct Account {
+        long position = 0;   // Face value held
+        double cash = 0;     // Dollars received less dollars paid
+    };
+
+    unordered_map<string, Account> accounts;
+    uint64_t fills = 0;
+    long filledQuantity = 0;
+};
+
+/**
+ * Listener keeping the mid of each product's consolidated book as of the last update that left both sides quoted.
+ */
+class LastMid : public ServiceListener<OrderBook<Bond>> {
+   public:
+    explicit LastMid(BondMarketDataService<Bond>& _marketData) : marketData(_marketData) {}
+
+    void ProcessAdd(OrderBook<Bond>& _data) {
+        const string& productId = _data.GetProduct().GetProductId();
+        BidOffer top = marketData.GetBestBidOffer(productId);
+        if (top.GetBidOrder().GetQuantity() <= 0 || top.GetOfferOrder().GetQuantity() <= 0) return;
+        mids[productId] = (static_cast<double>(top.GetBidOrder().GetPrice().Count()) +
+                           static_cast<double>(top.GetOfferOrder().GetPrice().Count())) / 2;
+    }
+    void ProcessRemove(OrderBook<Bond>& _data) {}
+    void ProcessUpdate(OrderBook<Bond>& _data) {}
+
+    BondMarketDataService<Bond>& marketData;
+    unordered_map<string, double> mids;  // Mid in ticks, by product
+};
+
+/**
+ * Feed the captured books to the market data service one interval of logical time apart, delivering the orders
+ * that have reached the exchange before each book, and the last orders after the last book.
+ */
+Task Replay(Scheduler& _scheduler, const BookCapture<Bond>& _capture, BondMarketDataService<Bond>& _marketData,
+            SimulatedExchange<Bond>& _exchange, uint64_t _interval, uint64_t _latency) {
+    uint64_t time = 0;
+    for (size_t i = 0; i < _capture.GetSize(); ++i) {
+        _exchange.Advance(time);
+        OrderBook<Bond> book = _capture.Book(i);
+        _marketData.OnMessage(book);
+        time += _interval;
+        co_await _scheduler.Yield(time);
+    }
+    _exchange.Advance(time + _latency);
+}
+
+/**
+ * Replay the books under one configuration.
+ */
+BacktestResult Run(const BookCapture<Bond>& _capture, const BacktestConfig& _config) {
+    BacktestResult result;
+    Scheduler scheduler(TIMESTAMP);
+    BondMarketDataService<Bond> marketData;
+    AlgoExecutionService<Bond> algo(_config.parameters);
+    SimulatedExchange<Bond> exchange(marketData, &scheduler, _config.latency);
+    AlgoToExchange router(exchange);
+    ListenerAlgoToExchange<Bond> quotes(&algo);
+    FillAccount account;
+    LastMid lastMid(marketData);
+
+    algo.SetMarketDataService(&marketData);
+    marketData.AddListener(&lastMid);
+    marketData.AddListener(algo.GetListener());
+    marketData.AddListener(exchange.GetMarketDataListener());
+    algo.AddListener(&router);
+    exchange.AddListener(&account);
+    exchange.AddListener(&quotes);
+
+    uint64_t interval = max<uint64_t>(1, SESSION_NANOS / max<size_t>(1, _capture.GetSize()));
+    auto start = chrono::steady_clock::now();
+    scheduler.Spawn(Replay(scheduler, _capture, marketData, exchange, interval, _config.latency));
+    scheduler.Run();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    result.orders = router.orders;
+    result.fills = account.fills;
+    result.filledQuantity = account.filledQuantity;
+    for (const auto& [productId, position] : account.accounts) {
+        // A product never quoted on both sides has no mid to mark to
+        auto mid = lastMid.mids.find(productId);
+        if (mid == lastMid.mids.end()) continue;
+        result.pnl += position.cash + FillAccount::Dollars(mid->second, position.position);
+    }
+    result.booksPerSecond = seconds > 0 ? _capture.GetSize() / seconds : 0;
+    if (algo.GetQuoteUpdates() > 0) {
+        result.amendsPerBook = static_cast<double>(algo.GetQuoteAmendments()) / algo.GetQuoteUpdates();
+        result.decisionP50 = algo.GetDecisionLatency().GetPercentile(50);
+        result.decisionP99 = algo.GetDecisionLatency().GetPercentile(99);
+    }
+    return result;
+}
+
+/**
+ * The grid of configurations swept: crossing the spread, spread threshold x side rule x size fraction x latency,
+ * then making markets, quote offset x amend threshold x size fraction x latency.
+ */
+vector<BacktestConfig> Grid() {
+    vector<BacktestConfig> grid;
+    for (long spread : {2L, 4L, 8L}) {
+        for (ExecutionSideRule rule : {ALTERNATE_SIDES, FOLLOW_IMBALANCE, FADE_IMBALANCE}) {
+            for (double fraction : {0.1, 0.5, 1.0}) {
+                for (uint64_t latency : {0ULL, 10'000'000ULL}) {
+                    AlgoExecutionParameters parameters;
+                    parameters.spreadThreshold = Ticks(spread);
+                    parameters.sideRule = rule;
+                    parameters.sizeFraction = fraction;
+                    grid.push_back({parameters, latency});
+                }
+            }
+        }
+    }
+    for (long offset : {0L, 2L}) {
+        for (long amend : {1L, 2L, 4L}) {
+            for (double fraction : {0.1, 1.0}) {
+                for (uint64_t latency : {0ULL, 10'000'000ULL}) {
+                    AlgoExecutionParameters parameters;
+                    parameters.mode = MAKE_MARKET;
+                    parameters.quoteOffset = Ticks(offset);
+                    parameters.amendThreshold = Ticks(amend);
+                    parameters.sizeFraction = fraction;
+                    grid.push_back({parameters, latency});
+                }
+            }
+        }
+    }
+    return grid;
+}
+
+/**
+ * Short description of the execution logic of a configuration, with prices in ticks of 1/256th.
+ */
+string Describe(const AlgoExecutionParameters& _parameters) {
+    ostringstream description;
+    description << EXECUTION_MODE_NAMES[_parameters.mode] << ' ';
+    if (_parameters.mode == MAKE_MARKET) {
+        description << "offset " << _parameters.quoteOffset.Count() << " amend " << _parameters.amendThreshold.Count();
+    } else {
+        description << "spread " << _parameters.spreadThreshold.Count() << ' '
+                    << EXECUTION_SIDE_RULE_NAMES[_parameters.sideRule];
+    }
+    description << " size " << fixed << setprecision(2) << _parameters.sizeFraction;
+    return description.str();
+}
+
+int main(int argc, char* argv[]) {
+    string input = argc > 1 ? argv[1] : "marketdata.txt";
+    size_t threads = argc > 2 ? static_cast<size_t>(atol(argv[2])) : thread::hardware_concurrency();
+#if defined(ENABLE_METRICS) || defined(ENABLE_TRACING)
+    threads = 1;
+#endif
+    threads = max<size_t>(1, threads);
+
+    // Read the books once: a capture as it is, market data through the trading system's connector
+    auto load = chrono::steady_clock::now();
+    BookCapture<Bond> capture;
+    if (input.size() > 4 && input.compare(input.size() - 4, 4, ".bin") == 0) {
+        capture = BookCapture<Bond>::Load(input, [](const string& _productId) { return BondInfo(_productId); });
+    } else {
+        ifstream data(input);
+        if (!data) throw std::runtime_error("Cannot open market data file: " + input);
+        BondMarketDataService<Bond> reader;
+        for (auto& book : reader.GetConnector()->Read(data)) capture.Append(book);
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - load).count();
+    cout << "[INFO] Loaded " << capture.GetSize() << " books of " << capture.GetProducts().size()
+         << " products from " << input << " in " << fixed << setprecision(2) << loadSeconds << "s" << endl;
+    if (argc > 3) {
+        capture.Save(argv[3]);
+        cout << "[INFO] Capture written to " << argv[3] << endl;
+    }
+
+    // Each worker takes the next configuration until the grid is done
+    vector<BacktestConfig> grid = Grid();
+    vector<BacktestResult> results(grid.size());
+    atomic<size_t> next{0};
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (size_t t = 0; t < min(threads, grid.size()); ++t) {
+        workers.emplace_back([&] {
+            for (size_t i = next.fetch_add(1); i < grid.size(); i = next.fetch_add(1)) {
+                try {
+                    results[i] = Run(capture, grid[i]);
+                } catch (...) {
+                    results[i].error = current_exception();
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (const auto& result : results) {
+        if (result.error) rethrow_exception(result.error);
+    }
+
+    cout << left << setw(36) << "CONFIGURATION" << right << setw(12) << "LATENCY(us)" << setw(10) << "ORDERS"
+         << setw(12) << "AMENDS/BOOK" << setw(10) << "P50(ns)" << setw(10) << "P99(ns)" << setw(10) << "FILLS"
+         << setw(16) << "FILLED" << setw(16) << "PNL($)" << setw(12) << "BOOKS/S" << endl;
+    size_t best = 0;
+    for (size_t i = 0; i < grid.size(); ++i) {
+        const BacktestResult& result = results[i];
+        cout << left << setw(36) << Describe(grid[i].parameters) << right << setw(12) << grid[i].latency / 1000
+             << setw(10) << result.orders << setw(12) << setprecision(3) << result.amendsPerBook << setw(10)
+             << result.decisionP50 << setw(10) << result.decisionP99 << setw(10) << result.fills << setw(16)
+             << result.filledQuantity << setw(16) << setprecision(0) << result.pnl << setw(12)
+             << result.booksPerSecond << endl;
+        if (result.pnl > results[best].pnl) best = i;
+    }
+    cout << "[INFO] " << grid.size() << " configurations on " << min(threads, grid.size()) << " threads in "
+         << setprecision(2) << seconds << "s, best PnL " << setprecision(0) << results[best].pnl << " with "
+         << Describe(grid[best].parameters) << ", latency " << grid[best].latency / 1000 << "us" << endl;
+    return 0;
+}
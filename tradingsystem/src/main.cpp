@@ -23,12 +23,27 @@
 #include "streamingservice.hpp"
 #include "tradebookingservice.hpp"
 #include "simulatedata.hpp"
+#include "metrics.hpp"
+#include "tracing.hpp"
+#include "coroutine.hpp"
+#include "conflator.hpp"
+#include "signalservice.hpp"
+#include "simulatedexchange.hpp"
+#include "pretradegate.hpp"
+#include "smartorderrouter.hpp"
+#include "executionanalytics.hpp"
+#include "bookstore.hpp"
 
 using namespace std;
 
 int main() {
     cout << ">> Bond Trading System Starting <<" << endl;
 
+#ifdef ENABLE_METRICS
+    // SIGUSR1 dumps the metrics report while the system is running
+    MetricsRegistry::Instance().InstallSignalHandler(SIGUSR1);
+#endif
+
     // Data generation
     cout << "[INFO] Generating simulation data..." << endl;
     DataSimulator simulator;
@@ -42,10 +57,23 @@ int main() {
     PositionService<Bond> positionService;
     RiskService<Bond> riskService;
     BondMarketDataService<Bond> marketDataService;
+    BookConflator<Bond> marketDataConflator;
+    SignalService<Bond> signalService(marketDataService);
+    BookStore<Bond> bookStore(marketDataService);
     AlgoExecutionService<Bond> algoExecutionService;
     AlgoStreamingService<Bond> algoStreamingService;
     GUIService<Bond> guiService;
     ExecutionService<Bond> executionService;
+    SimulatedExchange<Bond> exchange(marketDataService);
+    // Fees per unit of quantity in ticks of price, indexed by Market: they only break ties between venues
+    // quoting the same price
+    SmartOrderRouter<Bond> orderRouter({0.0, 0.02, 0.04});
+    // Markouts 1 second, 10 seconds and 1 minute after each fill
+    ExecutionAnalytics<Bond> executionAnalytics(marketDataService, {1'000'000'000, 10'000'000'000, 60'000'000'000});
+    // Limits per product: 50mm position overall and per book, 100mm PV01, orders within 8/256 of the mid,
+    // at most 1000 orders a second
+    PreTradeGate<Bond> preTradeGate(marketDataService,
+                                    {50'000'000, 50'000'000, 100'000'000.0, Ticks(8), 1000, 1'000'000'000}, CUSIPS_VEC);
     StreamingService<Bond> streamingService;
     BondInquiryService<Bond> inquiryService;
 
@@ -62,12 +90,31 @@ int main() {
     pricingService.AddListener(guiService.GetListener());
     algoStreamingService.AddListener(streamingService.GetListener());
     streamingService.AddListener(historicalStreamingService.GetListener());
-    marketDataService.AddListener(algoExecutionService.GetListener());
-    algoExecutionService.AddListener(executionService.GetListener());
-    executionService.AddListener(tradeBookingService.GetListener());
+    algoExecutionService.SetMarketDataService(&marketDataService);
+    // The analytics take the new mid before the algo can act on a book
+    marketDataService.AddListener(executionAnalytics.GetMarketDataListener());
+    marketDataService.AddListener(&marketDataConflator);
+    marketDataConflator.AddListener(algoExecutionService.GetListener());
+    marketDataService.AddListener(signalService.GetListener());
+    marketDataService.AddListener(&bookStore);
+    algoExecutionService.AddListener(&preTradeGate);
+    preTradeGate.AddListener(executionService.GetListener());
+    marketDataService.AddListener(preTradeGate.GetMarketDataListener());
+    // The analytics see an order before the router sends it on and it fills
+    executionService.AddListener(executionAnalytics.GetExecutionListener());
+    executionService.AddListener(orderRouter.GetListener());
+    marketDataService.AddListener(orderRouter.GetMarketDataListener());
+    orderRouter.AddListener(exchange.GetListener());
+    marketDataService.AddListener(exchange.GetMarketDataListener());
+    exchange.AddListener(orderRouter.GetExchangeListener());
+    orderRouter.AddFillListener(executionService.GetExchangeListener());
+    orderRouter.AddFillListener(tradeBookingService.GetFillListener());
+    orderRouter.AddFillListener(executionAnalytics.GetFillListener());
     executionService.AddListener(historicalExecutionService.GetListener());
     tradeBookingService.AddListener(positionService.GetListener());
     positionService.AddListener(riskService.GetListener());
+    positionService.AddListener(preTradeGate.GetPositionListener());
+    riskService.AddListener(preTradeGate.GetRiskListener());
     positionService.AddListener(historicalPositionService.GetListener());
     riskService.AddListener(historicalRiskService.GetListener());
     inquiryService.AddListener(historicalInquiryService.GetListener());
@@ -76,21 +123,100 @@ int main() {
     // Data processing
     cout << "[INFO] Processing input data..." << endl;
 
-    ifstream priceData("prices.txt");
-    pricingService.GetConnector()->Subscribe(priceData);
-    cout << "[INFO] Price data processed." << endl;
+    // Every feed runs as a coroutine on one scheduler and is interleaved with the others by
+    // logical time, each spreading its messages evenly over the same simulated session
+    constexpr uint64_t SESSION_NANOS = 6'500'000'000'000ULL;
+    constexpr size_t CHANNEL_CAPACITY = 1024;
+    constexpr uint64_t SECURITIES = DataSimulator::TOTAL_SECURITIES;
+    Scheduler scheduler(TIMESTAMP);
+    preTradeGate.SetClock(&scheduler);
+    executionAnalytics.SetClock(&scheduler);
 
+    ifstream priceData("prices.txt");
     ifstream tradeData("trades.txt");
-    tradeBookingService.GetConnector()->Subscribe(tradeData);
-    cout << "[INFO] Trade data processed." << endl;
-
     ifstream marketData("marketdata.txt");
-    marketDataService.GetConnector()->Subscribe(marketData);
-    cout << "[INFO] Market data processed." << endl;
-
     ifstream inquiryData("inquiries.txt");
-    inquiryService.GetConnector()->Subscribe(inquiryData);
-    cout << "[INFO] Inquiry data processed." << endl;
+
+    BoundedChannel<Price<Bond>> priceChannel(scheduler, CHANNEL_CAPACITY);
+    BoundedChannel<Trade<Bond>> tradeChannel(scheduler, CHANNEL_CAPACITY);
+    BoundedChannel<OrderBook<Bond>> marketDataChannel(scheduler, CHANNEL_CAPACITY);
+    BoundedChannel<Inquiry<Bond>> inquiryChannel(scheduler, CHANNEL_CAPACITY);
+
+    scheduler.Spawn(Feed(scheduler, pricingService.GetConnector()->Read(priceData), priceChannel,
+                         SESSION_NANOS / (SECURITIES * DataSimulator::PRICES_PER_SECURITY),
+                         PricingConnector<Bond>::BATCH_SIZE));
+    scheduler.Spawn(pricingService.Drain(priceChannel, PricingConnector<Bond>::BATCH_SIZE));
+
+    scheduler.Spawn(Feed(scheduler, tradeBookingService.GetConnector()->Read(tradeData), tradeChannel,
+                         SESSION_NANOS / (SECURITIES * DataSimulator::TRADES_PER_SECURITY)));
+    scheduler.Spawn(tradeBookingService.Drain(tradeChannel, TradeBookingConnector<Bond>::BATCH_SIZE));
+
+    scheduler.Spawn(Feed(scheduler, marketDataService.GetConnector()->Read(marketData), marketDataChannel,
+                         SESSION_NANOS / (SECURITIES * DataSimulator::PRICES_PER_SECURITY)));
+    scheduler.Spawn(marketDataService.Drain(marketDataChannel));
+    // Algo execution takes the latest book per product at its own pace
+    scheduler.Spawn(marketDataConflator.Pump(
+        scheduler, SESSION_NANOS / (SECURITIES * DataSimulator::PRICES_PER_SECURITY), marketDataChannel));
+
+    scheduler.Spawn(Feed(scheduler, inquiryService.GetConnector()->Read(inquiryData), inquiryChannel,
+                         SESSION_NANOS / (SECURITIES * DataSimulator::INQUIRIES_PER_SECURITY)));
+    scheduler.Spawn(inquiryService.Drain(inquiryChannel));
+
+    scheduler.Run();
+    cout << "[INFO] Price, trade, market and inquiry data processed." << endl;
+    cout << "[INFO] Market data conflation: " << marketDataConflator.GetReceived() << " books received, "
+         << marketDataConflator.GetPublished() << " published, ratio " << marketDataConflator.GetConflationRatio()
+         << "." << endl;
+    cout << "[INFO] Simulated exchange: " << exchange.GetFillCount() << " fills, " << exchange.GetFilledQuantity()
+         << " filled, " << exchange.GetUnfilledCount() << " orders unfilled, " << exchange.GetRestingCount()
+         << " resting." << endl;
+    cout << "[INFO] Order routing: " << orderRouter.GetParentCount() << " orders in " << orderRouter.GetChildCount()
+         << " child orders";
+    for (size_t v = 0; v < MARKET_COUNT; ++v) {
+        Market venue = static_cast<Market>(v);
+        cout << ", " << MarketName(venue) << " " << orderRouter.GetFilledQuantity(venue) << "/"
+             << orderRouter.GetRoutedQuantity(venue) << " filled";
+    }
+    cout << "." << endl;
+    cout << "[INFO] Pre-trade checks: " << preTradeGate.GetCount(PRE_TRADE_PASSED) << " passed";
+    for (size_t r = PRE_TRADE_UNKNOWN_PRODUCT; r < PRE_TRADE_RESULT_COUNT; ++r) {
+        PreTradeResult result = static_cast<PreTradeResult>(r);
+        cout << ", " << preTradeGate.GetCount(result) << " " << PreTradeResultName(result);
+    }
+    cout << "." << endl;
+    for (size_t a = 0; a < EXECUTION_ALGO_COUNT; ++a) {
+        ExecutionAlgo algo = static_cast<ExecutionAlgo>(a);
+        ExecutionStats stats = executionAnalytics.GetStats(algo);
+        if (stats.orders == 0) continue;
+        cout << "[INFO] Execution quality " << ExecutionAlgoName(algo) << ": " << stats.orders << " orders, fill ratio "
+             << stats.GetFillRatio() << ", slippage " << stats.GetSlippage() << ", shortfall " << stats.GetShortfall()
+             << ", markouts 1s/10s/60s " << stats.GetMarkout(0) << "/" << stats.GetMarkout(1) << "/"
+             << stats.GetMarkout(2) << " ticks." << endl;
+    }
+    cout << "[INFO] Execution orders: " << executionService.GetOrderStore().GetOpenCount() << " open, "
+         << executionService.GetOrderStore().GetSize() << " tracked in "
+         << executionService.GetOrderStore().GetCapacity() << " slots." << endl;
+    cout << "[INFO] Book store: " << bookStore.GetSize() << " products, " << bookStore.CountSpreadAtMost(Ticks(Ticks::PER_32ND))
+         << " at most 1/32 wide, tightest spread " << bookStore.MinSpread().Count() << " ticks, "
+         << bookStore.TotalBidSize() << " bid and " << bookStore.TotalOfferSize() << " offered at the top." << endl;
+    for (const auto& cusip : CUSIPS_VEC) {
+        const MarketSignal<Bond>& signal = signalService.GetData(cusip);
+        cout << "[INFO] Market signals " << cusip << ": spread p50/p90/p99 " << signal.GetSpreadMedian() << "/"
+             << signal.GetSpreadP90() << "/" << signal.GetSpreadP99() << " ticks, mid volatility "
+             << signal.GetVolatility() << " ticks, imbalance " << signal.GetImbalance() << "." << endl;
+    }
+
+#ifdef ENABLE_METRICS
+    MetricsRegistry::Instance().Dump("metrics");
+    MetricsRegistry::Instance().Report(cout);
+    cout << "[INFO] Metrics written to metrics.txt and metrics.json." << endl;
+#endif
+
+#ifdef ENABLE_TRACING
+    LatencyTracer::Instance().Dump("latency");
+    LatencyTracer::Instance().Report(cout);
+    cout << "[INFO] Latency traces written to latency.txt and latency.json." << endl;
+#endif
 
     cout << ">> Bond Trading System Completed <<" << endl;
 